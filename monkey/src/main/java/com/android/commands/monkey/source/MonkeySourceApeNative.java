@@ -64,6 +64,9 @@ import android.view.accessibility.AccessibilityNodeInfo;
 
 import android.util.Base64;
 import java.io.ByteArrayOutputStream;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.StandardCharsets;
 import java.util.ArrayList;
 import java.util.List;
 import org.json.JSONArray;
@@ -486,22 +489,22 @@ public class MonkeySourceApeNative implements MonkeyEventSource {
         }
         
         try {
-            // 创建一个Map存储所有提取的图标信息
-        Map<String, String> iconMap = new HashMap<>();
+            // 创建一个Map存储所有提取的图标信息（PNG字节）
+            Map<String, byte[]> iconMap = new HashMap<>();
         
             // 递归遍历UI树并提取图标，限制最大图标数量以避免内存问题
-        extractWidgetIconsRecursive(rootNode, iconMap);
+            extractWidgetIconsRecursive(rootNode, iconMap);
         
-        // 如果有图标被提取，将它们序列化并传递到C++端
-        if (!iconMap.isEmpty()) {
+            // 如果有图标被提取，按二进制格式写入direct buffer交给C++端，native端只拷贝入队，解码在后台完成
+            if (!iconMap.isEmpty()) {
                 Logger.println("Extracted " + iconMap.size() + " widget icons from " + activityName);
-            String serializedIcons = serializeWidgetIcons(iconMap);
-                
-            // 调用JNI方法将序列化后的图标信息传递到C++端
-                try {
-                    sendWidgetIconsToNative(activityName, serializedIcons);
-                } catch (Exception e) {
-                    Logger.errorPrintln("Failed to send widget icons to native: " + e.getMessage());
+                int length = serializeWidgetIcons(iconMap);
+                if (length > 0) {
+                    try {
+                        sendWidgetIconsToNative(activityName, length);
+                    } catch (Exception e) {
+                        Logger.errorPrintln("Failed to send widget icons to native: " + e.getMessage());
+                    }
                 }
             }
         } catch (Exception e) {
@@ -509,7 +512,7 @@ public class MonkeySourceApeNative implements MonkeyEventSource {
         }
     }
 
-    private void extractWidgetIconsRecursive(AccessibilityNodeInfo node, Map<String, String> iconMap) {
+    private void extractWidgetIconsRecursive(AccessibilityNodeInfo node, Map<String, byte[]> iconMap) {
         if (node == null) return;
         
         // 检查节点是否可点击、可滚动等可交互属性
@@ -526,12 +529,12 @@ public class MonkeySourceApeNative implements MonkeyEventSource {
                 // 生成widget的唯一标识
                 String widgetId = getWidgetIdentifier(node);
                 
-                // 将图标转换为Base64字符串
-                String base64Icon = bitmapToBase64(iconBitmap);
+                // 将图标压缩为PNG字节
+                byte[] pngIcon = bitmapToPng(iconBitmap);
                 
                     // 只有当转换成功时才添加到Map中
-                    if (!base64Icon.isEmpty()) {
-                iconMap.put(widgetId, base64Icon);
+                    if (pngIcon.length > 0) {
+                iconMap.put(widgetId, pngIcon);
                     }
                 }
             } catch (Exception e) {
@@ -636,23 +639,22 @@ public class MonkeySourceApeNative implements MonkeyEventSource {
     }
 
     /**
-     * 将Bitmap转换为字节数组
+     * 将Bitmap转换为PNG字节数组
      * @param bitmap 要转换的Bitmap
-     * @return 转换后的字节数组
+     * @return 转换后的字节数组，失败时为空数组
      */ 
-    private String bitmapToBase64(Bitmap bitmap) {
+    private byte[] bitmapToPng(Bitmap bitmap) {
         if (bitmap == null || bitmap.isRecycled()) {
-            Logger.errorPrintln("Cannot convert null or recycled bitmap to Base64");
-            return "";
+            Logger.errorPrintln("Cannot convert null or recycled bitmap to PNG");
+            return new byte[0];
         }
         ByteArrayOutputStream stream = new ByteArrayOutputStream();
         try {
-        bitmap.compress(Bitmap.CompressFormat.PNG, 100, stream);
-        byte[] byteArray = stream.toByteArray();
-        return Base64.encodeToString(byteArray, Base64.DEFAULT);
+            bitmap.compress(Bitmap.CompressFormat.PNG, 100, stream);
+            return stream.toByteArray();
         } catch (Exception e) {
-            Logger.errorPrintln("Error converting bitmap to Base64: " + e.getMessage());
-            return "";
+            Logger.errorPrintln("Error converting bitmap to PNG: " + e.getMessage());
+            return new byte[0];
         } finally {
             try {
                 stream.close();
@@ -661,55 +663,83 @@ public class MonkeySourceApeNative implements MonkeyEventSource {
             }
         }
     }
+
+    // 二进制图标包的格式常量，需与native端IconIngestion.cpp保持一致
+    private static final int ICON_BUFFER_MAGIC = 0x43494246; // "FBIC"
+    private static final short ICON_BUFFER_VERSION = 1;
+    private static final int MAX_ICONS_PER_BUFFER = 20;
+    private static final int MAX_ICON_BYTES = 75000;
+
+    // 复用的direct buffer，容量不够时按需扩大
+    private ByteBuffer mIconBuffer;
+
     /**
-     * 序列化Widget图标信息为JSON字符串
-     * @param iconMap 包含widget ID和对应图标Base64字符串的映射
-     * @return 序列化后的JSON字符串
+     * 将Widget图标写入复用的direct buffer：
+     * uint32 magic | uint16 version | uint16 count，之后每个图标为
+     * uint16 keyLength | uint16 reserved | uint32 imageLength | key(UTF-8) | image，全部为本机字节序
+     * @param iconMap 包含widget ID和对应图标PNG字节的映射
+     * @return 写入的字节数，没有可发送的图标时为0
      */
-    private String serializeWidgetIcons(Map<String, String> iconMap) {
+    private int serializeWidgetIcons(Map<String, byte[]> iconMap) {
         if (iconMap == null || iconMap.isEmpty()) {
-            return "{}";
+            return 0;
+        }
+
+        // 限制图标数量和单个图标大小，避免单次传输过大
+        List<byte[]> keys = new ArrayList<>();
+        List<byte[]> images = new ArrayList<>();
+        int length = 8;
+        for (Map.Entry<String, byte[]> entry : iconMap.entrySet()) {
+            if (keys.size() >= MAX_ICONS_PER_BUFFER) break;
+            byte[] key = entry.getKey() == null ? null : entry.getKey().getBytes(StandardCharsets.UTF_8);
+            byte[] image = entry.getValue();
+            if (key == null || key.length == 0 || key.length > 0xFFFF
+                    || image == null || image.length == 0 || image.length > MAX_ICON_BYTES) {
+                continue;
+            }
+            keys.add(key);
+            images.add(image);
+            length += 8 + key.length + image.length;
+        }
+        if (keys.isEmpty()) {
+            return 0;
         }
-        
-        try {
-            JSONObject jsonObject = new JSONObject();
-            
-            // 限制图标数量，避免JSON过大
-            int maxIcons = 20;
-            int count = 0;
 
-            // 遍历Map，将每个键值对添加到JSON对象中
-            for (Map.Entry<String, String> entry : iconMap.entrySet()) {
-                if (count++ >= maxIcons) break;
-                
-                String key = entry.getKey();
-                String value = entry.getValue();
-                
-                // 验证值不为空且长度合理
-                if (key != null && value != null && !value.isEmpty() && value.length() < 100000) {
-                    jsonObject.put(key, value);
-                }
+        try {
+            if (mIconBuffer == null || mIconBuffer.capacity() < length) {
+                mIconBuffer = ByteBuffer.allocateDirect(Math.max(length, 256 * 1024)).order(ByteOrder.nativeOrder());
             }
-
-            return jsonObject.toString();
-        } catch (JSONException e) {
-            Logger.errorPrintln("Failed to serialize widget icons: " + e.getMessage());
-            return "{}";
         } catch (OutOfMemoryError e) {
             Logger.errorPrintln("Out of memory when serializing widget icons");
-            return "{}";
+            mIconBuffer = null;
+            return 0;
         }
+        ByteBuffer buffer = mIconBuffer;
+        buffer.clear();
+        buffer.putInt(ICON_BUFFER_MAGIC);
+        buffer.putShort(ICON_BUFFER_VERSION);
+        buffer.putShort((short) keys.size());
+        for (int i = 0; i < keys.size(); i++) {
+            buffer.putShort((short) keys.get(i).length);
+            buffer.putShort((short) 0);
+            buffer.putInt(images.get(i).length);
+            buffer.put(keys.get(i));
+            buffer.put(images.get(i));
+        }
+        return buffer.position();
     }
 
     
     /**
-     * 将序列化后的Widget图标信息发送到C++端
+     * 将写好的图标包发送到C++端
      * @param activityName 当前活动的名称
-     * @param serializedIcons 序列化后的图标信息
+     * @param length 图标包的字节数
      */
-    private void sendWidgetIconsToNative(String activityName, String serializedIcons) {
+    private void sendWidgetIconsToNative(String activityName, int length) {
         try {
-            AiClient.setWidgetIcons(activityName, serializedIcons);
+            if (!AiClient.setWidgetIconBuffer(activityName, mIconBuffer, length)) {
+                Logger.errorPrintln("Native rejected widget icon buffer of " + length + " bytes");
+            }
         } catch (Exception e) {
             Logger.errorPrintln("Failed to send widget icons to native: " + e.getMessage());
         }
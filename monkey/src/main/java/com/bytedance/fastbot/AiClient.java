@@ -11,6 +11,7 @@ import android.os.SystemClock;
 import com.android.commands.monkey.fastbot.client.Operate;
 import com.android.commands.monkey.utils.Logger;
 
+import java.nio.ByteBuffer;
 import java.util.Arrays;
 import java.util.List;
 import java.util.concurrent.TimeUnit;
@@ -180,4 +181,14 @@ public class AiClient {
      * @param serializedIcons 序列化后的图标信息JSON字符串
      */
     public static native void setWidgetIcons(String activityName, String serializedIcons);
+
+    /**
+     * 通过direct buffer发送Widget图标（二进制格式，见MonkeySourceApeNative.serializeWidgetIcons）
+     * native端拷贝后立即返回，解码和嵌入在后台线程完成
+     * @param activityName 当前活动的名称
+     * @param buffer direct ByteBuffer
+     * @param length 有效字节数
+     * @return 格式正确并已入队时返回true
+     */
+    public static native boolean setWidgetIconBuffer(String activityName, ByteBuffer buffer, int length);
 }
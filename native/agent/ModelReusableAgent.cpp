@@ -12,6 +12,8 @@
 #include <cmath>
 #include "ActivityNameAction.h"
 #include "ReuseModel_generated.h"
+#include "MappedModelFile.h"
+#include <cstdio>
 #include <iostream>
 #include <fstream>
 #include <limits>
@@ -21,6 +23,11 @@
 
 namespace fastbotx {
 
+    struct ModelReusableAgent::MappedReuseModel {
+        MappedModelFilePtr file;
+        SortedEntryTable<ReuseEntry> entries;
+    };
+
     ModelReusableAgent::ModelReusableAgent(const ModelPtr &model)
             : AbstractAgent(model), _alpha(SarsaRLDefaultAlpha), _epsilon(SarsaRLDefaultEpsilon),
               _modelSavePath(""), _defaultModelSavePath("") {
@@ -117,25 +124,46 @@ namespace fastbotx {
 
         BLOG("Computing probability for action hash=%llu", actionHash);
 
+        auto countActivity = [&total, &unvisited, &visitedActivities](const stringPtr &activity, int count) {
+            total += count;//当前action的总执行次数
+            bool isVisited = visitedActivities.find(activity) != visitedActivities.end();
+
+            BLOG("  Activity: %s, count: %d, visited: %s",
+                 activity->c_str(), count, isVisited ? "yes" : "no");
+
+            if (!isVisited) {
+                unvisited += count;//执行完action后遇到当前未访问过的activity次数
+            }
+        };
+
         // find this action in this model according to its int hash
         // according to the given action, get the activities that this action could reach in reuse model.
+        // Entries touched in this run take precedence over the mapped model file.
         auto actionMapIterator = this->_reuseModel.find(actionHash);//(*actionMapIterator).first is hash, second is ReuseEntryMap --by me,init in line 496
-        if (actionMapIterator != this->_reuseModel.end()) {
-            BLOG("Action %llu found in reuse model with %zu target activities",
-                 actionHash, (*actionMapIterator).second.size());
-
+        const ReuseEntry *baseEntry = nullptr;
+        if (actionMapIterator == this->_reuseModel.end() && this->_reuseModelBase) {
+            baseEntry = this->_reuseModelBase->entries.find(actionHash);
+        }
+        if (actionMapIterator != this->_reuseModel.end() || nullptr != baseEntry) {
             // Iterate the map containing entry of activity name and visited count
             // to ascertain the unvisited activity count according to the pre-saved reuse model
-            for (const auto &activityCountMapIterator: (*actionMapIterator).second) {
-                total += activityCountMapIterator.second;//当前action的总执行次数
-                stringPtr activity = activityCountMapIterator.first;
-                bool isVisited = visitedActivities.find(activity) != visitedActivities.end();
-
-                BLOG("  Activity: %s, count: %d, visited: %s",
-                     activity->c_str(), activityCountMapIterator.second, isVisited ? "yes" : "no");
-
-                if (!isVisited) {
-                    unvisited += activityCountMapIterator.second;//执行完action后遇到当前未访问过的activity次数
+            if (actionMapIterator != this->_reuseModel.end()) {
+                BLOG("Action %llu found in reuse model with %zu target activities",
+                     actionHash, (*actionMapIterator).second.size());
+                for (const auto &activityCountMapIterator: (*actionMapIterator).second) {
+                    countActivity(activityCountMapIterator.first, activityCountMapIterator.second);
+                }
+            } else if (baseEntry->targets()) {
+                BLOG("Action %llu found in reuse model with %u target activities",
+                     actionHash, baseEntry->targets()->size());
+                // the activity names are read from the mapped file, one probe string is reused for the set lookup
+                stringPtr activity = std::make_shared<std::string>();
+                for (const auto *target: *baseEntry->targets()) {
+                    if (nullptr == target->activity()) {
+                        continue;
+                    }
+                    activity->assign(target->activity()->c_str(), target->activity()->size());
+                    countActivity(activity, target->times());
                 }
             }
 
@@ -165,7 +193,7 @@ namespace fastbotx {
             uintptr_t actionHash = action->hash();
             // if this action is new, increment the value by 1, else by 0.5
             // If this action has not been visited yet.
-            if (this->_reuseModel.find(actionHash) == this->_reuseModel.end()) {
+            if (!this->isActionInReuseModel(actionHash)) {
                 value += 1.0;
             }
                 // If this action is been performed in current testing.
@@ -237,15 +265,11 @@ namespace fastbotx {
             return;
         {
             std::lock_guard<std::mutex> reuseGuard(this->_reuseModelLock);
-            auto iter = this->_reuseModel.find(hash);
-            if (iter == this->_reuseModel.end()) {
+            if (!this->isActionInReuseModel(hash)) {
                 BDLOG("can not find action %s in reuse map", modelAction->getId().c_str());
-                ReuseEntryM entryMap;
-                entryMap.emplace(std::make_pair(activity, 1));//this->_reuseModel的数据格式为：hash->(activity->count)
-                this->_reuseModel[hash] = entryMap;//此处为this->_reuseModel真正初始化的地方
-            } else {
-                ((*iter).second)[activity] += 1;//更新当前action的执行次数
             }
+            // this->_reuseModel的数据格式为：hash->(activity->count)，模型文件中的条目第一次更新时才复制过来
+            this->mutableReuseEntry(hash)[activity] += 1;//更新当前action的执行次数
             auto qValueReuseEntryIter = this->_reuseQValue.find(hash);
             this->_reuseQValue[hash] = modelAction->getQValue();
         }
@@ -298,6 +322,15 @@ namespace fastbotx {
         }
         BLOG("No action found in randomPickUnvisitedAction");
 
+        // all the actions of this state are explored, walk towards a state that is not
+        BLOG("Trying selectActionTowardsFrontier");
+        action = this->selectActionTowardsFrontier();
+        if (nullptr != action) {
+            BLOG("%s", "select action towards frontier");
+            return action;
+        }
+        BLOG("No action found in selectActionTowardsFrontier");
+
         // if all the actions are explored, use those two methods to generate new action based on q value.
         // there are two methods to choose from.
         // based on q value and a uniform distribution, select an action with the highest value.
@@ -338,8 +371,7 @@ namespace fastbotx {
         std::vector<ActionPtr> actionsNotInModel;
         for (const auto &action: this->_newState->getActions()) {
             bool matched = action->isModelAct() // should be one of aforementioned actions.
-                           && (this->_reuseModel.find(action->hash()) ==
-                               this->_reuseModel.end()) // this action should not be in reuse model
+                           && !this->isActionInReuseModel(action->hash()) // this action should not be in reuse model
                            && action->getVisitedCount() <=
                               0; // find the action that not been explored before
             if (matched) {
@@ -373,8 +405,8 @@ namespace fastbotx {
         BLOG("Searching for unperformed actions in reuse model...");
 
         // 首先检查重用模型是否为空
-        BLOG("Reuse model size: %zu", this->_reuseModel.size());
-        if (this->_reuseModel.empty()) {
+        BLOG("Reuse model size: %zu", this->reuseModelSize());
+        if (0 == this->reuseModelSize()) {
             BLOG("Reuse model is empty, cannot select action from reuse model");
             return nullptr;
         }
@@ -391,7 +423,7 @@ namespace fastbotx {
         // 检查有多少操作在重用模型中
         int actionsInModel = 0;
         for (const auto &action: targetActions) {
-            if (this->_reuseModel.find(action->hash()) != this->_reuseModel.end()) {
+            if (this->isActionInReuseModel(action->hash())) {
                 actionsInModel++;
                 BLOG("Action hash=%llu found in reuse model", action->hash());
             } else {
@@ -406,8 +438,7 @@ namespace fastbotx {
             BLOG("Processing action hash=%llu, type=%s, visitedCount=%d",
                  actionHash, actName[action->getActionType()].c_str(), action->getVisitedCount());
 
-            if (this->_reuseModel.find(actionHash) !=
-                this->_reuseModel.end()) // found this action in reuse model
+            if (this->isActionInReuseModel(actionHash)) // found this action in reuse model
             {
                 BLOG("Found action %llu in reuse model", actionHash);
                 if (action->getVisitedCount() >
@@ -470,6 +501,17 @@ namespace fastbotx {
     /// Select an action with the largest quality value based on
     /// its quality value and the uniform distribution
     /// \return the selected action with the highest quality value
+// the frontier is searched over the observed transitions, at most this many steps away
+#define FrontierPlanMaxDepth 8
+
+    ActionPtr ModelReusableAgent::selectActionTowardsFrontier() const {
+        auto modelPointer = this->_model.lock();
+        if (!modelPointer || nullptr == this->_newState) {
+            return nullptr;
+        }
+        return modelPointer->getGraph()->planActionToFrontier(this->_newState, FrontierPlanMaxDepth);
+    }
+
     ActionPtr ModelReusableAgent::selectActionByQValue() {
         ActionPtr returnAction = nullptr;
         float maxQ = -MAXFLOAT;
@@ -481,8 +523,7 @@ namespace fastbotx {
             // it won't happen, since if there is am unvisited action in state, it will be
             // visited before this method is called.
             if (action->getVisitedCount() <= 0) {//不考虑
-                auto iterator = this->_reuseModel.find(actionHash);
-                if (iterator != this->_reuseModel.end()) {
+                if (this->isActionInReuseModel(actionHash)) {
                     qv += this->probabilityOfVisitingNewActivities(action, visitedActivities);
                 } else {
                     BDLOG("qvalue pick return a action: %s", action->toString().c_str());
@@ -545,70 +586,80 @@ namespace fastbotx {
         }
         BLOG("begin load model: %s", this->_modelSavePath.c_str());
 
-        std::ifstream modelFile(modelFilePath, std::ios::binary | std::ios::in);
-        if (modelFile.fail()) {
+        // the model file is mapped and queried in place, entries are only copied out when they get new observations
+        MappedModelFilePtr modelFile = MappedModelFile::open(modelFilePath);
+        if (!modelFile) {
             BLOG("read model file %s failed, check if file exists!", modelFilePath.c_str());
-            BLOG("Current _reuseModel will remain empty (size: %zu)", this->_reuseModel.size());
+            BLOG("Current _reuseModel will remain empty (size: %zu)", this->reuseModelSize());
             return;
         }
+        auto reuseFBModel = GetReuseModel(modelFile->data());
+        auto reusedModelDataPtr = reuseFBModel->model();
+        std::shared_ptr<MappedReuseModel> modelBase;
+        if (reusedModelDataPtr) {
+            modelBase = std::make_shared<MappedReuseModel>();
+            modelBase->file = modelFile;
+            modelBase->entries.reset(reusedModelDataPtr);
+        }
 
-        // load  model file to struct
-        std::filebuf *fileBuffer = modelFile.rdbuf();
-        // returns the new position of the altered control stream, which is the end of the file
-        std::size_t filesize = fileBuffer->pubseekoff(0, modelFile.end, modelFile.in);
-        // reset the position of the controlled stream
-        fileBuffer->pubseekpos(0, modelFile.in);
-        char *modelFileData = new char[filesize];
-        //Reads count characters from the input sequence and stores them into a character array.
-        fileBuffer->sgetn(modelFileData, static_cast<int>(filesize));
-        auto reuseFBModel = GetReuseModel(modelFileData);
-
-        // to std::map
         {
             std::lock_guard<std::mutex> reuseGuard(this->_reuseModelLock);
             this->_reuseModel.clear();
             this->_reuseQValue.clear();
+            this->_reuseModelNewEntries = 0;
+            this->_reuseModelBase = modelBase;
         }
-        auto reusedModelDataPtr = reuseFBModel->model();
-        if (!reusedModelDataPtr) {
+        if (!modelBase) {
             BLOG("%s", "model data is null");
             return;
         }
-        for (int entryIndex = 0; entryIndex < reusedModelDataPtr->size(); entryIndex++) {
-            auto reuseEntryInReuseModel = reusedModelDataPtr->Get(entryIndex);
-            uint64_t actionHash = reuseEntryInReuseModel->action();
-            auto activityEntry = reuseEntryInReuseModel->targets();
-            ReuseEntryM entryPtr;
-            for (int targetIndex = 0; targetIndex < activityEntry->size(); targetIndex++) {
-                auto targetEntry = activityEntry->Get(targetIndex);
-                BDLOG("load model hash: %llu %s %d", actionHash,
-                      targetEntry->activity()->str().c_str(), (int) targetEntry->times());//actionHash->activity_name->count
-                entryPtr.insert(std::make_pair(
-                        std::make_shared<std::string>(targetEntry->activity()->str()),
-                        (int) targetEntry->times()));
-            }
-            if (!entryPtr.empty()) {
-                std::lock_guard<std::mutex> reuseGuard(this->_reuseModelLock);
-//            this->_reuseQValue.insert(std::make_pair(actionHash, reuseEntryInReuseModel->quality()));
-                this->_reuseModel.insert(std::make_pair(actionHash, entryPtr));//把模型数据取出来存到当前的_reuseModel中
-            }
-        }
-        BLOG("loaded model contains actions: %zu", this->_reuseModel.size());
+        BLOG("loaded model contains actions: %zu (%zu bytes, %s)", this->reuseModelSize(), modelFile->size(),
+             modelFile->mapped() ? "mapped" : "read");
 
         // 打印加载的模型内容摘要
-        if (this->_reuseModel.size() > 0) {
+        if (this->reuseModelSize() > 0) {
             BLOG("Sample of loaded reuse model:");
-            int count = 0;
-            for (const auto &entry : this->_reuseModel) {
-                if (count >= 5) break; // 只打印前5个条目
-                BLOG("  Action hash=%llu has %zu target activities", entry.first, entry.second.size());
-                count++;
+            for (size_t entryIndex = 0; entryIndex < modelBase->entries.size() && entryIndex < 5; entryIndex++) { // 只打印前5个条目
+                auto reuseEntryInReuseModel = modelBase->entries.at(entryIndex);
+                BLOG("  Action hash=%llu has %u target activities", reuseEntryInReuseModel->action(),
+                     reuseEntryInReuseModel->targets() ? reuseEntryInReuseModel->targets()->size() : 0);
             }
         } else {
             BLOG("WARNING: Reuse model is empty after loading!");
         }
+    }
+
+    bool ModelReusableAgent::isActionInReuseModel(uint64_t actionHash) const {
+        if (this->_reuseModel.find(actionHash) != this->_reuseModel.end()) {
+            return true;
+        }
+        return this->_reuseModelBase && nullptr != this->_reuseModelBase->entries.find(actionHash);
+    }
 
-        delete[] modelFileData;
+    size_t ModelReusableAgent::reuseModelSize() const {
+        return (this->_reuseModelBase ? this->_reuseModelBase->entries.size() : 0) + this->_reuseModelNewEntries;
+    }
+
+    ReuseEntryM &ModelReusableAgent::mutableReuseEntry(uint64_t actionHash) {
+        auto iter = this->_reuseModel.find(actionHash);
+        if (iter != this->_reuseModel.end()) {
+            return iter->second;
+        }
+        ReuseEntryM &entryMap = this->_reuseModel[actionHash];
+        const ReuseEntry *baseEntry = this->_reuseModelBase ? this->_reuseModelBase->entries.find(actionHash) : nullptr;
+        if (nullptr == baseEntry) {
+            this->_reuseModelNewEntries++;
+            return entryMap;
+        }
+        if (baseEntry->targets()) {
+            for (const auto *targetEntry: *baseEntry->targets()) {
+                if (targetEntry->activity()) {
+                    entryMap.insert(std::make_pair(std::make_shared<std::string>(targetEntry->activity()->str()),
+                                                   (int) targetEntry->times()));
+                }
+            }
+        }
+        return entryMap;
     }
 
     std::string ModelReusableAgent::DefaultModelSavePath = "";
@@ -630,19 +681,47 @@ namespace fastbotx {
     // ...
     // }
     void ModelReusableAgent::saveReuseModel(const std::string &modelFilepath) {
+        this->writeReuseModel(modelFilepath);
+    }
+
+    void ModelReusableAgent::writeReuseModel(const std::string &modelFilepath) {
         flatbuffers::FlatBufferBuilder builder;
         std::vector<flatbuffers::Offset<fastbotx::ReuseEntry>> actionActivityVector;
         // loaded, but not visited
         {
             std::lock_guard<std::mutex> reuseGuard(this->_reuseModelLock);
-            for (const auto &actionIterator: this->_reuseModel) {//reuseModel的数据格式为：hash->(activity->count)
-                uint64_t actionHash = actionIterator.first;
-                ReuseEntryM activityCountEntryMap = actionIterator.second;
+            // both the mapped entries and the touched entries are sorted by action hash, merge them so that
+            // the output stays sorted for LookupByKey; a touched entry replaces the mapped one with the same hash
+            size_t baseIndex = 0;
+            size_t baseCount = this->_reuseModelBase ? this->_reuseModelBase->entries.size() : 0;
+            auto actionIterator = this->_reuseModel.begin();
+            while (baseIndex < baseCount || actionIterator != this->_reuseModel.end()) {
+                const ReuseEntry *baseEntry =
+                        baseIndex < baseCount ? this->_reuseModelBase->entries.at(baseIndex) : nullptr;
                 std::vector<flatbuffers::Offset<fastbotx::ActivityTimes>> activityCountEntryVector; // flat buffer needs vector rather than map
-                for (const auto &activityCountEntry: activityCountEntryMap) {
-                    auto sentryActT = CreateActivityTimes(builder, builder.CreateString(
-                            *(activityCountEntry.first)), activityCountEntry.second);
-                    activityCountEntryVector.push_back(sentryActT);
+                uint64_t actionHash;
+                if (actionIterator != this->_reuseModel.end() &&
+                    (nullptr == baseEntry || actionIterator->first <= baseEntry->action())) {
+                    actionHash = actionIterator->first;//reuseModel的数据格式为：hash->(activity->count)
+                    if (baseEntry && baseEntry->action() == actionHash) {
+                        baseIndex++;
+                    }
+                    for (const auto &activityCountEntry: actionIterator->second) {
+                        auto sentryActT = CreateActivityTimes(builder, builder.CreateString(
+                                *(activityCountEntry.first)), activityCountEntry.second);
+                        activityCountEntryVector.push_back(sentryActT);
+                    }
+                    ++actionIterator;
+                } else {
+                    actionHash = baseEntry->action();
+                    if (baseEntry->targets()) {
+                        for (const auto *targetEntry: *baseEntry->targets()) {
+                            auto sentryActT = CreateActivityTimes(builder, builder.CreateString(
+                                    targetEntry->activity()), targetEntry->times());
+                            activityCountEntryVector.push_back(sentryActT);
+                        }
+                    }
+                    baseIndex++;
                 }
                 auto savedActivityCountEntries = CreateReuseEntry(builder, actionHash,
                                                                   builder.CreateVector(
@@ -659,10 +738,20 @@ namespace fastbotx {
         std::string outputFilePath = modelFilepath;
         if (outputFilePath.empty()) // if the passed argument modelFilepath is "", use the tmpSavePath
             outputFilePath = this->_defaultModelSavePath;
+        if (outputFilePath.empty()) {
+            BLOG("%s", "model save path is empty, skip saving");
+            return;
+        }
         BLOG("save model to path: %s", outputFilePath.c_str());
-        std::ofstream outputFile(outputFilePath, std::ios::binary);
+        // the loaded model may still be mapped from this path: write a new file and rename it over the old one
+        std::string tempFilePath = outputFilePath + ".tmp";
+        std::ofstream outputFile(tempFilePath, std::ios::binary);
         outputFile.write((char *) builder.GetBufferPointer(), static_cast<int>(builder.GetSize()));
         outputFile.close();
+        if (!outputFile.good() || 0 != std::rename(tempFilePath.c_str(), outputFilePath.c_str())) {
+            BLOGE("save model to path %s failed", outputFilePath.c_str());
+            std::remove(tempFilePath.c_str());
+        }
     }
 
     // {用widget->hash()作为key，保存widget->count}?
@@ -683,39 +772,8 @@ namespace fastbotx {
     // ...
     // }
     void ModelReusableAgent::saveReuseModel_at_widget_level(const std::string &modelFilepath) {
-        flatbuffers::FlatBufferBuilder builder;
-        std::vector<flatbuffers::Offset<fastbotx::ReuseEntry>> actionActivityVector;
-        // loaded, but not visited
-        {
-            std::lock_guard<std::mutex> reuseGuard(this->_reuseModelLock);
-            for (const auto &actionIterator: this->_reuseModel) {//reuseModel的数据格式为：hash->(activity->count)
-                uint64_t actionHash = actionIterator.first;
-                ReuseEntryM activityCountEntryMap = actionIterator.second;//todo: 从activity->count 转换为 widget->count
-                std::vector<flatbuffers::Offset<fastbotx::ActivityTimes>> activityCountEntryVector; // flat buffer needs vector rather than map
-                for (const auto &activityCountEntry: activityCountEntryMap) {
-                    auto sentryActT = CreateActivityTimes(builder, builder.CreateString(//todo: 需要设计一个CreateWidgetTimes
-                            *(activityCountEntry.first)), activityCountEntry.second);
-                    activityCountEntryVector.push_back(sentryActT);
-                }
-                auto savedActivityCountEntries = CreateReuseEntry(builder, actionHash,
-                                                                  builder.CreateVector(
-                                                                          activityCountEntryVector.data(),
-                                                                          activityCountEntryVector.size()));
-                actionActivityVector.push_back(savedActivityCountEntries);
-            }
-        }
-        auto savedActionActivityEntries = CreateReuseModel(builder, builder.CreateVector(
-                actionActivityVector.data(), actionActivityVector.size()));
-        builder.Finish(savedActionActivityEntries);
-
-        //save to local file
-        std::string outputFilePath = modelFilepath;
-        if (outputFilePath.empty()) // if the passed argument modelFilepath is "", use the tmpSavePath
-            outputFilePath = this->_defaultModelSavePath;
-        BLOG("save model to path: %s", outputFilePath.c_str());
-        std::ofstream outputFile(outputFilePath, std::ios::binary);
-        outputFile.write((char *) builder.GetBufferPointer(), static_cast<int>(builder.GetSize()));
-        outputFile.close();
+        //todo: 从activity->count 转换为 widget->count，需要设计一个CreateWidgetTimes
+        this->writeReuseModel(modelFilepath);
     }
 
 }
@@ -70,8 +70,18 @@ namespace fastbotx {
 
         ActionPtr selectActionByQValue();
 
+        /// When every action of the new state has been performed, take the first step of the shortest known
+        /// path to a state that still has unperformed actions
+        /// \return The first action on the path, or nullptr if no such state is reachable within a few steps
+        ActionPtr selectActionTowardsFrontier() const;
+
         void computeAlphaValue();
 
+        // 复用模型查询：先查本次运行中修改过的条目，再查映射的模型文件
+        bool isActionInReuseModel(uint64_t actionHash) const;
+
+        size_t reuseModelSize() const;
+
 
     protected:
         double _alpha{};
@@ -84,6 +94,7 @@ namespace fastbotx {
     protected:  // 改为 protected 以便子类访问
         // A map containing entry of hash code of Action and map, which containing entry of name of activity that this
         // action goes to and the count of this very activity being visited.
+        // Only entries touched in this run live here; the rest are read in place from the mapped model file.
         ReuseEntryIntMap _reuseModel;
         ReuseEntryQValueMap _reuseQValue;
         std::string _modelSavePath;
@@ -96,6 +107,19 @@ namespace fastbotx {
         double getQValue(const ActionPtr &action);
 
         void setQValue(const ActionPtr &action, double qValue);
+
+    private:
+        // 加载的模型文件：按key排序的ReuseEntry表直接在映射区上查询
+        struct MappedReuseModel;
+        std::shared_ptr<const MappedReuseModel> _reuseModelBase;
+        // _reuseModel中不在模型文件里的条目数
+        size_t _reuseModelNewEntries{0};
+
+        // 取得可修改的条目，模型文件中已有的条目第一次修改时复制过来；调用方需持有_reuseModelLock
+        ReuseEntryM &mutableReuseEntry(uint64_t actionHash);
+
+        // 合并模型文件与修改过的条目，按action hash排序写出（先写临时文件再rename，映射中的旧文件不受影响）
+        void writeReuseModel(const std::string &modelFilepath);
     };
 
     typedef std::shared_ptr<ModelReusableAgent> ReuseAgentPtr;
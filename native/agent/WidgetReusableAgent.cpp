@@ -2,8 +2,16 @@
 #include "../storage/WidgetReuseModel_generated.h"
 #include "../desc/reuse/ActionSimilarity.h"
 #include "Base.h"
+#include "Preference.h"
+#include "../desc/reuse/SimilarityEngine.h"
+#include "../desc/reuse/WidgetReuseModelFormat.h"
+#include "../desc/reuse/base64.h"
 #include "flatbuffers/flatbuffers.h"
 #include "utils.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <memory>
 #include <string>
@@ -12,33 +20,194 @@
 #include <cmath>
 #include <thread>
 #include <chrono>
+#include <functional>
+#include <future>
+#include <shared_mutex>
 #include <mutex>
 #include <opencv2/opencv.hpp>
 #include <dirent.h>
 #include <sys/stat.h>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace fastbotx {
 
+// 批量匹配时每个平台做精确计算的候选数，以及候选分数相对阈值的放宽量
+#define ExternalIndexCandidates 8
+#define ExternalIndexScoreMargin 0.1
+// 外部widget视为已访问的相似度阈值，以及每个新访问widget在一个平台上精确验证的候选数
+#define ExternalCoverageThreshold 0.5
+#define ExternalCoverageCandidates 32
+
+// 外部匹配缓存文件的格式
+static const char EXTERNAL_MATCH_CACHE_MAGIC[8] = {'F', 'B', 'E', 'X', 'T', 'M', 'A', 'T'};
+static const uint32_t EXTERNAL_MATCH_CACHE_VERSION = 1;
+
+// 模型文件的标识：路径、大小与修改时间任一变化都视为不同的模型
+static uint64_t modelFileTag(const std::string& modelPath) {
+    struct stat fileStat{};
+    if (0 != stat(modelPath.c_str(), &fileStat)) {
+        return 0;
+    }
+    uint64_t tag = 0xcbf29ce484222325ULL;
+    for (unsigned char c : modelPath) {
+        tag = (tag ^ c) * 0x100000001b3ULL;
+    }
+    tag = (tag ^ static_cast<uint64_t>(fileStat.st_size)) * 0x100000001b3ULL;
+    tag = (tag ^ static_cast<uint64_t>(fileStat.st_mtime)) * 0x100000001b3ULL;
+    return tag;
+}
+
+// 嵌入索引的空属性掩码：属性为空指既没有字符串也没有保存的向量；
+// 有字符串但没有向量的属性无法用矩阵比较，indexable置为false
+static uint8_t embeddingEmptyMask(const std::string& text, const std::string& activityName,
+                                  const std::string& resourceId, const std::string& iconBase64,
+                                  const SimilarityEmbeddings& embeddings, bool& indexable) {
+    uint8_t emptyMask = 0;
+    indexable = true;
+    auto classify = [&emptyMask, &indexable](bool hasValue, const Int8EmbeddingView& view,
+                                             ActionEmbeddingIndex::Attribute attribute) {
+        if (view.empty()) {
+            if (hasValue) {
+                indexable = false;
+            } else {
+                emptyMask |= ActionEmbeddingIndex::attributeBit(attribute);
+            }
+        }
+    };
+    classify(!text.empty(), embeddings.text, ActionEmbeddingIndex::TEXT);
+    classify(!activityName.empty(), embeddings.activityName, ActionEmbeddingIndex::ACTIVITY_NAME);
+    classify(!resourceId.empty(), embeddings.resourceId, ActionEmbeddingIndex::RESOURCE_ID);
+    classify(!iconBase64.empty(), embeddings.icon, ActionEmbeddingIndex::ICON);
+    return emptyMask;
+}
+
+// 读取v2模型字典中一个widget记录的属性：字符串复制出来，量化向量为指向映射区的零拷贝视图；
+// 图标只在没有保存向量时才需要base64（逐个计算相似度），同一图标只编码一次。记录不存在时返回false
+template<typename Attributes>
+static bool readWidgetRecord(const fastbotx::WidgetReuseModel *model, uint32_t index,
+                             std::unordered_map<uint32_t, std::string>& iconBase64Cache, Attributes& out) {
+    const auto *record = dictionaryRecord(model->widgets(), index);
+    if (nullptr == record) {
+        return false;
+    }
+    out.widgetText = record->text() ? record->text()->str() : "";
+    out.widgetResourceId = record->resource_id() ? record->resource_id()->str() : "";
+    out.embeddings.text = embeddingView(record->text_embedding());
+    out.embeddings.resourceId = embeddingView(record->resource_id_embedding());
+    if (const auto *activity = dictionaryRecord(model->activities(), record->activity())) {
+        out.activityName = activity->name() ? activity->name()->str() : "";
+        out.embeddings.activityName = embeddingView(activity->embedding());
+    }
+    if (const auto *icon = dictionaryRecord(model->icons(), record->icon())) {
+        out.embeddings.icon = embeddingView(icon->embedding());
+        if (out.embeddings.icon.empty() && icon->bytes() && icon->bytes()->size() > 0) {
+            auto it = iconBase64Cache.find(record->icon());
+            if (it == iconBase64Cache.end()) {
+                it = iconBase64Cache.emplace(record->icon(),
+                                             base64_encode(icon->bytes()->data(), icon->bytes()->size())).first;
+            }
+            out.widgetIconBase64 = it->second;
+        }
+    }
+    return true;
+}
+
+// 把v1模型文件改名保留为 <path>.v1（已存在时依次加序号），旧版本的fastbot仍可使用；映射不受改名影响
+static bool backupV1WidgetReuseModel(const std::string& modelPath) {
+    std::string backupPath = modelPath + ".v1";
+    struct stat fileStat{};
+    for (int i = 1; 0 == stat(backupPath.c_str(), &fileStat); ++i) {
+        backupPath = modelPath + ".v1." + std::to_string(i);
+    }
+    if (0 != std::rename(modelPath.c_str(), backupPath.c_str())) {
+        BLOGE("back up v1 widget reuse model %s to %s failed", modelPath.c_str(), backupPath.c_str());
+        return false;
+    }
+    BLOG("v1 widget reuse model %s is kept as %s, the model is saved as v2 from now on", modelPath.c_str(),
+         backupPath.c_str());
+    return true;
+}
+
+// 打开复用模型文件，v1模型在加载时转换为v2。writeBack时先把v1文件改名备份，再把转换结果写到原路径（之后直接映射）；
+// 无法转换的v1文件同样备份。备份失败时置位originalAtRisk，调用方不能再向该路径保存。
+// 非writeBack（外部平台的模型）只在内存中转换
+static MappedModelFilePtr openWidgetReuseModel(const std::string& modelPath, bool writeBack,
+                                               bool* originalAtRisk = nullptr) {
+    MappedModelFilePtr modelFile = MappedModelFile::open(modelPath);
+    if (!modelFile || !WidgetReuseModelFormat::isV1(GetWidgetReuseModel(modelFile->data()))) {
+        return modelFile;
+    }
+    std::vector<uint8_t> converted;
+    bool convertedOk = WidgetReuseModelFormat::convertToV2(modelFile->data(), modelFile->size(), converted);
+    if (!convertedOk) {
+        BLOGE("convert widget reuse model %s to v2 failed", modelPath.c_str());
+    }
+    if (writeBack) {
+        if (!backupV1WidgetReuseModel(modelPath)) {
+            if (originalAtRisk) {
+                *originalAtRisk = true;
+            }
+        } else if (convertedOk) {
+            // 原路径已空出，写临时文件再rename
+            std::string tempFilePath = modelPath + ".tmp";
+            std::ofstream outputFile(tempFilePath, std::ios::binary);
+            outputFile.write(reinterpret_cast<const char *>(converted.data()), static_cast<std::streamsize>(converted.size()));
+            outputFile.close();
+            if (outputFile.good() && 0 == std::rename(tempFilePath.c_str(), modelPath.c_str())) {
+                MappedModelFilePtr convertedFile = MappedModelFile::open(modelPath);
+                if (convertedFile) {
+                    return convertedFile;
+                }
+            } else {
+                BLOGE("write converted widget reuse model %s failed", modelPath.c_str());
+                std::remove(tempFilePath.c_str());
+            }
+        }
+    }
+    return convertedOk ? MappedModelFile::fromBuffer(converted) : nullptr;
+}
+
 // 在文件开头的命名空间内添加静态变量初始化
 std::string WidgetReusableAgent::DefaultWidgetModelSavePath = "/sdcard/fastbot.widget.fbm";
 
+struct WidgetReusableAgent::MappedWidgetReuseModel {
+    MappedModelFilePtr file;
+    const WidgetReuseModel *model;
+    SortedEntryTable<ReuseEntryV2> entries;
+};
+
 WidgetReusableAgent::WidgetReusableAgent(const ModelPtr &model)
     : ModelReusableAgent(model) {
     // 初始化代码
     // 清空访问过的控件集合（新轮次开始）
     this->clearVisitedWidgets();
-
-    // 自动检测并加载多平台模型
-    BLOG("WidgetReusableAgent初始化，开始检测多平台模型...");
-    try {
-        autoLoadMultiPlatformModels("/sdcard", ""); // 构造函数时包名未知，使用空字符串
-    } catch (const std::exception& e) {
-        BLOGE("自动加载多平台模型失败: %s", e.what());
-    }
+    // 多平台模型在loadReuseModel确定包名后检测，并在后台加载
 }
 
 WidgetReusableAgent::~WidgetReusableAgent() {
     BLOG("WidgetReusableAgent destructor called");
+    // 后台加载外部模型的任务引用了本对象，先等它们结束
+    this->waitExternalModelLoads();
+    // 后台匹配任务引用了本对象，先等它们结束
+    for (auto &pending : this->_pendingExternalMatches) {
+        if (pending.second.valid()) {
+            pending.second.wait();
+        }
+    }
+    this->_pendingExternalMatches.clear();
+    for (auto &abandoned : this->_abandonedExternalMatches) {
+        if (abandoned.valid()) {
+            abandoned.wait();
+        }
+    }
+    this->_abandonedExternalMatches.clear();
+    for (auto &task : this->_externalCoverageTasks) {
+        if (task.valid()) {
+            task.wait();
+        }
+    }
+    this->_externalCoverageTasks.clear();
     BLOG("save widget reuse model in destruct");
 
     // 确保使用正确的保存路径
@@ -64,11 +233,14 @@ void WidgetReusableAgent::updateReuseModel() {
     if (nullptr == modelAction || nullptr == this->_newState)
         return;
     auto hash = (uint64_t)modelAction->hash();
+    std::vector<uint64_t> journalWidgets;
+    journalWidgets.reserve(this->_newState->getWidgets().size());
+    uint64_t journalSequence;
 
     {
         std::lock_guard<std::mutex> reuseGuard(this->_widgetReuseModelLock);
-        // 直接获取/创建 action_hash 对应的 widget map
-        auto &widgetMap = this->_widgetReuseModel[hash];
+        // 直接获取/创建 action_hash 对应的条目（模型文件中的条目第一次更新时才复制过来）
+        auto &row = this->mutableWidgetReuseEntry(hash);
 
         // 保存action的属性
         ActionAttributes actionAttrs;
@@ -80,32 +252,62 @@ void WidgetReusableAgent::updateReuseModel() {
             actionAttrs.targetWidgetText = targetWidget->getText();
             actionAttrs.targetWidgetResourceId = targetWidget->getResourceID();
             if (targetWidget->hasIcon()) {
-                actionAttrs.targetWidgetIconBase64 = targetWidget->getIconBase64();
+                actionAttrs.targetWidgetIconId = targetWidget->getIconId();
             }
         }
-        this->_actionAttributes[hash] = actionAttrs;
+        this->_actionAttributes[hash] = std::make_shared<const ActionAttributes>(actionAttrs);
 
         // 为当前状态的每个widget更新计数和属性
         for (const auto &widget : this->_newState->getWidgets()) {
             auto widgetHash = widget->hash();
-            auto &widgetCountWithAttrs = widgetMap[widgetHash];
-            
-            int oldCount = widgetCountWithAttrs.count;
-            int newCount = oldCount + 1;
-            widgetCountWithAttrs.count = newCount;
-            
-            // 更新widget属性
-            widgetCountWithAttrs.text = widget->getText();
-            widgetCountWithAttrs.activityName = actionAttrs.activityName;
-            widgetCountWithAttrs.resourceId = widget->getResourceID();
+            journalWidgets.push_back(widgetHash);
+            if (!this->countWidget(row, hash, widgetHash)) {
+                // 有界模型中计入了长尾，不保存属性
+                continue;
+            }
+
+            // 更新旁表中的widget属性，没有变化时不重新分配
+            LocalWidgetAttributes widgetAttrs;
+            widgetAttrs.text = widget->getText();
+            widgetAttrs.activityName = actionAttrs.activityName;
+            widgetAttrs.resourceId = widget->getResourceID();
             if (widget->hasIcon()) {
-                widgetCountWithAttrs.iconBase64 = widget->getIconBase64();
+                widgetAttrs.iconId = widget->getIconId();
+            }
+            auto &storedAttrs = this->_localWidgetAttributes[this->localWidgetId(widgetHash)];
+            if (!storedAttrs || !(*storedAttrs == widgetAttrs)) {
+                storedAttrs = std::make_shared<const LocalWidgetAttributes>(std::move(widgetAttrs));
             }
 
-            BDLOG("update reuse model: action_hash=%llu, widget_hash=%llu, old_count=%d, new_count=%d",
-                  hash, widgetHash, oldCount, newCount);
+            BDLOG("update reuse model: action_hash=%llu, widget_hash=%llu", hash, widgetHash);
         }
+        journalSequence = ++this->_journalSequence;
+        this->advanceAging();
+        // 增量缓冲较大时并入CSR；之后row不再有效
+        this->_widgetReuseModel.mergeDeltaIfNeeded();
+    }
+
+    // 计数的变化追加到日志，不在模型锁内写文件
+    if (this->_journal) {
+        this->_journal->append(journalSequence, hash, journalWidgets);
+    }
+}
+
+ActionPtr WidgetReusableAgent::resolveNewAction() {
+    // 一次决策（选择action和随后的updateStrategy）共用一个时间预算
+    int budgetMs = Preference::inst()->getDecisionBudgetMs();
+    this->_decisionBudgeted = budgetMs > 0;
+    this->_decisionDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(budgetMs, 0));
+
+    // 新状态中各action的外部模型匹配先分发到相似度引擎的线程池并行计算，
+    // 之后选择action和计算奖励时按截止时间取结果
+    this->prefetchExternalMatches(this->_newState, 0.5);
+
+    ActionPtr action = ModelReusableAgent::resolveNewAction();
+    if (this->decisionBudgetExhausted()) {
+        BLOG("决策超出预算%dms，未完成的外部匹配在后台继续: %zu个", budgetMs, this->_pendingExternalMatches.size());
     }
+    return action;
 }
 
 void WidgetReusableAgent::updateStrategy() {
@@ -191,32 +393,61 @@ double WidgetReusableAgent::probabilityOfVisitingNewWidgets(const ActivityStateA
     uintptr_t actionHash = action->hash();
     BLOG("Computing widget probability for action hash=%llu", actionHash);
 
-    // 查找action在widget重用模型中的记录
-    auto actionMapIterator = this->_widgetReuseModel.find(actionHash);
-    if (actionMapIterator != this->_widgetReuseModel.end()) {
-        const auto &widgetMap = actionMapIterator->second;
-
-        BLOG("Action %llu found in widget reuse model with %zu target widgets",
-             actionHash, widgetMap.size());
-
-        // 遍历该action能到达的所有widget
-        for (const auto &widgetCountPair : widgetMap) {
-            total += widgetCountPair.second.count;  // 累加总执行次数
-            uint64_t widgetHash = widgetCountPair.first;
+    // 查找action在widget重用模型中的记录，遍历该action能到达的所有widget
+    std::vector<uint64_t> exactWidgets;
+    bool found;
+    WidgetCountMatrix::RowView row;
+    if (this->_widgetReuseModel.row(actionHash, row)) {
+        // 本次运行修改过的条目：编号列和计数列连续存放，按编号查已访问位图顺序累加
+        long long rowTotal = 0;
+        long long rowVisited = 0;
+        WidgetCountMatrix::sumRow(row, this->_visitedLocalWidgets, rowTotal, rowVisited);
+        total = static_cast<int>(std::min<long long>(rowTotal, std::numeric_limits<int>::max()));
+        unvisited = static_cast<int>(std::min<long long>(rowTotal - rowVisited, std::numeric_limits<int>::max()));
+        if (this->boundedWidgetReuseModel()) {
+            for (size_t i = 0; i < row.size; ++i) {
+                exactWidgets.push_back(this->_localWidgetHashes[row.columns[i]]);
+            }
+        }
+        BLOG("Action %llu found in widget reuse model with %zu target widgets", actionHash, row.size);
+        found = true;
+    } else {
+        // 模型文件中的条目
+        found = this->forEachWidgetCount(actionHash, [this, &total, &unvisited, &exactWidgets](uint64_t widgetHash,
+                                                                                             int count) {
+            total += count;  // 累加总执行次数
+            exactWidgets.push_back(widgetHash);
 
             // 检查该widget是否在当前轮次中已被访问过
             // 使用我们自己维护的 _visitedWidgets 集合
             bool isVisited = this->_visitedWidgets.find(widgetHash) != this->_visitedWidgets.end();
 
             BLOG("  Widget hash: %llu, count: %d, visited in current round: %s",
-                 widgetHash, widgetCountPair.second.count, isVisited ? "yes" : "no");
+                 widgetHash, count, isVisited ? "yes" : "no");
 
             if (!isVisited) {
-                unvisited += widgetCountPair.second.count;  // 累加未访问次数
+                unvisited += count;  // 累加未访问次数
+            }
+        });
+    }
+    int tail = found && this->boundedWidgetReuseModel() ? this->tailCount(actionHash) : 0;
+    if (tail > 0) {
+        // 有界模型的长尾：本轮访问过、不在精确计数中的widget按sketch的估计计为已访问，不超过长尾总数
+        std::sort(exactWidgets.begin(), exactWidgets.end());
+        long long visitedTail = 0;
+        for (uint64_t widgetHash : this->_visitedWidgets) {
+            if (visitedTail >= tail) {
+                break;
+            }
+            if (!std::binary_search(exactWidgets.begin(), exactWidgets.end(), widgetHash)) {
+                visitedTail += this->_tailSketch->estimate(tailSketchKey(actionHash, widgetHash));
             }
         }
-
-        BLOG("Action %llu: total=%d, unvisited=%d", actionHash, total, unvisited);
+        total += tail;
+        unvisited += tail - static_cast<int>(std::min<long long>(visitedTail, tail));
+    }
+    if (found) {
+        BLOG("Action %llu: total=%d, unvisited=%d, tail=%d", actionHash, total, unvisited, tail);
 
         if (total > 0 && unvisited > 0) {
             value = static_cast<double>(unvisited) / total;
@@ -239,8 +470,8 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionInReuseModel() const {
     BLOG("WidgetReusableAgent: Searching for unperformed actions in widget reuse model...");
 
     // 首先检查widget重用模型是否为空
-    BLOG("Widget reuse model size: %zu", this->_widgetReuseModel.size());
-    if (this->_widgetReuseModel.empty()) {
+    BLOG("Widget reuse model size: %zu", this->widgetReuseModelSize());
+    if (0 == this->widgetReuseModelSize()) {
         BLOG("Widget reuse model is empty, cannot select action from reuse model");
         return nullptr;
     }
@@ -277,7 +508,7 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionInReuseModel() const {
         }
 
         // 检查本地模型
-        bool inLocalModel = (this->_widgetReuseModel.find(actionHash) != this->_widgetReuseModel.end());
+        bool inLocalModel = this->isActionInWidgetReuseModel(actionHash);
         ExternalActionMatch externalMatch;
 
         // 检查外部模型（先查询缓存）
@@ -285,21 +516,7 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionInReuseModel() const {
         if (activityNameAction) {
             BLOG("尝试在外部模型中查找相似action: hash=%llu, type=%s", 
                  actionHash, actName[action->getActionType()].c_str());
-            // 先命中缓存
-            bool cacheHit = false;
-            {
-                std::lock_guard<std::mutex> cacheLock(_externalActionMatchCacheLock);
-                auto it = _externalActionMatchCache.find(actionHash);
-                if (it != _externalActionMatchCache.end() && it->second.found && it->second.similarity >= 0.5) {
-                    externalMatch = it->second;
-                    cacheHit = true;
-                    BLOG("外部action匹配在selectUnperformedActionInReuseModel命中缓存: platform=%s, similarity=%.3f",
-                         externalMatch.platformId.c_str(), externalMatch.similarity);
-                }
-            }
-            if (!cacheHit) {
-                externalMatch = findSimilarActionInExternalModels(activityNameAction, 0.5);
-            }
+            externalMatch = lookupExternalMatch(activityNameAction, 0.5);
             
             if (externalMatch.found) {
                 BLOG("成功在外部模型中找到相似action: platform=%s, similarity=%.3f",
@@ -381,7 +598,7 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
         }
 
         // 检查是否在本地模型中
-        bool inLocalModel = (this->_widgetReuseModel.find(action->hash()) != this->_widgetReuseModel.end());
+        bool inLocalModel = this->isActionInWidgetReuseModel(action->hash());
 
         // 检查是否在外部模型中（使用相似度匹配）
         bool inExternalModel = false;
@@ -438,7 +655,7 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
             if (nullptr != lastSelectedAction) {
                 // 首先检查本机模型
                 uint64_t actionHash = lastSelectedAction->hash();
-                bool foundInLocalModel = (this->_widgetReuseModel.find(actionHash) != this->_widgetReuseModel.end());
+                bool foundInLocalModel = this->isActionInWidgetReuseModel(actionHash);
 
                 if (foundInLocalModel) {
                     // 在本机模型中找到，使用原有逻辑
@@ -448,21 +665,8 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
                     // 本机模型中没找到，检查外部模型（先查缓存）
                     auto activityNameAction = std::dynamic_pointer_cast<ActivityNameAction>(lastSelectedAction);
                     if (activityNameAction) {
-                        WidgetReusableAgent::ExternalActionMatch externalMatch;
-                        bool cacheHit = false;
-                        {
-                            std::lock_guard<std::mutex> cacheLock(_externalActionMatchCacheLock);
-                            auto it = _externalActionMatchCache.find(activityNameAction->hash());
-                            if (it != _externalActionMatchCache.end() && it->second.found && it->second.similarity >= 0.5) {
-                                externalMatch = it->second;
-                                cacheHit = true;
-                                BLOG("computeReward: 外部action匹配命中缓存: platform=%s, similarity=%.3f",
-                                     externalMatch.platformId.c_str(), externalMatch.similarity);
-                            }
-                        }
-                        if (!cacheHit) {
-                            externalMatch = findSimilarActionInExternalModels(activityNameAction, 0.5);
-                        }
+                        WidgetReusableAgent::ExternalActionMatch externalMatch =
+                                lookupExternalMatch(activityNameAction, 0.5);
                         if (externalMatch.found) {
                             // 在外部模型中找到相似action
                             rewardValue = this->probabilityOfVisitingNewWidgetsFromExternalModel(
@@ -515,7 +719,7 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
                 uintptr_t actionHash = action->hash();
 
                 // 首先检查本机模型
-                bool foundInLocalModel = (this->_widgetReuseModel.find(actionHash) != this->_widgetReuseModel.end());
+                bool foundInLocalModel = this->isActionInWidgetReuseModel(actionHash);
 
                 if (foundInLocalModel) {
                     // 在本机模型中找到，根据访问次数给予奖励
@@ -526,21 +730,8 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
                     // 本机模型中没找到，检查外部模型（先查缓存）
                     auto activityNameAction = std::dynamic_pointer_cast<ActivityNameAction>(action);
                     if (activityNameAction) {
-                        WidgetReusableAgent::ExternalActionMatch externalMatch;
-                        bool cacheHit = false;
-                        {
-                            std::lock_guard<std::mutex> cacheLock(_externalActionMatchCacheLock);
-                            auto it = _externalActionMatchCache.find(activityNameAction->hash());
-                            if (it != _externalActionMatchCache.end() && it->second.found && it->second.similarity >= 0.5) {
-                                externalMatch = it->second;
-                                cacheHit = true;
-                                BLOG("getStateExpectation: 外部action匹配命中缓存: platform=%s, similarity=%.3f",
-                                     externalMatch.platformId.c_str(), externalMatch.similarity);
-                            }
-                        }
-                        if (!cacheHit) {
-                            externalMatch = findSimilarActionInExternalModels(activityNameAction, 0.5);
-                        }
+                        WidgetReusableAgent::ExternalActionMatch externalMatch =
+                                lookupExternalMatch(activityNameAction, 0.5);
                         if (externalMatch.found) {
                             // 在外部模型中找到相似action，给予中等奖励
                             value += 0.7;
@@ -572,115 +763,351 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
     /// by FlatBuffers
     /// \param packageName The package name of the tested application
     void WidgetReusableAgent::saveReuseModel(const std::string &modelFilepath) {
-        flatbuffers::FlatBufferBuilder builder;
-        std::vector<flatbuffers::Offset<fastbotx::ReuseEntry>> reuseEntryVector;
+        // 压缩同一时间只有一个（后台保存线程与析构/强制保存）
+        std::lock_guard<std::mutex> compactionGuard(this->_compactionLock);
+        std::string outputFilePath = modelFilepath;
+        if (outputFilePath.empty()) {
+            outputFilePath = this->_widgetDefaultModelSavePath;
+        }
+        if (!this->_unsavableModelPath.empty() && outputFilePath == this->_unsavableModelPath) {
+            BLOGE("v1 widget reuse model %s could not be backed up, skip saving over it", outputFilePath.c_str());
+            return;
+        }
 
+        // 在模型锁内只取快照视图：映射的模型文件、修改过的条目（共享的CSR和增量行的指针）与widget旁表，
+        // 之后的更新写时复制，不影响视图
+        std::shared_ptr<const MappedWidgetReuseModel> modelBase;
+        WidgetCountMatrix touchedEntries;
+        std::vector<uint64_t> localWidgetHashes;
+        std::vector<std::shared_ptr<const LocalWidgetAttributes>> localWidgetAttributes;
+        ActionAttributesSharedMap touchedActionAttributes;
+        uint64_t journalSequence;
+        size_t modelSize;
+        // 有界模型的状态（未开启时tailSketch为nullptr）
+        CountMinSketchPtr tailSketch;
+        std::map<uint64_t, int> touchedTailCounts;
+        double baseDecay;
+        size_t maxActions;
         {
             std::lock_guard<std::mutex> reuseGuard(this->_widgetReuseModelLock);
+            modelBase = this->_widgetReuseModelBase;
+            touchedEntries = this->_widgetReuseModel;
+            localWidgetHashes = this->_localWidgetHashes;
+            localWidgetAttributes = this->_localWidgetAttributes;
+            touchedActionAttributes = this->_actionAttributes;
+            journalSequence = this->_journalSequence;
+            modelSize = this->widgetReuseModelSize();
+            if (this->_tailSketch) {
+                tailSketch = std::make_shared<CountMinSketch>(*this->_tailSketch);
+                touchedTailCounts = this->_widgetReuseTailCounts;
+            }
+            baseDecay = this->_baseDecay;
+            maxActions = this->_boundedConfig.maxActions;
+        }
+        const bool bounded = nullptr != tailSketch;
+        // 日志对应的是加载的模型文件，只有写回这个文件时才合并日志
+        bool compactJournal = this->_journal && outputFilePath == this->_widgetModelSavePath;
 
-            // 检查模型是否为空
-            if (this->_widgetReuseModel.empty()) {
-                BLOG("Widget reuse model is empty, skipping save");
-                return;
+        // 检查模型是否为空
+        if (0 == modelSize) {
+            BLOG("Widget reuse model is empty, skipping save");
+            return;
+        }
+        if (compactJournal && journalSequence == this->_compactedSequence) {
+            BLOG("Widget reuse model has no new observations since sequence %llu, skipping compaction",
+                 (unsigned long long) journalSequence);
+            ActionSimilarity::saveIconEmbeddingCache();
+            saveExternalMatchCache();
+            return;
+        }
+        if (compactJournal) {
+            // 之后的记录写入新的活动日志；序号不超过journalSequence的记录都已在视图中
+            this->_journal->seal();
+        }
+
+        flatbuffers::FlatBufferBuilder builder;
+        std::vector<flatbuffers::Offset<fastbotx::ReuseEntryV2>> reuseEntryVector;
+
+        // 属性写入去重字典，条目只保存下标。先原样复制模型文件的字典（下标不变），
+        // 未修改的条目连同其引用直接复制，只有本次运行新出现的widget/action/图标追加新记录。
+        // 有界模型中只按条目的引用逐条复制记录，被剪掉或老化的条目引用的记录不再写出，文件大小有上限
+        WidgetReuseDictionary dictionary(builder);
+        const WidgetReuseModel *baseModel = modelBase ? modelBase->model : nullptr;
+        std::unordered_map<uint64_t, uint32_t> baseWidgetsByHash;
+        if (!bounded) {
+            dictionary.copyFrom(baseModel);
+        } else if (baseModel && baseModel->widgets()) {
+            for (uint32_t i = 1; i < baseModel->widgets()->size(); ++i) {
+                uint64_t widgetHash = baseModel->widgets()->Get(i)->hash();
+                if (0 != widgetHash) {
+                    baseWidgetsByHash.emplace(widgetHash, i);
+                }
+            }
+        }
+        auto baseCount = [bounded, baseDecay](int count) {
+            return bounded && baseDecay < 1.0 ? static_cast<int>(count * baseDecay) : count;
+        };
+
+        // 本次运行中计算过的嵌入向量以int8写入新记录；已保存图标向量时不再写入原图
+        std::unordered_map<IconId, uint32_t> iconIndices;
+        auto iconIndexOf = [&dictionary, &iconIndices](IconId iconId) -> uint32_t {
+            if (INVALID_ICON_ID == iconId) {
+                return 0;
+            }
+            auto it = iconIndices.find(iconId);
+            if (it != iconIndices.end()) {
+                return it->second;
+            }
+            Int8Embedding quantized;
+            std::vector<uchar> bytes;
+            if (!ActionSimilarity::lookupQuantizedIconEmbedding(iconId, quantized)) {
+                IconStore::inst()->bytes(iconId, bytes);
+            }
+            uint32_t index = dictionary.icon(bytes.data(), bytes.size(), Int8EmbeddingView(quantized));
+            iconIndices[iconId] = index;
+            return index;
+        };
+        auto activityIndexOf = [&dictionary](const std::string &activityName) -> uint32_t {
+            uint32_t index = dictionary.findActivity(activityName);
+            if (0 != index || activityName.empty()) {
+                return index;
             }
+            Int8Embedding quantized;
+            ActionSimilarity::lookupQuantizedEmbedding(ActionSimilarity::EmbeddingKind::ActivityName, activityName, quantized);
+            return dictionary.activity(activityName, Int8EmbeddingView(quantized));
+        };
+        auto widgetIndexOf = [&dictionary, &activityIndexOf, &iconIndexOf, &baseWidgetsByHash, baseModel](
+                uint64_t widgetHash, const std::string &text, const std::string &activityName,
+                const std::string &resourceId, IconId iconId) -> uint32_t {
+            uint32_t index = 0 != widgetHash ? dictionary.findWidget(widgetHash) : 0;
+            if (0 != index) {
+                return index;
+            }
+            auto baseWidget = 0 != widgetHash ? baseWidgetsByHash.find(widgetHash) : baseWidgetsByHash.end();
+            if (baseWidget != baseWidgetsByHash.end()) {
+                return dictionary.copyWidget(baseModel, baseWidget->second);
+            }
+            Int8Embedding textEmbedding;
+            Int8Embedding resourceIdEmbedding;
+            if (!text.empty()) {
+                ActionSimilarity::lookupQuantizedEmbedding(ActionSimilarity::EmbeddingKind::Text, text, textEmbedding);
+            }
+            if (!resourceId.empty()) {
+                ActionSimilarity::lookupQuantizedEmbedding(ActionSimilarity::EmbeddingKind::ResourceId, resourceId,
+                                                           resourceIdEmbedding);
+            }
+            uint32_t activity = activityIndexOf(activityName);
+            uint32_t icon = iconIndexOf(iconId);
+            return dictionary.widget(widgetHash, text, resourceId, activity, icon,
+                                     Int8EmbeddingView(textEmbedding), Int8EmbeddingView(resourceIdEmbedding));
+        };
 
-            BLOG("Saving widget reuse model with %zu actions (with similarity attributes)", this->_widgetReuseModel.size());
+        {
+            BLOG("Saving widget reuse model with %zu actions (with similarity attributes)", modelSize);
             int actionsWithAttrs = 0;
 
-            for (const auto &actionIterator : this->_widgetReuseModel) {
-                uint64_t actionHash = actionIterator.first;
-                const WidgetCountMapWithAttrs &widgetMap = actionIterator.second;
-
-                // 获取action的属性
-                const ActionAttributes* actionAttrs = nullptr;
-                auto actionAttrsIt = this->_actionAttributes.find(actionHash);
-                if (actionAttrsIt != this->_actionAttributes.end()) {
-                    actionAttrs = &actionAttrsIt->second;
+            // 模型文件中的条目与修改过的条目都按action hash升序，归并遍历以保持LookupByKey需要的顺序；
+            // 修改过的条目替换文件中的同一条目
+            typedef std::function<void(const ReuseEntryV2 *)> BaseEntryVisitor;
+            typedef std::function<void(uint64_t, const WidgetCountMatrix::RowView &, const ReuseEntryV2 *)> TouchedEntryVisitor;
+            std::vector<std::pair<uint64_t, WidgetCountMatrix::RowView>> touchedRows;
+            touchedRows.reserve(touchedEntries.rowCount());
+            touchedEntries.forEachRow([&touchedRows](uint64_t actionHash, const WidgetCountMatrix::RowView &row) {
+                touchedRows.emplace_back(actionHash, row);
+            });
+            auto forEachEntry = [&modelBase, &touchedRows](const BaseEntryVisitor &visitBase,
+                                                          const TouchedEntryVisitor &visitTouched) {
+                size_t baseIndex = 0;
+                size_t baseCount = modelBase ? modelBase->entries.size() : 0;
+                auto overlayIterator = touchedRows.begin();
+                while (baseIndex < baseCount || overlayIterator != touchedRows.end()) {
+                    const ReuseEntryV2 *baseEntry = baseIndex < baseCount ? modelBase->entries.at(baseIndex) : nullptr;
+                    if (overlayIterator == touchedRows.end() ||
+                        (baseEntry && baseEntry->action() < overlayIterator->first)) {
+                        visitBase(baseEntry);
+                        baseIndex++;
+                        continue;
+                    }
+                    if (baseEntry && baseEntry->action() == overlayIterator->first) {
+                        baseIndex++;
+                    } else {
+                        baseEntry = nullptr;
+                    }
+                    visitTouched(overlayIterator->first, overlayIterator->second, baseEntry);
+                    ++overlayIterator;
                 }
-
-                // 创建action的相似度属性
-                flatbuffers::Offset<fastbotx::ActionSimilarityAttributes> actionAttrsOffset;
-                bool hasActionAttrs = false;
-                
-                if (actionAttrs) {
-                        // 创建target widget的相似度属性
-                        auto targetWidgetAttrs = fastbotx::CreateWidgetSimilarityAttributes(builder,
-                        builder.CreateString(actionAttrs->targetWidgetText),
-                        builder.CreateString(actionAttrs->activityName),
-                        builder.CreateString(actionAttrs->targetWidgetResourceId),
-                        builder.CreateString(actionAttrs->targetWidgetIconBase64));
-
-                        // 创建action的相似度属性
-                    actionAttrsOffset = fastbotx::CreateActionSimilarityAttributes(builder,
-                        actionAttrs->actionType,
-                        builder.CreateString(actionAttrs->activityName),
-                            targetWidgetAttrs);
-                    
-                    hasActionAttrs = true;
+            };
+            auto touchedTailOf = [&touchedTailCounts](uint64_t actionHash) {
+                auto tailIterator = touchedTailCounts.find(actionHash);
+                return tailIterator == touchedTailCounts.end() ? 0 : tailIterator->second;
+            };
+
+            // 有界模型中action数超过上限时只保留计数之和最大的maxActions个
+            bool capActions = bounded && modelSize > maxActions;
+            std::unordered_set<uint64_t> keptActions;
+            if (capActions) {
+                std::vector<std::pair<long long, uint64_t>> actionTotals;
+                actionTotals.reserve(modelSize);
+                forEachEntry([&actionTotals, &baseCount](const ReuseEntryV2 *baseEntry) {
+                    long long total = baseCount(baseEntry->tail_count());
+                    if (baseEntry->widgets()) {
+                        for (const auto *widgetRef : *baseEntry->widgets()) {
+                            total += baseCount(widgetRef->count());
+                        }
+                    }
+                    actionTotals.emplace_back(total, baseEntry->action());
+                }, [&actionTotals, &touchedTailOf](uint64_t actionHash, const WidgetCountMatrix::RowView &row,
+                                                   const ReuseEntryV2 *) {
+                    long long total = touchedTailOf(actionHash);
+                    for (size_t i = 0; i < row.size; ++i) {
+                        total += row.counts[i];
+                    }
+                    actionTotals.emplace_back(total, actionHash);
+                });
+                auto kept = actionTotals.begin() + static_cast<std::ptrdiff_t>(std::min(maxActions, actionTotals.size()));
+                std::nth_element(actionTotals.begin(), kept, actionTotals.end(),
+                                 std::greater<std::pair<long long, uint64_t>>());
+                for (auto it = actionTotals.begin(); it != kept; ++it) {
+                    keptActions.insert(it->second);
+                }
+            }
+            size_t droppedActions = 0;
+            auto keepAction = [&](uint64_t actionHash, long long total) {
+                if (bounded && (total <= 0 || (capActions && 0 == keptActions.count(actionHash)))) {
+                    droppedActions++;
+                    return false;
+                }
+                return true;
+            };
+
+            forEachEntry([&](const ReuseEntryV2 *baseEntry) {
+                if (!bounded) {
+                    // 字典下标不变，widget计数数组按原字节复制
+                    flatbuffers::Offset<flatbuffers::Vector<const fastbotx::WidgetCountRef *>> widgetRefs;
+                    if (baseEntry->widgets()) {
+                        widgetRefs = builder.CreateVectorOfStructs(
+                                reinterpret_cast<const fastbotx::WidgetCountRef *>(baseEntry->widgets()->Data()),
+                                baseEntry->widgets()->size());
+                    }
+                    reuseEntryVector.push_back(fastbotx::CreateReuseEntryV2(builder, baseEntry->action(),
+                                                                            baseEntry->attributes(), widgetRefs,
+                                                                            baseEntry->tail_count()));
+                    return;
+                }
+                // 有界模型：计数乘上累计的衰减，引用的记录逐条复制进新字典
+                long long total = baseCount(baseEntry->tail_count());
+                if (baseEntry->widgets()) {
+                    for (const auto *widgetRef : *baseEntry->widgets()) {
+                        total += baseCount(widgetRef->count());
+                    }
+                }
+                if (!keepAction(baseEntry->action(), total)) {
+                    return;
+                }
+                std::vector<fastbotx::WidgetCountRef> widgetRefs;
+                if (baseEntry->widgets()) {
+                    for (const auto *widgetRef : *baseEntry->widgets()) {
+                        int count = baseCount(widgetRef->count());
+                        if (count > 0) {
+                            widgetRefs.emplace_back(dictionary.copyWidget(baseModel, widgetRef->widget()), count);
+                        }
+                    }
+                }
+                uint32_t actionAttributes = dictionary.copyAction(baseModel, baseEntry->attributes());
+                if (0 != actionAttributes) {
                     actionsWithAttrs++;
-                    
+                }
+                reuseEntryVector.push_back(fastbotx::CreateReuseEntryV2Direct(builder, baseEntry->action(),
+                                                                              actionAttributes, &widgetRefs,
+                                                                              baseCount(baseEntry->tail_count())));
+            }, [&](uint64_t actionHash, const WidgetCountMatrix::RowView &row, const ReuseEntryV2 *baseEntry) {
+                int tail = touchedTailOf(actionHash);
+                long long total = tail;
+                for (size_t i = 0; i < row.size; ++i) {
+                    total += row.counts[i];
+                }
+                if (!keepAction(actionHash, total)) {
+                    return;
+                }
+
+                // action的属性：模型文件中已有时沿用（hash相同即属性相同），否则由本次运行记录的属性新建
+                uint32_t actionAttributes = 0;
+                if (baseEntry) {
+                    actionAttributes = bounded ? dictionary.copyAction(baseModel, baseEntry->attributes())
+                                               : baseEntry->attributes();
+                }
+                auto actionAttrsIt = touchedActionAttributes.find(actionHash);
+                if (0 == actionAttributes && actionAttrsIt != touchedActionAttributes.end()) {
+                    const ActionAttributes *actionAttrs = actionAttrsIt->second.get();
+                    uint32_t targetWidget = widgetIndexOf(0, actionAttrs->targetWidgetText, actionAttrs->activityName,
+                                                          actionAttrs->targetWidgetResourceId,
+                                                          actionAttrs->targetWidgetIconId);
+                    actionAttributes = dictionary.action(actionAttrs->actionType,
+                                                         activityIndexOf(actionAttrs->activityName), targetWidget);
                     BLOG("保存action属性: hash=%llu, type=%d, text='%s', resourceId='%s'",
-                         actionHash, actionAttrs->actionType, 
+                         actionHash, actionAttrs->actionType,
                          actionAttrs->targetWidgetText.c_str(), actionAttrs->targetWidgetResourceId.c_str());
                 }
-
-                // 创建widget count向量，包含相似度属性
-                std::vector<flatbuffers::Offset<fastbotx::WidgetCount>> widgetVector;
-                for (const auto &widgetIterator : widgetMap) {
-                    uint64_t widgetHash = widgetIterator.first;
-                    const WidgetCountWithAttributes &widgetCountWithAttrs = widgetIterator.second;
-
-                    // 直接使用内存中的widget属性数据
-                    auto widgetAttrs = fastbotx::CreateWidgetSimilarityAttributes(builder,
-                        builder.CreateString(widgetCountWithAttrs.text),
-                        builder.CreateString(widgetCountWithAttrs.activityName),
-                        builder.CreateString(widgetCountWithAttrs.resourceId),
-                        builder.CreateString(widgetCountWithAttrs.iconBase64));
-
-                    auto widgetCount = fastbotx::CreateWidgetCount(builder, widgetHash, widgetCountWithAttrs.count, widgetAttrs);
-                    widgetVector.push_back(widgetCount);
+                if (0 != actionAttributes) {
+                    actionsWithAttrs++;
                 }
 
-                // 创建ActivityWidgetMap
-                auto activityWidgetMap = CreateActivityWidgetMap(
-                    builder,
-                    builder.CreateString(""), // 空的activity名称
-                    builder.CreateVector(widgetVector)
-                );
-
-                std::vector<flatbuffers::Offset<fastbotx::ActivityWidgetMap>> activityVector;
-                activityVector.push_back(activityWidgetMap);
-
-                // 创建ReuseEntry，包含相似度属性
-                auto reuseEntry = CreateReuseEntry(
-                    builder,
-                    actionHash,
-                    builder.CreateVector(activityVector),
-                    actionAttrsOffset
-                );
-                reuseEntryVector.push_back(reuseEntry);
+                // widget计数只引用字典下标；从模型文件复制来的widget没有记录属性，按hash沿用文件中的记录
+                static const LocalWidgetAttributes emptyAttrs;
+                std::vector<fastbotx::WidgetCountRef> widgetRefs;
+                widgetRefs.reserve(row.size);
+                for (size_t i = 0; i < row.size; ++i) {
+                    uint32_t widgetId = row.columns[i];
+                    const LocalWidgetAttributes &widgetAttrs = localWidgetAttributes[widgetId]
+                                                               ? *localWidgetAttributes[widgetId] : emptyAttrs;
+                    uint32_t widgetIndex = widgetIndexOf(localWidgetHashes[widgetId], widgetAttrs.text,
+                                                         widgetAttrs.activityName, widgetAttrs.resourceId,
+                                                         widgetAttrs.iconId);
+                    widgetRefs.emplace_back(widgetIndex, row.counts[i]);
+                }
+                reuseEntryVector.push_back(fastbotx::CreateReuseEntryV2Direct(builder, actionHash, actionAttributes,
+                                                                              &widgetRefs, tail));
+            });
+            if (droppedActions > 0) {
+                BLOG("有界模型: 丢弃了 %zu 个计数最小或已老化的actions（上限 %zu）", droppedActions, maxActions);
             }
-            
-            BLOG("保存模型: 总共 %zu 个actions, 其中 %d 个包含属性", this->_widgetReuseModel.size(), actionsWithAttrs);
+
+            BLOG("保存模型: 总共 %zu 个actions, 其中 %d 个包含属性, 字典中 %zu 个widget, %zu 个图标, 去重后的嵌入向量 %zu 个",
+                 reuseEntryVector.size(), actionsWithAttrs, dictionary.widgetCount(), dictionary.iconCount(),
+                 dictionary.embeddingCount());
         }
-        
-        // 创建包含相似度属性的模型
-        auto widgetReuseModel = fastbotx::CreateWidgetReuseModel(
-            builder,
-            builder.CreateVector(reuseEntryVector),
-            builder.CreateString("current_platform"), // 平台信息
-            true // 保存了相似度属性
-        );
+
+        // 已合并的日志序号只在写回加载的模型文件时记录
+        auto widgetReuseModel = dictionary.finish(reuseEntryVector, "current_platform",
+                                                  compactJournal ? journalSequence : 0);
         builder.Finish(widgetReuseModel);
         
-        std::string outputFilePath = modelFilepath;
-        if (outputFilePath.empty()) {
-            outputFilePath = this->_widgetDefaultModelSavePath;
-        }
-        BLOG("save widget reuse model to path: %s", outputFilePath.c_str());
-        std::ofstream outputFile(outputFilePath, std::ios::binary);
+        BLOG("save widget reuse model to path: %s (icon store: %zu icons, %zu bytes)", outputFilePath.c_str(),
+             IconStore::inst()->size(), IconStore::inst()->byteSize());
+        // 加载的模型可能仍映射着这个路径：写到临时文件再rename替换，不能原地截断
+        std::string tempFilePath = outputFilePath + ".tmp";
+        std::ofstream outputFile(tempFilePath, std::ios::binary);
         outputFile.write((char *)builder.GetBufferPointer(), static_cast<int>(builder.GetSize()));
         outputFile.close();
+        if (!outputFile.good() || 0 != std::rename(tempFilePath.c_str(), outputFilePath.c_str())) {
+            BLOGE("save widget reuse model to path %s failed", outputFilePath.c_str());
+            std::remove(tempFilePath.c_str());
+        } else {
+            if (bounded) {
+                // 长尾计数的sketch与模型文件记录同一个日志序号，加载时不一致就丢弃
+                tailSketch->save(outputFilePath, compactJournal ? journalSequence : 0);
+            }
+            if (compactJournal) {
+                // 新文件已替换旧文件，合并进去的日志可以删除；崩溃在这之前时按文件中的序号跳过重复记录
+                this->_compactedSequence = journalSequence;
+                this->_journal->discardThrough(journalSequence);
+                BLOG("compacted widget reuse journal through sequence %llu", (unsigned long long) journalSequence);
+            }
+        }
+
+        // 图标嵌入缓存和外部匹配缓存跟随复用模型一起落盘，下次运行直接复用
+        ActionSimilarity::saveIconEmbeddingCache();
+        saveExternalMatchCache();
     }
 
     void WidgetReusableAgent::forceSaveReuseModel() {
@@ -720,9 +1147,29 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
         BLOG("begin load widget reuse model: %s", this->_widgetModelSavePath.c_str());
         BLOG("parent class _modelSavePath set to: %s", this->_modelSavePath.c_str());
         
-        std::ifstream modelFile(modelFilePath, std::ios::binary | std::ios::in);
-        if (modelFile.fail()) {
+        // 有界模型的配置须在重放日志之前确定
+        {
+            const BoundedReuseModelConfig &boundedConfig = Preference::inst()->getBoundedReuseModelConfig();
+            std::lock_guard<std::mutex> reuseGuard(this->_widgetReuseModelLock);
+            this->_boundedConfig = boundedConfig;
+            this->_tailSketch = boundedConfig.enabled
+                                ? std::make_shared<CountMinSketch>(boundedConfig.sketchWidth, boundedConfig.sketchDepth)
+                                : nullptr;
+            this->_widgetReuseTailCounts.clear();
+            this->_baseDecay = 1.0;
+        }
+
+        // 模型文件映射后直接查询，只有在本次运行中有新观测的条目才复制出来；v1文件先备份，再转换为v2并写回
+        bool originalAtRisk = false;
+        MappedModelFilePtr modelFile = openWidgetReuseModel(modelFilePath, true, &originalAtRisk);
+        {
+            std::lock_guard<std::mutex> compactionGuard(this->_compactionLock);
+            this->_unsavableModelPath = originalAtRisk ? modelFilePath : std::string();
+        }
+        if (!modelFile) {
             BLOG("read widget reuse model file %s failed, check if file exists!", modelFilePath.c_str());
+            // 上次运行还没有压缩出模型文件时，学习到的计数都在日志中
+            this->replayJournal(modelFilePath, 0);
 
             // 即使本机模型加载失败，也要尝试加载外部模型
             BLOG("本机模型不存在，但仍然检测多平台模型...");
@@ -733,71 +1180,41 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
             }
             return;
         }
-        
-        std::filebuf *fileBuffer = modelFile.rdbuf();
-        std::size_t filesize = fileBuffer->pubseekoff(0, modelFile.end, modelFile.in);
-        fileBuffer->pubseekpos(0, modelFile.in);
-        char *modelFileData = new char[filesize];
-        fileBuffer->sgetn(modelFileData, static_cast<int>(filesize));
-        
-        auto widgetReuseFBModel = GetWidgetReuseModel(modelFileData);
-        
+
+        auto widgetReuseFBModel = GetWidgetReuseModel(modelFile->data());
+        auto modelDataPtr = widgetReuseFBModel->entries();
+        std::shared_ptr<MappedWidgetReuseModel> modelBase;
+        if (modelDataPtr) {
+            modelBase = std::make_shared<MappedWidgetReuseModel>();
+            modelBase->file = modelFile;
+            modelBase->model = widgetReuseFBModel;
+            modelBase->entries.reset(modelDataPtr);
+        }
+
         {
             std::lock_guard<std::mutex> reuseGuard(this->_widgetReuseModelLock);
             this->_widgetReuseModel.clear();
+            this->_localWidgetHashes.clear();
+            this->_localWidgetAttributes.clear();
+            this->_localWidgetIds.clear();
+            this->_visitedLocalWidgets.clear();
             this->_widgetReuseQValue.clear();
+            this->_widgetReuseModelNewEntries = 0;
+            this->_widgetReuseModelBase = modelBase;
+            if (this->_tailSketch && this->_tailSketch->load(modelFilePath, widgetReuseFBModel->journal_sequence())) {
+                BLOG("loaded long-tail sketch of widget reuse model (%zu bytes)", this->_tailSketch->byteSize());
+            }
         }
-        
-        auto modelDataPtr = widgetReuseFBModel->model();
-        if (!modelDataPtr) {
+        // 模型文件之后的计数变化从日志恢复
+        this->replayJournal(modelFilePath, widgetReuseFBModel->journal_sequence());
+
+        if (!modelBase) {
             BLOG("%s", "widget reuse model data is null");
             return;
         }
-        
-        for (int entryIndex = 0; entryIndex < modelDataPtr->size(); entryIndex++) {
-            auto reuseEntry = modelDataPtr->Get(entryIndex);
-            uint64_t actionHash = reuseEntry->action();
-            const auto* activities = reuseEntry->activities();
-
-            // 在新的数据结构中，我们直接创建widget map，忽略activity层级
-            WidgetCountMap widgetMap;
-
-            // 遍历所有activity（通常只有一个空的activity）
-            for (int activityIndex = 0; activityIndex < activities->size(); activityIndex++) {
-                const ::fastbotx::ActivityWidgetMap* activityEntry = activities->Get(activityIndex);
-                const flatbuffers::Vector<flatbuffers::Offset<::fastbotx::WidgetCount>>* widgets = activityEntry->widgets();
-
-                // 将所有widget合并到同一个map中
-                for (int widgetIndex = 0; widgetIndex < widgets->size(); widgetIndex++) {
-                    const ::fastbotx::WidgetCount* widgetEntry = widgets->Get(widgetIndex);
-                    uint64_t widgetHash = widgetEntry->widget_hash();
-                    int count = widgetEntry->count();
-
-                    // 如果widget已存在，取较大的count值（合并不同activity的数据）
-                    if (widgetMap.find(widgetHash) != widgetMap.end()) {
-                        widgetMap[widgetHash] = std::max(widgetMap[widgetHash], count);
-                    } else {
-                        widgetMap[widgetHash] = count;
-                    }
-                }
-            }
 
-            if (!widgetMap.empty()) {
-                std::lock_guard<std::mutex> reuseGuard(this->_widgetReuseModelLock);
-                // 将WidgetCountMap转换为WidgetCountMapWithAttrs
-                WidgetCountMapWithAttrs widgetMapWithAttrs;
-                for (const auto& widgetPair : widgetMap) {
-                    WidgetCountWithAttributes widgetCountWithAttrs;
-                    widgetCountWithAttrs.count = widgetPair.second;
-                    // 其他属性保持默认值，因为旧模型中没有这些信息
-                    widgetMapWithAttrs[widgetPair.first] = widgetCountWithAttrs;
-                }
-                this->_widgetReuseModel[actionHash] = widgetMapWithAttrs;
-            }
-        }
-        
-        BLOG("loaded widget reuse model contains actions: %zu", this->_widgetReuseModel.size());
-        delete[] modelFileData;
+        BLOG("loaded widget reuse model contains actions: %zu (%zu bytes, %s)", this->widgetReuseModelSize(),
+             modelFile->size(), modelFile->mapped() ? "mapped" : "read");
 
         // 加载本地模型后，自动检测并加载多平台模型
         BLOG("本地模型加载完成，开始检测多平台模型...");
@@ -806,10 +1223,6 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
             std::lock_guard<std::mutex> cacheLock(_externalActionMatchCacheLock);
             _externalActionMatchCache.clear();
         }
-        {
-            std::lock_guard<std::mutex> idxLock(_externalWidgetIndexLock);
-            _externalWidgetVisitedIndex.clear();
-        }
         try {
             autoLoadMultiPlatformModels("/sdcard", packageName);
         } catch (const std::exception& e) {
@@ -817,6 +1230,231 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
         }
     }
 
+    void WidgetReusableAgent::replayJournal(const std::string& modelFilePath, uint64_t snapshotSequence) {
+        auto journal = std::make_shared<ReuseModelJournal>(modelFilePath);
+        std::lock_guard<std::mutex> reuseGuard(this->_widgetReuseModelLock);
+        this->_agingObservations = snapshotSequence;
+        uint64_t lastSequence = journal->replay(snapshotSequence, [this](uint64_t actionHash,
+                                                                         const std::vector<uint64_t>& widgetHashes) {
+            auto &row = this->mutableWidgetReuseEntry(actionHash);
+            for (uint64_t widgetHash : widgetHashes) {
+                this->countWidget(row, actionHash, widgetHash);
+            }
+            this->advanceAging();
+            this->_widgetReuseModel.mergeDeltaIfNeeded();
+        });
+        this->_journal = journal;
+        this->_journalSequence = lastSequence;
+        this->_compactedSequence = snapshotSequence;
+    }
+
+    bool WidgetReusableAgent::isActionInWidgetReuseModel(uint64_t actionHash) const {
+        if (this->_widgetReuseModel.contains(actionHash)) {
+            return true;
+        }
+        return this->_widgetReuseModelBase && nullptr != this->_widgetReuseModelBase->entries.find(actionHash);
+    }
+
+    size_t WidgetReusableAgent::widgetReuseModelSize() const {
+        return (this->_widgetReuseModelBase ? this->_widgetReuseModelBase->entries.size() : 0) +
+               this->_widgetReuseModelNewEntries;
+    }
+
+    bool WidgetReusableAgent::forEachWidgetCount(uint64_t actionHash,
+                                                 const std::function<void(uint64_t, int)>& visit) const {
+        WidgetCountMatrix::RowView row;
+        if (this->_widgetReuseModel.row(actionHash, row)) {
+            BLOG("Action %llu found in widget reuse model with %zu target widgets", actionHash, row.size);
+            for (size_t i = 0; i < row.size; ++i) {
+                visit(this->_localWidgetHashes[row.columns[i]], row.counts[i]);
+            }
+            return true;
+        }
+
+        const ReuseEntryV2 *reuseEntry =
+                this->_widgetReuseModelBase ? this->_widgetReuseModelBase->entries.find(actionHash) : nullptr;
+        if (nullptr == reuseEntry) {
+            return false;
+        }
+        // 保存时已合并了同一widget在多个activity下的计数，直接在映射区上遍历，hash从widget字典中取
+        const auto *widgets = reuseEntry->widgets();
+        const auto *widgetRecords = this->_widgetReuseModelBase->model->widgets();
+        BLOG("Action %llu found in widget reuse model with %u target widgets",
+             actionHash, widgets ? widgets->size() : 0);
+        if (widgets) {
+            for (const auto *widgetRef : *widgets) {
+                const auto *record = dictionaryRecord(widgetRecords, widgetRef->widget());
+                int count = this->decayedBaseCount(widgetRef->count());
+                if (record && count > 0) {
+                    visit(record->hash(), count);
+                }
+            }
+        }
+        return true;
+    }
+
+    WidgetCountMatrix::DeltaRow& WidgetReusableAgent::mutableWidgetReuseEntry(uint64_t actionHash) {
+        // 已修改过的条目在增量缓冲或CSR中；压缩中的快照视图还在读的行由矩阵复制后再修改
+        bool created = false;
+        WidgetCountMatrix::DeltaRow &row = this->_widgetReuseModel.mutableRow(actionHash, &created);
+        if (!created) {
+            return row;
+        }
+        const ReuseEntryV2 *reuseEntry =
+                this->_widgetReuseModelBase ? this->_widgetReuseModelBase->entries.find(actionHash) : nullptr;
+        if (nullptr == reuseEntry) {
+            this->_widgetReuseModelNewEntries++;
+            return row;
+        }
+        // 只复制计数；保存时按hash沿用模型文件字典中的widget记录，不需要复制属性
+        if (const auto *widgets = reuseEntry->widgets()) {
+            const auto *widgetRecords = this->_widgetReuseModelBase->model->widgets();
+            for (const auto *widgetRef : *widgets) {
+                const auto *record = dictionaryRecord(widgetRecords, widgetRef->widget());
+                int count = this->decayedBaseCount(widgetRef->count());
+                if (record && count > 0) {
+                    uint32_t widgetId = this->localWidgetId(record->hash());
+                    size_t i = row.find(widgetId);
+                    if (i < row.size()) {
+                        row.counts[i] = count;
+                    } else {
+                        row.append(widgetId, count);
+                    }
+                }
+            }
+        }
+        if (this->boundedWidgetReuseModel()) {
+            this->_widgetReuseTailCounts[actionHash] = this->decayedBaseCount(reuseEntry->tail_count());
+            // 未开启有界模型时保存的条目可能超出上限
+            this->trimWidgetReuseEntry(row, actionHash);
+        }
+        return row;
+    }
+
+    uint32_t WidgetReusableAgent::localWidgetId(uint64_t widgetHash) {
+        auto idIterator = this->_localWidgetIds.find(widgetHash);
+        if (idIterator != this->_localWidgetIds.end()) {
+            return idIterator->second;
+        }
+        auto widgetId = static_cast<uint32_t>(this->_localWidgetHashes.size());
+        this->_localWidgetIds.emplace(widgetHash, widgetId);
+        this->_localWidgetHashes.push_back(widgetHash);
+        this->_localWidgetAttributes.emplace_back();
+        // 已访问位图覆盖所有编号；本轮已访问过的widget第一次编号时补上
+        this->_visitedLocalWidgets.resize((this->_localWidgetHashes.size() + 63) / 64, 0);
+        if (this->_visitedWidgets.count(widgetHash)) {
+            this->_visitedLocalWidgets[widgetId >> 6] |= 1ULL << (widgetId & 63);
+        }
+        return widgetId;
+    }
+
+    uint64_t WidgetReusableAgent::tailSketchKey(uint64_t actionHash, uint64_t widgetHash) {
+        return actionHash * 0x9e3779b97f4a7c15ULL ^ widgetHash;
+    }
+
+    int WidgetReusableAgent::decayedBaseCount(int count) const {
+        return this->_baseDecay < 1.0 ? static_cast<int>(count * this->_baseDecay) : count;
+    }
+
+    bool WidgetReusableAgent::countWidget(WidgetCountMatrix::DeltaRow& row, uint64_t actionHash, uint64_t widgetHash) {
+        // 有界模型中进入长尾的widget不分配编号，旁表只随精确计数的widget增长
+        auto idIterator = this->_localWidgetIds.find(widgetHash);
+        size_t i = idIterator != this->_localWidgetIds.end() ? row.find(idIterator->second) : row.size();
+        if (i < row.size()) {
+            if (row.counts[i] < std::numeric_limits<int>::max()) {
+                row.counts[i]++;
+            }
+            return true;
+        }
+        if (!this->boundedWidgetReuseModel()) {
+            row.append(this->localWidgetId(widgetHash), 1);
+            return true;
+        }
+
+        // 不在前topWidgets个中的widget先计入sketch；sketch中的估计超过条目中最小的计数时把它换进来，
+        // 被换出的widget的计数进入sketch和长尾
+        uint64_t key = tailSketchKey(actionHash, widgetHash);
+        this->_tailSketch->add(key, 1);
+        int &tail = this->_widgetReuseTailCounts[actionHash];
+        tail++;
+        int estimate = static_cast<int>(std::min<uint32_t>(this->_tailSketch->estimate(key),
+                                                           static_cast<uint32_t>(std::numeric_limits<int>::max())));
+        if (row.size() >= this->_boundedConfig.topWidgets && row.size() > 0) {
+            size_t minimum = static_cast<size_t>(std::min_element(row.counts.begin(), row.counts.end()) -
+                                                 row.counts.begin());
+            if (row.counts[minimum] >= estimate) {
+                return false;
+            }
+            this->_tailSketch->raise(tailSketchKey(actionHash, this->_localWidgetHashes[row.columns[minimum]]),
+                                     static_cast<uint32_t>(std::max(0, row.counts[minimum])));
+            tail += row.counts[minimum];
+            row.erase(minimum);
+        }
+        // sketch的估计可能偏高（哈希冲突），换入的计数不超过长尾总数
+        int promoted = std::min(estimate, tail);
+        tail -= promoted;
+        row.append(this->localWidgetId(widgetHash), std::max(1, promoted));
+        return true;
+    }
+
+    void WidgetReusableAgent::trimWidgetReuseEntry(WidgetCountMatrix::DeltaRow& row, uint64_t actionHash) {
+        if (row.size() <= this->_boundedConfig.topWidgets) {
+            return;
+        }
+        std::vector<std::pair<int, uint32_t>> counts;
+        counts.reserve(row.size());
+        for (size_t i = 0; i < row.size(); ++i) {
+            counts.emplace_back(row.counts[i], row.columns[i]);
+        }
+        auto kept = counts.begin() + static_cast<std::ptrdiff_t>(this->_boundedConfig.topWidgets);
+        std::nth_element(counts.begin(), kept, counts.end(), std::greater<std::pair<int, uint32_t>>());
+        int &tail = this->_widgetReuseTailCounts[actionHash];
+        for (auto it = kept; it != counts.end(); ++it) {
+            this->_tailSketch->raise(tailSketchKey(actionHash, this->_localWidgetHashes[it->second]),
+                                     static_cast<uint32_t>(std::max(0, it->first)));
+            tail += it->first;
+        }
+        row.columns.clear();
+        row.counts.clear();
+        for (auto it = counts.begin(); it != kept; ++it) {
+            row.append(it->second, it->first);
+        }
+    }
+
+    int WidgetReusableAgent::tailCount(uint64_t actionHash) const {
+        auto tailIterator = this->_widgetReuseTailCounts.find(actionHash);
+        if (tailIterator != this->_widgetReuseTailCounts.end()) {
+            return tailIterator->second;
+        }
+        if (this->_widgetReuseModel.contains(actionHash)) {
+            return 0;
+        }
+        const ReuseEntryV2 *reuseEntry =
+                this->_widgetReuseModelBase ? this->_widgetReuseModelBase->entries.find(actionHash) : nullptr;
+        return reuseEntry ? this->decayedBaseCount(reuseEntry->tail_count()) : 0;
+    }
+
+    void WidgetReusableAgent::advanceAging() {
+        if (!this->boundedWidgetReuseModel() || this->_boundedConfig.agingPeriod <= 0 ||
+            this->_boundedConfig.decay >= 1.0) {
+            return;
+        }
+        if (0 != ++this->_agingObservations % static_cast<uint64_t>(this->_boundedConfig.agingPeriod)) {
+            return;
+        }
+        // 计数向下取整，长期没有再出现的widget逐渐老化出模型；文件中的条目在读取和保存时乘上累计的衰减。
+        // 修改过的条目先并入CSR再整体缩放，快照仍引用旧的CSR
+        double decay = this->_boundedConfig.decay;
+        this->_baseDecay *= decay;
+        this->_widgetReuseModel.scale(decay);
+        for (auto &tail : this->_widgetReuseTailCounts) {
+            tail.second = static_cast<int>(tail.second * decay);
+        }
+        this->_tailSketch->decay(decay);
+        BLOG("aged widget reuse model at observation %llu, decay %.3f (file counts x%.3f)",
+             (unsigned long long) this->_agingObservations, decay, this->_baseDecay);
+    }
+
     // 为了保持与基类接口的兼容性，保留原方法名但调用新的实现
     double WidgetReusableAgent::probabilityOfVisitingNewActivities(const ActivityStateActionPtr &action,
                                                                   const stringPtrSet &visitedActivities) const {
@@ -830,25 +1468,181 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
         if (!state) return;
 
         const auto& widgets = state->getWidgets();
+        std::vector<WidgetPtr> newlyVisited;
         for (const auto& widget : widgets) {
             if (widget) {
                 uint64_t widgetHash = widget->hash();
-                this->_visitedWidgets.insert(widgetHash);
-                BLOG("Added widget hash %llu to visited widgets set", widgetHash);
+                if (this->_visitedWidgets.insert(widgetHash).second) {
+                    auto idIterator = this->_localWidgetIds.find(widgetHash);
+                    if (idIterator != this->_localWidgetIds.end()) {
+                        this->_visitedLocalWidgets[idIterator->second >> 6] |= 1ULL << (idIterator->second & 63);
+                    }
+                    newlyVisited.push_back(widget);
+                    BLOG("Added widget hash %llu to visited widgets set", widgetHash);
+                }
             }
         }
         BLOG("Total visited widgets in current round: %zu", this->_visitedWidgets.size());
-    }
 
-    // 清空当前轮次访问过的控件集合（新轮次开始时调用）
-    void WidgetReusableAgent::clearVisitedWidgets() {
-        BLOG("Clearing visited widgets set (had %zu widgets)", this->_visitedWidgets.size());
-        this->_visitedWidgets.clear();
+        // 外部widget的覆盖只在本地widget第一次被访问时更新
+        this->updateExternalCoverage(std::move(newlyVisited));
     }
 
-    // ========== 多平台复用功能实现 ==========
+    void WidgetReusableAgent::updateExternalCoverage(std::vector<WidgetPtr> widgets) {
+        SimilarityEnginePtr engine;
+        uint64_t generation = 0;
+        {
+            std::shared_lock<std::shared_timed_mutex> modelsLock(_externalModelsLock);
+            if (_externalPlatformModels.empty()) {
+                return;
+            }
+            std::lock_guard<std::mutex> coverageLock(_externalWidgetCoverageLock);
+            auto markCovered = [this](size_t platform, uint32_t slot) {
+                std::vector<uint64_t>& bits = _externalWidgetCoverage[platform];
+                bits[slot >> 6] |= 1ULL << (slot & 63);
+            };
+
+            // 模型重新加载后位图重建，已访问widget的hash覆盖立即恢复
+            if (_externalWidgetCoverage.size() != _externalPlatformModels.size()) {
+                _externalWidgetCoverage.assign(_externalPlatformModels.size(), std::vector<uint64_t>());
+                for (size_t p = 0; p < _externalPlatformModels.size(); ++p) {
+                    const auto& platformData = _externalPlatformModels[p];
+                    _externalWidgetCoverage[p].assign((platformData.widgetHashes.size() + 63) / 64, 0);
+                    for (uint64_t widgetHash : _visitedWidgets) {
+                        auto slotIt = platformData.widgetSlots.find(widgetHash);
+                        if (slotIt != platformData.widgetSlots.end()) {
+                            markCovered(p, slotIt->second);
+                        }
+                    }
+                }
+            }
 
-    void WidgetReusableAgent::autoLoadMultiPlatformModels(const std::string& baseDir, const std::string& packageNameParam) {
+            for (const auto& widget : widgets) {
+                for (size_t p = 0; p < _externalPlatformModels.size(); ++p) {
+                    auto slotIt = _externalPlatformModels[p].widgetSlots.find(widget->hash());
+                    if (slotIt != _externalPlatformModels[p].widgetSlots.end()) {
+                        markCovered(p, slotIt->second);
+                    }
+                }
+            }
+
+            // 离开状态时控件细节会被清除，之后（或在线程池中）做相似度匹配时使用副本
+            for (auto& widget : widgets) {
+                widget = std::make_shared<Widget>(*widget);
+            }
+            // 相似度匹配需要模型：未就绪时先记下，就绪后一起匹配
+            engine = ActionSimilarity::currentEngine();
+            if (!engine || !engine->hasBert()) {
+                _pendingCoverageWidgets.insert(_pendingCoverageWidgets.end(), widgets.begin(), widgets.end());
+                return;
+            }
+            widgets.insert(widgets.end(), _pendingCoverageWidgets.begin(), _pendingCoverageWidgets.end());
+            _pendingCoverageWidgets.clear();
+            if (widgets.empty()) {
+                return;
+            }
+            generation = _externalCoverageGeneration;
+        }
+
+        // 相似覆盖需要推理，交给引擎的线程池，不占用决策时间预算；结果在之后的决策中生效。
+        // 任务引用了本对象，析构时等待
+        _externalCoverageTasks.erase(
+            std::remove_if(_externalCoverageTasks.begin(), _externalCoverageTasks.end(),
+                           [](const std::future<void>& task) {
+                               return std::future_status::ready == task.wait_for(std::chrono::milliseconds(0));
+                           }),
+            _externalCoverageTasks.end());
+        _externalCoverageTasks.push_back(engine->submit([this, widgets, generation]() {
+            this->matchExternalCoverage(widgets, generation);
+        }));
+    }
+
+    void WidgetReusableAgent::matchExternalCoverage(const std::vector<WidgetPtr>& widgets, uint64_t generation) {
+        std::shared_lock<std::shared_timed_mutex> modelsLock(_externalModelsLock);
+        auto stale = [this, generation]() {
+            return generation != _externalCoverageGeneration ||
+                   _externalWidgetCoverage.size() != _externalPlatformModels.size();
+        };
+        auto isCovered = [this, &stale](size_t platform, uint32_t slot) {
+            std::lock_guard<std::mutex> coverageLock(_externalWidgetCoverageLock);
+            return stale() || 0 != (_externalWidgetCoverage[platform][slot >> 6] & (1ULL << (slot & 63)));
+        };
+
+        // 每个新访问的widget取一次各属性向量，与每个平台的widget嵌入矩阵批量比较，只对候选做精确计算
+        std::vector<EmbeddingQuery> queries(widgets.size());
+        for (size_t i = 0; i < widgets.size(); ++i) {
+            ActionSimilarity::buildEmbeddingQuery(widgets[i], "", queries[i]);
+        }
+        std::vector<std::vector<uint32_t>> matched(_externalPlatformModels.size());
+        for (size_t p = 0; p < _externalPlatformModels.size(); ++p) {
+            const auto& platformData = _externalPlatformModels[p];
+            if (!platformData.widgetIndex || 0 == platformData.widgetIndex->size()) {
+                continue;
+            }
+            auto candidates = platformData.widgetIndex->topK(
+                    queries, ExternalCoverageCandidates,
+                    static_cast<float>(ExternalCoverageThreshold - ExternalIndexScoreMargin));
+            for (size_t i = 0; i < widgets.size(); ++i) {
+                for (const auto& candidate : candidates[i]) {
+                    auto slot = static_cast<uint32_t>(candidate.id);
+                    if (isCovered(p, slot)) {
+                        continue;
+                    }
+                    auto attrsIt = platformData.widgetAttributes.find(platformData.widgetHashes[slot]);
+                    if (attrsIt == platformData.widgetAttributes.end()) {
+                        continue;
+                    }
+                    const auto& attrs = attrsIt->second;
+                    double similarity = ActionSimilarity::calculateSimilarity(
+                            widgets[i], "", attrs.widgetText, attrs.activityName, attrs.widgetResourceId,
+                            attrs.widgetIconBase64, attrs.embeddings, ExternalCoverageThreshold);
+                    if (similarity >= ExternalCoverageThreshold) {
+                        matched[p].push_back(slot);
+                    }
+                }
+            }
+        }
+
+        // 新一轮开始或模型重新加载后，旧的匹配结果不再适用
+        std::lock_guard<std::mutex> coverageLock(_externalWidgetCoverageLock);
+        if (stale()) {
+            return;
+        }
+        size_t newlyCovered = 0;
+        for (size_t p = 0; p < _externalPlatformModels.size(); ++p) {
+            std::vector<uint64_t>& bits = _externalWidgetCoverage[p];
+            for (uint32_t slot : matched[p]) {
+                uint64_t mask = 1ULL << (slot & 63);
+                if (0 == (bits[slot >> 6] & mask)) {
+                    bits[slot >> 6] |= mask;
+                    ++newlyCovered;
+                }
+            }
+        }
+        for (size_t p = 0; p < _externalPlatformModels.size(); ++p) {
+            size_t covered = 0;
+            for (uint64_t word : _externalWidgetCoverage[p]) {
+                covered += static_cast<size_t>(__builtin_popcountll(word));
+            }
+            BLOG("平台 %s 的widget覆盖: %zu/%zu（本次新增相似覆盖%zu个）", _externalPlatformModels[p].platformId.c_str(),
+                 covered, _externalPlatformModels[p].widgetHashes.size(), newlyCovered);
+        }
+    }
+
+    // 清空当前轮次访问过的控件集合（新轮次开始时调用）
+    void WidgetReusableAgent::clearVisitedWidgets() {
+        BLOG("Clearing visited widgets set (had %zu widgets)", this->_visitedWidgets.size());
+        this->_visitedWidgets.clear();
+        std::fill(this->_visitedLocalWidgets.begin(), this->_visitedLocalWidgets.end(), 0);
+        std::lock_guard<std::mutex> coverageLock(_externalWidgetCoverageLock);
+        _externalWidgetCoverage.clear();
+        _pendingCoverageWidgets.clear();
+        ++_externalCoverageGeneration;
+    }
+
+    // ========== 多平台复用功能实现 ==========
+
+    void WidgetReusableAgent::autoLoadMultiPlatformModels(const std::string& baseDir, const std::string& packageNameParam) {
         BLOG("自动检测多平台模型，目录: %s", baseDir.c_str());
 
         std::string packageName;
@@ -890,27 +1684,33 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
 
         BLOG("当前包名: %s, 当前平台: %s", packageName.c_str(), currentPlatform.c_str());
 
-        // 清空现有的外部平台模型（重新加载）
+        // 清空现有的外部平台模型（重新加载）；上一次的后台加载须先结束
+        waitExternalModelLoads();
         {
-            std::lock_guard<std::mutex> lock(_externalModelsLock);
+            std::lock_guard<std::shared_timed_mutex> lock(_externalModelsLock);
             if (!_externalPlatformModels.empty()) {
                 BLOG("清空现有的 %zu 个外部平台模型", _externalPlatformModels.size());
                 _externalPlatformModels.clear();
             }
+            _externalPlatformIndex.clear();
         }
         // 同步清空与外部模型关联的缓存与索引
         {
             std::lock_guard<std::mutex> cacheLock(_externalActionMatchCacheLock);
             _externalActionMatchCache.clear();
+            _externalMatchCacheDirty = false;
+            _externalModelsVersion = 0;
         }
         {
-            std::lock_guard<std::mutex> idxLock(_externalWidgetIndexLock);
-            _externalWidgetVisitedIndex.clear();
+            // 覆盖位图按新加载的模型重新建立
+            std::lock_guard<std::mutex> coverageLock(_externalWidgetCoverageLock);
+            _externalWidgetCoverage.clear();
+            ++_externalCoverageGeneration;
         }
 
-        // 搜索其他平台的模型文件
+        // 搜索其他平台的模型文件（只检查文件是否存在，在调用线程上完成）
         std::vector<std::string> platformSuffixes = {"tablet", "tv", "car", "watch", "phone"};
-        int foundModels = 0;
+        std::vector<std::pair<std::string, std::string>> foundModels;  // (路径, 平台)
 
         for (const auto& platform : platformSuffixes) {
             if (platform == currentPlatform) {
@@ -922,29 +1722,55 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
             BLOG("检查外部平台模型: %s", modelPath.c_str());
 
             // 检查文件是否存在
-            std::ifstream file(modelPath);
-            if (file.good()) {
-                file.close();
+            struct stat fileStat{};
+            if (0 == stat(modelPath.c_str(), &fileStat) && S_ISREG(fileStat.st_mode)) {
                 BLOG("发现外部平台模型: %s", modelPath.c_str());
-                foundModels++;
+                foundModels.emplace_back(modelPath, platform);
+            } else {
+                BLOG("未找到平台 %s 的模型文件", platform.c_str());
+            }
+        }
+
+        if (foundModels.empty()) {
+            BLOG("未找到任何外部平台模型");
+            finishExternalModelLoading();
+            return;
+        }
 
-                if (addExternalPlatformModel(modelPath, platform)) {
+        // 每个模型文件在自己的线程中解析并建立索引，加载完成后立即发布；调用线程（InitAgent）不等待，
+        // 决策在外部模型就绪之前只使用本地模型。手动补全属性时参考的状态在这里取快照，不在工作线程读_newState
+        _externalModelsReadiness = ExternalModelsReadiness::Loading;
+        _pendingExternalModelLoads = foundModels.size();
+        StatePtr referenceState = this->_newState;
+        for (const auto& found : foundModels) {
+            std::string modelPath = found.first;
+            std::string platform = found.second;
+            _externalModelLoads.push_back(std::async(std::launch::async, [this, modelPath, platform, referenceState]() {
+                if (addExternalPlatformModel(modelPath, platform, referenceState)) {
                     BLOG("成功加载外部平台模型: %s", platform.c_str());
                 } else {
                     BLOGE("加载外部平台模型失败: %s", platform.c_str());
                 }
-            } else {
-                BLOG("未找到平台 %s 的模型文件", platform.c_str());
-            }
+                if (0 == --_pendingExternalModelLoads) {
+                    finishExternalModelLoading();
+                }
+            }));
         }
+    }
 
-        if (foundModels == 0) {
-            BLOG("未找到任何外部平台模型");
+    void WidgetReusableAgent::waitExternalModelLoads() {
+        for (auto& load : _externalModelLoads) {
+            if (load.valid()) {
+                load.wait();
+            }
         }
+        _externalModelLoads.clear();
+    }
 
+    void WidgetReusableAgent::finishExternalModelLoading() {
         // 检查是否成功加载了模型
         {
-            std::lock_guard<std::mutex> lock(_externalModelsLock);
+            std::shared_lock<std::shared_timed_mutex> lock(_externalModelsLock);
             if (_externalPlatformModels.empty()) {
                 BLOG("未成功加载任何外部平台模型");
             } else {
@@ -954,47 +1780,38 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
                     const auto& platform = _externalPlatformModels[i];
                     BLOG("  %zu) 平台: %s, Actions: %zu, 属性: %zu", 
                          i+1, platform.platformId.c_str(), 
-                         platform.reuseModel.size(), platform.actionAttributes.size());
+                         platform.reuseModel.rowCount(), platform.actionAttributes.size());
                 }
             }
         }
+
+        // 上次运行针对同一组外部模型的匹配结果直接复用；缓存的版本由全部模型决定，须在所有模型加载完成后读取
+        loadExternalMatchCache();
+        _externalModelsReadiness = ExternalModelsReadiness::Ready;
     }
 
-    bool WidgetReusableAgent::addExternalPlatformModel(const std::string& modelPath, const std::string& platformInfo) {
+    bool WidgetReusableAgent::addExternalPlatformModel(const std::string& modelPath, const std::string& platformInfo,
+                                                       const StatePtr& referenceState) {
         BLOG("加载外部平台模型: %s (平台: %s)", modelPath.c_str(), platformInfo.c_str());
 
         try {
-            std::ifstream modelFile(modelPath, std::ios::binary);
-            if (!modelFile.is_open()) {
+            // 映射随平台数据一起保存，属性中的量化向量直接引用其中的数据；v1模型转换为v2后保存在内存中
+            MappedModelFilePtr modelFile = openWidgetReuseModel(modelPath, false);
+            if (!modelFile) {
                 BLOGE("无法打开模型文件: %s", modelPath.c_str());
                 return false;
             }
 
-            // 读取文件内容
-            std::filebuf* fileBuffer = modelFile.rdbuf();
-            std::size_t filesize = fileBuffer->pubseekoff(0, modelFile.end, modelFile.in);
-            fileBuffer->pubseekpos(0, modelFile.in);
-
-            auto modelFileData = std::make_unique<char[]>(filesize);
-            fileBuffer->sgetn(modelFileData.get(), static_cast<int>(filesize));
-
             // 解析FlatBuffers数据
-            auto widgetReuseFBModel = GetWidgetReuseModel(modelFileData.get());
-            if (!widgetReuseFBModel || !widgetReuseFBModel->model()) {
+            auto widgetReuseFBModel = GetWidgetReuseModel(modelFile->data());
+            if (!widgetReuseFBModel || !widgetReuseFBModel->entries()) {
                 BLOGE("解析模型文件失败: %s", modelPath.c_str());
                 return false;
             }
 
             // 检查模型中是否有相似度属性
-            bool hasSimilarityAttrs = false;
-            // 尝试读取第一个条目的相似度属性来判断
-            if (widgetReuseFBModel->model()->size() > 0) {
-                auto firstEntry = widgetReuseFBModel->model()->Get(0);
-                if (firstEntry->similarity_attrs() != nullptr) {
-                    hasSimilarityAttrs = true;
-                }
-            }
-            
+            bool hasSimilarityAttrs = widgetReuseFBModel->actions() && widgetReuseFBModel->actions()->size() > 1;
+
             BLOG("模型文件: %s, 是否包含相似度属性: %s", 
                  modelPath.c_str(), hasSimilarityAttrs ? "是" : "否");
 
@@ -1002,109 +1819,114 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
             ExternalPlatformData platformData;
             platformData.platformId = platformInfo;
             platformData.modelPath = modelPath;
+            platformData.modelFile = modelFile;
+            platformData.modelTag = modelFileTag(modelPath);
 
             // 加载基本复用数据
-            auto modelDataPtr = widgetReuseFBModel->model();
+            auto modelDataPtr = widgetReuseFBModel->entries();
             int actionWithAttrsCount = 0;
-
-            for (int actionIndex = 0; actionIndex < modelDataPtr->size(); actionIndex++) {
-                const auto* reuseEntry = modelDataPtr->Get(actionIndex);
+            // 每个widget记录只读取一次属性
+            std::vector<bool> widgetRecordLoaded(widgetReuseFBModel->widgets() ? widgetReuseFBModel->widgets()->size() : 0);
+            std::unordered_map<uint32_t, std::string> iconBase64Cache;
+
+            // 按action hash升序读取，计数直接追加成CSR的行，列为widget编号
+            SortedEntryTable<ReuseEntryV2> sortedEntries;
+            sortedEntries.reset(modelDataPtr);
+            std::vector<uint32_t> rowColumns;
+            std::vector<int32_t> rowCounts;
+            bool hasRow = false;
+            uint64_t lastRowAction = 0;
+            for (size_t entryIndex = 0; entryIndex < sortedEntries.size(); ++entryIndex) {
+                const ReuseEntryV2 *reuseEntry = sortedEntries.at(entryIndex);
                 uint64_t actionHash = reuseEntry->action();
 
-                std::map<uint64_t, int> widgetMap;
-
-                // 处理activities
-                auto activities = reuseEntry->activities();
-                if (activities) {
-                    for (int activityIndex = 0; activityIndex < activities->size(); activityIndex++) {
-                        const auto* activityWidgetMap = activities->Get(activityIndex);
-                        auto widgets = activityWidgetMap->widgets();
-
-                        if (widgets) {
-                            for (int widgetIndex = 0; widgetIndex < widgets->size(); widgetIndex++) {
-                                const auto* widgetEntry = widgets->Get(widgetIndex);
-                                uint64_t widgetHash = widgetEntry->widget_hash();
-                                int count = widgetEntry->count();
-
-                                // 合并不同activity的widget计数
-                                if (widgetMap.find(widgetHash) != widgetMap.end()) {
-                                    widgetMap[widgetHash] = std::max(widgetMap[widgetHash], count);
-                                } else {
-                                    widgetMap[widgetHash] = count;
-                                }
-
-                                // 加载widget的相似度属性
-                                if (widgetEntry->similarity_attrs()) {
-                                    const auto* widgetAttrs = widgetEntry->similarity_attrs();
-
-                                    ExternalPlatformData::WidgetAttributes attrs;
-                                    attrs.widgetHash = widgetHash;
-                                    attrs.widgetText = widgetAttrs->text() ? widgetAttrs->text()->str() : "";
-                                    attrs.activityName = widgetAttrs->activity_name() ? widgetAttrs->activity_name()->str() : "";
-                                    attrs.widgetResourceId = widgetAttrs->resource_id() ? widgetAttrs->resource_id()->str() : "";
-
-                                    // 读取图标数据（base64格式）
-                                    if (widgetAttrs->icon_base64()) {
-                                        attrs.widgetIconBase64 = widgetAttrs->icon_base64()->str();
-                                    }
-
-                                    platformData.widgetAttributes[widgetHash] = attrs;
-                                }
+                // 保存时已合并了多个activity下的widget计数
+                rowColumns.clear();
+                rowCounts.clear();
+                if (reuseEntry->widgets()) {
+                    for (const auto* widgetRef : *reuseEntry->widgets()) {
+                        const auto* widgetRecord = dictionaryRecord(widgetReuseFBModel->widgets(), widgetRef->widget());
+                        if (nullptr == widgetRecord) {
+                            continue;
+                        }
+                        uint64_t widgetHash = widgetRecord->hash();
+                        // 属性单独保存在widgetAttributes中
+                        rowColumns.push_back(assignExternalWidgetSlot(platformData, widgetHash));
+                        rowCounts.push_back(widgetRef->count());
+
+                        // 加载widget的相似度属性
+                        if (!widgetRecordLoaded[widgetRef->widget()]) {
+                            widgetRecordLoaded[widgetRef->widget()] = true;
+                            ExternalPlatformData::WidgetAttributes attrs;
+                            attrs.widgetHash = widgetHash;
+                            readWidgetRecord(widgetReuseFBModel, widgetRef->widget(), iconBase64Cache, attrs);
+                            bool hasAttrs = !attrs.widgetText.empty() || !attrs.widgetResourceId.empty() ||
+                                            !attrs.activityName.empty() || !attrs.widgetIconBase64.empty() ||
+                                            !attrs.embeddings.empty();
+                            if (hasAttrs) {
+                                platformData.widgetAttributes[widgetHash] = attrs;
                             }
                         }
                     }
                 }
 
-                if (!widgetMap.empty()) {
-                    // 将WidgetCountMap转换为WidgetCountMapWithAttrs
-                    WidgetCountMapWithAttrs widgetMapWithAttrs;
-                    for (const auto& widgetPair : widgetMap) {
-                        WidgetCountWithAttributes widgetCountWithAttrs;
-                        widgetCountWithAttrs.count = widgetPair.second;
-                        // 其他属性保持默认值，因为外部模型可能没有这些信息
-                        widgetMapWithAttrs[widgetPair.first] = widgetCountWithAttrs;
-                    }
-                    platformData.reuseModel[actionHash] = widgetMapWithAttrs;
+                // 同一action重复出现时只保留第一条
+                if (!rowColumns.empty() && (!hasRow || actionHash != lastRowAction)) {
+                    platformData.reuseModel.appendRow(actionHash, rowColumns.data(), rowCounts.data(), rowColumns.size());
+                    hasRow = true;
+                    lastRowAction = actionHash;
                 }
 
                 // 如果有相似度属性，也加载它们
-                if (reuseEntry->similarity_attrs()) {
+                if (const auto* actionRecord = dictionaryRecord(widgetReuseFBModel->actions(), reuseEntry->attributes())) {
                     ExternalPlatformData::ActionAttributes attrs;
                     attrs.actionHash = actionHash;
-
-                    const auto* actionAttrs = reuseEntry->similarity_attrs();
-                    attrs.actionType = actionAttrs->action_type();
-                    attrs.activityName = actionAttrs->activity_name() ? actionAttrs->activity_name()->str() : "";
-
-                    if (actionAttrs->target_widget()) {
-                        const auto* widgetAttrs = actionAttrs->target_widget();
-                        attrs.widgetText = widgetAttrs->text() ? widgetAttrs->text()->str() : "";
-                        attrs.widgetResourceId = widgetAttrs->resource_id() ? widgetAttrs->resource_id()->str() : "";
-
-                        // 读取图标数据（base64格式）
-                        if (widgetAttrs->icon_base64()) {
-                            attrs.widgetIconBase64 = widgetAttrs->icon_base64()->str();
-                        }
-                        
-                        BLOG("加载action属性: hash=%llu, type=%d, text='%s', resourceId='%s', iconSize=%zu",
-                             attrs.actionHash, attrs.actionType, attrs.widgetText.c_str(), 
-                             attrs.widgetResourceId.c_str(), attrs.widgetIconBase64.size());
+                    attrs.actionType = actionRecord->action_type();
+                    readWidgetRecord(widgetReuseFBModel, actionRecord->target_widget(), iconBase64Cache, attrs);
+                    // action的activity以action记录为准
+                    attrs.activityName.clear();
+                    attrs.embeddings.activityName = Int8EmbeddingView();
+                    if (const auto* activity = dictionaryRecord(widgetReuseFBModel->activities(), actionRecord->activity())) {
+                        attrs.activityName = activity->name() ? activity->name()->str() : "";
+                        attrs.embeddings.activityName = embeddingView(activity->embedding());
                     }
 
+                    BLOG("加载action属性: hash=%llu, type=%d, text='%s', resourceId='%s', iconSize=%zu",
+                         attrs.actionHash, attrs.actionType, attrs.widgetText.c_str(),
+                         attrs.widgetResourceId.c_str(), attrs.widgetIconBase64.size());
+
                     platformData.actionAttributes.push_back(attrs);
                     actionWithAttrsCount++;
                 }
             }
 
             // 如果模型中没有相似度属性，但我们需要它们进行跨平台匹配，则手动创建
-            if (platformData.actionAttributes.empty() && !platformData.reuseModel.empty()) {
+            if (platformData.actionAttributes.empty() && 0 != platformData.reuseModel.rowCount()) {
                 BLOG("模型中没有相似度属性，正在手动创建...");
-                BLOG("外部模型包含 %zu 个actions，但没有任何action属性", platformData.reuseModel.size());
+                BLOG("外部模型包含 %zu 个actions，但没有任何action属性", platformData.reuseModel.rowCount());
+
+                // 参考状态中的action和widget按hash建表，每个外部action只查一次
+                std::unordered_map<uint64_t, ActivityNameActionPtr> stateActions;
+                std::unordered_map<uint64_t, WidgetPtr> stateWidgets;
+                if (referenceState) {
+                    for (const auto& action : referenceState->getActions()) {
+                        auto activityNameAction = std::dynamic_pointer_cast<ActivityNameAction>(action);
+                        if (activityNameAction) {
+                            stateActions.emplace(activityNameAction->hash(), activityNameAction);
+                        }
+                    }
+                    for (const auto& widget : referenceState->getWidgets()) {
+                        if (widget) {
+                            stateWidgets.emplace(widget->hash(), widget);
+                        }
+                    }
+                }
                 
                 // 遍历所有action
-                for (const auto& actionPair : platformData.reuseModel) {
+                platformData.reuseModel.forEachRow([&platformData, &stateActions, &stateWidgets](
+                        uint64_t actionHash, const WidgetCountMatrix::RowView& row) {
                     ExternalPlatformData::ActionAttributes attrs;
-                    attrs.actionHash = actionPair.first;
+                    attrs.actionHash = actionHash;
                     
                     // 默认值
                     attrs.actionType = 1; // 默认为CLICK类型
@@ -1121,70 +1943,61 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
                     }
                     
                     BLOG("处理外部模型action: hash=%llu, type=%d, widgetCount=%zu", 
-                         attrs.actionHash, attrs.actionType, actionPair.second.size());
+                         attrs.actionHash, attrs.actionType, row.size);
                     
-                    // 尝试从本地模型中查找相同hash的action，获取更多信息
-                    if (this->_newState) {
-                        for (const auto& action : this->_newState->getActions()) {
-                            if (action && action->hash() == attrs.actionHash) {
-                                // 找到了相同hash的action，获取它的属性
-                                auto activityNameAction = std::dynamic_pointer_cast<ActivityNameAction>(action);
-                                if (activityNameAction) {
-                                    attrs.actionType = static_cast<int>(activityNameAction->getActionType());
-                                    attrs.activityName = activityNameAction->getActivity() ? *activityNameAction->getActivity() : "";
-                                    
-                                    auto targetWidget = activityNameAction->getTarget();
-                                    if (targetWidget) {
-                                        attrs.widgetText = targetWidget->getText();
-                                        attrs.widgetResourceId = targetWidget->getResourceID();
-                                        
-                                        if (targetWidget->hasIcon()) {
-                                            attrs.widgetIconBase64 = targetWidget->getIconBase64();
-                                        }
-                                    }
-                                    
-                                    BLOG("从本地模型找到匹配action: hash=%llu, type=%d, text='%s', resourceId='%s'",
-                                         attrs.actionHash, attrs.actionType, attrs.widgetText.c_str(), attrs.widgetResourceId.c_str());
-                                }
-                                break;
+                    // 尝试从参考状态中查找相同hash的action，获取更多信息
+                    auto stateActionIt = stateActions.find(attrs.actionHash);
+                    if (stateActionIt != stateActions.end()) {
+                        // 找到了相同hash的action，获取它的属性
+                        const auto& activityNameAction = stateActionIt->second;
+                        attrs.actionType = static_cast<int>(activityNameAction->getActionType());
+                        attrs.activityName = activityNameAction->getActivity() ? *activityNameAction->getActivity() : "";
+
+                        auto targetWidget = activityNameAction->getTarget();
+                        if (targetWidget) {
+                            attrs.widgetText = targetWidget->getText();
+                            attrs.widgetResourceId = targetWidget->getResourceID();
+
+                            if (targetWidget->hasIcon()) {
+                                attrs.widgetIconBase64 = targetWidget->getIconBase64();
                             }
                         }
+
+                        BLOG("从本地模型找到匹配action: hash=%llu, type=%d, text='%s', resourceId='%s'",
+                             attrs.actionHash, attrs.actionType, attrs.widgetText.c_str(), attrs.widgetResourceId.c_str());
                     }
                     
-                    // 尝试从widgetMap中提取更多信息
-                    const auto& widgetMap = actionPair.second;
-                    if (!widgetMap.empty()) {
+                    // 尝试从widget计数中提取更多信息
+                    if (row.size > 0) {
                         // 查找出现频率最高的widget
                         uint64_t mostFrequentWidgetHash = 0;
                         int maxCount = 0;
-                        for (const auto& widgetPair : widgetMap) {
-                            if (widgetPair.second.count > maxCount) {
-                                maxCount = widgetPair.second.count;
-                                mostFrequentWidgetHash = widgetPair.first;
+                        for (size_t i = 0; i < row.size; ++i) {
+                            if (row.counts[i] > maxCount) {
+                                maxCount = row.counts[i];
+                                mostFrequentWidgetHash = platformData.widgetHashes[row.columns[i]];
                             }
                         }
                         
                         BLOG("外部模型action %llu 最频繁的widget: hash=%llu, count=%d", 
                              attrs.actionHash, mostFrequentWidgetHash, maxCount);
                         
-                        // 尝试从本地模型中查找这个widget
-                        if (this->_newState && mostFrequentWidgetHash != 0) {
-                            for (const auto& widget : this->_newState->getWidgets()) {
-                                if (widget && widget->hash() == mostFrequentWidgetHash) {
-                                    // 使用这个widget的属性补充action属性
-                                    if (attrs.widgetText.empty()) {
-                                        attrs.widgetText = widget->getText();
-                                    }
-                                    if (attrs.widgetResourceId.empty()) {
-                                        attrs.widgetResourceId = widget->getResourceID();
-                                    }
-                                    // 不覆盖activity，因为widget没有activity信息
-                                    
-                                    BLOG("从本地模型找到匹配widget: hash=%llu, text='%s', resourceId='%s'",
-                                         mostFrequentWidgetHash, widget->getText().c_str(), widget->getResourceID().c_str());
-                                    break;
-                                }
+                        // 尝试从参考状态中查找这个widget
+                        auto stateWidgetIt = mostFrequentWidgetHash != 0 ? stateWidgets.find(mostFrequentWidgetHash)
+                                                                         : stateWidgets.end();
+                        if (stateWidgetIt != stateWidgets.end()) {
+                            const auto& widget = stateWidgetIt->second;
+                            // 使用这个widget的属性补充action属性
+                            if (attrs.widgetText.empty()) {
+                                attrs.widgetText = widget->getText();
+                            }
+                            if (attrs.widgetResourceId.empty()) {
+                                attrs.widgetResourceId = widget->getResourceID();
                             }
+                            // 不覆盖activity，因为widget没有activity信息
+
+                            BLOG("从本地模型找到匹配widget: hash=%llu, text='%s', resourceId='%s'",
+                                 mostFrequentWidgetHash, widget->getText().c_str(), widget->getResourceID().c_str());
                         }
                     }
                     
@@ -1210,19 +2023,17 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
                          attrs.actionHash, attrs.actionType, attrs.widgetText.c_str(), attrs.widgetResourceId.c_str());
                     
                     platformData.actionAttributes.push_back(attrs);
-                }
+                });
                 
                 BLOG("手动创建了 %zu 个action属性记录", platformData.actionAttributes.size());
             }
 
-            // 添加到外部模型列表
-            {
-                std::lock_guard<std::mutex> lock(_externalModelsLock);
-                _externalPlatformModels.push_back(platformData);
-            }
+            buildExternalActionBuckets(platformData);
+            buildExternalActionIndex(platformData);
+            buildExternalWidgetIndex(platformData);
 
             BLOG("成功加载外部平台模型: %s, %zu个actions, %d个带属性的actions, %zu个属性",
-                 platformInfo.c_str(), platformData.reuseModel.size(), 
+                 platformInfo.c_str(), platformData.reuseModel.rowCount(), 
                  actionWithAttrsCount, platformData.actionAttributes.size());
              
             // 打印前5个action属性的详细信息，帮助调试
@@ -1236,6 +2047,16 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
                 }
             }
 
+            // 完整建好索引后在独占锁内整体发布，查询只会看到未加载或已加载完成的模型
+            {
+                std::lock_guard<std::shared_timed_mutex> lock(_externalModelsLock);
+                if (_externalPlatformIndex.count(platformData.platformId)) {
+                    BLOG("外部平台模型 %s 已加载，忽略重复的模型", platformData.platformId.c_str());
+                    return false;
+                }
+                _externalPlatformIndex.emplace(platformData.platformId, _externalPlatformModels.size());
+                _externalPlatformModels.push_back(std::move(platformData));
+            }
             return true;
 
         } catch (const std::exception& e) {
@@ -1249,22 +2070,6 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
             return false;
         }
 
-        uint64_t actionHash = action->hash();
-
-        // 先检查缓存命中（仅缓存成功匹配的结果）
-        {
-            std::lock_guard<std::mutex> cacheLock(_externalActionMatchCacheLock);
-            auto it = _externalActionMatchCache.find(actionHash);
-            if (it != _externalActionMatchCache.end()) {
-                const auto& cached = it->second;
-                if (cached.found && cached.similarity >= similarityThreshold) {
-                    BLOG("外部action匹配命中缓存: platform=%s, similarity=%.3f, actionHash=%llu",
-                         cached.platformId.c_str(), cached.similarity, cached.actionHash);
-                    return true;
-                }
-            }
-        }
-
         // // 首先检查本地模型
         // {
         //     std::lock_guard<std::mutex> reuseGuard(this->_widgetReuseModelLock);
@@ -1273,11 +2078,148 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
         //     }
         // }
 
-        // 检查外部模型
-        auto match = findSimilarActionInExternalModels(action, similarityThreshold);
+        // 检查外部模型（依次查缓存、本状态的并行预取结果）
+        auto match = lookupExternalMatch(action, similarityThreshold);
         return match.found;
     }
 
+    WidgetReusableAgent::ExternalActionMatch WidgetReusableAgent::lookupExternalMatch(
+        const ActivityNameActionPtr& action, double similarityThreshold) const {
+        uint64_t actionHash = action->hash();
+
+        // 先检查缓存命中（包括确认过没有匹配的结果）
+        ExternalActionMatch cached;
+        if (findCachedExternalMatch(actionHash, similarityThreshold, cached)) {
+            return cached;
+        }
+
+        // 不在预算内的阈值直接同步计算
+        if (similarityThreshold != _stateExternalMatchThreshold) {
+            return findSimilarActionInExternalModels(action, similarityThreshold);
+        }
+
+        // 再查本状态已完成的结果（包含未匹配的结果）
+        auto doneIt = _stateExternalMatches.find(actionHash);
+        if (doneIt != _stateExternalMatches.end()) {
+            return doneIt->second;
+        }
+
+        auto pendingIt = _pendingExternalMatches.find(actionHash);
+        if (pendingIt == _pendingExternalMatches.end()) {
+            SimilarityEnginePtr engine = ActionSimilarity::currentEngine();
+            if (!engine) {
+                // 模型仍在加载，相似度走字符串回退，直接在决策线程上计算
+                return findSimilarActionInExternalModels(action, similarityThreshold);
+            }
+            pendingIt = _pendingExternalMatches.emplace(
+                    actionHash, submitExternalMatch(engine, action, similarityThreshold)).first;
+        }
+
+        // 在截止时间前等待后台任务；超时则本次按未匹配处理，任务留在后台继续执行
+        std::future_status status = _decisionBudgeted ? pendingIt->second.wait_until(_decisionDeadline)
+                                                      : std::future_status::ready;
+        ExternalActionMatch result;
+        result.found = false;
+        result.similarity = 0.0;
+        result.actionHash = 0;
+        if (std::future_status::ready != status) {
+            BLOG("决策预算已用完，外部匹配转入后台: actionHash=%llu", actionHash);
+            return result;
+        }
+        try {
+            result = pendingIt->second.get();
+        } catch (const std::exception& e) {
+            BLOGE("外部匹配任务失败: %s", e.what());
+        }
+        _pendingExternalMatches.erase(pendingIt);
+        _stateExternalMatches[actionHash] = result;
+        return result;
+    }
+
+    std::future<WidgetReusableAgent::ExternalActionMatch> WidgetReusableAgent::submitExternalMatch(
+        const SimilarityEnginePtr& engine, const ActivityNameActionPtr& action, double similarityThreshold) const {
+        // 任务持有action，并通过共享锁读取外部模型；析构时等待所有任务结束
+        return engine->submit([this, action, similarityThreshold]() {
+            return this->findSimilarActionInExternalModels(action, similarityThreshold);
+        });
+    }
+
+    bool WidgetReusableAgent::decisionBudgetExhausted() const {
+        return _decisionBudgeted && std::chrono::steady_clock::now() >= _decisionDeadline;
+    }
+
+    void WidgetReusableAgent::prefetchExternalMatches(const StatePtr& state, double similarityThreshold) {
+        _stateExternalMatches.clear();
+        // 丢弃已结束的作废任务
+        _abandonedExternalMatches.erase(
+            std::remove_if(_abandonedExternalMatches.begin(), _abandonedExternalMatches.end(),
+                           [](const std::future<ExternalActionMatch>& abandoned) {
+                               return std::future_status::ready ==
+                                      abandoned.wait_for(std::chrono::milliseconds(0));
+                           }),
+            _abandonedExternalMatches.end());
+        if (similarityThreshold != _stateExternalMatchThreshold) {
+            // 旧阈值下的结果不再使用，但任务可能仍在执行，保留future以便析构时等待
+            for (auto& pending : _pendingExternalMatches) {
+                _abandonedExternalMatches.push_back(std::move(pending.second));
+            }
+            _pendingExternalMatches.clear();
+            _stateExternalMatchThreshold = similarityThreshold;
+        }
+
+        // 收取上一步决策超时后在后台完成的匹配
+        for (auto it = _pendingExternalMatches.begin(); it != _pendingExternalMatches.end();) {
+            if (std::future_status::ready != it->second.wait_for(std::chrono::milliseconds(0))) {
+                ++it;
+                continue;
+            }
+            try {
+                _stateExternalMatches[it->first] = it->second.get();
+            } catch (const std::exception& e) {
+                BLOGE("外部匹配任务失败: %s", e.what());
+            }
+            it = _pendingExternalMatches.erase(it);
+        }
+
+        if (!state) {
+            return;
+        }
+        SimilarityEnginePtr engine = ActionSimilarity::currentEngine();
+        if (!engine) {
+            // 模型加载中，逐个在决策线程上按需计算
+            return;
+        }
+        {
+            std::shared_lock<std::shared_timed_mutex> modelsLock(_externalModelsLock);
+            if (_externalPlatformModels.empty()) {
+                return;
+            }
+        }
+
+        // 本状态中需要外部匹配的action：不在本地模型中、未命中缓存、也没有已完成或执行中的任务
+        size_t submitted = 0;
+        for (const auto& action : state->getActions()) {
+            auto activityNameAction = std::dynamic_pointer_cast<ActivityNameAction>(action);
+            if (!activityNameAction || !activityNameAction->getTarget()) {
+                continue;
+            }
+            uint64_t actionHash = activityNameAction->hash();
+            if (this->isActionInWidgetReuseModel(actionHash) ||
+                _stateExternalMatches.count(actionHash) > 0 || _pendingExternalMatches.count(actionHash) > 0) {
+                continue;
+            }
+            ExternalActionMatch cached;
+            if (findCachedExternalMatch(actionHash, similarityThreshold, cached)) {
+                continue;
+            }
+            _pendingExternalMatches.emplace(actionHash,
+                                            submitExternalMatch(engine, activityNameAction, similarityThreshold));
+            ++submitted;
+        }
+        BLOG("外部匹配已提交%zu个, 后台执行中%zu个, 已完成%zu个, 工作线程%zu个", submitted,
+             _pendingExternalMatches.size(), _stateExternalMatches.size(), engine->workerCount());
+    }
+
     bool WidgetReusableAgent::isWidgetVisitedWithSimilarity(const WidgetPtr& widget, double similarityThreshold) const {
         if (!widget) {
             return false;
@@ -1291,6 +2233,220 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
 
     WidgetReusableAgent::ExternalActionMatch WidgetReusableAgent::findSimilarActionInExternalModels(
         const ActivityNameActionPtr& action, double similarityThreshold) const {
+        std::shared_lock<std::shared_timed_mutex> lock(_externalModelsLock);
+        ExternalActionMatch result = matchExternalModelsLocked(action, similarityThreshold);
+        // 相似度模型加载完成前相似度走字符串回退；外部模型还在后台加载时只查了已发布的模型。
+        // 这两种情况下的未匹配结果都不缓存
+        bool externalModelsReady = ExternalModelsReadiness::Ready == _externalModelsReadiness.load();
+        if (action && !_externalPlatformModels.empty() &&
+            (result.found || (ActionSimilarity::currentEngine() && externalModelsReady))) {
+            storeExternalMatch(action->hash(), similarityThreshold, result);
+        }
+        return result;
+    }
+
+    bool WidgetReusableAgent::findCachedExternalMatch(uint64_t actionHash, double similarityThreshold,
+                                                      ExternalActionMatch& out) const {
+        std::lock_guard<std::mutex> cacheLock(_externalActionMatchCacheLock);
+        auto it = _externalActionMatchCache.find(actionHash);
+        if (it == _externalActionMatchCache.end()) {
+            return false;
+        }
+        const CachedExternalMatch& cached = it->second;
+        if (cached.match.found && cached.match.similarity >= similarityThreshold) {
+            BLOG("外部action匹配命中缓存: platform=%s, similarity=%.3f, actionHash=%llu",
+                 cached.match.platformId.c_str(), cached.match.similarity, cached.match.actionHash);
+            out = cached.match;
+            return true;
+        }
+        if (similarityThreshold >= cached.missThreshold) {
+            out = ExternalActionMatch();
+            out.found = false;
+            out.similarity = 0.0;
+            out.actionHash = 0;
+            return true;
+        }
+        return false;
+    }
+
+    void WidgetReusableAgent::storeExternalMatch(uint64_t actionHash, double similarityThreshold,
+                                                 const ExternalActionMatch& match) const {
+        std::lock_guard<std::mutex> cacheLock(_externalActionMatchCacheLock);
+        auto it = _externalActionMatchCache.find(actionHash);
+        if (it == _externalActionMatchCache.end()) {
+            CachedExternalMatch cached;
+            cached.match.found = false;
+            cached.match.similarity = 0.0;
+            cached.match.actionHash = 0;
+            cached.missThreshold = std::numeric_limits<double>::infinity();
+            it = _externalActionMatchCache.emplace(actionHash, cached).first;
+        }
+        CachedExternalMatch& cached = it->second;
+        if (match.found) {
+            cached.match = match;
+        } else {
+            cached.missThreshold = std::min(cached.missThreshold, similarityThreshold);
+        }
+        _externalMatchCacheDirty = true;
+    }
+
+    std::string WidgetReusableAgent::externalMatchCachePath() const {
+        std::string modelPath = _widgetModelSavePath.empty() ? _widgetDefaultModelSavePath : _widgetModelSavePath;
+        const std::string extension = ".fbm";
+        if (modelPath.size() > extension.size() &&
+            0 == modelPath.compare(modelPath.size() - extension.size(), extension.size(), extension)) {
+            modelPath.resize(modelPath.size() - extension.size());
+        }
+        return modelPath + ".external_matches.bin";
+    }
+
+    void WidgetReusableAgent::loadExternalMatchCache() {
+        bool hasExternalModels = false;
+        {
+            std::shared_lock<std::shared_timed_mutex> modelsLock(_externalModelsLock);
+            hasExternalModels = !_externalPlatformModels.empty();
+        }
+        // 匹配结果还取决于相似度模型（BERT/CLIP及其int8/fp32变体）和嵌入矩阵的精度；有外部模型时本函数在
+        // 后台加载线程上调用，先等相似度模型加载完成，版本才对应之后实际用于匹配的模型
+        uint64_t similarityTag = 0;
+        if (hasExternalModels) {
+            ActionSimilarity::awaitEngine();
+            similarityTag = ActionSimilarity::similarityModelsTag();
+        }
+        MatrixPrecision precision = parseMatrixPrecision(
+                Preference::inst()->getInferenceSessionConfig().embeddingMatrixPrecision, MatrixPrecision::Int8);
+
+        std::shared_lock<std::shared_timed_mutex> modelsLock(_externalModelsLock);
+        // 模型按后台加载完成的顺序加入，版本按排序后的文件标识计算，与加载顺序无关
+        std::vector<uint64_t> modelTags;
+        modelTags.reserve(_externalPlatformModels.size());
+        for (const auto& platformData : _externalPlatformModels) {
+            modelTags.push_back(platformData.modelTag);
+        }
+        std::sort(modelTags.begin(), modelTags.end());
+        uint64_t version = 0xcbf29ce484222325ULL;
+        for (uint64_t modelTag : modelTags) {
+            version = (version ^ modelTag) * 0x100000001b3ULL;
+        }
+        version = (version ^ similarityTag) * 0x100000001b3ULL;
+        version = (version ^ static_cast<uint64_t>(precision)) * 0x100000001b3ULL;
+        {
+            std::lock_guard<std::mutex> cacheLock(_externalActionMatchCacheLock);
+            _externalModelsVersion = _externalPlatformModels.empty() ? 0 : version;
+        }
+        if (_externalPlatformModels.empty()) {
+            return;
+        }
+
+        std::string path = externalMatchCachePath();
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            return;
+        }
+        char magic[8] = {0};
+        uint32_t fileVersion = 0;
+        uint64_t modelsVersion = 0;
+        uint64_t count = 0;
+        in.read(magic, sizeof(magic));
+        in.read(reinterpret_cast<char*>(&fileVersion), sizeof(fileVersion));
+        in.read(reinterpret_cast<char*>(&modelsVersion), sizeof(modelsVersion));
+        in.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (!in.good() || 0 != std::memcmp(magic, EXTERNAL_MATCH_CACHE_MAGIC, sizeof(magic)) ||
+            EXTERNAL_MATCH_CACHE_VERSION != fileVersion || version != modelsVersion) {
+            BLOG("外部匹配缓存%s与当前外部模型不匹配，忽略", path.c_str());
+            return;
+        }
+
+        // 条目：本地actionHash, found, similarity, missThreshold, 外部actionHash, platformId长度 + 内容，本机字节序
+        std::lock_guard<std::mutex> cacheLock(_externalActionMatchCacheLock);
+        size_t loaded = 0;
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t actionHash = 0;
+            uint8_t found = 0;
+            CachedExternalMatch cached;
+            uint16_t platformLength = 0;
+            in.read(reinterpret_cast<char*>(&actionHash), sizeof(actionHash));
+            in.read(reinterpret_cast<char*>(&found), sizeof(found));
+            in.read(reinterpret_cast<char*>(&cached.match.similarity), sizeof(cached.match.similarity));
+            in.read(reinterpret_cast<char*>(&cached.missThreshold), sizeof(cached.missThreshold));
+            in.read(reinterpret_cast<char*>(&cached.match.actionHash), sizeof(cached.match.actionHash));
+            in.read(reinterpret_cast<char*>(&platformLength), sizeof(platformLength));
+            cached.match.platformId.resize(platformLength);
+            if (platformLength > 0) {
+                in.read(&cached.match.platformId[0], platformLength);
+            }
+            if (!in.good()) {
+                break;
+            }
+            cached.match.found = false;
+            if (found) {
+                // 匹配的widget计数从当前加载的模型中取，外部action已不存在时只保留未匹配部分
+                auto platformIt = _externalPlatformIndex.find(cached.match.platformId);
+                if (platformIt != _externalPlatformIndex.end()) {
+                    cached.match.found = copyExternalWidgetCounts(_externalPlatformModels[platformIt->second],
+                                                                  cached.match.actionHash, cached.match.widgetCounts);
+                }
+            }
+            if (!cached.match.found && std::isinf(cached.missThreshold)) {
+                continue;
+            }
+            // 本次运行已经算过的条目较新，不覆盖
+            if (_externalActionMatchCache.emplace(actionHash, cached).second) {
+                ++loaded;
+            }
+        }
+        BLOG("从%s加载外部匹配缓存%zu条", path.c_str(), loaded);
+    }
+
+    void WidgetReusableAgent::saveExternalMatchCache() const {
+        // 在锁内复制快照，写文件时不阻塞查询
+        std::vector<std::pair<uint64_t, CachedExternalMatch>> entries;
+        uint64_t modelsVersion = 0;
+        {
+            std::lock_guard<std::mutex> cacheLock(_externalActionMatchCacheLock);
+            if (!_externalMatchCacheDirty || 0 == _externalModelsVersion) {
+                return;
+            }
+            entries.assign(_externalActionMatchCache.begin(), _externalActionMatchCache.end());
+            modelsVersion = _externalModelsVersion;
+            _externalMatchCacheDirty = false;
+        }
+
+        std::string path = externalMatchCachePath();
+        std::string tempPath = path + ".tmp";
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            BLOGE("无法写入外部匹配缓存: %s", tempPath.c_str());
+            return;
+        }
+        uint64_t count = entries.size();
+        out.write(EXTERNAL_MATCH_CACHE_MAGIC, sizeof(EXTERNAL_MATCH_CACHE_MAGIC));
+        out.write(reinterpret_cast<const char*>(&EXTERNAL_MATCH_CACHE_VERSION), sizeof(EXTERNAL_MATCH_CACHE_VERSION));
+        out.write(reinterpret_cast<const char*>(&modelsVersion), sizeof(modelsVersion));
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& entry : entries) {
+            const CachedExternalMatch& cached = entry.second;
+            uint8_t found = cached.match.found ? 1 : 0;
+            auto platformLength = static_cast<uint16_t>(std::min<size_t>(cached.match.platformId.size(), 0xffff));
+            out.write(reinterpret_cast<const char*>(&entry.first), sizeof(entry.first));
+            out.write(reinterpret_cast<const char*>(&found), sizeof(found));
+            out.write(reinterpret_cast<const char*>(&cached.match.similarity), sizeof(cached.match.similarity));
+            out.write(reinterpret_cast<const char*>(&cached.missThreshold), sizeof(cached.missThreshold));
+            out.write(reinterpret_cast<const char*>(&cached.match.actionHash), sizeof(cached.match.actionHash));
+            out.write(reinterpret_cast<const char*>(&platformLength), sizeof(platformLength));
+            out.write(cached.match.platformId.data(), platformLength);
+        }
+        out.close();
+        if (!out.good() || 0 != std::rename(tempPath.c_str(), path.c_str())) {
+            std::remove(tempPath.c_str());
+            BLOGE("保存外部匹配缓存失败: %s", path.c_str());
+            return;
+        }
+        BLOG("外部匹配缓存已保存到%s，共%zu条", path.c_str(), entries.size());
+    }
+
+    WidgetReusableAgent::ExternalActionMatch WidgetReusableAgent::matchExternalModelsLocked(
+        const ActivityNameActionPtr& action, double similarityThreshold) const {
 
         ExternalActionMatch result;
         result.found = false;
@@ -1320,22 +2476,24 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
              currentActivityName.c_str());
 
         // 检查外部模型数量
-        {
-            std::lock_guard<std::mutex> lock(_externalModelsLock);
-            BLOG("当前已加载 %zu 个外部平台模型", _externalPlatformModels.size());
-            
-            if (_externalPlatformModels.empty()) {
-                BLOG("没有加载任何外部平台模型，跳过相似度匹配");
-                return result;
-            }
+        BLOG("当前已加载 %zu 个外部平台模型", _externalPlatformModels.size());
+        if (_externalPlatformModels.empty()) {
+            BLOG("没有加载任何外部平台模型，跳过相似度匹配");
+            return result;
         }
 
 
         BLOG("使用相似度阈值: %.2f（按入参保持不变）", similarityThreshold);
 
+        // 模型已加载时先为当前action取一次各属性向量，与每个平台的嵌入矩阵批量比较
+        EmbeddingQuery query;
+        bool useIndex = ActionSimilarity::buildEmbeddingQuery(action, query);
+        uint64_t bucketKey = externalBucketKey(currentActionType, currentActivityName);
+        // 已在桶内比较过的action，扩大范围时跳过
+        std::vector<bool> tried;
+
         // 遍历所有外部模型
         try {
-            std::lock_guard<std::mutex> lock(_externalModelsLock);
             int matchingTypeCount = 0;
             int totalActionCount = 0;
             bool strictTypeMatching = false;  // 设置为false，不要求严格类型匹配
@@ -1348,6 +2506,63 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
                     BLOG("平台 %s 没有action属性数据，跳过", platformData.platformId.c_str());
                     continue;
                 }
+
+                // 先比较hash相同的action，再比较同一动作类型、同一activity词干桶中的action，
+                // 都没有达到阈值时才扩大到整个模型
+                tried.assign(platformData.actionAttributes.size(), false);
+                auto hashIt = platformData.actionByHash.find(action->hash());
+                if (hashIt != platformData.actionByHash.end()) {
+                    tried[hashIt->second] = true;
+                    if (matchExternalAction(platformData, platformData.actionAttributes[hashIt->second], action,
+                                            similarityThreshold, result)) {
+                        return result;
+                    }
+                }
+                auto bucketIt = platformData.actionBuckets.find(bucketKey);
+                if (bucketIt != platformData.actionBuckets.end()) {
+                    BLOG("平台 %s 先比较同桶的 %zu 个action", platformData.platformId.c_str(), bucketIt->second.size());
+                    for (size_t index : bucketIt->second) {
+                        if (tried[index]) {
+                            continue;
+                        }
+                        tried[index] = true;
+                        if (matchExternalAction(platformData, platformData.actionAttributes[index], action,
+                                                similarityThreshold, result)) {
+                            return result;
+                        }
+                    }
+                }
+
+                if (useIndex && platformData.actionIndex && platformData.actionIndex->size() > 0) {
+                    // 一次矩阵乘得到与全部已索引action的加权相似度，只对排名靠前的候选做精确计算；
+                    // 图标的感知哈希捷径可能改变精确结果，候选下限比阈值放宽一些
+                    std::vector<EmbeddingQuery> queries(1, query);
+                    std::vector<ScoredRow> candidates = platformData.actionIndex->topK(
+                            queries, ExternalIndexCandidates,
+                            static_cast<float>(similarityThreshold - ExternalIndexScoreMargin))[0];
+                    BLOG("平台 %s 批量匹配: 已索引%zu个action，候选%zu个，未索引%zu个",
+                         platformData.platformId.c_str(), platformData.actionIndex->size(), candidates.size(),
+                         platformData.unindexedActions.size());
+                    for (const auto& candidate : candidates) {
+                        const auto& attrs = platformData.actionAttributes[candidate.id];
+                        if (tried[candidate.id] || (strictTypeMatching && attrs.actionType != currentActionType)) {
+                            continue;
+                        }
+                        if (matchExternalAction(platformData, attrs, action, similarityThreshold, result)) {
+                            return result;
+                        }
+                    }
+                    for (size_t index : platformData.unindexedActions) {
+                        const auto& attrs = platformData.actionAttributes[index];
+                        if (tried[index] || (strictTypeMatching && attrs.actionType != currentActionType)) {
+                            continue;
+                        }
+                        if (matchExternalAction(platformData, attrs, action, similarityThreshold, result)) {
+                            return result;
+                        }
+                    }
+                    continue;
+                }
                 
                 // 打印前5个action属性的详细信息，帮助调试
                 int debugCount = 0;
@@ -1360,11 +2575,12 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
                     }
                 }
                  
-                for (const auto& attrs : platformData.actionAttributes) {
+                for (size_t index = 0; index < platformData.actionAttributes.size(); ++index) {
+                    const auto& attrs = platformData.actionAttributes[index];
                     totalActionCount++;
                     
                     // 动作类型匹配检查（可选）
-                    if (strictTypeMatching && attrs.actionType != currentActionType) {
+                    if (tried[index] || (strictTypeMatching && attrs.actionType != currentActionType)) {
                         continue;
                     }
 
@@ -1374,50 +2590,8 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
                          currentActionType, currentText.c_str(), currentResourceId.c_str(), currentActivityName.c_str(),
                          attrs.actionType, attrs.widgetText.c_str(), attrs.widgetResourceId.c_str(), attrs.activityName.c_str());
 
-                    // 如果外部模型的属性都是空的，直接跳过
-                    if (attrs.widgetText.empty() && attrs.widgetResourceId.empty() && attrs.activityName.empty()) {
-                        BLOG("外部模型属性都是空的，跳过相似度计算");
-                        continue;
-                    }
-
-                    try {
-                    // 使用混合相似度计算：当前action对象 vs 外部模型数据
-                        BLOG("调用calculateSimilarity计算相似度...");
-                    double similarity = ActionSimilarity::calculateSimilarity(
-                        action,  // 当前action对象
-                        attrs.widgetText, attrs.activityName, attrs.widgetResourceId, attrs.widgetIconBase64);
-
-                        BLOG("计算相似度: 当前='%s' vs 外部='%s', 相似度=%.3f", 
-                             currentText.c_str(), attrs.widgetText.c_str(), similarity);
-
-                        if (similarity >= similarityThreshold) {
-                            result.found = true;
-                            result.similarity = similarity;
-                            result.platformId = platformData.platformId;
-                            result.actionHash = attrs.actionHash;
-
-                            // 获取对应的widget计数
-                            auto it = platformData.reuseModel.find(attrs.actionHash);
-                            if (it != platformData.reuseModel.end()) {
-                                const auto& widgetMap = it->second;
-                                for (const auto& widgetPair : widgetMap) {
-                                    result.widgetCounts[widgetPair.first] = widgetPair.second.count;
-                                }
-                            }
-
-                            BLOG("匹配成功（提前返回）: platform=%s, similarity=%.3f, actionHash=%llu, 阈值=%.2f",
-                                 result.platformId.c_str(), result.similarity, result.actionHash, similarityThreshold);
-                            // 写入缓存
-                            {
-                                std::lock_guard<std::mutex> cacheLock(_externalActionMatchCacheLock);
-                                _externalActionMatchCache[result.actionHash] = result;
-                            }
-                            return result; // 提前返回，提升性能
-                        } else {
-                            BLOG("相似度 %.3f 低于阈值 %.2f，不匹配", similarity, similarityThreshold);
-                        }
-                    } catch (const std::exception& e) {
-                        BLOGE("计算相似度时发生异常: %s", e.what());
+                    if (matchExternalAction(platformData, attrs, action, similarityThreshold, result)) {
+                        return result; // 提前返回，提升性能
                     }
                 }
                 
@@ -1437,6 +2611,206 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
         return result;
     }
 
+    bool WidgetReusableAgent::matchExternalAction(const ExternalPlatformData& platformData,
+                                                  const ExternalPlatformData::ActionAttributes& attrs,
+                                                  const ActivityNameActionPtr& action, double similarityThreshold,
+                                                  ExternalActionMatch& result) const {
+        // 如果外部模型的属性都是空的，直接跳过
+        if (attrs.widgetText.empty() && attrs.widgetResourceId.empty() && attrs.activityName.empty() &&
+            attrs.embeddings.empty()) {
+            BLOG("外部模型属性都是空的，跳过相似度计算");
+            return false;
+        }
+
+        try {
+            // 使用混合相似度计算：当前action对象 vs 外部模型数据
+            double similarity = ActionSimilarity::calculateSimilarity(
+                action,  // 当前action对象
+                attrs.widgetText, attrs.activityName, attrs.widgetResourceId, attrs.widgetIconBase64,
+                attrs.embeddings, similarityThreshold);
+
+            BLOG("计算相似度: 外部='%s', 相似度=%.3f", attrs.widgetText.c_str(), similarity);
+
+            if (similarity < similarityThreshold) {
+                BLOG("相似度 %.3f 低于阈值 %.2f，不匹配", similarity, similarityThreshold);
+                return false;
+            }
+            result.found = true;
+            result.similarity = similarity;
+            result.platformId = platformData.platformId;
+            result.actionHash = attrs.actionHash;
+
+            // 获取对应的widget计数
+            copyExternalWidgetCounts(platformData, attrs.actionHash, result.widgetCounts);
+
+            BLOG("匹配成功（提前返回）: platform=%s, similarity=%.3f, actionHash=%llu, 阈值=%.2f",
+                 result.platformId.c_str(), result.similarity, result.actionHash, similarityThreshold);
+            return true;
+        } catch (const std::exception& e) {
+            BLOGE("计算相似度时发生异常: %s", e.what());
+        }
+        return false;
+    }
+
+    // activity名称的词干：取最后一段，小写，去掉Activity/ViewController等平台相关的后缀，
+    // 使不同平台上的同一页面落到同一个桶
+    static std::string activityStem(const std::string& activityName) {
+        size_t begin = activityName.find_last_of("./");
+        std::string stem = activityName.substr(begin == std::string::npos ? 0 : begin + 1);
+        std::transform(stem.begin(), stem.end(), stem.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        static const char* const suffixes[] = {"viewcontroller", "controller", "activity", "ability", "fragment", "page"};
+        for (const char* suffix : suffixes) {
+            size_t length = std::strlen(suffix);
+            if (stem.size() > length && 0 == stem.compare(stem.size() - length, length, suffix)) {
+                stem.erase(stem.size() - length);
+                break;
+            }
+        }
+        return stem;
+    }
+
+    uint64_t WidgetReusableAgent::externalBucketKey(int actionType, const std::string& activityName) {
+        uint64_t key = static_cast<uint64_t>(std::hash<std::string>()(activityStem(activityName)));
+        return key ^ (0x9e3779b97f4a7c15ULL * (static_cast<uint64_t>(actionType) + 1));
+    }
+
+    void WidgetReusableAgent::buildExternalActionBuckets(ExternalPlatformData& platformData) {
+        platformData.actionByHash.clear();
+        platformData.actionBuckets.clear();
+        platformData.actionByHash.reserve(platformData.actionAttributes.size());
+        for (size_t i = 0; i < platformData.actionAttributes.size(); ++i) {
+            const auto& attrs = platformData.actionAttributes[i];
+            platformData.actionByHash.emplace(attrs.actionHash, i);
+            platformData.actionBuckets[externalBucketKey(attrs.actionType, attrs.activityName)].push_back(i);
+        }
+        BLOG("平台 %s 的action分为 %zu 个桶", platformData.platformId.c_str(), platformData.actionBuckets.size());
+    }
+
+    void WidgetReusableAgent::buildExternalActionIndex(ExternalPlatformData& platformData) {
+        MatrixPrecision precision = parseMatrixPrecision(
+                Preference::inst()->getInferenceSessionConfig().embeddingMatrixPrecision, MatrixPrecision::Int8);
+        auto index = std::make_shared<ActionEmbeddingIndex>(precision, ActionSimilarity::attributeWeights(true),
+                                                            ActionSimilarity::attributeWeights(false));
+        platformData.unindexedActions.clear();
+        for (size_t i = 0; i < platformData.actionAttributes.size(); ++i) {
+            const auto& attrs = platformData.actionAttributes[i];
+            // 有字符串但没有向量的action留给逐个比较
+            bool indexable = true;
+            uint8_t emptyMask = embeddingEmptyMask(attrs.widgetText, attrs.activityName, attrs.widgetResourceId,
+                                                   attrs.widgetIconBase64, attrs.embeddings, indexable);
+            if (0x0f == emptyMask) {
+                // 属性全空的action不参与匹配
+                continue;
+            }
+            if (indexable) {
+                index->add(i, emptyMask, attrs.embeddings);
+            } else {
+                platformData.unindexedActions.push_back(i);
+            }
+        }
+        std::vector<size_t> rejected = index->build();
+        platformData.unindexedActions.insert(platformData.unindexedActions.end(), rejected.begin(), rejected.end());
+        std::sort(platformData.unindexedActions.begin(), platformData.unindexedActions.end());
+        platformData.actionIndex = index;
+        BLOG("平台 %s 的嵌入索引: %zu个action已索引（%zu字节），%zu个逐个比较",
+             platformData.platformId.c_str(), index->size(), index->byteSize(), platformData.unindexedActions.size());
+    }
+
+    uint32_t WidgetReusableAgent::assignExternalWidgetSlot(ExternalPlatformData& platformData, uint64_t widgetHash) {
+        auto inserted = platformData.widgetSlots.emplace(widgetHash, static_cast<uint32_t>(platformData.widgetHashes.size()));
+        if (inserted.second) {
+            platformData.widgetHashes.push_back(widgetHash);
+        }
+        return inserted.first->second;
+    }
+
+    bool WidgetReusableAgent::copyExternalWidgetCounts(const ExternalPlatformData& platformData, uint64_t actionHash,
+                                                       std::map<uint64_t, int>& widgetCounts) {
+        WidgetCountMatrix::RowView row;
+        if (!platformData.reuseModel.row(actionHash, row)) {
+            return false;
+        }
+        for (size_t i = 0; i < row.size; ++i) {
+            widgetCounts[platformData.widgetHashes[row.columns[i]]] = row.counts[i];
+        }
+        return true;
+    }
+
+    void WidgetReusableAgent::buildExternalWidgetIndex(ExternalPlatformData& platformData) {
+        // 计数中出现的widget在加载时已编号（CSR的列），这里补上只有属性的widget
+        platformData.unindexedWidgets.clear();
+        for (const auto& widgetPair : platformData.widgetAttributes) {
+            assignExternalWidgetSlot(platformData, widgetPair.first);
+        }
+
+        // 有字符串但没有保存向量的属性（v1模型）在后台加载时推理一次，之后与其他widget一样进入索引，
+        // 决策线程上不再逐个跑模型比较
+        SimilarityEnginePtr engine;
+        size_t computed = 0;
+        auto fill = [&platformData, &computed](ActionSimilarity::EmbeddingKind kind, const std::string& rawValue,
+                                               Int8EmbeddingView& view) {
+            if (rawValue.empty() || !view.empty()) {
+                return;
+            }
+            auto embedding = std::make_shared<Int8Embedding>();
+            if (ActionSimilarity::computeQuantizedEmbedding(kind, rawValue, *embedding)) {
+                view = Int8EmbeddingView(*embedding);
+                platformData.computedEmbeddings.push_back(embedding);
+                ++computed;
+            }
+        };
+        for (auto& widgetPair : platformData.widgetAttributes) {
+            auto& attrs = widgetPair.second;
+            bool indexable = true;
+            embeddingEmptyMask(attrs.widgetText, attrs.activityName, attrs.widgetResourceId, attrs.widgetIconBase64,
+                               attrs.embeddings, indexable);
+            if (indexable) {
+                continue;
+            }
+            if (!engine) {
+                engine = ActionSimilarity::awaitEngine();
+                if (!engine) {
+                    BLOGE("相似度模型不可用，平台 %s 没有向量的widget只按hash覆盖", platformData.platformId.c_str());
+                    break;
+                }
+            }
+            fill(ActionSimilarity::EmbeddingKind::Text, attrs.widgetText, attrs.embeddings.text);
+            fill(ActionSimilarity::EmbeddingKind::ActivityName, attrs.activityName, attrs.embeddings.activityName);
+            fill(ActionSimilarity::EmbeddingKind::ResourceId, attrs.widgetResourceId, attrs.embeddings.resourceId);
+            fill(ActionSimilarity::EmbeddingKind::Icon, attrs.widgetIconBase64, attrs.embeddings.icon);
+        }
+        if (computed > 0) {
+            BLOG("平台 %s 加载时补算了%zu个widget属性向量", platformData.platformId.c_str(), computed);
+        }
+
+        MatrixPrecision precision = parseMatrixPrecision(
+                Preference::inst()->getInferenceSessionConfig().embeddingMatrixPrecision, MatrixPrecision::Int8);
+        auto index = std::make_shared<ActionEmbeddingIndex>(precision, ActionSimilarity::attributeWeights(true),
+                                                            ActionSimilarity::attributeWeights(false));
+        for (const auto& widgetPair : platformData.widgetAttributes) {
+            const auto& attrs = widgetPair.second;
+            uint32_t slot = platformData.widgetSlots[widgetPair.first];
+            bool indexable = true;
+            uint8_t emptyMask = embeddingEmptyMask(attrs.widgetText, attrs.activityName, attrs.widgetResourceId,
+                                                   attrs.widgetIconBase64, attrs.embeddings, indexable);
+            if (0x0f == emptyMask) {
+                continue;
+            }
+            if (indexable) {
+                index->add(slot, emptyMask, attrs.embeddings);
+            } else {
+                platformData.unindexedWidgets.push_back(slot);
+            }
+        }
+        for (size_t slot : index->build()) {
+            platformData.unindexedWidgets.push_back(static_cast<uint32_t>(slot));
+        }
+        platformData.widgetIndex = index;
+        BLOG("平台 %s 的widget: %zu个，%zu个已索引，%zu个只按hash覆盖", platformData.platformId.c_str(),
+             platformData.widgetHashes.size(), index->size(), platformData.unindexedWidgets.size());
+    }
+
 
 
     double WidgetReusableAgent::probabilityOfVisitingNewWidgetsFromExternalModel(
@@ -1453,72 +2827,28 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
         int totalWidgets = 0;
         int unvisitedWidgets = 0;
 
-        // 遍历外部模型中的widget计数
+        // 覆盖位图在widget被访问时已经更新，这里只需按编号查位
+        std::shared_lock<std::shared_timed_mutex> modelsLock(_externalModelsLock);
+        std::lock_guard<std::mutex> coverageLock(_externalWidgetCoverageLock);
+        const ExternalPlatformData* platformData = nullptr;
+        const std::vector<uint64_t>* coverage = nullptr;
+        auto platformIt = _externalPlatformIndex.find(externalMatch.platformId);
+        if (platformIt != _externalPlatformIndex.end() && platformIt->second < _externalWidgetCoverage.size()) {
+            platformData = &_externalPlatformModels[platformIt->second];
+            coverage = &_externalWidgetCoverage[platformIt->second];
+        }
+
         for (const auto& widgetEntry : externalMatch.widgetCounts) {
             uint64_t widgetHash = widgetEntry.first;
             int count = widgetEntry.second;
 
             totalWidgets += count;
 
-            // 检查这个widget是否已经被访问过
-            // 由于是外部模型的widget，需要使用相似度匹配
-            bool isVisited = false;
-
-            // 首先使用索引与精确匹配
-            if (_visitedWidgets.find(widgetHash) != _visitedWidgets.end()) {
-                isVisited = true;
-            } else {
-                // 快速索引：platformId + externalWidgetHash 对应的本地已判相似widget集合
-                bool indexedHit = false;
-                {
-                    std::lock_guard<std::mutex> idxLock(_externalWidgetIndexLock);
-                    auto pit = _externalWidgetVisitedIndex.find(externalMatch.platformId);
-                    if (pit != _externalWidgetVisitedIndex.end()) {
-                        auto wit = pit->second.find(widgetHash);
-                        if (wit != pit->second.end()) {
-                            for (const auto& localHash : wit->second) {
-                                if (_visitedWidgets.find(localHash) != _visitedWidgets.end()) {
-                                    indexedHit = true;
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                }
-                if (indexedHit) {
-                    BLOG("外部widget命中相似索引，视为已访问");
-                    isVisited = true;
-                } else {
-                // 如果没有精确匹配或索引命中，使用相似度匹配
-                // 查找外部模型中该widget的属性
-                auto externalWidgetAttr = this->findExternalWidgetAttributes(widgetHash, externalMatch.platformId);
-                if (externalWidgetAttr) {
-                    // 遍历当前状态中已访问的widgets，进行相似度比较
-                    if (this->_newState) {
-                        for (const auto& currentWidget : this->_newState->getWidgets()) {
-                            if (currentWidget && _visitedWidgets.find(currentWidget->hash()) != _visitedWidgets.end()) {
-                                // 这个widget已经被访问过，检查与外部widget的相似度
-                                // 使用混合相似度计算：当前对象 vs 外部模型数据
-                                double similarity = ActionSimilarity::calculateSimilarity(
-                                    currentWidget, "",  // 当前widget对象和activity
-                                    externalWidgetAttr->widgetText, externalWidgetAttr->activityName,
-                                    externalWidgetAttr->widgetResourceId, externalWidgetAttr->widgetIconBase64);
-
-                                if (similarity >= 0.5) {
-                                    BLOG("外部widget与已访问widget相似度匹配: 相似度=%.3f", similarity);
-                                    // 写入索引缓存
-                                    {
-                                        std::lock_guard<std::mutex> idxLock(_externalWidgetIndexLock);
-                                        _externalWidgetVisitedIndex[externalMatch.platformId][widgetHash].insert(currentWidget->hash());
-                                    }
-                                    isVisited = true;
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                }
-                }
+            bool isVisited = _visitedWidgets.find(widgetHash) != _visitedWidgets.end();
+            if (!isVisited && platformData) {
+                auto slotIt = platformData->widgetSlots.find(widgetHash);
+                isVisited = slotIt != platformData->widgetSlots.end() &&
+                            0 != ((*coverage)[slotIt->second >> 6] & (1ULL << (slotIt->second & 63)));
             }
 
             if (!isVisited) {
@@ -1541,19 +2871,15 @@ ActionPtr WidgetReusableAgent::selectUnperformedActionNotInReuseModel() const {
     const WidgetReusableAgent::ExternalPlatformData::WidgetAttributes* WidgetReusableAgent::findExternalWidgetAttributes(
         uint64_t widgetHash, const std::string& platformId) const {
 
-        std::lock_guard<std::mutex> lock(_externalModelsLock);
+        std::shared_lock<std::shared_timed_mutex> lock(_externalModelsLock);
 
-        for (const auto& platformData : _externalPlatformModels) {
-            if (platformData.platformId == platformId) {
-                auto it = platformData.widgetAttributes.find(widgetHash);
-                if (it != platformData.widgetAttributes.end()) {
-                    return &(it->second);
-                }
-                break;
-            }
+        auto platformIt = _externalPlatformIndex.find(platformId);
+        if (platformIt == _externalPlatformIndex.end()) {
+            return nullptr;
         }
-
-        return nullptr;
+        const auto& widgetAttributes = _externalPlatformModels[platformIt->second].widgetAttributes;
+        auto it = widgetAttributes.find(widgetHash);
+        return it != widgetAttributes.end() ? &(it->second) : nullptr;
     }
 
     ActionPtr WidgetReusableAgent::selectActionByQValue() {
@@ -6,25 +6,44 @@
 #include "State.h"
 #include "Action.h"
 #include "Model.h"
+#include "Preference.h"
+#include "../desc/reuse/ActionEmbeddingIndex.h"
+#include "../desc/reuse/CountMinSketch.h"
+#include "../desc/reuse/EmbeddingQuantizer.h"
+#include "../desc/reuse/MappedModelFile.h"
+#include "../desc/reuse/ReuseModelJournal.h"
+#include "../desc/reuse/WidgetCountMatrix.h"
+#include <atomic>
 #include <vector>
 #include <map>
 #include <set>
+#include <chrono>
+#include <functional>
+#include <future>
 #include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 
 namespace fastbotx {
 
+    class SimilarityEngine;
+    typedef std::shared_ptr<SimilarityEngine> SimilarityEnginePtr;
+
     typedef std::map<uint64_t, int> WidgetCountMap;// widget_hash -> count
     
-    // 扩展的widget计数结构，包含相似度属性
-    struct WidgetCountWithAttributes {
-        int count;
+    // 本地widget的相似度属性：旁表中每个widget只保存一份，计数矩阵中只记widget编号
+    struct LocalWidgetAttributes {
         std::string text;
         std::string activityName;
         std::string resourceId;
-        std::string iconBase64;
-        
-        WidgetCountWithAttributes() : count(0) {}
-        WidgetCountWithAttributes(int c) : count(c) {}
+        IconId iconId;  // 图标保存在IconStore中，这里只记id
+
+        LocalWidgetAttributes() : iconId(INVALID_ICON_ID) {}
+
+        bool operator==(const LocalWidgetAttributes &other) const {
+            return iconId == other.iconId && text == other.text && activityName == other.activityName &&
+                   resourceId == other.resourceId;
+        }
     };
     
     // 扩展的action属性结构
@@ -33,14 +52,12 @@ namespace fastbotx {
         std::string activityName;
         std::string targetWidgetText;
         std::string targetWidgetResourceId;
-        std::string targetWidgetIconBase64;
+        IconId targetWidgetIconId;
         
-        ActionAttributes() : actionType(1) {}
+        ActionAttributes() : actionType(1), targetWidgetIconId(INVALID_ICON_ID) {}
     };
     
-    // 统一使用带属性的数据结构
-    typedef std::map<uint64_t, WidgetCountWithAttributes> WidgetCountMapWithAttrs;
-    typedef std::map<uint64_t, WidgetCountMapWithAttrs> WidgetReuseEntryIntMap;
+    typedef std::map<uint64_t, std::shared_ptr<const ActionAttributes>> ActionAttributesSharedMap;
     typedef std::map<uint64_t, double> WidgetReuseEntryQValueMap;
 
     class WidgetReusableAgent : public ModelReusableAgent {
@@ -51,7 +68,11 @@ namespace fastbotx {
         struct ExternalPlatformData {
             std::string platformId;
             std::string modelPath;
-            WidgetReuseEntryIntMap reuseModel;  // action_hash -> widget_counts
+            WidgetCountMatrix reuseModel;  // action_hash -> (widget编号, 计数)，编号见widgetSlots
+            // 映射的模型文件，属性中的量化向量直接指向这块内存（零拷贝），需与属性同生命周期
+            MappedModelFilePtr modelFile;
+            // 模型文件的标识（路径、大小、修改时间），用于判断持久化的匹配缓存是否过期
+            uint64_t modelTag{0};
 
             // 相似度匹配所需的属性数据
             struct ActionAttributes {
@@ -61,6 +82,7 @@ namespace fastbotx {
                 std::string activityName;
                 std::string widgetResourceId;
                 std::string widgetIconBase64;  // 改为base64字符串
+                SimilarityEmbeddings embeddings; // 模型中保存的int8量化向量（可选）
             };
 
             struct WidgetAttributes {
@@ -69,16 +91,37 @@ namespace fastbotx {
                 std::string activityName;
                 std::string widgetResourceId;
                 std::string widgetIconBase64;  // 改为base64字符串
+                SimilarityEmbeddings embeddings; // 模型中保存的int8量化向量（可选）
             };
 
             std::vector<ActionAttributes> actionAttributes;
-            std::map<uint64_t, WidgetAttributes> widgetAttributes; // widget_hash -> attributes
+            std::unordered_map<uint64_t, WidgetAttributes> widgetAttributes; // widget_hash -> attributes
+
+            // 加载时建立的查找表：action_hash -> actionAttributes下标；
+            // (动作类型, activity词干) -> 下标列表，匹配时先比较同一个桶里的action
+            std::unordered_map<uint64_t, size_t> actionByHash;
+            std::unordered_map<uint64_t, std::vector<size_t>> actionBuckets;
+
+            // 由保存了嵌入向量的action属性建立的批量匹配索引，行id为actionAttributes的下标；
+            // 有字符串但没有保存向量的action不能进入索引，记在unindexedActions中逐个比较
+            ActionEmbeddingIndexPtr actionIndex;
+            std::vector<size_t> unindexedActions;
+
+            // 外部widget的紧凑编号（模型中出现过的所有widget hash），覆盖位图按编号置位；
+            // 有属性的widget中有向量（保存的或加载时补算的）的进入widgetIndex（行id为编号），其余记在unindexedWidgets中，只按hash覆盖
+            std::unordered_map<uint64_t, uint32_t> widgetSlots;
+            std::vector<uint64_t> widgetHashes;
+            ActionEmbeddingIndexPtr widgetIndex;
+            std::vector<uint32_t> unindexedWidgets;
+            // 加载时为没有保存向量的widget属性（v1模型）推理出的量化向量，属性中的视图指向这里
+            std::vector<std::shared_ptr<Int8Embedding>> computedEmbeddings;
         };
         explicit WidgetReusableAgent(const ModelPtr &model);
         virtual ~WidgetReusableAgent();
 
         void updateReuseModel() override; // 重写更新逻辑
         void updateStrategy() override; // 重写策略更新逻辑，添加控件访问跟踪
+        ActionPtr resolveNewAction() override; // 设置本次决策的时间预算并预取外部匹配
         void saveReuseModel(const std::string &modelFilepath) override;
         void loadReuseModel(const std::string &modelFilepath) override;
 
@@ -108,8 +151,19 @@ namespace fastbotx {
         // 自动检测并加载多平台模型
         void autoLoadMultiPlatformModels(const std::string& baseDir = "/sdcard", const std::string& packageNameParam = "");
 
-        // 添加外部平台模型
-        bool addExternalPlatformModel(const std::string& modelPath, const std::string& platformInfo);
+        // 添加外部平台模型：解析并建立索引后整体发布，可在工作线程中调用。
+        // 模型中没有action属性时参考referenceState中的action和widget补全
+        bool addExternalPlatformModel(const std::string& modelPath, const std::string& platformInfo,
+                                      const StatePtr& referenceState = nullptr);
+
+        // 外部模型的加载状态：Loading时已加载完成的模型已可查询，其余仍在后台加载
+        enum class ExternalModelsReadiness {
+            NotLoaded,
+            Loading,
+            Ready
+        };
+
+        ExternalModelsReadiness externalModelsReadiness() const { return _externalModelsReadiness.load(); }
 
         // 检查action是否在任何模型中（本地或外部）
         bool isActionInAnyModel(const ActivityNameActionPtr& action, double similarityThreshold = 0.8) const;
@@ -129,6 +183,17 @@ namespace fastbotx {
         ExternalActionMatch findSimilarActionInExternalModels(const ActivityNameActionPtr& action,
                                                              double similarityThreshold = 0.8) const;
 
+        // 查询外部匹配：依次查匹配缓存、本状态已完成的结果和后台任务；后台任务在决策截止时间前等待，
+        // 预算用完仍未完成时按未匹配返回（本次决策只用本地模型），任务继续在后台执行供后续步骤使用
+        ExternalActionMatch lookupExternalMatch(const ActivityNameActionPtr& action, double similarityThreshold) const;
+
+        // 收取已在后台完成的匹配，并把状态中需要外部匹配的action提交到相似度引擎的线程池，
+        // 结果（包括未匹配）按本地action hash保存到本状态的结果表
+        void prefetchExternalMatches(const StatePtr& state, double similarityThreshold);
+
+        // 本次决策的时间预算是否已用完
+        bool decisionBudgetExhausted() const;
+
         // 使用外部模型数据计算访问新widget的概率
         double probabilityOfVisitingNewWidgetsFromExternalModel(const ActivityStateActionPtr& action,
                                                                const ExternalActionMatch& externalMatch) const;
@@ -139,33 +204,198 @@ namespace fastbotx {
 
 
     private:
-        // 统一使用带属性的数据结构
-        WidgetReuseEntryIntMap _widgetReuseModel;           // action_hash -> widget_hash -> WidgetCountWithAttributes
+        // 只保存本次运行中有新观测的条目，其余条目直接在映射的模型文件上查询。
+        // 行为action hash，列为本地widget编号；按值复制即得到压缩用的一致快照
+        WidgetCountMatrix _widgetReuseModel;
+        // 本地widget编号：编号 -> hash与属性（去重的旁表），hash -> 编号。只追加，受_widgetReuseModelLock保护
+        std::vector<uint64_t> _localWidgetHashes;
+        std::vector<std::shared_ptr<const LocalWidgetAttributes>> _localWidgetAttributes;
+        std::unordered_map<uint64_t, uint32_t> _localWidgetIds;
         WidgetReuseEntryQValueMap _widgetReuseQValue;
-        std::map<uint64_t, ActionAttributes> _actionAttributes;      // action_hash -> ActionAttributes
+        ActionAttributesSharedMap _actionAttributes;        // action_hash -> ActionAttributes
         
         std::string _widgetModelSavePath;
         std::string _widgetDefaultModelSavePath;
+        // 没能备份的v1模型文件路径，不向其保存以免覆盖；受_compactionLock保护
+        std::string _unsavableModelPath;
         static std::string DefaultWidgetModelSavePath; // if the saved path is not specified, use this as the default.
         mutable std::mutex _widgetReuseModelLock;
 
+        // 加载的本地模型文件（v2）：按key排序的ReuseEntryV2表直接在映射区上查询，widget hash从字典中取
+        struct MappedWidgetReuseModel;
+        std::shared_ptr<const MappedWidgetReuseModel> _widgetReuseModelBase;
+        // _widgetReuseModel中不在模型文件里的条目数
+        size_t _widgetReuseModelNewEntries{0};
+
+        // 本地模型查询：先查修改过的条目，再查映射的模型文件
+        bool isActionInWidgetReuseModel(uint64_t actionHash) const;
+
+        size_t widgetReuseModelSize() const;
+
+        // 遍历action记录的widget计数，action不在模型中时返回false
+        bool forEachWidgetCount(uint64_t actionHash, const std::function<void(uint64_t, int)>& visit) const;
+
+        // 取得可修改的条目，模型文件中已有的条目第一次修改时复制其计数（属性留在模型文件的字典中），
+        // 条目仍被压缩中的快照视图引用时先复制一份；调用方需持有_widgetReuseModelLock
+        WidgetCountMatrix::DeltaRow& mutableWidgetReuseEntry(uint64_t actionHash);
+
+        // widget的本地编号，第一次出现时分配；调用方需持有_widgetReuseModelLock
+        uint32_t localWidgetId(uint64_t widgetHash);
+
+        // ========== 持久化：追加日志 + 后台压缩 ==========
+        // 每次updateReuseModel追加一条计数日志（决策路径上只有一次小的顺序写）；
+        // saveReuseModel是压缩：在锁内只复制条目指针，锁外把快照视图合并写成新的模型文件并rename替换，再删除已合并的日志
+        ReuseModelJournalPtr _journal;
+        uint64_t _journalSequence{0};       // 最后一条日志的序号，受_widgetReuseModelLock保护
+        uint64_t _compactedSequence{0};     // 模型文件已包含的最后序号
+        std::mutex _compactionLock;
+
+        // 加载模型文件后重放其后的日志
+        void replayJournal(const std::string& modelFilePath, uint64_t snapshotSequence);
+
+        // ========== 有界模型（max.reuseModel.bounded） ==========
+        // 每个action只精确保存计数最大的topWidgets个widget（带属性），其余widget的计数进入count-min sketch，
+        // 条目中只记长尾计数之和；每agingPeriod次观测所有计数乘以decay，保存时只保留计数之和最大的maxActions个action，
+        // 模型文件和内存都有上限。以下都受_widgetReuseModelLock保护
+        BoundedReuseModelConfig _boundedConfig;
+        CountMinSketchPtr _tailSketch;                      // 未开启有界模型时为nullptr
+        std::map<uint64_t, int> _widgetReuseTailCounts;     // 修改过的条目的长尾计数之和
+        double _baseDecay{1.0};                             // 模型文件加载之后累计的衰减，读取文件中的计数时乘上
+        uint64_t _agingObservations{0};                     // 观测次数，从模型文件已合并的日志序号开始计
+
+        bool boundedWidgetReuseModel() const { return nullptr != this->_tailSketch; }
+
+        static uint64_t tailSketchKey(uint64_t actionHash, uint64_t widgetHash);
+
+        // 模型文件中的计数乘上累计的衰减
+        int decayedBaseCount(int count) const;
+
+        // 记录一次观测中action执行后出现的一个widget。有界时widget不在前topWidgets个中则计入长尾并返回false，
+        // 否则返回true（widget已有本地编号，调用方随后更新属性）
+        bool countWidget(WidgetCountMatrix::DeltaRow& row, uint64_t actionHash, uint64_t widgetHash);
+
+        // 条目超过topWidgets个时把计数最小的widget移入长尾
+        void trimWidgetReuseEntry(WidgetCountMatrix::DeltaRow& row, uint64_t actionHash);
+
+        // action的长尾计数之和，不在模型中时为0
+        int tailCount(uint64_t actionHash) const;
+
+        // 一次观测之后推进老化，每agingPeriod次观测衰减一次所有计数
+        void advanceAging();
+
         // 跟踪当前测试轮次中访问过的控件hash值
         std::set<uint64_t> _visitedWidgets;
+        // 同一集合按本地widget编号置位，覆盖所有已分配的编号；计算新widget概率时顺序扫描条目的编号列
+        std::vector<uint64_t> _visitedLocalWidgets;
 
-        // 外部平台模型列表
+        // 外部平台模型列表，以及platformId -> 列表下标
         std::vector<ExternalPlatformData> _externalPlatformModels;
+        std::unordered_map<std::string, size_t> _externalPlatformIndex;
+
+        // 外部模型访问锁：匹配任务在多个线程中共享读取，加载和清空时独占
+        mutable std::shared_timed_mutex _externalModelsLock;
+
+        // 外部模型的后台加载：每个模型文件一个任务，最后一个任务结束时读取匹配缓存并置为Ready。
+        // _externalModelLoads只在调用autoLoadMultiPlatformModels的线程和析构中访问
+        std::atomic<ExternalModelsReadiness> _externalModelsReadiness{ExternalModelsReadiness::NotLoaded};
+        std::atomic<size_t> _pendingExternalModelLoads{0};
+        std::vector<std::future<void>> _externalModelLoads;
+
+        // 等待进行中的后台加载结束
+        void waitExternalModelLoads();
+
+        // 所有外部模型加载结束（包括没有找到模型）时调用
+        void finishExternalModelLoading();
+
+        // findSimilarActionInExternalModels的实现，调用方需持有_externalModelsLock；只读外部模型，可在多个线程同时调用
+        ExternalActionMatch matchExternalModelsLocked(const ActivityNameActionPtr& action,
+                                                      double similarityThreshold) const;
+
+        // 精确计算action与一个外部action属性的相似度，达到阈值时填写result
+        bool matchExternalAction(const ExternalPlatformData& platformData,
+                                 const ExternalPlatformData::ActionAttributes& attrs,
+                                 const ActivityNameActionPtr& action, double similarityThreshold,
+                                 ExternalActionMatch& result) const;
+
+        // 由外部模型中保存的嵌入向量建立批量匹配索引（加载外部模型时调用）
+        static void buildExternalActionIndex(ExternalPlatformData& platformData);
+
+        // 给外部widget编号并由保存的向量建立widget嵌入索引（加载外部模型时调用）
+        static void buildExternalWidgetIndex(ExternalPlatformData& platformData);
+
+        // 外部widget的编号，第一次出现时分配
+        static uint32_t assignExternalWidgetSlot(ExternalPlatformData& platformData, uint64_t widgetHash);
+
+        // 外部action记录的widget计数（按hash）写入widgetCounts，action不在模型中时返回false
+        static bool copyExternalWidgetCounts(const ExternalPlatformData& platformData, uint64_t actionHash,
+                                             std::map<uint64_t, int>& widgetCounts);
 
-        // 外部模型访问锁
-        mutable std::mutex _externalModelsLock;
+        // 新访问的本地widget与各外部模型的widget只匹配一次：hash相同或相似的外部widget在覆盖位图中置位。
+        // 相似度模型未就绪时只按hash覆盖，widget留到模型就绪后再做相似度匹配
+        void updateExternalCoverage(std::vector<WidgetPtr> widgets);
+
+        // 在线程池中对新访问的widget做相似覆盖匹配；generation与当前不同时结果作废
+        void matchExternalCoverage(const std::vector<WidgetPtr>& widgets, uint64_t generation);
+
+        // 按动作类型和activity词干给外部action分桶，并建立action hash查找表（加载外部模型时调用）
+        static void buildExternalActionBuckets(ExternalPlatformData& platformData);
+
+        // 外部action桶的键：动作类型 + 归一化后的activity词干
+        static uint64_t externalBucketKey(int actionType, const std::string& activityName);
+
+        // 当前状态已完成的外部匹配：本地actionHash -> 匹配结果；以及仍在线程池中执行的匹配任务。
+        // 两者只在决策线程上读写
+        mutable std::unordered_map<uint64_t, ExternalActionMatch> _stateExternalMatches;
+        mutable std::unordered_map<uint64_t, std::future<ExternalActionMatch>> _pendingExternalMatches;
+        // 相似度阈值变化后作废、但可能仍在线程池中执行的任务；任务引用了本对象，析构时同样要等待
+        std::vector<std::future<ExternalActionMatch>> _abandonedExternalMatches;
+        double _stateExternalMatchThreshold{-1.0};
+
+        // 提交一个外部匹配任务到线程池
+        std::future<ExternalActionMatch> submitExternalMatch(const SimilarityEnginePtr& engine,
+                                                             const ActivityNameActionPtr& action,
+                                                             double similarityThreshold) const;
+
+        // 本次决策的截止时间，max.decisionBudgetMs <= 0时不限时
+        std::chrono::steady_clock::time_point _decisionDeadline;
+        bool _decisionBudgeted{false};
         
         // ========== 索引与缓存 ==========
-        // 外部action相似度匹配缓存：当前actionHash -> 匹配结果
-        mutable std::map<uint64_t, ExternalActionMatch> _externalActionMatchCache;
+        // 外部action匹配缓存的条目：找到过的匹配，以及已确认没有匹配的最低阈值
+        struct CachedExternalMatch {
+            ExternalActionMatch match;   // match.found为false表示还没有找到过匹配
+            double missThreshold;        // 在这个阈值及以上没有匹配，未确认过时为正无穷
+        };
+
+        // 外部action相似度匹配缓存：本地actionHash -> 匹配结果（包括未匹配），
+        // 只对_externalModelsVersion对应的一组外部模型有效，随复用模型一起落盘
+        mutable std::unordered_map<uint64_t, CachedExternalMatch> _externalActionMatchCache;
         mutable std::mutex _externalActionMatchCacheLock;
+        mutable bool _externalMatchCacheDirty{false};
+        uint64_t _externalModelsVersion{0};
+
+        // 按阈值查缓存：找到过相似度不低于阈值的匹配，或在不高于该阈值时确认过没有匹配
+        bool findCachedExternalMatch(uint64_t actionHash, double similarityThreshold, ExternalActionMatch& out) const;
+
+        void storeExternalMatch(uint64_t actionHash, double similarityThreshold, const ExternalActionMatch& match) const;
+
+        // 缓存文件与本地复用模型放在一起：xxx.fbm -> xxx.external_matches.bin
+        std::string externalMatchCachePath() const;
+
+        // 外部模型加载完成后读取缓存文件，外部模型有变化时丢弃；匹配的widget计数从已加载的模型中恢复
+        void loadExternalMatchCache();
+
+        void saveExternalMatchCache() const;
 
-        // 外部widget相似访问索引：platformId -> (externalWidgetHash -> {visitedLocalWidgetHash})
-        mutable std::map<std::string, std::map<uint64_t, std::set<uint64_t>>> _externalWidgetVisitedIndex;
-        mutable std::mutex _externalWidgetIndexLock;
+        // 外部widget覆盖位图：与_externalPlatformModels一一对应，按外部widget编号置位，表示本轮已访问过
+        // hash相同或相似的本地widget；以及等待相似度模型就绪后再匹配的已访问widget
+        std::vector<std::vector<uint64_t>> _externalWidgetCoverage;
+        std::vector<WidgetPtr> _pendingCoverageWidgets;
+        mutable std::mutex _externalWidgetCoverageLock;
+        // 位图清空（新一轮、模型重新加载）时递增，线程池中较早提交的相似覆盖结果据此丢弃
+        uint64_t _externalCoverageGeneration{0};
+        // 线程池中的相似覆盖任务，只在决策线程上读写
+        std::vector<std::future<void>> _externalCoverageTasks;
         
 };
 
@@ -115,7 +115,11 @@ namespace fastbotx {
     }
 
     bool ActivityStateAction::isValid() const {
-        return (this->_target == nullptr || !this->_target->getBounds()->isEmpty());
+        // 需要目标控件的action在控件树释放后、或重新填充时没有找回目标控件，视为无效
+        if (this->_target == nullptr) {
+            return !this->requireTarget();
+        }
+        return !this->_target->getBounds()->isEmpty();
     }
 
     bool ActivityStateAction::getEnabled() const {
@@ -139,6 +143,9 @@ namespace fastbotx {
 
 
     bool ActivityStateAction::isEmpty() const {
+        if (!this->getTarget()) {
+            return true;
+        }
         auto rect = this->getTarget()->getBounds();
         return rect->isEmpty();
     }
@@ -44,6 +44,10 @@ namespace fastbotx {
         /// \return Visited count
         int getVisitedCount() const { return this->_visitedCount; }
 
+        /// Restore the visited count, e.g. from the graph snapshot of the previous run
+        /// \param visitedCount Visited count
+        void setVisitedCount(int visitedCount) { _visitedCount = visitedCount; }
+
         // implements Serializable
         std::string toString() const override;
 
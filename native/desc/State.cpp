@@ -132,7 +132,18 @@ namespace fastbotx {
     }
 
 
+    void State::recordValidActions() {
+        if (_hasNoDetail) {
+            return;
+        }
+        this->_validWhenCleared.assign(this->_actions.size(), false);
+        for (size_t i = 0; i < this->_actions.size(); ++i) {
+            this->_validWhenCleared[i] = this->_actions[i]->getEnabled() && this->_actions[i]->isValid();
+        }
+    }
+
     void State::clearDetails() {
+        recordValidActions();
         for (auto const &widget: this->_widgets) {
             widget->clearDetails();
         }
@@ -140,7 +151,40 @@ namespace fastbotx {
         _hasNoDetail = true;
     }
 
+    void State::compactDetails() {
+        recordValidActions();
+        for (const auto &action: this->_actions) {
+            action->setTarget(nullptr);
+        }
+        WidgetPtrVec().swap(this->_widgets);
+        this->_mergedWidgets.clear();
+        _hasNoDetail = true;
+        _compacted = true;
+    }
+
     void State::fillDetails(const std::shared_ptr<State> &copy) {
+        if (_compacted) {
+            // 控件树已释放：直接接过新建状态的控件，action按hash取回目标控件
+            this->_widgets = copy->_widgets;
+            this->_mergedWidgets = copy->_mergedWidgets;
+            this->_rootBounds = copy->_rootBounds;
+            std::map<uintptr_t, WidgetPtr> targets;
+            for (const auto &action: copy->_actions) {
+                targets[action->hash()] = action->getTarget();
+            }
+            for (const auto &action: this->_actions) {
+                auto target = targets.find(action->hash());
+                if (target != targets.end()) {
+                    action->setTarget(target->second);
+                } else if (action->requireTarget()) {
+                    // 目标控件为空的action的isValid为假，不会被选中
+                    LOGE("ERROR can not refill action target");
+                }
+            }
+            _compacted = false;
+            _hasNoDetail = false;
+            return;
+        }
         for (auto widgetPtr: this->_widgets) {
             auto widgetIterator = std::find_if(copy->_widgets.begin(), copy->_widgets.end(),
                                                [&widgetPtr](const WidgetPtr &cw) {
@@ -79,6 +79,17 @@ namespace fastbotx {
 
         bool hasNoDetail() const { return this->_hasNoDetail; }
 
+        // 清除控件细节时第index个action是否可执行（enabled且目标边界非空）；细节清除后isValid不再可靠
+        bool wasValidWhenCleared(size_t index) const {
+            return index < this->_validWhenCleared.size() && this->_validWhenCleared[index];
+        }
+
+        // 长时间没有访问的状态只保留hash、activity和action（hash、计数、Q值），释放控件树与action的目标控件；
+        // 再次访问时由fillDetails从新建的同一状态接回
+        virtual void compactDetails();
+
+        bool isCompacted() const { return this->_compacted; }
+
         FuncGetID(State);
 
     protected:
@@ -120,11 +131,16 @@ namespace fastbotx {
         WidgetPtrVecMap _mergedWidgets; //
 
         bool _hasNoDetail; //
+        bool _compacted{false}; //
+        std::vector<bool> _validWhenCleared; //
         static RectPtr _sameRootBounds; //
         ActivityStateActionPtr _backAction; //
     private:
         static std::shared_ptr<State> create(ElementPtr elem, stringPtr activityName);
 
+        // 细节仍在时记录每个action是否可执行
+        void recordValidActions();
+
         PropertyIDPrefix(State);
 
     };
@@ -194,23 +194,20 @@ namespace fastbotx {
 
     void Widget::setIcon(const std::string& base64Icon) {
         if (!base64Icon.empty()) {
-            _icon = std::make_shared<WidgetIcon>(base64Icon);
+            _iconId = IconStore::inst()->intern(base64Icon);
         }
     }
 
     WidgetIconPtr Widget::getIcon() const {
-        return _icon;
+        return IconStore::inst()->decode(_iconId);
     }
 
     bool Widget::hasIcon() const {
-        return _icon != nullptr && !_icon->isEmpty();
+        return INVALID_ICON_ID != _iconId;
     }
 
     std::string Widget::getIconBase64() const {
-        if (_icon != nullptr) {
-            return _icon->getBase64String();
-        }
-        return "";
+        return IconStore::inst()->base64(_iconId);
     }
 }
 
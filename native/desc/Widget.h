@@ -13,7 +13,7 @@
 #include <string>
 #include <memory>
 #include "Element.h"
-#include "WidgetIcon.h"
+#include "IconStore.h"
 #include "../Base.h"
 
 namespace fastbotx {
@@ -49,8 +49,14 @@ namespace fastbotx {
         std::string toString() const override;
 
         std::string buildFullXpath() const;
+        // 图标登记到IconStore（按内容去重），widget只保存IconId
         void setIcon(const std::string& base64Icon);
 
+        void setIconId(IconId iconId) { this->_iconId = iconId; }
+
+        IconId getIconId() const { return this->_iconId; }
+
+        // 临时解码出图标图像，调用方不应长期持有
         WidgetIconPtr getIcon() const;
 
         bool hasIcon() const;
@@ -73,7 +79,7 @@ namespace fastbotx {
         void initFormElement(const ElementPtr &element);
 
         uintptr_t _hashcode{};
-        WidgetIconPtr _icon;
+        IconId _iconId{INVALID_ICON_ID};
         std::shared_ptr<Widget> _parent;
         std::string _text;
         int _index{};
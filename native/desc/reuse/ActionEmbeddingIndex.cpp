@@ -0,0 +1,238 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef ActionEmbeddingIndex_CPP_
+#define ActionEmbeddingIndex_CPP_
+
+#include "ActionEmbeddingIndex.h"
+#include <algorithm>
+#include <cmath>
+
+namespace fastbotx {
+
+namespace {
+    // 每次与矩阵相乘的查询数，分数缓冲区为 查询数 × 行数
+    const size_t QUERY_BLOCK = 16;
+
+    // top-k用小顶堆维护，堆顶是当前第k名
+    bool higherScore(const ScoredRow &a, const ScoredRow &b) {
+        return a.score > b.score;
+    }
+}
+
+ActionEmbeddingIndex::ActionEmbeddingIndex(MatrixPrecision precision, const SimilarityWeights &withIcon,
+                                           const SimilarityWeights &withoutIcon)
+        : _precision(precision), _withIcon(withIcon), _withoutIcon(withoutIcon), _dimensions() {
+    _groups[0].withIcon = false;
+    _groups[1].withIcon = true;
+}
+
+const Int8EmbeddingView &ActionEmbeddingIndex::attributeView(const SimilarityEmbeddings &embeddings,
+                                                             Attribute attribute) {
+    switch (attribute) {
+        case TEXT:
+            return embeddings.text;
+        case ACTIVITY_NAME:
+            return embeddings.activityName;
+        case RESOURCE_ID:
+            return embeddings.resourceId;
+        default:
+            return embeddings.icon;
+    }
+}
+
+float ActionEmbeddingIndex::attributeWeight(const SimilarityWeights &weights, Attribute attribute) {
+    switch (attribute) {
+        case TEXT:
+            return weights.text;
+        case ACTIVITY_NAME:
+            return weights.activityName;
+        case RESOURCE_ID:
+            return weights.resourceId;
+        default:
+            return weights.icon;
+    }
+}
+
+void ActionEmbeddingIndex::add(size_t id, uint8_t emptyMask, const SimilarityEmbeddings &embeddings) {
+    _pending.push_back(PendingRow{id, emptyMask, embeddings});
+}
+
+std::vector<size_t> ActionEmbeddingIndex::build() {
+    for (int a = 0; a < ATTRIBUTE_COUNT; ++a) {
+        auto attribute = static_cast<Attribute>(a);
+        for (const auto &row : _pending) {
+            const Int8EmbeddingView &view = attributeView(row.embeddings, attribute);
+            if (0 == (row.emptyMask & attributeBit(attribute)) && !view.empty()) {
+                _dimensions[a] = view.size;
+                break;
+            }
+        }
+    }
+
+    std::vector<size_t> rejected;
+    std::vector<const PendingRow *> accepted[2];
+    for (const auto &row : _pending) {
+        bool indexable = true;
+        for (int a = 0; a < ATTRIBUTE_COUNT && indexable; ++a) {
+            auto attribute = static_cast<Attribute>(a);
+            const Int8EmbeddingView &view = attributeView(row.embeddings, attribute);
+            indexable = 0 != (row.emptyMask & attributeBit(attribute)) || (!view.empty() && view.size == _dimensions[a]);
+        }
+        if (!indexable) {
+            rejected.push_back(row.id);
+            continue;
+        }
+        accepted[0 == (row.emptyMask & attributeBit(ICON)) ? 1 : 0].push_back(&row);
+    }
+
+    for (int g = 0; g < 2; ++g) {
+        Group &group = _groups[g];
+        group.ids.clear();
+        group.emptyMasks.clear();
+        group.matrices.clear();
+        for (int a = 0; a < ATTRIBUTE_COUNT; ++a) {
+            // 没有图标的组不需要图标矩阵
+            size_t dimension = (ICON == a && !group.withIcon) ? 0 : _dimensions[a];
+            group.matrices.emplace_back(dimension, _precision);
+            group.matrices.back().reserve(accepted[g].size());
+        }
+        for (const PendingRow *row : accepted[g]) {
+            group.ids.push_back(row->id);
+            group.emptyMasks.push_back(row->emptyMask);
+            for (int a = 0; a < ATTRIBUTE_COUNT; ++a) {
+                auto attribute = static_cast<Attribute>(a);
+                if (0 == group.matrices[a].dimension()) {
+                    continue;
+                }
+                if (row->emptyMask & attributeBit(attribute)) {
+                    group.matrices[a].appendRow(Int8EmbeddingView());
+                } else {
+                    group.matrices[a].appendRow(attributeView(row->embeddings, attribute));
+                }
+            }
+        }
+    }
+
+    std::vector<PendingRow>().swap(_pending);
+    return rejected;
+}
+
+size_t ActionEmbeddingIndex::size() const {
+    return _groups[0].ids.size() + _groups[1].ids.size();
+}
+
+size_t ActionEmbeddingIndex::byteSize() const {
+    size_t bytes = 0;
+    for (const auto &group : _groups) {
+        for (const auto &matrix : group.matrices) {
+            bytes += matrix.byteSize();
+        }
+        bytes += group.ids.size() * (sizeof(size_t) + sizeof(uint8_t));
+    }
+    return bytes;
+}
+
+std::vector<std::vector<ScoredRow>> ActionEmbeddingIndex::topK(const std::vector<EmbeddingQuery> &queries, size_t k,
+                                                               float minScore) const {
+    std::vector<std::vector<ScoredRow>> heaps(queries.size());
+    if (0 == k) {
+        return heaps;
+    }
+    for (const auto &group : _groups) {
+        scoreGroup(group, queries, k, minScore, heaps);
+    }
+    for (auto &heap : heaps) {
+        std::sort_heap(heap.begin(), heap.end(), higherScore);
+    }
+    return heaps;
+}
+
+void ActionEmbeddingIndex::scoreGroup(const Group &group, const std::vector<EmbeddingQuery> &queries, size_t k,
+                                      float minScore, std::vector<std::vector<ScoredRow>> &heaps) const {
+    size_t rowCount = group.ids.size();
+    if (0 == rowCount) {
+        return;
+    }
+    std::vector<float> scores;
+    std::vector<float> queryBlock;
+    std::vector<float> weights;
+    for (size_t queryBegin = 0; queryBegin < queries.size(); queryBegin += QUERY_BLOCK) {
+        size_t queryCount = std::min(QUERY_BLOCK, queries.size() - queryBegin);
+        scores.assign(queryCount * rowCount, 0.0f);
+
+        // 权重折进每个查询的系数，一个属性一次矩阵乘
+        for (int a = 0; a < ATTRIBUTE_COUNT; ++a) {
+            auto attribute = static_cast<Attribute>(a);
+            const EmbeddingMatrix &matrix = group.matrices[a];
+            size_t dimension = matrix.dimension();
+            if (0 == dimension || 0 == matrix.rows()) {
+                continue;
+            }
+            queryBlock.assign(queryCount * dimension, 0.0f);
+            weights.assign(queryCount, 0.0f);
+            for (size_t i = 0; i < queryCount; ++i) {
+                const EmbeddingQuery &query = queries[queryBegin + i];
+                const std::vector<float> &vector = query.vectors[a];
+                if ((query.emptyMask & attributeBit(attribute)) || vector.size() != dimension) {
+                    continue;
+                }
+                double squareSum = 0.0;
+                for (float value : vector) {
+                    squareSum += static_cast<double>(value) * value;
+                }
+                if (squareSum <= 0.0) {
+                    continue;
+                }
+                auto invNorm = static_cast<float>(1.0 / std::sqrt(squareSum));
+                float *target = queryBlock.data() + i * dimension;
+                for (size_t d = 0; d < dimension; ++d) {
+                    target[d] = vector[d] * invNorm;
+                }
+                bool compareIcons = group.withIcon && 0 == (query.emptyMask & attributeBit(ICON));
+                weights[i] = attributeWeight(compareIcons ? _withIcon : _withoutIcon, attribute);
+            }
+            matrix.multiplyAccumulate(queryBlock.data(), queryCount, weights.data(), scores.data(), rowCount);
+        }
+
+        for (size_t i = 0; i < queryCount; ++i) {
+            const EmbeddingQuery &query = queries[queryBegin + i];
+            bool compareIcons = group.withIcon && 0 == (query.emptyMask & attributeBit(ICON));
+            const SimilarityWeights &queryWeights = compareIcons ? _withIcon : _withoutIcon;
+            // 两边都为空的属性记1：按空属性组合预先求和
+            float emptyBonus[1u << ATTRIBUTE_COUNT];
+            for (unsigned mask = 0; mask < (1u << ATTRIBUTE_COUNT); ++mask) {
+                emptyBonus[mask] = 0.0f;
+                for (int a = 0; a < ATTRIBUTE_COUNT; ++a) {
+                    if (mask & (1u << a)) {
+                        emptyBonus[mask] += attributeWeight(queryWeights, static_cast<Attribute>(a));
+                    }
+                }
+            }
+
+            std::vector<ScoredRow> &heap = heaps[queryBegin + i];
+            const float *rowScores = scores.data() + i * rowCount;
+            for (size_t r = 0; r < rowCount; ++r) {
+                float score = rowScores[r] + emptyBonus[query.emptyMask & group.emptyMasks[r] & 0x0fu];
+                if (score < minScore) {
+                    continue;
+                }
+                if (heap.size() < k) {
+                    heap.push_back(ScoredRow{group.ids[r], score});
+                    std::push_heap(heap.begin(), heap.end(), higherScore);
+                } else if (score > heap.front().score) {
+                    std::pop_heap(heap.begin(), heap.end(), higherScore);
+                    heap.back() = ScoredRow{group.ids[r], score};
+                    std::push_heap(heap.begin(), heap.end(), higherScore);
+                }
+            }
+        }
+    }
+}
+
+} // namespace fastbotx
+
+#endif // ActionEmbeddingIndex_CPP_
@@ -0,0 +1,108 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef ActionEmbeddingIndex_H_
+#define ActionEmbeddingIndex_H_
+
+#include "EmbeddingMatrix.h"
+#include "EmbeddingQuantizer.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace fastbotx {
+
+// 加权相似度中各属性的权重
+struct SimilarityWeights {
+    float text;
+    float activityName;
+    float resourceId;
+    float icon;
+};
+
+// 一次批量匹配的查询：各属性的嵌入向量和空属性掩码。
+// 属性为空时置位emptyMask且不需要向量；属性非空但向量为空（模型不可用、预处理后为空）时该属性贡献0
+struct EmbeddingQuery {
+    std::vector<float> vectors[4];
+    uint8_t emptyMask{0};
+};
+
+// 一个候选行及其加权相似度
+struct ScoredRow {
+    size_t id;
+    float score;
+};
+
+// 外部模型action的属性嵌入索引：每个属性一个预先归一化的行主序矩阵，一批查询用分块矩阵乘一次得到
+// 与全部action的加权相似度，再按行取top-k。
+// 权重与ActionSimilarity::calculateSimilarity一致：两边都有图标时用withIcon，否则用withoutIcon；
+// 两边都为空的属性记1，只有一边为空的记0，其余取余弦相似度。行按是否有图标分成两组，每组只用一套权重
+class ActionEmbeddingIndex {
+public:
+    enum Attribute {
+        TEXT = 0,
+        ACTIVITY_NAME = 1,
+        RESOURCE_ID = 2,
+        ICON = 3,
+        ATTRIBUTE_COUNT = 4
+    };
+
+    static uint8_t attributeBit(Attribute attribute) { return static_cast<uint8_t>(1u << attribute); }
+
+    ActionEmbeddingIndex(MatrixPrecision precision, const SimilarityWeights &withIcon,
+                         const SimilarityWeights &withoutIcon);
+
+    // 登记一行：emptyMask中置位的属性为空，其余属性必须在embeddings中有向量；
+    // embeddings是指向模型数据的视图，需要在build()之前保持有效
+    void add(size_t id, uint8_t emptyMask, const SimilarityEmbeddings &embeddings);
+
+    // 按各属性首个向量的维度建立矩阵，返回因维度不一致或缺少向量而没有进入索引的行
+    std::vector<size_t> build();
+
+    size_t size() const;
+
+    size_t byteSize() const;
+
+    // 每个查询返回加权相似度不低于minScore的前k行，按相似度降序
+    std::vector<std::vector<ScoredRow>> topK(const std::vector<EmbeddingQuery> &queries, size_t k,
+                                             float minScore) const;
+
+private:
+    struct PendingRow {
+        size_t id;
+        uint8_t emptyMask;
+        SimilarityEmbeddings embeddings;
+    };
+
+    // 有图标与没有图标的行分别成组
+    struct Group {
+        bool withIcon;
+        std::vector<size_t> ids;
+        std::vector<uint8_t> emptyMasks;
+        std::vector<EmbeddingMatrix> matrices;
+    };
+
+    static const Int8EmbeddingView &attributeView(const SimilarityEmbeddings &embeddings, Attribute attribute);
+
+    static float attributeWeight(const SimilarityWeights &weights, Attribute attribute);
+
+    void scoreGroup(const Group &group, const std::vector<EmbeddingQuery> &queries, size_t k, float minScore,
+                    std::vector<std::vector<ScoredRow>> &heaps) const;
+
+    MatrixPrecision _precision;
+    SimilarityWeights _withIcon;
+    SimilarityWeights _withoutIcon;
+    size_t _dimensions[ATTRIBUTE_COUNT];
+    std::vector<PendingRow> _pending;
+    Group _groups[2];
+};
+
+typedef std::shared_ptr<ActionEmbeddingIndex> ActionEmbeddingIndexPtr;
+
+} // namespace fastbotx
+
+#endif // ActionEmbeddingIndex_H_
@@ -13,6 +13,7 @@
 #include <iostream>
 #include <vector>
 #include "../utils.hpp"
+#include "Preference.h"
 #include <algorithm>
 #include <cmath>
 #include <fstream>
@@ -20,6 +21,10 @@
 #include <sstream>
 #include <cctype>
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <sys/stat.h>
 
 namespace fastbotx {
 bool ActionSimilarity::jiebaReady = false;
@@ -42,20 +47,6 @@ bool ActionSimilarity::containsChineseUTF8(const std::string& text) {
     return false;
 }
 
-std::vector<std::string> ActionSimilarity::splitEnglishLike(const std::string& text) {
-    std::vector<std::string> words;
-    std::string current;
-    for (char c : text) {
-        if (std::isspace(static_cast<unsigned char>(c)) || c == '.' || c == '_' || c == ':' || c == '/' || c == '\\') {
-            if (!current.empty()) { words.push_back(current); current.clear(); }
-        } else {
-            current.push_back(c);
-        }
-    }
-    if (!current.empty()) words.push_back(current);
-    return words;
-}
-
 // 拆分驼峰命名
 std::vector<std::string> ActionSimilarity::splitCamelCase(const std::string& text) {
     std::vector<std::string> words;
@@ -233,17 +224,28 @@ void ActionSimilarity::initializeJieba() {
 }
 
 // 初始化静态成员变量
-Ort::Session* ActionSimilarity::bertSession = nullptr;
-std::vector<const char*> ActionSimilarity::bertInputNames;
-std::vector<const char*> ActionSimilarity::bertOutputNames;
-std::vector<int64_t> ActionSimilarity::bertInputShape;
-
-Ort::Session* ActionSimilarity::clipSession = nullptr;
-std::vector<const char*> ActionSimilarity::clipInputNames;
-std::vector<const char*> ActionSimilarity::clipOutputNames;
-std::vector<int64_t> ActionSimilarity::clipInputShape;
-
-std::unordered_map<std::string, int64_t> ActionSimilarity::vocabMap;
+SimilarityEnginePtr ActionSimilarity::engine;
+std::atomic<int> ActionSimilarity::modelLoadState(ActionSimilarity::MODEL_LOAD_IDLE);
+
+WordPieceTokenizerPtr ActionSimilarity::tokenizer;
+const char* const ActionSimilarity::ENGLISH_WORD_DELIMITERS = "._:/\\";
+std::unordered_map<std::string, ActionSimilarity::CachedEmbedding> ActionSimilarity::embeddingCache;
+std::list<std::string> ActionSimilarity::embeddingCacheOrder;
+std::mutex ActionSimilarity::embeddingCacheLock;
+const size_t ActionSimilarity::MAX_EMBEDDING_CACHE_SIZE;
+std::unordered_map<std::string, Int8Embedding> ActionSimilarity::quantizedEmbeddings;
+std::unordered_map<uint64_t, Int8Embedding> ActionSimilarity::quantizedIconEmbeddings;
+const size_t ActionSimilarity::MAX_QUANTIZED_EMBEDDINGS;
+IconEmbeddingCache ActionSimilarity::iconEmbeddingCache(IconSimilarityConfig().embeddingCacheSize);
+std::string ActionSimilarity::iconEmbeddingCachePath;
+uint64_t ActionSimilarity::clipModelTag = 0;
+uint64_t ActionSimilarity::bertModelTag = 0;
+ActionSimilarity::LexicalCalibration ActionSimilarity::lexicalCalibration[3] = {{0, 0.0}, {0, 0.0}, {0, 0.0}};
+std::mutex ActionSimilarity::lexicalCalibrationLock;
+const int ActionSimilarity::MODEL_LOAD_IDLE;
+const int ActionSimilarity::MODEL_LOAD_RUNNING;
+const int ActionSimilarity::MODEL_LOAD_DONE;
+const int ActionSimilarity::MODEL_LOAD_SHUTDOWN;
 // 为避免链接期未定义，提供静态常量定义
 const int64_t ActionSimilarity::UNK_TOKEN_ID;
 const int64_t ActionSimilarity::CLS_TOKEN_ID;
@@ -299,237 +301,398 @@ static double calculateCosineSimilarity(const float* a, const float* b, size_t s
     return dot_product / (norm_a * norm_b);
 }
 
-ActionSimilarity::ActionSimilarity() {
-    initializeModels();
-    initializeVocab();
+static bool fileExists(const std::string& path) {
+    struct stat fileStat{};
+    return 0 == stat(path.c_str(), &fileStat) && S_ISREG(fileStat.st_mode);
+}
+
+static time_t fileModifiedTime(const std::string& path) {
+    struct stat fileStat{};
+    if (0 != stat(path.c_str(), &fileStat)) {
+        return 0;
+    }
+    return fileStat.st_mtime;
 }
 
-ActionSimilarity::~ActionSimilarity() {
-    if (bertSession) {
-        delete bertSession;
-        bertSession = nullptr;
+// xxx.onnx -> xxx<suffix>，用于定位int8模型和优化后的模型缓存
+static std::string modelVariantPath(const std::string& modelPath, const std::string& suffix) {
+    const std::string extension = ".onnx";
+    if (modelPath.size() > extension.size() &&
+        0 == modelPath.compare(modelPath.size() - extension.size(), extension.size(), extension)) {
+        return modelPath.substr(0, modelPath.size() - extension.size()) + suffix;
     }
-    if (clipSession) {
-        delete clipSession;
-        clipSession = nullptr;
+    return modelPath + suffix;
+}
+
+// 模型文件的标识：路径、大小与修改时间任一变化都视为不同的模型
+static uint64_t modelFileTag(const std::string& modelPath) {
+    struct stat fileStat{};
+    if (0 != stat(modelPath.c_str(), &fileStat)) {
+        return 0;
     }
+    uint64_t tag = 0xcbf29ce484222325ULL;
+    for (unsigned char c : modelPath) {
+        tag = (tag ^ c) * 0x100000001b3ULL;
+    }
+    tag = (tag ^ static_cast<uint64_t>(fileStat.st_size)) * 0x100000001b3ULL;
+    tag = (tag ^ static_cast<uint64_t>(fileStat.st_mtime)) * 0x100000001b3ULL;
+    return tag;
 }
 
-void ActionSimilarity::initializeModels() {
-    try {
-        BLOG("开始初始化模型");
-        
-        // 创建共享的环境和会话选项
-        static Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "fastbot-models");
-        Ort::SessionOptions sessionOptions;
-        sessionOptions.SetIntraOpNumThreads(1);
-        sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
-        sessionOptions.SetExecutionMode(ExecutionMode::ORT_SEQUENTIAL);
-        
-        // 初始化BERT模型
-        if (!bertSession) {
-            BLOG("正在初始化BERT模型");
-#ifdef __ANDROID__
-            // 使用与vocab一致的多语言模型
-            std::string bertModelPath = "/data/local/tmp/bert-base-multilingual-cased.onnx";
-            BLOG("检查BERT模型路径: %s", bertModelPath.c_str());
-            
-            // 检查文件是否存在
-            std::ifstream bertFile(bertModelPath);
-            if (!bertFile.good()) {
-                BLOGE("BERT模型文件不存在或无法访问: %s", bertModelPath.c_str());
-                // 尝试在其他位置查找（SD卡）
-                bertModelPath = "/sdcard/bert-base-multilingual-cased.onnx";
-                BLOG("尝试备用BERT模型路径: %s", bertModelPath.c_str());
-                
-                std::ifstream bertFile2(bertModelPath);
-                if (!bertFile2.good()) {
-                    BLOGE("备用BERT模型文件也不存在或无法访问");
-                    throw std::runtime_error("找不到BERT模型文件");
-                }
+// 按顺序在候选路径中查找模型文件，偏好int8时优先使用同目录下的*.int8.onnx
+static std::string resolveModelPath(const std::vector<std::string>& candidates, bool preferInt8) {
+    if (preferInt8) {
+        for (const auto& path : candidates) {
+            std::string quantizedPath = modelVariantPath(path, ".int8.onnx");
+            if (fileExists(quantizedPath)) {
+                return quantizedPath;
             }
+        }
+    }
+    for (const auto& path : candidates) {
+        if (fileExists(path)) {
+            return path;
+        }
+        BLOGE("模型文件不存在或无法访问: %s", path.c_str());
+    }
+    return "";
+}
+
+// 进程内共享的ORT环境，线程池与共享arena按第一次创建时的配置确定
+static Ort::Env& sharedOrtEnv(const InferenceSessionConfig& config) {
+    static std::unique_ptr<Ort::Env> env;
+    static std::once_flag envOnce;
+    std::call_once(envOnce, [&config]() {
+        if (config.globalThreadPool) {
+            // BERT与CLIP会话共用一组线程，避免两套线程池在小核设备上互相抢占
+            Ort::ThreadingOptions threadingOptions;
+            threadingOptions.SetGlobalIntraOpNumThreads(config.intraOpThreads);
+            threadingOptions.SetGlobalInterOpNumThreads(config.interOpThreads);
+            env.reset(new Ort::Env(threadingOptions, ORT_LOGGING_LEVEL_WARNING, "fastbot-models"));
+        } else {
+            env.reset(new Ort::Env(ORT_LOGGING_LEVEL_WARNING, "fastbot-models"));
+        }
+        if (config.arenaExtendSameAsRequested) {
+            // arena_extend_strategy: 0 = kNextPowerOfTwo, 1 = kSameAsRequested；其余参数取默认值
+            Ort::ArenaCfg arenaCfg(0, 1, -1, -1);
+            Ort::MemoryInfo memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+            env->CreateAndRegisterAllocator(memoryInfo, arenaCfg);
+        }
+    });
+    return *env;
+}
+
+static Ort::SessionOptions buildSessionOptions(const InferenceSessionConfig& config) {
+    Ort::SessionOptions sessionOptions;
+    if (config.globalThreadPool) {
+        sessionOptions.DisablePerSessionThreads();
+    } else {
+        sessionOptions.SetIntraOpNumThreads(config.intraOpThreads);
+        sessionOptions.SetInterOpNumThreads(config.interOpThreads);
+    }
+    sessionOptions.SetExecutionMode(config.parallelExecution ? ExecutionMode::ORT_PARALLEL
+                                                             : ExecutionMode::ORT_SEQUENTIAL);
+    if (config.cpuMemArena) {
+        sessionOptions.EnableCpuMemArena();
+    } else {
+        sessionOptions.DisableCpuMemArena();
+    }
+    if (config.memPattern) {
+        sessionOptions.EnableMemPattern();
+    } else {
+        sessionOptions.DisableMemPattern();
+    }
+    if (config.arenaExtendSameAsRequested) {
+        sessionOptions.AddConfigEntry("session.use_env_allocators", "1");
+    }
+    return sessionOptions;
+}
+
+// 创建模型会话：存在不早于模型文件的优化缓存时直接加载缓存并跳过图优化，
+// 否则做完整图优化并把结果写到缓存，供下次启动使用
+static Ort::Session* createModelSession(const std::string& modelPath, const InferenceSessionConfig& config) {
+    Ort::Env& env = sharedOrtEnv(config);
+    std::string optimizedPath = modelVariantPath(modelPath, ".optimized.onnx");
+    if (config.cacheOptimizedModel && fileExists(optimizedPath) &&
+        fileModifiedTime(optimizedPath) >= fileModifiedTime(modelPath)) {
+        try {
+            Ort::SessionOptions sessionOptions = buildSessionOptions(config);
+            sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_DISABLE_ALL);
+            auto* session = new Ort::Session(env, optimizedPath.c_str(), sessionOptions);
+            BLOG("使用优化后的模型缓存: %s", optimizedPath.c_str());
+            return session;
+        } catch (const std::exception& e) {
+            BLOGE("优化模型缓存加载失败，重新生成: %s", e.what());
+            std::remove(optimizedPath.c_str());
+        }
+    }
+
+    Ort::SessionOptions sessionOptions = buildSessionOptions(config);
+    sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+    if (config.cacheOptimizedModel) {
+        sessionOptions.SetOptimizedModelFilePath(optimizedPath.c_str());
+        try {
+            return new Ort::Session(env, modelPath.c_str(), sessionOptions);
+        } catch (const std::exception& e) {
+            // 缓存目录不可写等情况，不带缓存重试
+            BLOGE("写出优化模型缓存失败: %s", e.what());
+            std::remove(optimizedPath.c_str());
+            sessionOptions = buildSessionOptions(config);
+            sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+        }
+    }
+    return new Ort::Session(env, modelPath.c_str(), sessionOptions);
+}
+
+SimilarityEnginePtr ActionSimilarity::createEngine(const InferenceSessionConfig& config) {
+    BLOG("开始初始化模型");
+    ModelSession bert;
+    ModelSession clip;
+
+    // 初始化BERT模型，加载失败时会话保持为空，调用方回退到字符串比较
+    {
+        BLOG("正在初始化BERT模型");
+#ifdef __ANDROID__
+        // 使用与vocab一致的多语言模型，找不到时尝试SD卡
+        std::vector<std::string> bertCandidates = {"/data/local/tmp/bert-base-multilingual-cased.onnx",
+                                                   "/sdcard/bert-base-multilingual-cased.onnx"};
 #else
-            std::string bertModelPath = "/Users/atmo/program/Fastbot_Android_副本/native/desc/reuse/models/bert-base-multilingual-cased.onnx";
+        std::vector<std::string> bertCandidates = {"/Users/atmo/program/Fastbot_Android_副本/native/desc/reuse/models/bert-base-multilingual-cased.onnx"};
 #endif
+        std::string bertModelPath = resolveModelPath(bertCandidates, config.preferInt8Models);
+        if (bertModelPath.empty()) {
+            BLOGE("找不到BERT模型文件");
+        } else {
             BLOG("BERT模型路径: %s", bertModelPath.c_str());
-            
             try {
-                // 检查文件是否存在
-                std::ifstream file(bertModelPath);
-                if (!file.good()) {
-                    throw std::runtime_error("BERT模型文件不存在或无法访问: " + bertModelPath);
-                }
-                
-                bertSession = new Ort::Session(env, bertModelPath.c_str(), sessionOptions);
-                if (!bertSession) {
-                    throw std::runtime_error("BERT模型会话创建失败");
-                }
-                
+                bert.session.reset(createModelSession(bertModelPath, config));
                 BLOG("BERT模型加载成功");
-                
+
                 // 设置输入输出名称
-                bertInputNames = {"input_ids", "attention_mask", "token_type_ids"};
-                bertOutputNames = {"last_hidden_state"};
-                bertInputShape = {1, 512};
+                bert.inputNames = {"input_ids", "attention_mask", "token_type_ids"};
+                bert.outputNames = {"last_hidden_state"};
+                bert.inputShape = {1, 512};
+                bertModelTag = modelFileTag(bertModelPath);
             } catch (const std::exception& e) {
                 BLOGE("BERT模型加载失败: %s", e.what());
-                if (bertSession) {
-                    delete bertSession;
-                    bertSession = nullptr;
-                }
-                throw;
+                bert.session.reset();
             }
         }
-        
-        // 初始化CLIP模型
-        if (!clipSession) {
-            BLOG("正在初始化CLIP模型");
+    }
+
+    // 初始化CLIP模型
+    {
+        BLOG("正在初始化CLIP模型");
 #ifdef __ANDROID__
-            std::string clipModelPath = "/data/local/tmp/clip_image_encoder.onnx";
-            BLOG("检查CLIP模型路径: %s", clipModelPath.c_str());
-            
-            // 检查文件是否存在
-            std::ifstream clipFile(clipModelPath);
-            if (!clipFile.good()) {
-                BLOGE("CLIP模型文件不存在或无法访问: %s", clipModelPath.c_str());
-                // 尝试在其他位置查找
-                clipModelPath = "/sdcard/clip_image_encoder.onnx";
-                BLOG("尝试备用CLIP模型路径: %s", clipModelPath.c_str());
-                
-                std::ifstream clipFile2(clipModelPath);
-                if (!clipFile2.good()) {
-                    BLOGE("备用CLIP模型文件也不存在或无法访问");
-                    throw std::runtime_error("找不到CLIP模型文件");
-                }
-            }
+        std::vector<std::string> clipCandidates = {"/data/local/tmp/clip_image_encoder.onnx",
+                                                   "/sdcard/clip_image_encoder.onnx"};
 #else
-            std::string clipModelPath = "/Users/atmo/program/Fastbot_Android_副本/native/desc/reuse/models/clip_image_encoder.onnx";
+        std::vector<std::string> clipCandidates = {"/Users/atmo/program/Fastbot_Android_副本/native/desc/reuse/models/clip_image_encoder.onnx"};
 #endif
+        std::string clipModelPath = resolveModelPath(clipCandidates, config.preferInt8Models);
+        if (clipModelPath.empty()) {
+            BLOGE("找不到CLIP模型文件");
+        } else {
             BLOG("CLIP模型路径: %s", clipModelPath.c_str());
-            
             try {
-                // 检查文件是否存在
-                std::ifstream file(clipModelPath);
-                if (!file.good()) {
-                    throw std::runtime_error("CLIP模型文件不存在或无法访问: " + clipModelPath);
-                }
-                
-                clipSession = new Ort::Session(env, clipModelPath.c_str(), sessionOptions);
-                if (!clipSession) {
-                    throw std::runtime_error("CLIP模型会话创建失败");
-                }
-                
+                clip.session.reset(createModelSession(clipModelPath, config));
                 BLOG("CLIP模型加载成功");
-                
+
                 // 强制指定输入输出名，防止乱码
                 static const char* clip_input_name = "image";
                 static const char* clip_output_name = "image_features";
-                clipInputNames = {clip_input_name};
-                clipOutputNames = {clip_output_name};
-                clipInputShape = {1, 3, 224, 224};
+                clip.inputNames = {clip_input_name};
+                clip.outputNames = {clip_output_name};
+                clip.inputShape = {1, 3, 224, 224};
+                iconEmbeddingCachePath = modelVariantPath(clipModelPath, ".icon_embeddings.bin");
+                clipModelTag = modelFileTag(clipModelPath);
             } catch (const std::exception& e) {
                 BLOGE("CLIP模型加载失败: %s", e.what());
-                if (clipSession) {
-                    delete clipSession;
-                    clipSession = nullptr;
-                }
-                throw;
+                clip.session.reset();
             }
         }
-        
-        BLOG("所有模型初始化完成");
+    }
+
+    BLOG("模型初始化完成: BERT=%s, CLIP=%s", bert.session ? "ok" : "unavailable", clip.session ? "ok" : "unavailable");
+    return std::make_shared<SimilarityEngine>(std::move(bert), std::move(clip),
+                                              static_cast<size_t>(config.similarityWorkers));
+}
+
+void ActionSimilarity::warmUpModels(const SimilarityEnginePtr& loaded) {
+    // 各推理一次：创建第一个推理上下文，并让ORT完成内存规划和arena的首次分配
+    if (loaded->hasBert()) {
+        auto embedding = computeBertEmbedding(loaded, "预热 warm up");
+        BLOG("BERT模型预热完成，向量维度: %zu", embedding.size());
+    }
+    if (loaded->hasClip()) {
+        std::vector<float> embedding;
+        loaded->clipEmbedding(cv::Mat(224, 224, CV_8UC3, cv::Scalar::all(0)), embedding);
+        BLOG("CLIP模型预热完成，向量维度: %zu", embedding.size());
+    }
+}
+
+void ActionSimilarity::loadModels(const InferenceSessionConfig& config, bool warmUp) {
+    auto startTime = std::chrono::steady_clock::now();
+    SimilarityEnginePtr loaded;
+    try {
+        // 词表和分词词典在引擎发布前初始化，发布后各线程只读
+        initializeVocab();
+        initializeJieba();
+        loaded = createEngine(config);
+        loadIconEmbeddingCache();
+        if (warmUp) {
+            warmUpModels(loaded);
+        }
     } catch (const std::exception& e) {
-        BLOGE("模型初始化过程中发生错误: %s", e.what());
-        throw;
+        BLOGE("模型加载过程中发生错误: %s", e.what());
+    }
+    std::atomic_store(&engine, loaded);
+    int expected = MODEL_LOAD_RUNNING;
+    if (!modelLoadState.compare_exchange_strong(expected, MODEL_LOAD_DONE, std::memory_order_acq_rel)) {
+        // 加载期间引擎已被停止：不发布，停止刚加载的引擎
+        SimilarityEnginePtr discarded = std::atomic_exchange(&engine, SimilarityEnginePtr());
+        if (discarded) {
+            discarded->shutdown();
+        }
+        BLOG("%s", "相似度引擎已停止，丢弃加载完成的模型");
+        return;
+    }
+    auto costMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - startTime).count();
+    BLOG("模型加载结束，耗时%lldms", static_cast<long long>(costMs));
+}
+
+SimilarityEnginePtr ActionSimilarity::acquireEngine() {
+    int state = modelLoadState.load(std::memory_order_acquire);
+    if (MODEL_LOAD_DONE == state) {
+        return std::atomic_load(&engine);
+    }
+    int expected = MODEL_LOAD_IDLE;
+    if (MODEL_LOAD_IDLE != state || !modelLoadState.compare_exchange_strong(expected, MODEL_LOAD_RUNNING)) {
+        // 后台仍在加载（或引擎已停止），本次相似度走字符串回退，不阻塞决策
+        return currentEngine();
+    }
+    // 没有预加载时（或预加载已关闭）在调用线程同步加载
+    loadModels(Preference::inst()->getInferenceSessionConfig(), false);
+    return std::atomic_load(&engine);
+}
+
+SimilarityEnginePtr ActionSimilarity::currentEngine() {
+    if (MODEL_LOAD_DONE != modelLoadState.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    return std::atomic_load(&engine);
+}
+
+uint64_t ActionSimilarity::similarityModelsTag() {
+    // 标识在引擎发布前写入，发布后只读
+    SimilarityEnginePtr current = currentEngine();
+    uint64_t tag = 0xcbf29ce484222325ULL;
+    tag = (tag ^ (current && current->hasBert() ? bertModelTag : 0)) * 0x100000001b3ULL;
+    tag = (tag ^ (current && current->hasClip() ? clipModelTag : 0)) * 0x100000001b3ULL;
+    return tag;
+}
+
+void ActionSimilarity::shutdownEngine() {
+    int previousState = modelLoadState.exchange(MODEL_LOAD_SHUTDOWN, std::memory_order_acq_rel);
+    if (MODEL_LOAD_DONE != previousState) {
+        // 仍在加载时不打断，加载线程完成后发现已停止，自行停止加载出的引擎
+        return;
+    }
+    SimilarityEnginePtr previous = std::atomic_exchange(&engine, SimilarityEnginePtr());
+    if (previous) {
+        previous->shutdown();
+        BLOG("相似度引擎已停止");
     }
 }
 
+void ActionSimilarity::preloadModelsAsync() {
+    InferenceSessionConfig config = Preference::inst()->getInferenceSessionConfig();
+    if (!config.preloadModels) {
+        BLOG("模型预加载已关闭，首次计算相似度时同步加载");
+        return;
+    }
+    // 在启动线程前占住加载状态，避免决策线程抢先同步加载
+    int expected = MODEL_LOAD_IDLE;
+    if (!modelLoadState.compare_exchange_strong(expected, MODEL_LOAD_RUNNING)) {
+        return;
+    }
+    BLOG("开始在后台加载并预热相似度模型");
+    std::thread([config]() {
+        loadModels(config, true);
+    }).detach();
+}
+
+void ActionSimilarity::loadIconEmbeddingCache() {
+    const IconSimilarityConfig& iconConfig = Preference::inst()->getIconSimilarityConfig();
+    iconEmbeddingCache.setCapacity(iconConfig.embeddingCacheSize);
+    // 缓存路径只在CLIP会话创建成功后设置
+    if (!iconConfig.persistEmbeddingCache || iconEmbeddingCachePath.empty()) {
+        return;
+    }
+    iconEmbeddingCache.load(iconEmbeddingCachePath, clipModelTag);
+}
+
+void ActionSimilarity::saveIconEmbeddingCache() {
+    SimilarityEnginePtr loaded = currentEngine();
+    if (!loaded || !loaded->hasClip() || iconEmbeddingCachePath.empty() || !Preference::inst()->getIconSimilarityConfig().persistEmbeddingCache) {
+        return;
+    }
+    iconEmbeddingCache.save(iconEmbeddingCachePath, clipModelTag);
+}
+
 void ActionSimilarity::initializeVocab() {
-    if (!vocabMap.empty()) return;
+    if (tokenizer) return;
 
     BLOG("开始加载官方BERT词汇表");
     
-    // 加载官方BERT词汇表
-    std::string vocabPath;
+    // 优先映射与vocab.txt同目录的预编译词表（vocab.bin），没有或过期时从vocab.txt构建并写出
 #ifdef __ANDROID__
-    // Android设备上的路径
-    vocabPath = "/data/local/tmp/vocab.txt";
-    BLOG("尝试Android词汇表路径: %s", vocabPath.c_str());
-    
-    std::ifstream vocabFile(vocabPath);
-    if (!vocabFile.is_open()) {
-        // 尝试备用路径
-        vocabPath = "/sdcard/vocab.txt";
-        BLOG("尝试备用Android词汇表路径: %s", vocabPath.c_str());
-        vocabFile.open(vocabPath);
-    }
+    std::vector<std::string> vocabCandidates = {"/data/local/tmp/vocab.txt", "/sdcard/vocab.txt"};
 #else
     // macOS/开发环境路径
-    vocabPath = "/Users/atmo/program/Fastbot_Android_副本/vocab.txt";
-    BLOG("尝试macOS词汇表路径: %s", vocabPath.c_str());
-    std::ifstream vocabFile(vocabPath);
+    std::vector<std::string> vocabCandidates = {"/Users/atmo/program/Fastbot_Android_副本/vocab.txt"};
 #endif
+    for (const auto& vocabPath : vocabCandidates) {
+        BLOG("尝试词汇表路径: %s", vocabPath.c_str());
+        std::string binaryPath = vocabPath.substr(0, vocabPath.find_last_of('.')) + ".bin";
+        tokenizer = WordPieceTokenizer::load(vocabPath, binaryPath);
+        if (tokenizer) break;
+    }
     
-    if (!vocabFile.is_open()) {
-        BLOGE("无法打开词汇表文件: %s", vocabPath.c_str());
+    if (!tokenizer) {
+        BLOGE("无法打开词汇表文件");
         // 回退到简单的词汇表
-        vocabMap["[UNK]"] = UNK_TOKEN_ID;
-        vocabMap["[CLS]"] = CLS_TOKEN_ID;
-        vocabMap["[SEP]"] = SEP_TOKEN_ID;
-        vocabMap["[PAD]"] = PAD_TOKEN_ID;
+        tokenizer = WordPieceTokenizer::build({{"[UNK]", static_cast<int32_t>(UNK_TOKEN_ID)},
+                                               {"[CLS]", static_cast<int32_t>(CLS_TOKEN_ID)},
+                                               {"[SEP]", static_cast<int32_t>(SEP_TOKEN_ID)},
+                                               {"[PAD]", static_cast<int32_t>(PAD_TOKEN_ID)}});
         BLOG("使用简单词汇表，仅包含特殊token");
         return;
     }
     
-    std::string line;
-    int64_t lineNumber = 0;
-    while (std::getline(vocabFile, line)) {
-        lineNumber++;
-        
-        // 跳过空行
-        if (line.empty()) continue;
-        
-        // 词汇表格式：每行一个token，行号就是ID
-        vocabMap[line] = lineNumber - 1;  // 行号从1开始，ID从0开始
-    }
-    
-    vocabFile.close();
-    BLOG("成功加载词汇表，共%d个token", static_cast<int>(vocabMap.size()));
-    
-    // 验证特殊token
-    if (vocabMap.find("[UNK]") != vocabMap.end()) {
-        BLOG("UNK token ID: %lld", vocabMap["[UNK]"]);
-    }
-    if (vocabMap.find("[CLS]") != vocabMap.end()) {
-        BLOG("CLS token ID: %lld", vocabMap["[CLS]"]);
-    }
-    if (vocabMap.find("[SEP]") != vocabMap.end()) {
-        BLOG("SEP token ID: %lld", vocabMap["[SEP]"]);
-    }
-    if (vocabMap.find("[PAD]") != vocabMap.end()) {
-        BLOG("PAD token ID: %lld", vocabMap["[PAD]"]);
-    }
+    BLOG("成功加载词汇表，共%zu个token，UNK=%lld CLS=%lld SEP=%lld PAD=%lld", tokenizer->tokenCount(),
+         (long long) tokenizer->unkId(), (long long) tokenizer->clsId(),
+         (long long) tokenizer->sepId(), (long long) tokenizer->padId());
 }
 
-std::vector<std::string> ActionSimilarity::tokenize(const std::string& text) {
-    std::vector<std::string> tokens;
-    
+void ActionSimilarity::tokenize(const std::string& text, std::vector<int64_t>& ids) {
     // 处理空文本
     if (text.empty()) {
-        return tokens;
+        return;
     }
 
-    BLOG("开始分词: '%s'", text.c_str());
+#ifdef _DEBUG_
+    BDLOG("开始分词: '%s'", text.c_str());
+    size_t firstToken = ids.size();
+#endif
 
-    // 中文优先用jieba（若可用）；英文/标识符走规则切分
-    std::vector<std::string> words;
+    // 中文优先用jieba（若可用）切词；英文/标识符按空白和ENGLISH_WORD_DELIMITERS切词，直接在原文上做WordPiece
     if (containsChineseUTF8(text)) {
+        std::vector<std::string> words;
 #ifdef FASTBOT_USE_CPPJIEBA
-        initializeJieba();
         if (jiebaReady && jiebaPtr) {
-            std::vector<std::string> cut;
-            jiebaPtr->Cut(text, cut, true); // 搜索引擎模式
-            words.assign(cut.begin(), cut.end());
+            jiebaPtr->Cut(text, words, true); // 搜索引擎模式
         } else {
             // 回退：中文按UTF-8逐字切分
             std::string buf;
@@ -548,240 +711,319 @@ std::vector<std::string> ActionSimilarity::tokenize(const std::string& text) {
         }
         if (!buf.empty()) words.push_back(buf);
 #endif
-    } else {
-        words = splitEnglishLike(text);
-    }
-
-    // 2. 对每个词进行WordPiece分词（仅当词不在词表时）
-    for (const std::string& word : words) {
-        if (word.empty()) continue;
-        
-        // 检查是否在词汇表中
-        if (vocabMap.find(word) != vocabMap.end()) {
-            tokens.push_back(word);
-            BLOG("找到完整词: '%s'", word.c_str());
-        } else {
-            // 进行WordPiece分词
-            std::vector<std::string> subTokens = wordPieceTokenize(word);
-            tokens.insert(tokens.end(), subTokens.begin(), subTokens.end());
+        for (const std::string& word : words) {
+            tokenizer->tokenizeText(word.data(), word.size(), nullptr, ids);
         }
+    } else {
+        tokenizer->tokenizeText(text.data(), text.size(), ENGLISH_WORD_DELIMITERS, ids);
     }
 
-    BLOG("分词结果: [%s]", [&tokens]() {
+#ifdef _DEBUG_
+    // 逐个token拼字符串的开销与分词本身相当，只在调试构建中输出
+    BDLOG("分词结果: [%s]", [&]() {
         std::string result;
-        for (size_t i = 0; i < tokens.size(); ++i) {
-            if (i > 0) result += ", ";
-            result += "'" + tokens[i] + "'";
+        for (size_t i = firstToken; i < ids.size(); ++i) {
+            if (i > firstToken) result += ", ";
+            result += "'" + tokenizer->token(ids[i]) + "'";
         }
         return result;
     }().c_str());
-
-    return tokens;
+#endif
 }
 
-// 辅助函数：WordPiece分词
-std::vector<std::string> ActionSimilarity::wordPieceTokenize(const std::string& word) {
-    std::vector<std::string> tokens;
+std::vector<int64_t> ActionSimilarity::preprocessText(const std::string& text, size_t maxLength) {
+    std::vector<int64_t> ids;
+    ids.reserve(maxLength);
+
+    // 添加[CLS]标记，分词并转换为ID，再添加[SEP]标记
+    ids.push_back(tokenizer->clsId());
+    tokenize(text, ids);
+    ids.push_back(tokenizer->sepId());
     
-    // 如果词太短，直接返回
-    if (word.length() <= 2) {
-        tokens.push_back(word);
-        return tokens;
+    // 截断到最大长度
+    if (ids.size() > maxLength) {
+        ids.resize(maxLength);
+        ids[maxLength - 1] = tokenizer->sepId();
     }
-    
-    // 尝试从最长子串开始匹配
-    for (size_t len = word.length(); len > 0; --len) {
-        for (size_t start = 0; start <= word.length() - len; ++start) {
-            std::string subword = word.substr(start, len);
-            
-            // 检查是否在词汇表中
-            if (vocabMap.find(subword) != vocabMap.end()) {
-                tokens.push_back(subword);
-                
-                // 递归处理剩余部分
-                if (start > 0) {
-                    std::string left = word.substr(0, start);
-                    auto leftTokens = wordPieceTokenize(left);
-                    tokens.insert(tokens.begin(), leftTokens.begin(), leftTokens.end());
-                }
-                
-                if (start + len < word.length()) {
-                    std::string right = word.substr(start + len);
-                    auto rightTokens = wordPieceTokenize(right);
-                    tokens.insert(tokens.end(), rightTokens.begin(), rightTokens.end());
-                }
-                
-                return tokens;
-            }
+
+    // 填充到最大长度
+    ids.resize(maxLength, tokenizer->padId());
+    return ids;
+}
+
+std::vector<float> ActionSimilarity::getBertEmbedding(const std::string& text) {
+    SimilarityEnginePtr loaded = acquireEngine();
+    if (!loaded || !loaded->hasBert()) {
+        BLOGE("BERT模型未就绪");
+        return std::vector<float>();
+    }
+    return computeBertEmbedding(loaded, text);
+}
+
+std::vector<float> ActionSimilarity::computeBertEmbedding(const SimilarityEnginePtr& loaded, const std::string& text) {
+    try {
+        // 预处理文本，推理在引擎借出的上下文中完成，多个线程可同时计算
+        std::vector<int64_t> inputIds = preprocessText(text, loaded->bertSequenceLength());
+        std::vector<float> embedding;
+        if (!loaded->bertEmbedding(inputIds, tokenizer->padId(), embedding)) {
+            return std::vector<float>();
         }
+
+        BLOG("BERT嵌入向量计算完成，向量维度: %zu", embedding.size());
+
+        return embedding;
+    } catch (const std::exception& e) {
+        std::cerr << "获取BERT嵌入向量失败: " << e.what() << std::endl;
+        return std::vector<float>();
     }
-    
-    // 如果没有找到匹配，返回原词
-    tokens.push_back(word);
-    return tokens;
 }
 
-std::vector<int64_t> ActionSimilarity::convertTokensToIds(const std::vector<std::string>& tokens) {
-    std::vector<int64_t> ids;
-    ids.reserve(tokens.size());
+std::string ActionSimilarity::embeddingCacheKey(EmbeddingKind kind, const std::string& rawValue) {
+    std::string key;
+    key.reserve(rawValue.size() + 1);
+    key.push_back(static_cast<char>(kind));
+    key += rawValue;
+    return key;
+}
 
-    for (const auto& token : tokens) {
-        auto it = vocabMap.find(token);
-        if (it != vocabMap.end()) {
-            ids.push_back(it->second);
-        } else {
-            // 使用词汇表中的UNK token ID，如果找不到则使用默认值
-            auto unkIt = vocabMap.find("[UNK]");
-            if (unkIt != vocabMap.end()) {
-                ids.push_back(unkIt->second);
-            } else {
-                ids.push_back(UNK_TOKEN_ID);
-            }
-        }
+bool ActionSimilarity::findCachedEmbedding(EmbeddingKind kind, const std::string& rawValue, std::vector<float>& out) {
+    std::lock_guard<std::mutex> cacheGuard(embeddingCacheLock);
+    auto it = embeddingCache.find(embeddingCacheKey(kind, rawValue));
+    if (it == embeddingCache.end()) {
+        return false;
     }
+    embeddingCacheOrder.splice(embeddingCacheOrder.begin(), embeddingCacheOrder, it->second.position);
+    out = it->second.embedding;
+    return true;
+}
 
-    return ids;
+void ActionSimilarity::storeCachedEmbedding(EmbeddingKind kind, const std::string& rawValue,
+                                            const std::vector<float>& embedding) {
+    if (embedding.empty()) return;
+    std::string key = embeddingCacheKey(kind, rawValue);
+    Int8Embedding quantized;
+    bool hasQuantized = EmbeddingQuantizer::quantize(embedding, quantized);
+    std::lock_guard<std::mutex> cacheGuard(embeddingCacheLock);
+    if (hasQuantized && (quantizedEmbeddings.size() < MAX_QUANTIZED_EMBEDDINGS || quantizedEmbeddings.count(key))) {
+        quantizedEmbeddings[key] = std::move(quantized);
+    }
+    auto it = embeddingCache.find(key);
+    if (it != embeddingCache.end()) {
+        it->second.embedding = embedding;
+        embeddingCacheOrder.splice(embeddingCacheOrder.begin(), embeddingCacheOrder, it->second.position);
+        return;
+    }
+    while (embeddingCache.size() >= MAX_EMBEDDING_CACHE_SIZE && !embeddingCacheOrder.empty()) {
+        embeddingCache.erase(embeddingCacheOrder.back());
+        embeddingCacheOrder.pop_back();
+    }
+    embeddingCacheOrder.push_front(key);
+    CachedEmbedding& cached = embeddingCache[key];
+    cached.embedding = embedding;
+    cached.position = embeddingCacheOrder.begin();
 }
 
-std::vector<int64_t> ActionSimilarity::preprocessText(const std::string& text) {
-    // 获取特殊token的ID
-    int64_t clsId = CLS_TOKEN_ID;
-    int64_t sepId = SEP_TOKEN_ID;
-    int64_t padId = PAD_TOKEN_ID;
-    
-    // 如果词汇表已加载，使用词汇表中的ID
-    if (!vocabMap.empty()) {
-        auto clsIt = vocabMap.find("[CLS]");
-        if (clsIt != vocabMap.end()) clsId = clsIt->second;
-        
-        auto sepIt = vocabMap.find("[SEP]");
-        if (sepIt != vocabMap.end()) sepId = sepIt->second;
-        
-        auto padIt = vocabMap.find("[PAD]");
-        if (padIt != vocabMap.end()) padId = padIt->second;
+std::vector<float> ActionSimilarity::getAttributeEmbedding(EmbeddingKind kind, const std::string& rawValue,
+                                                           const std::string& processedValue) {
+    std::vector<float> embedding;
+    if (findCachedEmbedding(kind, rawValue, embedding)) {
+        return embedding;
     }
-    
-    // 添加[CLS]标记
-    std::vector<int64_t> ids = {clsId};
-    
-    // 分词并转换为ID
-    auto tokens = tokenize(text);
-    auto tokenIds = convertTokensToIds(tokens);
-    ids.insert(ids.end(), tokenIds.begin(), tokenIds.end());
-    
-    // 添加[SEP]标记
-    ids.push_back(sepId);
-    
-    // 填充到最大长度
-    while (ids.size() < bertInputShape[1]) {
-        ids.push_back(padId);
+    embedding = getBertEmbedding(processedValue);
+    storeCachedEmbedding(kind, rawValue, embedding);
+    return embedding;
+}
+
+bool ActionSimilarity::getIconFingerprint(const std::string& iconBase64, IconFingerprint& fingerprint,
+                                          IconId* iconId) {
+    IconId id = IconStore::inst()->intern(iconBase64);
+    if (!IconStore::inst()->fingerprint(id, fingerprint)) {
+        return false;
     }
-    
-    // 截断到最大长度
-    if (ids.size() > bertInputShape[1]) {
-        ids.resize(bertInputShape[1]);
-        ids[bertInputShape[1] - 1] = sepId;
+    if (iconId) {
+        *iconId = id;
     }
-    
-    return ids;
+    return true;
 }
 
-std::vector<float> ActionSimilarity::getBertEmbedding(const std::string& text) {
-    if (!bertSession) {
-        BLOGE("BERT模型未初始化");
-        // 尝试重新初始化模型
-        try {
-            initializeModels();
-            if (!bertSession) {
-                BLOGE("BERT模型重新初始化失败");
-                return std::vector<float>();
-            }
-        } catch (const std::exception& e) {
-            BLOGE("BERT模型重新初始化异常: %s", e.what());
-            return std::vector<float>();
-        }
+bool ActionSimilarity::perceptualIconSimilarity(const IconFingerprint& fingerprint1,
+                                                const IconFingerprint& fingerprint2, double& similarity) {
+    if (fingerprint1.contentHash == fingerprint2.contentHash) {
+        similarity = 1.0;
+        return true;
     }
-    
-    // 确保词汇表已加载
-    if (vocabMap.empty()) {
-        BLOG("词汇表未加载，开始初始化词汇表");
-        initializeVocab();
+    const IconSimilarityConfig& iconConfig = Preference::inst()->getIconSimilarityConfig();
+    int distance = WidgetIcon::hammingDistance(fingerprint1.perceptualHash, fingerprint2.perceptualHash);
+    if (distance <= iconConfig.identicalHashDistance) {
+        BLOG("图标感知哈希距离%d，视为同一图标", distance);
+        similarity = 1.0;
+        return true;
     }
+    if (distance >= iconConfig.differentHashDistance) {
+        BLOG("图标感知哈希距离%d，视为不同图标", distance);
+        similarity = 0.0;
+        return true;
+    }
+    return false;
+}
 
-    try {
-        // 预处理文本
-        std::vector<int64_t> inputIds = preprocessText(text);
-        // 构建有效的attention mask：非PAD为1，PAD为0
-        std::vector<int64_t> attentionMask(bertInputShape[1], 0);
-        int64_t padId = PAD_TOKEN_ID;
-        if (!vocabMap.empty()) {
-            auto itPad = vocabMap.find("[PAD]");
-            if (itPad != vocabMap.end()) padId = itPad->second;
-        }
-        for (size_t i = 0; i < inputIds.size(); ++i) {
-            attentionMask[i] = (inputIds[i] == padId) ? 0 : 1;
+std::vector<float> ActionSimilarity::getIconEmbedding(const std::string& iconBase64) {
+    std::vector<float> embedding;
+    IconFingerprint fingerprint;
+    IconId iconId = INVALID_ICON_ID;
+    if (!getIconFingerprint(iconBase64, fingerprint, &iconId)) {
+        return embedding;
+    }
+    if (iconEmbeddingCache.find(fingerprint.contentHash, embedding)) {
+        return embedding;
+    }
+    // 只在需要推理时临时解码
+    embedding = getClipEmbedding(IconStore::inst()->decode(iconId));
+    storeIconEmbedding(fingerprint.contentHash, embedding);
+    return embedding;
+}
+
+bool ActionSimilarity::lookupQuantizedEmbedding(EmbeddingKind kind, const std::string& rawValue, Int8Embedding& out) {
+    if (rawValue.empty()) {
+        return false;
+    }
+    if (EmbeddingKind::Icon == kind) {
+        // 只查已登记的图标，不为了写模型去解码
+        return lookupQuantizedIconEmbedding(IconStore::inst()->find(rawValue), out);
+    }
+    std::lock_guard<std::mutex> cacheGuard(embeddingCacheLock);
+    auto it = quantizedEmbeddings.find(embeddingCacheKey(kind, rawValue));
+    if (it == quantizedEmbeddings.end()) {
+        return false;
+    }
+    out = it->second;
+    return true;
+}
+
+bool ActionSimilarity::computeQuantizedEmbedding(EmbeddingKind kind, const std::string& rawValue, Int8Embedding& out) {
+    if (rawValue.empty()) {
+        return false;
+    }
+    SimilarityEnginePtr loaded = currentEngine();
+    if (!loaded) {
+        return false;
+    }
+    std::vector<float> embedding;
+    if (EmbeddingKind::Icon == kind) {
+        if (!loaded->hasClip()) {
+            return false;
         }
-        std::vector<int64_t> tokenTypeIds(bertInputShape[1], 0);
-
-        // 创建输入tensor
-        auto memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-        std::vector<Ort::Value> inputTensors;
-        inputTensors.push_back(Ort::Value::CreateTensor<int64_t>(memoryInfo, inputIds.data(), inputIds.size(), bertInputShape.data(), bertInputShape.size()));
-        inputTensors.push_back(Ort::Value::CreateTensor<int64_t>(memoryInfo, attentionMask.data(), attentionMask.size(), bertInputShape.data(), bertInputShape.size()));
-        inputTensors.push_back(Ort::Value::CreateTensor<int64_t>(memoryInfo, tokenTypeIds.data(), tokenTypeIds.size(), bertInputShape.data(), bertInputShape.size()));
-
-        // 运行模型
-        auto outputTensors = bertSession->Run(Ort::RunOptions{nullptr}, bertInputNames.data(), inputTensors.data(), inputTensors.size(), bertOutputNames.data(), bertOutputNames.size());
-
-        // 获取输出向量
-        float* outputData = outputTensors[0].GetTensorMutableData<float>();
-        size_t outputSize = outputTensors[0].GetTensorTypeAndShapeInfo().GetElementCount();
-        // BERT输出形状: [1, sequence_length, hidden_size]
-        size_t sequenceLength = bertInputShape[1];
-        size_t hiddenSize = outputSize / sequenceLength;
-
-        BLOG("BERT输出形状: batch_size=1, sequence_length=%zu, hidden_size=%zu", sequenceLength, hiddenSize);
-
-        std::vector<float> embedding(hiddenSize, 0.0f);
-        // 掩码平均池化：仅对attentionMask==1的位置做平均
-        int64_t validCount = 0;
-        for (size_t j = 0; j < sequenceLength; ++j) {
-            if (attentionMask[j] == 1) validCount++;
+        embedding = getIconEmbedding(rawValue);
+    } else {
+        if (!loaded->hasBert()) {
+            return false;
         }
-        if (validCount == 0) validCount = 1; // 防止除零
-        for (size_t i = 0; i < hiddenSize; ++i) {
-            float sumVal = 0.0f;
-            for (size_t j = 0; j < sequenceLength; ++j) {
-                if (attentionMask[j] == 1) {
-                    sumVal += outputData[j * hiddenSize + i];
-                }
-            }
-            embedding[i] = sumVal / static_cast<float>(validCount);
+        std::string processed = EmbeddingKind::ResourceId == kind ? preprocessResourceId(rawValue)
+                              : EmbeddingKind::ActivityName == kind ? preprocessActivityName(rawValue) : rawValue;
+        if (processed.empty()) {
+            return false;
         }
+        embedding = computeBertEmbedding(loaded, processed);
+    }
+    return EmbeddingQuantizer::quantize(embedding, out);
+}
 
-        BLOG("BERT嵌入向量计算完成，向量维度: %zu", embedding.size());
+SimilarityEnginePtr ActionSimilarity::awaitEngine() {
+    SimilarityEnginePtr loaded = acquireEngine();
+    while (!loaded && MODEL_LOAD_RUNNING == modelLoadState.load(std::memory_order_acquire)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        loaded = currentEngine();
+    }
+    return loaded ? loaded : currentEngine();
+}
 
-        return embedding;
-    } catch (const std::exception& e) {
-        std::cerr << "获取BERT嵌入向量失败: " << e.what() << std::endl;
-        return std::vector<float>();
+void ActionSimilarity::prefetchIconEmbedding(IconId iconId) {
+    SimilarityEnginePtr loaded = currentEngine();
+    if (!loaded || !loaded->hasClip()) {
+        return;
+    }
+    IconFingerprint fingerprint;
+    if (!IconStore::inst()->fingerprint(iconId, fingerprint) || iconEmbeddingCache.contains(fingerprint.contentHash)) {
+        return;
+    }
+    storeIconEmbedding(fingerprint.contentHash, getClipEmbedding(IconStore::inst()->decode(iconId)));
+}
+
+void ActionSimilarity::storeIconEmbedding(uint64_t contentHash, const std::vector<float>& embedding) {
+    iconEmbeddingCache.put(contentHash, embedding);
+    Int8Embedding quantized;
+    if (!EmbeddingQuantizer::quantize(embedding, quantized)) {
+        return;
+    }
+    std::lock_guard<std::mutex> cacheGuard(embeddingCacheLock);
+    if (quantizedIconEmbeddings.size() < MAX_QUANTIZED_EMBEDDINGS || quantizedIconEmbeddings.count(contentHash)) {
+        quantizedIconEmbeddings[contentHash] = std::move(quantized);
     }
 }
 
-double ActionSimilarity::calculateTextSimilarity(const std::string& text1, const std::string& text2) {
+bool ActionSimilarity::lookupQuantizedIconEmbedding(IconId iconId, Int8Embedding& out) {
+    IconFingerprint fingerprint;
+    if (!IconStore::inst()->fingerprint(iconId, fingerprint)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> cacheGuard(embeddingCacheLock);
+        auto it = quantizedIconEmbeddings.find(fingerprint.contentHash);
+        if (it != quantizedIconEmbeddings.end()) {
+            out = it->second;
+            return true;
+        }
+    }
+    // 从缓存文件加载、本次运行没有推理过的图标
+    std::vector<float> embedding;
+    if (!iconEmbeddingCache.find(fingerprint.contentHash, embedding)) {
+        return false;
+    }
+    return EmbeddingQuantizer::quantize(embedding, out);
+}
+
+bool ActionSimilarity::storedEmbeddingSimilarity(const std::vector<float>& current, const Int8EmbeddingView& stored,
+                                                 double& similarity) {
+    if (current.empty() || stored.empty() || current.size() != stored.size) {
+        return false;
+    }
+    Int8Embedding quantized;
+    if (!EmbeddingQuantizer::quantize(current, quantized)) {
+        return false;
+    }
+    similarity = EmbeddingQuantizer::cosineSimilarity(Int8EmbeddingView(quantized), stored);
+    return true;
+}
+
+double ActionSimilarity::calculateTextSimilarity(const std::string& text1, const std::string& text2,
+                                                 const Int8EmbeddingView& stored2) {
     BLOG("计算文本相似度: '%s' vs '%s'", text1.c_str(), text2.c_str());
+    // 模型中保存了向量时，原始文本可以省略
+    bool hasText2 = !text2.empty() || !stored2.empty();
     
     // 如果两个文本都为空，认为它们相似
-    if (text1.empty() && text2.empty()) {
+    if (text1.empty() && !hasText2) {
         BLOG("两个文本都为空，相似度为1.0");
         return 1.0;
     }
     
     // 如果只有一个为空，认为它们不相似
-    if (text1.empty() || text2.empty()) {
+    if (text1.empty() || !hasText2) {
         BLOG("一个文本为空，另一个不为空，相似度为0.0");
         return 0.0;
     }
+
+    // 优先使用模型中保存的量化向量，只需对当前文本推理（通常已命中缓存）
+    if (!stored2.empty()) {
+        double storedSim = 0.0;
+        if (storedEmbeddingSimilarity(getAttributeEmbedding(EmbeddingKind::Text, text1, text1), stored2, storedSim)) {
+            BLOG("使用保存的量化向量计算文本相似度结果: %f", storedSim);
+            return storedSim;
+        }
+        if (text2.empty()) {
+            return 0.0;
+        }
+    }
     
     // // 调试：显示分词结果
     // auto tokens1 = tokenize(text1);
@@ -806,29 +1048,14 @@ double ActionSimilarity::calculateTextSimilarity(const std::string& text1, const
     // 尝试使用BERT模型计算相似度
     try {
         BLOG("尝试使用BERT模型计算文本相似度");
-        if (!bertSession) {
-            BLOG("BERT模型未初始化，尝试初始化");
-            try {
-                initializeModels();
-            } catch (const std::exception& e) {
-                BLOGE("BERT模型初始化失败: %s", e.what());
-                throw;
-            }
+        SimilarityEnginePtr loaded = acquireEngine();
+        if (!loaded || !loaded->hasBert()) {
+            BLOGE("BERT模型未就绪，使用备用方法");
+            throw std::runtime_error("BERT模型未就绪");
         }
         
-        if (!bertSession) {
-            BLOGE("BERT模型仍然未初始化，使用备用方法");
-            throw std::runtime_error("BERT模型未初始化");
-        }
-        
-        // 确保词汇表已加载
-        if (vocabMap.empty()) {
-            BLOG("词汇表未加载，开始初始化词汇表");
-            initializeVocab();
-        }
-        
-        auto embedding1 = getBertEmbedding(text1);
-        auto embedding2 = getBertEmbedding(text2);
+        auto embedding1 = getAttributeEmbedding(EmbeddingKind::Text, text1, text1);
+        auto embedding2 = getAttributeEmbedding(EmbeddingKind::Text, text2, text2);
         
         if (embedding1.empty() || embedding2.empty()) {
             BLOGE("获取BERT嵌入向量失败，使用备用方法");
@@ -904,19 +1131,36 @@ double ActionSimilarity::calculateTextSimilarity(const std::string& text1, const
     }
 }
 
-double ActionSimilarity::calculateResourceIdSimilarity(const std::string& id1, const std::string& id2) {
+double ActionSimilarity::calculateResourceIdSimilarity(const std::string& id1, const std::string& id2,
+                                                       const Int8EmbeddingView& stored2) {
+    bool hasId2 = !id2.empty() || !stored2.empty();
+
     // 如果两个ID都为空，认为它们相似
-    if (id1.empty() && id2.empty()) {
+    if (id1.empty() && !hasId2) {
         return 1.0;
     }
     
     // 如果只有一个为空，认为它们不相似
-    if (id1.empty() || id2.empty()) {
+    if (id1.empty() || !hasId2) {
         return 0.0;
     }
     
     // 预处理resource-id
     std::string processedId1 = preprocessResourceId(id1);
+
+    // 保存的向量只会来自预处理后非空的resource-id
+    if (!stored2.empty()) {
+        if (processedId1.empty()) {
+            return 0.0;
+        }
+        double storedSim = 0.0;
+        if (storedEmbeddingSimilarity(getAttributeEmbedding(EmbeddingKind::ResourceId, id1, processedId1), stored2, storedSim)) {
+            return storedSim;
+        }
+        if (id2.empty()) {
+            return 0.0;
+        }
+    }
     std::string processedId2 = preprocessResourceId(id2);
     
     BLOG("预处理后的resource-id比较: '%s' vs '%s'", processedId1.c_str(), processedId2.c_str());
@@ -932,8 +1176,8 @@ double ActionSimilarity::calculateResourceIdSimilarity(const std::string& id1, c
     }
     
     // 使用BERT模型计算相似度
-    auto embedding1 = getBertEmbedding(processedId1);
-    auto embedding2 = getBertEmbedding(processedId2);
+    auto embedding1 = getAttributeEmbedding(EmbeddingKind::ResourceId, id1, processedId1);
+    auto embedding2 = getAttributeEmbedding(EmbeddingKind::ResourceId, id2, processedId2);
     
     if (embedding1.empty() || embedding2.empty()) {
         // 如果BERT模型失败，回退到字符串比较
@@ -949,19 +1193,36 @@ double ActionSimilarity::calculateResourceIdSimilarity(const std::string& id1, c
     return cosine_similarity(embedding1, embedding2);
 }
 
-double ActionSimilarity::calculateActivitySimilarity(const std::string& activity1, const std::string& activity2) {
+double ActionSimilarity::calculateActivitySimilarity(const std::string& activity1, const std::string& activity2,
+                                                     const Int8EmbeddingView& stored2) {
+    bool hasActivity2 = !activity2.empty() || !stored2.empty();
+
     // 如果两个活动名称都为空，认为它们相似
-    if (activity1.empty() && activity2.empty()) {
+    if (activity1.empty() && !hasActivity2) {
         return 1.0;
     }
     
     // 如果只有一个为空，认为它们不相似
-    if (activity1.empty() || activity2.empty()) {
+    if (activity1.empty() || !hasActivity2) {
         return 0.0;
     }
     
     // 预处理activity名称
     std::string processedActivity1 = preprocessActivityName(activity1);
+
+    if (!stored2.empty()) {
+        if (processedActivity1.empty()) {
+            return 0.0;
+        }
+        double storedSim = 0.0;
+        if (storedEmbeddingSimilarity(getAttributeEmbedding(EmbeddingKind::ActivityName, activity1, processedActivity1),
+                                      stored2, storedSim)) {
+            return storedSim;
+        }
+        if (activity2.empty()) {
+            return 0.0;
+        }
+    }
     std::string processedActivity2 = preprocessActivityName(activity2);
     
     BLOG("预处理后的activity名称比较: '%s' vs '%s'", processedActivity1.c_str(), processedActivity2.c_str());
@@ -977,8 +1238,8 @@ double ActionSimilarity::calculateActivitySimilarity(const std::string& activity
     }
     
     // 使用BERT模型计算相似度
-    auto embedding1 = getBertEmbedding(processedActivity1);
-    auto embedding2 = getBertEmbedding(processedActivity2);
+    auto embedding1 = getAttributeEmbedding(EmbeddingKind::ActivityName, activity1, processedActivity1);
+    auto embedding2 = getAttributeEmbedding(EmbeddingKind::ActivityName, activity2, processedActivity2);
     
     if (embedding1.empty() || embedding2.empty()) {
         // 如果BERT模型失败，回退到精确匹配
@@ -1054,104 +1315,351 @@ double ActionSimilarity::calculateActivitySimilarity(const std::string& activity
 //     return calculateSimilarity(action1, action2) >= threshold;
 // }
 
+// 去掉首尾空白并把连续空白压成一个空格：分词按空白切词，归一化后相同的文本得到相同的token序列
+static std::string normalizeWhitespace(const std::string& text) {
+    std::string result;
+    result.reserve(text.size());
+    bool pendingSpace = false;
+    for (char c : text) {
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            pendingSpace = !result.empty();
+            continue;
+        }
+        if (pendingSpace) {
+            result.push_back(' ');
+            pendingSpace = false;
+        }
+        result.push_back(c);
+    }
+    return result;
+}
+
+// 字符n-gram：按UTF-8码点切分，ASCII转小写并忽略空白；两个码点一组，不足两个码点时取单字
+static std::vector<uint64_t> characterNGrams(const std::string& text) {
+    std::vector<uint32_t> codePoints;
+    codePoints.reserve(text.size());
+    for (size_t i = 0; i < text.size();) {
+        auto c = static_cast<unsigned char>(text[i]);
+        size_t length = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 1;
+        length = std::min(length, text.size() - i);
+        if (1 == length) {
+            if (!std::isspace(c)) {
+                codePoints.push_back(static_cast<uint32_t>(std::tolower(c)));
+            }
+        } else {
+            uint32_t codePoint = 0;
+            for (size_t j = 0; j < length; ++j) {
+                codePoint = (codePoint << 8) | static_cast<unsigned char>(text[i + j]);
+            }
+            codePoints.push_back(codePoint);
+        }
+        i += length;
+    }
+    std::vector<uint64_t> grams;
+    if (codePoints.size() < 2) {
+        grams.assign(codePoints.begin(), codePoints.end());
+    } else {
+        grams.reserve(codePoints.size() - 1);
+        for (size_t i = 0; i + 1 < codePoints.size(); ++i) {
+            grams.push_back((static_cast<uint64_t>(codePoints[i]) << 32) | codePoints[i + 1]);
+        }
+    }
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    return grams;
+}
+
+double ActionSimilarity::lexicalSimilarity(const std::string& text1, const std::string& text2) {
+    std::vector<uint64_t> grams1 = characterNGrams(text1);
+    std::vector<uint64_t> grams2 = characterNGrams(text2);
+    if (grams1.empty() && grams2.empty()) {
+        return 1.0;
+    }
+    size_t common = 0;
+    auto it1 = grams1.begin();
+    auto it2 = grams2.begin();
+    while (it1 != grams1.end() && it2 != grams2.end()) {
+        if (*it1 < *it2) {
+            ++it1;
+        } else if (*it2 < *it1) {
+            ++it2;
+        } else {
+            ++common;
+            ++it1;
+            ++it2;
+        }
+    }
+    return static_cast<double>(common) / static_cast<double>(grams1.size() + grams2.size() - common);
+}
+
+// 词法上界生效前每类属性需要的校准样本数，以及在观测到的最大差距之外再留出的余量
+static const size_t LEXICAL_CALIBRATION_SAMPLES = 200;
+static const double LEXICAL_BOUND_MARGIN = 0.05;
+
+double ActionSimilarity::lexicalUpperBound(EmbeddingKind kind, double lexical) {
+    std::lock_guard<std::mutex> calibrationGuard(lexicalCalibrationLock);
+    const LexicalCalibration& calibration = lexicalCalibration[static_cast<int>(kind)];
+    if (calibration.samples < LEXICAL_CALIBRATION_SAMPLES) {
+        return 1.0;
+    }
+    return std::min(1.0, lexical + calibration.maxGap + LEXICAL_BOUND_MARGIN);
+}
+
+void ActionSimilarity::recordLexicalGap(EmbeddingKind kind, double lexical, double similarity) {
+    std::lock_guard<std::mutex> calibrationGuard(lexicalCalibrationLock);
+    LexicalCalibration& calibration = lexicalCalibration[static_cast<int>(kind)];
+    calibration.samples++;
+    calibration.maxGap = std::max(calibration.maxGap, similarity - lexical);
+}
+
+namespace {
+    // 级联中的一个相似度分量：resolved时value为最终值，否则upperBound为尚未计算的模型分数上界（未校准时为1）。
+    // lexical为两侧原始值的词法相似度，没有计算时为负
+    struct SimilarityComponent {
+        const char* name;
+        double weight;
+        bool resolved;
+        double value;
+        double upperBound;
+        double lexical;
+
+        void resolve(double similarity) {
+            resolved = true;
+            value = similarity;
+            upperBound = similarity;
+        }
+    };
+
+    // 已计算分量取实际值、未计算分量取上界时的加权和，即本次比较最高可能得到的相似度
+    double achievableScore(SimilarityComponent* const* components, size_t count) {
+        double score = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            score += components[i]->weight * components[i]->upperBound;
+        }
+        return score;
+    }
+}
+
+SimilarityWeights ActionSimilarity::attributeWeights(bool compareIcons) {
+    if (compareIcons) {
+        return SimilarityWeights{0.35f, 0.1f, 0.2f, 0.35f};
+    }
+    return SimilarityWeights{0.4f, 0.4f, 0.2f, 0.0f};
+}
+
+bool ActionSimilarity::buildEmbeddingQuery(const ActivityNameActionPtr& action, EmbeddingQuery& query) {
+    if (!action) {
+        return false;
+    }
+    return buildEmbeddingQuery(action->getTarget(), action->getActivity() ? *action->getActivity() : "", query);
+}
+
+bool ActionSimilarity::buildEmbeddingQuery(const WidgetPtr& targetWidget, const std::string& activityName,
+                                           EmbeddingQuery& query) {
+    SimilarityEnginePtr loaded = currentEngine();
+    if (!targetWidget || !loaded || !loaded->hasBert()) {
+        return false;
+    }
+    std::string text = targetWidget->getText();
+    std::string resourceId = targetWidget->getResourceID();
+
+    query.emptyMask = 0;
+    for (auto& vector : query.vectors) {
+        vector.clear();
+    }
+    // 与保存的向量比较时各分量使用的嵌入：文本原样，resource-id和activity取预处理后的结果，
+    // 预处理后为空的不推理（与保存的向量相似度为0）
+    if (text.empty()) {
+        query.emptyMask |= ActionEmbeddingIndex::attributeBit(ActionEmbeddingIndex::TEXT);
+    } else {
+        query.vectors[ActionEmbeddingIndex::TEXT] = getAttributeEmbedding(EmbeddingKind::Text, text, text);
+    }
+    if (resourceId.empty()) {
+        query.emptyMask |= ActionEmbeddingIndex::attributeBit(ActionEmbeddingIndex::RESOURCE_ID);
+    } else {
+        std::string processedId = preprocessResourceId(resourceId);
+        if (!processedId.empty()) {
+            query.vectors[ActionEmbeddingIndex::RESOURCE_ID] =
+                    getAttributeEmbedding(EmbeddingKind::ResourceId, resourceId, processedId);
+        }
+    }
+    if (activityName.empty()) {
+        query.emptyMask |= ActionEmbeddingIndex::attributeBit(ActionEmbeddingIndex::ACTIVITY_NAME);
+    } else {
+        std::string processedActivity = preprocessActivityName(activityName);
+        if (!processedActivity.empty()) {
+            query.vectors[ActionEmbeddingIndex::ACTIVITY_NAME] =
+                    getAttributeEmbedding(EmbeddingKind::ActivityName, activityName, processedActivity);
+        }
+    }
+    if (!targetWidget->hasIcon()) {
+        query.emptyMask |= ActionEmbeddingIndex::attributeBit(ActionEmbeddingIndex::ICON);
+    } else if (loaded->hasClip()) {
+        query.vectors[ActionEmbeddingIndex::ICON] = getIconEmbedding(targetWidget->getIconBase64());
+    }
+    return true;
+}
+
 // 基于属性的相似度计算（支持序列化数据）
 double ActionSimilarity::calculateSimilarity(
     const std::string& text1, const std::string& activityName1, const std::string& resourceId1, const std::string& iconBase64_1,
-    const std::string& text2, const std::string& activityName2, const std::string& resourceId2, const std::string& iconBase64_2) {
+    const std::string& text2, const std::string& activityName2, const std::string& resourceId2, const std::string& iconBase64_2,
+    const SimilarityEmbeddings& embeddings2, double threshold) {
 
-    BLOG("开始基于属性计算相似度");
+    BLOG("开始基于属性计算相似度，阈值: %.2f", threshold);
     
     try {
-    // 计算各个属性的相似度
-        double textSim = 0.0;
-        try {
-            textSim = calculateTextSimilarity(text1, text2);
-            BLOG("text相似度: %f ('%s' vs '%s')", textSim, text1.c_str(), text2.c_str());
-        } catch (const std::exception& e) {
-            BLOGE("计算text相似度时发生错误: %s", e.what());
-            // 如果BERT模型不可用，使用简单的字符串比较
-            if (text1 == text2) {
-                textSim = 1.0;
-            } else if (text1.find(text2) != std::string::npos || text2.find(text1) != std::string::npos) {
-                textSim = 0.8;
-            } else {
-                textSim = 0.0;
-            }
-            BLOG("使用备用方法计算text相似度: %f", textSim);
+    // 加权平均的权重：没有图标时调整其他权重
+    bool hasIcon2 = !iconBase64_2.empty() || !embeddings2.icon.empty();
+    bool compareIcons = !iconBase64_1.empty() && hasIcon2;
+    SimilarityWeights weights = attributeWeights(compareIcons);
+    SimilarityComponent activity = {"activity", weights.activityName, false, 0.0, 1.0, -1.0};
+    SimilarityComponent resourceId = {"resourceId", weights.resourceId, false, 0.0, 1.0, -1.0};
+    SimilarityComponent text = {"text", weights.text, false, 0.0, 1.0, -1.0};
+    SimilarityComponent icon = {"icon", weights.icon, false, 0.0, 1.0, -1.0};
+    if (!compareIcons) {
+        BLOG("跳过图标相似度计算，至少一个图标数据为空");
+        icon.resolve(0.0);
+    }
+
+    // 第一级：空值与（归一化后）相等直接得出结果，不需要模型；其余分量用字符n-gram相似度估计上界
+    bool hasText2 = !text2.empty() || !embeddings2.text.empty();
+    if (text1.empty() || !hasText2) {
+        text.resolve((text1.empty() && !hasText2) ? 1.0 : 0.0);
+    } else if (!text2.empty()) {
+        if (text1 == text2 || normalizeWhitespace(text1) == normalizeWhitespace(text2)) {
+            text.resolve(1.0);
+        } else {
+            text.lexical = lexicalSimilarity(text1, text2);
+            text.upperBound = lexicalUpperBound(EmbeddingKind::Text, text.lexical);
         }
+    }
 
-        double resourceIdSim = 0.0;
-        try {
-            resourceIdSim = calculateResourceIdSimilarity(resourceId1, resourceId2);
-            BLOG("resourceId相似度: %f ('%s' vs '%s')", resourceIdSim, resourceId1.c_str(), resourceId2.c_str());
-        } catch (const std::exception& e) {
-            BLOGE("计算resourceId相似度时发生错误: %s", e.what());
-            // 如果BERT模型不可用，使用简单的字符串比较
-            if (resourceId1 == resourceId2) {
-                resourceIdSim = 1.0;
-            } else if (resourceId1.find(resourceId2) != std::string::npos || resourceId2.find(resourceId1) != std::string::npos) {
-                resourceIdSim = 0.8;
+    bool hasResourceId2 = !resourceId2.empty() || !embeddings2.resourceId.empty();
+    std::string processedId1;
+    if (resourceId1.empty() || !hasResourceId2) {
+        resourceId.resolve((resourceId1.empty() && !hasResourceId2) ? 1.0 : 0.0);
+    } else if (resourceId1 == resourceId2) {
+        resourceId.resolve(1.0);
+    } else {
+        processedId1 = preprocessResourceId(resourceId1);
+        if (resourceId2.empty()) {
+            // 只有保存的向量：预处理后为空的resource-id不会有向量
+            if (processedId1.empty()) resourceId.resolve(0.0);
+        } else {
+            std::string processedId2 = preprocessResourceId(resourceId2);
+            if (processedId1.empty() || processedId2.empty()) {
+                resourceId.resolve((processedId1.empty() && processedId2.empty()) ? 1.0 : 0.0);
+            } else if (processedId1 == processedId2) {
+                resourceId.resolve(1.0);
             } else {
-                resourceIdSim = 0.0;
+                resourceId.lexical = lexicalSimilarity(processedId1, processedId2);
+                resourceId.upperBound = lexicalUpperBound(EmbeddingKind::ResourceId, resourceId.lexical);
             }
-            BLOG("使用备用方法计算resourceId相似度: %f", resourceIdSim);
         }
+    }
 
-        double activitySim = 0.0;
-        try {
-            activitySim = calculateActivitySimilarity(activityName1, activityName2);
-            BLOG("activity相似度: %f ('%s' vs '%s')", activitySim, activityName1.c_str(), activityName2.c_str());
-        } catch (const std::exception& e) {
-            BLOGE("计算activity相似度时发生错误: %s", e.what());
-            // 如果BERT模型不可用，使用简单的字符串比较
-            if (activityName1 == activityName2) {
-                activitySim = 1.0;
+    bool hasActivity2 = !activityName2.empty() || !embeddings2.activityName.empty();
+    if (activityName1.empty() || !hasActivity2) {
+        activity.resolve((activityName1.empty() && !hasActivity2) ? 1.0 : 0.0);
+    } else if (activityName1 == activityName2) {
+        activity.resolve(1.0);
+    } else {
+        std::string processedActivity1 = preprocessActivityName(activityName1);
+        if (activityName2.empty()) {
+            if (processedActivity1.empty()) activity.resolve(0.0);
+        } else {
+            std::string processedActivity2 = preprocessActivityName(activityName2);
+            if (processedActivity1.empty() || processedActivity2.empty()) {
+                activity.resolve((processedActivity1.empty() && processedActivity2.empty()) ? 1.0 : 0.0);
+            } else if (processedActivity1 == processedActivity2) {
+                activity.resolve(1.0);
             } else {
-                activitySim = 0.0;
+                activity.lexical = lexicalSimilarity(processedActivity1, processedActivity2);
+                activity.upperBound = lexicalUpperBound(EmbeddingKind::ActivityName, activity.lexical);
             }
-            BLOG("使用备用方法计算activity相似度: %f", activitySim);
         }
+    }
+
+    if (compareIcons && !iconBase64_2.empty() && iconBase64_1 == iconBase64_2) {
+        icon.resolve(1.0);
+    }
 
-    // 计算图标相似度（直接使用base64字符串，适用于外部模型匹配）
-    double iconSim = 0.0;
-    if (!iconBase64_1.empty() && !iconBase64_2.empty()) {
+    // 第二级：按代价从低到高计算模型分量（三个BERT分量通常命中嵌入缓存，CLIP最贵放最后），
+    // 每算完一个就更新可达到的最高分，已不可能达到阈值时提前结束
+    SimilarityComponent* ordered[] = {&activity, &resourceId, &text, &icon};
+    const size_t componentCount = sizeof(ordered) / sizeof(ordered[0]);
+    for (size_t i = 0; i <= componentCount; ++i) {
+        double upperBound = achievableScore(ordered, componentCount);
+        if (upperBound < threshold) {
+            BLOG("可达到的最高相似度%.3f低于阈值%.2f，提前结束（已跳过%zu个模型分量）", upperBound, threshold,
+                 static_cast<size_t>(std::count_if(ordered, ordered + componentCount,
+                                                   [](const SimilarityComponent* c) { return !c->resolved; })));
+            return upperBound;
+        }
+        if (i == componentCount) break;
+
+        SimilarityComponent& component = *ordered[i];
+        if (component.resolved) continue;
+        if (&component == &activity) {
             try {
-        iconSim = calculateIconSimilarity(iconBase64_1, iconBase64_2);
-        BLOG("icon相似度: %f", iconSim);
+                activity.resolve(calculateActivitySimilarity(activityName1, activityName2, embeddings2.activityName));
+                if (activity.lexical >= 0.0) recordLexicalGap(EmbeddingKind::ActivityName, activity.lexical, activity.value);
             } catch (const std::exception& e) {
-                BLOGE("计算图标相似度时发生错误: %s", e.what());
+                BLOGE("计算activity相似度时发生错误: %s", e.what());
+                // 如果BERT模型不可用，使用简单的字符串比较
+                activity.resolve(activityName1 == activityName2 ? 1.0 : 0.0);
+            }
+        } else if (&component == &resourceId) {
+            try {
+                resourceId.resolve(calculateResourceIdSimilarity(resourceId1, resourceId2, embeddings2.resourceId));
+                if (resourceId.lexical >= 0.0) recordLexicalGap(EmbeddingKind::ResourceId, resourceId.lexical, resourceId.value);
+            } catch (const std::exception& e) {
+                BLOGE("计算resourceId相似度时发生错误: %s", e.what());
+                // 如果BERT模型不可用，使用简单的字符串比较
+                if (resourceId1 == resourceId2) {
+                    resourceId.resolve(1.0);
+                } else if (resourceId1.find(resourceId2) != std::string::npos || resourceId2.find(resourceId1) != std::string::npos) {
+                    resourceId.resolve(0.8);
+                } else {
+                    resourceId.resolve(0.0);
+                }
+            }
+        } else if (&component == &text) {
+            try {
+                text.resolve(calculateTextSimilarity(text1, text2, embeddings2.text));
+                if (text.lexical >= 0.0) recordLexicalGap(EmbeddingKind::Text, text.lexical, text.value);
+            } catch (const std::exception& e) {
+                BLOGE("计算text相似度时发生错误: %s", e.what());
+                // 如果BERT模型不可用，使用简单的字符串比较
+                if (text1 == text2) {
+                    text.resolve(1.0);
+                } else if (text1.find(text2) != std::string::npos || text2.find(text1) != std::string::npos) {
+                    text.resolve(0.8);
+                } else {
+                    text.resolve(0.0);
+                }
             }
         } else {
-            BLOG("跳过图标相似度计算，至少一个图标数据为空");
-    }
-
-    // 加权平均计算最终相似度
-    double weightText = 0.35;
-    double weightResourceId = 0.2;
-    double weightActivity = 0.1;
-    double weightIcon = 0.35;
-
-    // 如果没有图标，调整其他权重
-    if (iconBase64_1.empty() || iconBase64_2.empty()) {
-        weightText = 0.4;
-        weightResourceId = 0.2;
-        weightActivity = 0.4;
-        weightIcon = 0.0;
-            BLOG("无图标数据，调整权重: text=%.2f, resourceId=%.2f, activity=%.2f", 
-                 weightText, weightResourceId, weightActivity);
-        } else {
-            BLOG("有图标数据，使用标准权重: text=%.2f, resourceId=%.2f, activity=%.2f, icon=%.2f", 
-                 weightText, weightResourceId, weightActivity, weightIcon);
+            // 计算图标相似度（直接使用base64字符串，适用于外部模型匹配；外部模型保存了图标向量时可以没有base64）
+            try {
+                icon.resolve(calculateIconSimilarity(iconBase64_1, iconBase64_2, embeddings2.icon));
+            } catch (const std::exception& e) {
+                BLOGE("计算图标相似度时发生错误: %s", e.what());
+                icon.resolve(0.0);
+            }
+        }
+        BLOG("%s相似度: %f", component.name, component.value);
     }
 
-    double similarity = weightText * textSim +
-                        weightResourceId * resourceIdSim +
-                        weightActivity * activitySim +
-                        weightIcon * iconSim;
+    double similarity = text.weight * text.value +
+                        resourceId.weight * resourceId.value +
+                        activity.weight * activity.value +
+                        icon.weight * icon.value;
 
         BLOG("最终相似度: %f = %.2f*%.3f + %.2f*%.3f + %.2f*%.3f + %.2f*%.3f", 
-             similarity, weightText, textSim, weightResourceId, resourceIdSim, 
-             weightActivity, activitySim, weightIcon, iconSim);
+             similarity, text.weight, text.value, resourceId.weight, resourceId.value,
+             activity.weight, activity.value, icon.weight, icon.value);
     return similarity;
     } catch (const std::exception& e) {
         BLOGE("计算相似度过程中发生异常: %s", e.what());
@@ -1162,7 +1670,8 @@ double ActionSimilarity::calculateSimilarity(
 // 混合相似度计算：当前对象 vs 外部模型数据（用于外部模型匹配）
 double ActionSimilarity::calculateSimilarity(const WidgetPtr& currentWidget, const std::string& currentActivityName,
                                              const std::string& externalText, const std::string& externalActivityName,
-                                             const std::string& externalResourceId, const std::string& externalIconBase64) {
+                                             const std::string& externalResourceId, const std::string& externalIconBase64,
+                                             const SimilarityEmbeddings& externalEmbeddings, double threshold) {
     if (!currentWidget) {
         return 0.0;
     }
@@ -1178,13 +1687,15 @@ double ActionSimilarity::calculateSimilarity(const WidgetPtr& currentWidget, con
 
     // 调用基于属性的相似度计算
     return calculateSimilarity(currentText, currentActivityName, currentResourceId, currentIconBase64,
-                              externalText, externalActivityName, externalResourceId, externalIconBase64);
+                              externalText, externalActivityName, externalResourceId, externalIconBase64,
+                              externalEmbeddings, threshold);
 }
 
 // 混合相似度计算：当前action对象 vs 外部模型数据（用于外部模型匹配）
 double ActionSimilarity::calculateSimilarity(const ActivityNameActionPtr& currentAction,
                                              const std::string& externalText, const std::string& externalActivityName,
-                                             const std::string& externalResourceId, const std::string& externalIconBase64) {
+                                             const std::string& externalResourceId, const std::string& externalIconBase64,
+                                             const SimilarityEmbeddings& externalEmbeddings, double threshold) {
     BLOG("开始计算相似度: currentAction vs 外部模型数据");
     
     if (!currentAction) {
@@ -1225,7 +1736,8 @@ double ActionSimilarity::calculateSimilarity(const ActivityNameActionPtr& curren
     try {
     // 调用基于属性的相似度计算
         double similarity = calculateSimilarity(currentText, currentActivityName, currentResourceId, currentIconBase64,
-                              externalText, externalActivityName, externalResourceId, externalIconBase64);
+                              externalText, externalActivityName, externalResourceId, externalIconBase64,
+                              externalEmbeddings, threshold);
         
         BLOG("计算相似度结果: %.3f", similarity);
         return similarity;
@@ -1270,6 +1782,21 @@ double ActionSimilarity::calculateSimilarity(const ActivityNameActionPtr& curren
     }
 }
 
+std::vector<float> ActionSimilarity::getClipEmbedding(const WidgetIconPtr& icon) {
+    std::vector<float> embedding;
+    if (!icon || icon->isEmpty()) {
+        return embedding;
+    }
+
+    // 模型仍在后台加载或加载失败时直接返回空向量
+    SimilarityEnginePtr loaded = acquireEngine();
+    if (!loaded || !loaded->hasClip()) {
+        return embedding;
+    }
+    loaded->clipEmbedding(icon->getIcon(), embedding);
+    return embedding;
+}
+
 double ActionSimilarity::calculateIconSimilarity(const WidgetIconPtr& icon1, const WidgetIconPtr& icon2) {
     if (!icon1 || !icon2 || icon1->isEmpty() || icon2->isEmpty()) {
         BLOGE("图标数据无效，无法计算相似度");
@@ -1278,75 +1805,29 @@ double ActionSimilarity::calculateIconSimilarity(const WidgetIconPtr& icon1, con
 
     try {
         BLOG("开始计算图标相似度");
-        
-        // 确保模型已初始化
-        if (!clipSession) {
-            BLOG("CLIP模型未初始化，开始初始化");
-            initializeModels();
+
+        double perceptualSim = 0.0;
+        if (perceptualIconSimilarity(icon1->getFingerprint(), icon2->getFingerprint(), perceptualSim)) {
+            return perceptualSim;
         }
 
-        // 获取图标数据
-        cv::Mat img1 = icon1->getIcon();
-        cv::Mat img2 = icon2->getIcon();
-        BLOG("获取到两个图标的图像数据，尺寸分别为: %dx%d 和 %dx%d", 
-              img1.cols, img1.rows, img2.cols, img2.rows);
-
-        // 转换为张量
-        std::vector<float> tensor1 = WidgetIcon::mat_to_tensor(img1);
-        std::vector<float> tensor2 = WidgetIcon::mat_to_tensor(img2);
-        BLOG("图像数据转换为张量完成，大小分别为: %zu 和 %zu", 
-              tensor1.size(), tensor2.size());
-
-        // 创建输入张量
-        std::vector<Ort::Value> inputTensors1;
-        std::vector<Ort::Value> inputTensors2;
-        
-        // 设置输入形状
-        std::vector<int64_t> inputShape = {1, 3, 224, 224};
-        
-        // 创建内存分配器
-        Ort::MemoryInfo memoryInfo = Ort::MemoryInfo::CreateCpu(
-            OrtArenaAllocator, OrtMemTypeDefault);
-
-        // 创建输入张量
-        inputTensors1.push_back(Ort::Value::CreateTensor<float>(
-            memoryInfo, tensor1.data(), tensor1.size(),
-            inputShape.data(), inputShape.size()));
-            
-        inputTensors2.push_back(Ort::Value::CreateTensor<float>(
-            memoryInfo, tensor2.data(), tensor2.size(),
-            inputShape.data(), inputShape.size()));
-            
-        BLOG("创建输入张量完成");
-
-        // 运行模型
-        auto output1 = clipSession->Run(
-            Ort::RunOptions{nullptr}, 
-            clipInputNames.data(), 
-            inputTensors1.data(), 
-            1, 
-            clipOutputNames.data(), 
-            1);
-            
-        auto output2 = clipSession->Run(
-            Ort::RunOptions{nullptr}, 
-            clipInputNames.data(), 
-            inputTensors2.data(), 
-            1, 
-            clipOutputNames.data(), 
-            1);
-            
+        std::vector<float> embedding1, embedding2;
+        if (!iconEmbeddingCache.find(icon1->getFingerprint().contentHash, embedding1)) {
+            embedding1 = getClipEmbedding(icon1);
+            storeIconEmbedding(icon1->getFingerprint().contentHash, embedding1);
+        }
+        if (!iconEmbeddingCache.find(icon2->getFingerprint().contentHash, embedding2)) {
+            embedding2 = getClipEmbedding(icon2);
+            storeIconEmbedding(icon2->getFingerprint().contentHash, embedding2);
+        }
         BLOG("模型推理完成");
 
-        // 获取输出数据
-        float* outputData1 = output1[0].GetTensorMutableData<float>();
-        float* outputData2 = output2[0].GetTensorMutableData<float>();
-        
+        if (embedding1.empty() || embedding1.size() != embedding2.size()) {
+            return 0.0;
+        }
+
         // 计算余弦相似度
-        double similarity = calculateCosineSimilarity(
-            outputData1, outputData2, output1[0].GetTensorTypeAndShapeInfo().GetElementCount());
-            
-        return similarity;
+        return calculateCosineSimilarity(embedding1.data(), embedding2.data(), embedding1.size());
     } catch (const std::exception& e) {
         BLOGE("计算图标相似度时发生错误: %s", e.what());
         return 0.0;
@@ -1354,8 +1835,9 @@ double ActionSimilarity::calculateIconSimilarity(const WidgetIconPtr& icon1, con
 }
 
 // 基于base64字符串的图标相似度计算（用于外部模型匹配）
-double ActionSimilarity::calculateIconSimilarity(const std::string& iconBase64_1, const std::string& iconBase64_2) {
-    if (iconBase64_1.empty() || iconBase64_2.empty()) {
+double ActionSimilarity::calculateIconSimilarity(const std::string& iconBase64_1, const std::string& iconBase64_2,
+                                                 const Int8EmbeddingView& stored2) {
+    if (iconBase64_1.empty() || (iconBase64_2.empty() && stored2.empty())) {
         BLOG("base64图标数据为空，无法计算相似度");
         return 0.0;
     }
@@ -1363,17 +1845,38 @@ double ActionSimilarity::calculateIconSimilarity(const std::string& iconBase64_1
     try {
         BLOG("开始计算base64图标相似度");
 
-        // 创建WidgetIcon对象
-        auto icon1 = std::make_shared<WidgetIcon>(iconBase64_1);
-        auto icon2 = std::make_shared<WidgetIcon>(iconBase64_2);
+        // 两边都有图标数据时先用指纹判断，能确定结果就不跑CLIP
+        if (!iconBase64_2.empty()) {
+            IconFingerprint fingerprint1, fingerprint2;
+            double perceptualSim = 0.0;
+            if (getIconFingerprint(iconBase64_1, fingerprint1) && getIconFingerprint(iconBase64_2, fingerprint2) &&
+                perceptualIconSimilarity(fingerprint1, fingerprint2, perceptualSim)) {
+                return perceptualSim;
+            }
+        }
 
-        if (!icon1 || !icon2 || icon1->isEmpty() || icon2->isEmpty()) {
-            BLOGE("无法从base64创建有效的WidgetIcon对象");
+        // 同一个图标在一次运行中会被反复比较，嵌入结果按图标内容缓存
+        std::vector<float> embedding1 = getIconEmbedding(iconBase64_1);
+        if (embedding1.empty()) {
             return 0.0;
         }
 
-        // 调用现有的WidgetIconPtr版本的方法
-        return calculateIconSimilarity(icon1, icon2);
+        if (!stored2.empty()) {
+            double storedSim = 0.0;
+            if (storedEmbeddingSimilarity(embedding1, stored2, storedSim)) {
+                BLOG("使用保存的量化向量计算图标相似度结果: %f", storedSim);
+                return storedSim;
+            }
+            if (iconBase64_2.empty()) {
+                return 0.0;
+            }
+        }
+
+        std::vector<float> embedding2 = getIconEmbedding(iconBase64_2);
+        if (embedding2.empty() || embedding1.size() != embedding2.size()) {
+            return 0.0;
+        }
+        return calculateCosineSimilarity(embedding1.data(), embedding2.data(), embedding1.size());
 
     } catch (const std::exception& e) {
         BLOGE("计算base64图标相似度时发生错误: %s", e.what());
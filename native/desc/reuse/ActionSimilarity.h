@@ -7,8 +7,17 @@
 #ifndef ActionSimilarity_H_
 #define ActionSimilarity_H_
 
+#include "ActionEmbeddingIndex.h"
 #include "ActivityNameAction.h"
+#include "EmbeddingQuantizer.h"
+#include "IconEmbeddingCache.h"
+#include "IconStore.h"
+#include "SimilarityEngine.h"
+#include "WordPieceTokenizer.h"
+#include <atomic>
+#include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <onnxruntime/onnxruntime_cxx_api.h>
 #include <vector>
@@ -20,30 +29,94 @@
 
 namespace fastbotx {
 
+struct InferenceSessionConfig;
+
+// 相似度计算入口，全部为静态接口；模型会话、推理上下文和线程池由SimilarityEngine持有
 class ActionSimilarity {
 public:
-    ActionSimilarity();
-    ~ActionSimilarity();
+    ActionSimilarity() = delete;
+
+    // 嵌入向量对应的属性类型
+    enum class EmbeddingKind {
+        Text = 0,
+        ActivityName = 1,
+        ResourceId = 2,
+        Icon = 3
+    };
 
     // 计算两个action的相似度
     // static double calculateSimilarity(const ActivityNameActionPtr& action1, const ActivityNameActionPtr& action2);
 
     // 基于属性的相似度计算（支持序列化数据）
+    // 级联计算：先用空值/归一化相等直接得出分量，未计算的模型分量以1为上界；
+    // 字符n-gram相似度与模型分数的最大差距在本次运行中校准足够样本后，模型分量的上界收紧为 词法相似度 + 差距。
+    // 然后按代价从低到高运行模型；可达到的最高分低于threshold时提前返回该上界（小于threshold）。
+    // threshold不超过-1时不剪枝，结果与逐项计算一致
     static double calculateSimilarity(
         const std::string& text1, const std::string& activityName1, const std::string& resourceId1, const std::string& iconBase64_1,
-        const std::string& text2, const std::string& activityName2, const std::string& resourceId2, const std::string& iconBase64_2);
-
+        const std::string& text2, const std::string& activityName2, const std::string& resourceId2, const std::string& iconBase64_2,
+        const SimilarityEmbeddings& embeddings2 = SimilarityEmbeddings(), double threshold = -1.0);
 
 
     // 混合相似度计算：当前widget对象 vs 外部模型数据（用于外部模型匹配）
     static double calculateSimilarity(const WidgetPtr& currentWidget, const std::string& currentActivityName,
                                      const std::string& externalText, const std::string& externalActivityName,
-                                     const std::string& externalResourceId, const std::string& externalIconBase64);
+                                     const std::string& externalResourceId, const std::string& externalIconBase64,
+                                     const SimilarityEmbeddings& externalEmbeddings = SimilarityEmbeddings(),
+                                     double threshold = -1.0);
 
     // 混合相似度计算：当前action对象 vs 外部模型数据（用于外部模型匹配）
     static double calculateSimilarity(const ActivityNameActionPtr& currentAction,
                                      const std::string& externalText, const std::string& externalActivityName,
-                                     const std::string& externalResourceId, const std::string& externalIconBase64);
+                                     const std::string& externalResourceId, const std::string& externalIconBase64,
+                                     const SimilarityEmbeddings& externalEmbeddings = SimilarityEmbeddings(),
+                                     double threshold = -1.0);
+
+    // 加权相似度的属性权重：两边都有图标时比较图标，否则图标不参与
+    static SimilarityWeights attributeWeights(bool compareIcons);
+
+    // 按calculateSimilarity的口径取当前action各属性的嵌入向量，用于与外部模型的嵌入矩阵批量比较；
+    // 引擎未加载完成或没有BERT时返回false，调用方退回逐个比较
+    static bool buildEmbeddingQuery(const ActivityNameActionPtr& action, EmbeddingQuery& query);
+
+    // 同上，按widget和给定的activity名称取向量
+    static bool buildEmbeddingQuery(const WidgetPtr& widget, const std::string& activityName, EmbeddingQuery& query);
+
+    // 查询本次运行中已经计算过的属性嵌入的int8量化向量（不触发推理），用于写入复用模型
+    static bool lookupQuantizedEmbedding(EmbeddingKind kind, const std::string& rawValue, Int8Embedding& out);
+
+    // 同上，按IconStore中的图标id查询图标嵌入
+    static bool lookupQuantizedIconEmbedding(IconId iconId, Int8Embedding& out);
+
+    // 按calculateSimilarity的口径推理一个属性的嵌入并量化为int8（文本原样，resource-id和activity取预处理结果），
+    // 用于给没有保存向量的外部模型属性补上向量。BERT属性不进入嵌入缓存；预处理后为空或模型不可用时返回false
+    static bool computeQuantizedEmbedding(EmbeddingKind kind, const std::string& rawValue, Int8Embedding& out);
+
+    // 等待后台加载结束并返回引擎（没有加载时在当前线程加载），加载失败返回nullptr。
+    // 会阻塞，只在工作线程（如外部模型的后台加载）中调用
+    static SimilarityEnginePtr awaitEngine();
+
+    // 在后台线程加载模型和词汇表并各预热推理一次（InitAgent时调用），
+    // 加载完成前的相似度计算直接走字符串回退，不会阻塞首个getAction
+    static void preloadModelsAsync();
+
+    // 预先计算图标嵌入（供图标接入的后台线程调用），模型未加载完成或已缓存时直接返回
+    static void prefetchIconEmbedding(IconId iconId);
+
+    // 把本次运行新算出的图标嵌入写回缓存文件（随复用模型一起保存），没有新条目时不写
+    static void saveIconEmbeddingCache();
+
+    // 已发布的相似度引擎，模型未加载完成时返回nullptr，不会触发加载；
+    // 用于把一批相似度计算分发到引擎的线程池
+    static SimilarityEnginePtr currentEngine();
+
+    // 当前引擎所用相似度模型的标识：BERT与CLIP各自的模型文件标识（int8与fp32变体路径不同），
+    // 模型未加载或不可用时对应部分为0。按相似度得到的持久化结果以此判断是否作废
+    static uint64_t similarityModelsTag();
+
+    // 取消发布当前引擎并停止其线程池（JNI cleanup时调用），正在使用引擎的调用方持有引用直到结束；
+    // 正在后台加载时，加载完成的引擎不再发布而是直接停止。之后不再加载模型
+    static void shutdownEngine();
 
     // 判断两个action是否相似（相似度超过阈值）
     // static bool isSimilar(const ActivityNameActionPtr& action1, const ActivityNameActionPtr& action2, double threshold = 0.8);
@@ -56,65 +129,141 @@ private:
     static bool jiebaReady;
     static void initializeJieba();
 
-    // 计算文本相似度
-    static double calculateTextSimilarity(const std::string& text1, const std::string& text2);
+    // 字符n-gram的Jaccard相似度，不需要模型
+    static double lexicalSimilarity(const std::string& text1, const std::string& text2);
+
+    // 词法相似度 -> 模型分量的上界。每类属性记录已算出的模型分数比词法相似度高出的最大值，
+    // 样本不足时上界为1（不剪枝）
+    struct LexicalCalibration {
+        size_t samples;
+        double maxGap;
+    };
+    static LexicalCalibration lexicalCalibration[3];
+    static std::mutex lexicalCalibrationLock;
+    static double lexicalUpperBound(EmbeddingKind kind, double lexical);
+    static void recordLexicalGap(EmbeddingKind kind, double lexical, double similarity);
+
+    // 计算文本相似度（stored2非空时直接使用模型中保存的量化向量）
+    static double calculateTextSimilarity(const std::string& text1, const std::string& text2,
+                                          const Int8EmbeddingView& stored2 = Int8EmbeddingView());
     
     // 计算资源ID相似度
-    static double calculateResourceIdSimilarity(const std::string& id1, const std::string& id2);
+    static double calculateResourceIdSimilarity(const std::string& id1, const std::string& id2,
+                                                const Int8EmbeddingView& stored2 = Int8EmbeddingView());
     
     // 计算活动名称相似度
-    static double calculateActivitySimilarity(const std::string& activity1, const std::string& activity2);
+    static double calculateActivitySimilarity(const std::string& activity1, const std::string& activity2,
+                                              const Int8EmbeddingView& stored2 = Int8EmbeddingView());
     
     // 计算图标相似度（使用CLIP模型）
     static double calculateIconSimilarity(const WidgetIconPtr& icon1, const WidgetIconPtr& icon2);
 
     // 计算图标相似度（基于base64字符串，用于外部模型匹配）
-    static double calculateIconSimilarity(const std::string& iconBase64_1, const std::string& iconBase64_2);
+    static double calculateIconSimilarity(const std::string& iconBase64_1, const std::string& iconBase64_2,
+                                          const Int8EmbeddingView& stored2 = Int8EmbeddingView());
+
+    // 加载完成后发布的引擎（通过std::atomic_load/atomic_store访问），引擎中的会话仍可能为空
+    // （模型文件缺失或加载失败）；词表和分词器在发布前初始化，之后只读
+    static SimilarityEnginePtr engine;
+
+    // 模型加载状态；SHUTDOWN为终态，引擎停止后不再加载模型，相似度计算一律走字符串回退
+    static const int MODEL_LOAD_IDLE = 0;
+    static const int MODEL_LOAD_RUNNING = 1;
+    static const int MODEL_LOAD_DONE = 2;
+    static const int MODEL_LOAD_SHUTDOWN = 3;
+    static std::atomic<int> modelLoadState;
+
+    // 按max.config中的会话策略创建模型会话和引擎，失败的模型对应会话为空
+    static SimilarityEnginePtr createEngine(const InferenceSessionConfig& config);
+
+    // 加载词汇表、分词词典和模型并发布引擎，调用方需先把状态置为MODEL_LOAD_RUNNING
+    static void loadModels(const InferenceSessionConfig& config, bool warmUp);
+
+    static void warmUpModels(const SimilarityEnginePtr& loaded);
+
+    // 返回可用的引擎；后台加载中返回nullptr，未加载时在当前线程同步加载
+    static SimilarityEnginePtr acquireEngine();
 
-    // BERT模型相关
-    static Ort::Session* bertSession;
-    static std::vector<const char*> bertInputNames;
-    static std::vector<const char*> bertOutputNames;
-    static std::vector<int64_t> bertInputShape;
-    
-    // CLIP模型相关
-    static Ort::Session* clipSession;
-    static std::vector<const char*> clipInputNames;
-    static std::vector<const char*> clipOutputNames;
-    static std::vector<int64_t> clipInputShape;
-    
-    // 初始化模型
-    static void initializeModels();
-    
     // 使用BERT模型获取文本的嵌入向量
     static std::vector<float> getBertEmbedding(const std::string& text);
 
-    // 文本预处理相关
-    static std::unordered_map<std::string, int64_t> vocabMap;  // 词汇表映射
+    // 不检查加载状态的BERT推理，调用方保证引擎中有BERT会话
+    static std::vector<float> computeBertEmbedding(const SimilarityEnginePtr& loaded, const std::string& text);
+
+    // 使用CLIP模型获取图标的嵌入向量
+    static std::vector<float> getClipEmbedding(const WidgetIconPtr& icon);
+
+    // 属性嵌入缓存：(属性类型, 原始值) -> 模型输出，避免重复推理。
+    // 超出容量时淘汰最久未使用的条目；键为类型字节加原始值，不同类型的同一字符串互不冲突
+    struct CachedEmbedding {
+        std::vector<float> embedding;
+        std::list<std::string>::iterator position;
+    };
+    static std::unordered_map<std::string, CachedEmbedding> embeddingCache;
+    // 队首为最近使用
+    static std::list<std::string> embeddingCacheOrder;
+    static std::mutex embeddingCacheLock;
+    static const size_t MAX_EMBEDDING_CACHE_SIZE = 2048;
+    // 本次运行推理过的属性的int8量化向量，键同上，不随缓存淘汰：保存复用模型时从这里取向量写入新记录。
+    // 条目数有上限，超出后不再记录（之后新出现的值保存时没有向量，下次运行重新推理）
+    static std::unordered_map<std::string, Int8Embedding> quantizedEmbeddings;
+    // 同上，图标按内容哈希记录
+    static std::unordered_map<uint64_t, Int8Embedding> quantizedIconEmbeddings;
+    static const size_t MAX_QUANTIZED_EMBEDDINGS = 65536;
+    static std::string embeddingCacheKey(EmbeddingKind kind, const std::string& rawValue);
+    static bool findCachedEmbedding(EmbeddingKind kind, const std::string& rawValue, std::vector<float>& out);
+    static void storeCachedEmbedding(EmbeddingKind kind, const std::string& rawValue, const std::vector<float>& embedding);
+
+    // 带缓存的文本类属性嵌入，processedValue为送入BERT的预处理结果
+    static std::vector<float> getAttributeEmbedding(EmbeddingKind kind, const std::string& rawValue,
+                                                    const std::string& processedValue);
+    // 带缓存的图标嵌入：先由base64查到图标指纹，再按内容哈希查LRU缓存，都未命中才跑CLIP
+    static std::vector<float> getIconEmbedding(const std::string& iconBase64);
+
+    // 图标嵌入按解码后字节的内容哈希缓存，容量和持久化由max.config控制
+    static IconEmbeddingCache iconEmbeddingCache;
+    // 缓存文件位置与生成向量的CLIP模型标识（模型路径、大小、修改时间），模型变化后旧缓存自动作废
+    static std::string iconEmbeddingCachePath;
+    static uint64_t clipModelTag;
+    // 同上，BERT模型的标识
+    static uint64_t bertModelTag;
+    static void loadIconEmbeddingCache();
+    // 写入图标嵌入缓存并记录量化向量
+    static void storeIconEmbedding(uint64_t contentHash, const std::vector<float>& embedding);
+
+    // base64 -> 图标指纹：图标登记到IconStore，同一图标只解码一次
+    static bool getIconFingerprint(const std::string& iconBase64, IconFingerprint& fingerprint,
+                                   IconId* iconId = nullptr);
+
+    // 感知哈希预筛选：内容相同或汉明距离足够小时视为同一图标，足够大时视为不同图标，无需CLIP；
+    // 返回false表示需要模型判断
+    static bool perceptualIconSimilarity(const IconFingerprint& fingerprint1, const IconFingerprint& fingerprint2,
+                                         double& similarity);
+
+    // 当前向量与模型中保存的量化向量的相似度，维度不一致或向量无效时返回false
+    static bool storedEmbeddingSimilarity(const std::vector<float>& current, const Int8EmbeddingView& stored,
+                                          double& similarity);
+
+    // 文本预处理相关：词表保存在WordPiece分词器的trie中
+    static WordPieceTokenizerPtr tokenizer;
     static const int64_t UNK_TOKEN_ID = 100;  // 未知token的ID
     static const int64_t CLS_TOKEN_ID = 101;  // 分类token的ID
     static const int64_t SEP_TOKEN_ID = 102;  // 分隔token的ID
     static const int64_t PAD_TOKEN_ID = 0;    // 填充token的ID
+    // 英文/标识符的切词分隔符（空白之外），用于英文、resource-id、activity
+    static const char* const ENGLISH_WORD_DELIMITERS;
 
     // 初始化词汇表
     static void initializeVocab();
     
-    // 对文本进行分词
-    static std::vector<std::string> tokenize(const std::string& text);
-    
-    // WordPiece分词辅助函数
-    static std::vector<std::string> wordPieceTokenize(const std::string& word);
-    
-    // 将token转换为ID
-    static std::vector<int64_t> convertTokensToIds(const std::vector<std::string>& tokens);
+    // 对文本分词，token id追加到ids
+    static void tokenize(const std::string& text, std::vector<int64_t>& ids);
     
-    // 预处理文本（分词并转换为ID）
-    static std::vector<int64_t> preprocessText(const std::string& text);
+    // 预处理文本（[CLS] + token + [SEP]，截断并填充到模型输入长度maxLength）
+    static std::vector<int64_t> preprocessText(const std::string& text, size_t maxLength);
 
     // 工具：判断是否包含中文（UTF-8 非ASCII)
     static bool containsChineseUTF8(const std::string& text);
-    // 工具：英文/标识符样式拆分（用于英文、resource-id、activity）
-    static std::vector<std::string> splitEnglishLike(const std::string& text);
     // 工具：拆分驼峰命名
     static std::vector<std::string> splitCamelCase(const std::string& text);
     
@@ -0,0 +1,180 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef CountMinSketch_CPP_
+#define CountMinSketch_CPP_
+
+#include "CountMinSketch.h"
+#ifdef FASTBOT_HOST_TOOL
+#include "../../tools/MergeLog.h"
+#else
+#include "../utils.hpp"
+#endif
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace fastbotx {
+
+static const char SKETCH_MAGIC[8] = {'F', 'B', 'S', 'K', 'E', 'T', 'C', 'H'};
+static const uint32_t SKETCH_VERSION = 1;
+
+struct SketchFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t depth;
+    uint64_t width;
+    uint64_t sequence;
+};
+
+static uint64_t mixKey(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+CountMinSketch::CountMinSketch(size_t width, size_t depth)
+        : _width(std::max<size_t>(1, width)), _depth(std::max<size_t>(1, depth)), _cells(_width * _depth, 0) {
+}
+
+size_t CountMinSketch::cellIndex(size_t row, uint64_t key) const {
+    // 每行用不同的种子重新混合，行间的哈希相互独立
+    return row * _width + static_cast<size_t>(mixKey(key + (row + 1) * 0x9e3779b97f4a7c15ULL) % _width);
+}
+
+void CountMinSketch::add(uint64_t key, uint32_t amount) {
+    if (0 == amount) {
+        return;
+    }
+    uint32_t current = estimate(key);
+    raise(key, current > std::numeric_limits<uint32_t>::max() - amount
+               ? std::numeric_limits<uint32_t>::max() : current + amount);
+}
+
+void CountMinSketch::raise(uint64_t key, uint32_t value) {
+    for (size_t row = 0; row < _depth; ++row) {
+        uint32_t &cell = _cells[cellIndex(row, key)];
+        cell = std::max(cell, value);
+    }
+}
+
+uint32_t CountMinSketch::estimate(uint64_t key) const {
+    uint32_t value = std::numeric_limits<uint32_t>::max();
+    for (size_t row = 0; row < _depth; ++row) {
+        value = std::min(value, _cells[cellIndex(row, key)]);
+    }
+    return value;
+}
+
+void CountMinSketch::decay(double factor) {
+    for (uint32_t &cell : _cells) {
+        cell = static_cast<uint32_t>(cell * factor);
+    }
+}
+
+bool CountMinSketch::save(const std::string &modelPath, uint64_t sequence) const {
+    std::string path = modelPath + ".sketch";
+    std::string tempPath = path + ".tmp";
+    SketchFileHeader header{};
+    memcpy(header.magic, SKETCH_MAGIC, sizeof(header.magic));
+    header.version = SKETCH_VERSION;
+    header.depth = static_cast<uint32_t>(_depth);
+    header.width = _width;
+    header.sequence = sequence;
+    std::ofstream out(tempPath, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(_cells.data()), static_cast<std::streamsize>(byteSize()));
+    out.close();
+    if (!out.good() || 0 != std::rename(tempPath.c_str(), path.c_str())) {
+        BLOGE("save count-min sketch to %s failed", path.c_str());
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// 读取sketch文件的头部和计数器；序号与快照不一致时返回false
+static bool readSketchFile(const std::string &path, uint64_t sequence, SketchFileHeader &header,
+                           std::vector<uint32_t> &cells) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!in.good() || 0 != memcmp(header.magic, SKETCH_MAGIC, sizeof(header.magic)) ||
+        SKETCH_VERSION != header.version || 0 == header.depth || 0 == header.width) {
+        BLOGE("count-min sketch %s is invalid", path.c_str());
+        return false;
+    }
+    if (header.sequence != sequence) {
+        BLOG("count-min sketch %s does not match (%llu x %u, sequence %llu), ignored", path.c_str(),
+             (unsigned long long) header.width, header.depth, (unsigned long long) header.sequence);
+        return false;
+    }
+    // 尺寸来自文件，先与文件长度核对再分配
+    std::streamoff cellsOffset = in.tellg();
+    in.seekg(0, std::ios::end);
+    uint64_t cellBytes = static_cast<uint64_t>(in.tellg() - cellsOffset);
+    in.seekg(cellsOffset);
+    if (header.width > cellBytes / sizeof(uint32_t) / header.depth) {
+        BLOGE("count-min sketch %s is truncated", path.c_str());
+        return false;
+    }
+    cells.resize(static_cast<size_t>(header.width) * header.depth);
+    in.read(reinterpret_cast<char *>(cells.data()), static_cast<std::streamsize>(cells.size() * sizeof(uint32_t)));
+    if (!in.good()) {
+        BLOGE("count-min sketch %s is truncated", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool CountMinSketch::load(const std::string &modelPath, uint64_t sequence) {
+    std::string path = modelPath + ".sketch";
+    SketchFileHeader header{};
+    std::vector<uint32_t> cells;
+    if (!readSketchFile(path, sequence, header, cells)) {
+        return false;
+    }
+    if (header.depth != _depth || header.width != _width) {
+        BLOG("count-min sketch %s does not match (%llu x %u, sequence %llu), ignored", path.c_str(),
+             (unsigned long long) header.width, header.depth, (unsigned long long) header.sequence);
+        return false;
+    }
+    _cells.swap(cells);
+    return true;
+}
+
+CountMinSketchPtr CountMinSketch::loadSnapshot(const std::string &modelPath, uint64_t sequence) {
+    SketchFileHeader header{};
+    std::vector<uint32_t> cells;
+    if (!readSketchFile(modelPath + ".sketch", sequence, header, cells)) {
+        return nullptr;
+    }
+    auto sketch = std::make_shared<CountMinSketch>(static_cast<size_t>(header.width), header.depth);
+    sketch->_cells.swap(cells);
+    return sketch;
+}
+
+bool CountMinSketch::merge(const CountMinSketch &other) {
+    if (other._width != _width || other._depth != _depth) {
+        return false;
+    }
+    for (size_t i = 0; i < _cells.size(); ++i) {
+        _cells[i] = other._cells[i] > std::numeric_limits<uint32_t>::max() - _cells[i]
+                    ? std::numeric_limits<uint32_t>::max() : _cells[i] + other._cells[i];
+    }
+    return true;
+}
+
+} // namespace fastbotx
+
+#endif // CountMinSketch_CPP_
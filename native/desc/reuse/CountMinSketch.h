@@ -0,0 +1,68 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef CountMinSketch_H_
+#define CountMinSketch_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fastbotx {
+
+// 固定大小的count-min sketch：depth行、每行width个计数器，估计值不小于真实计数，
+// 超出的部分随width增大而减小。用保守更新（只增加各行中最小的计数器）降低高估。不是线程安全的
+class CountMinSketch {
+public:
+    CountMinSketch(size_t width, size_t depth);
+
+    void add(uint64_t key, uint32_t amount);
+
+    uint32_t estimate(uint64_t key) const;
+
+    // 把key的估计值提高到不小于value：从精确计数中移出的key回到sketch时使用，
+    // 不会与它之前留在sketch中的计数重复累加
+    void raise(uint64_t key, uint32_t value);
+
+    // 所有计数乘以factor（向下取整），用于老化
+    void decay(double factor);
+
+    size_t width() const { return _width; }
+
+    size_t depth() const { return _depth; }
+
+    size_t byteSize() const { return _cells.size() * sizeof(uint32_t); }
+
+    // 与模型快照一起保存在 <模型路径>.sketch；sequence为快照中已合并的日志序号。
+    // 写临时文件再rename
+    bool save(const std::string &modelPath, uint64_t sequence) const;
+
+    // 文件不存在、损坏、尺寸与当前配置不同或序号与快照不一致时返回false，计数保持不变
+    bool load(const std::string &modelPath, uint64_t sequence);
+
+    // 按文件中记录的尺寸读取 <模型路径>.sketch，用于合并多台设备的模型；
+    // 文件不存在、损坏或序号与快照不一致时返回nullptr
+    static std::shared_ptr<CountMinSketch> loadSnapshot(const std::string &modelPath, uint64_t sequence);
+
+    // 逐个计数器相加（不超过uint32上限），两个sketch的尺寸不同时返回false，计数保持不变。
+    // 对同一组key，相加后的估计值不小于各自真实计数之和
+    bool merge(const CountMinSketch &other);
+
+private:
+    size_t cellIndex(size_t row, uint64_t key) const;
+
+    size_t _width;
+    size_t _depth;
+    std::vector<uint32_t> _cells;
+};
+
+typedef std::shared_ptr<CountMinSketch> CountMinSketchPtr;
+
+} // namespace fastbotx
+
+#endif // CountMinSketch_H_
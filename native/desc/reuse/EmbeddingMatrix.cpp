@@ -0,0 +1,399 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef EmbeddingMatrix_CPP_
+#define EmbeddingMatrix_CPP_
+
+#include "EmbeddingMatrix.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__AVX2__) || defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+namespace fastbotx {
+
+namespace {
+    // 分块大小：一个行块在一个维度块内为64 × 256个元素（fp32为64KB），与当前查询块一起留在L2中
+    const size_t ROW_BLOCK = 64;
+    const size_t DEPTH_BLOCK = 256;
+    // 微块：2个查询 × 4行，8个累加器加上4个行向量、1个查询向量不超过16个寄存器
+    const size_t TILE_QUERIES = 2;
+    const size_t TILE_ROWS = 4;
+
+    uint16_t floatToHalf(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000u;
+        uint32_t biased = (bits >> 23) & 0xffu;
+        uint32_t mantissa = bits & 0x7fffffu;
+        if (0xffu == biased) {
+            return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+        }
+        int32_t exponent = static_cast<int32_t>(biased) - 127 + 15;
+        if (exponent >= 31) {
+            return static_cast<uint16_t>(sign | 0x7c00u);
+        }
+        if (exponent <= 0) {
+            // 非规格化数，太小的值直接为0
+            if (exponent < -10) {
+                return static_cast<uint16_t>(sign);
+            }
+            mantissa |= 0x800000u;
+            auto shift = static_cast<uint32_t>(14 - exponent);
+            uint32_t half = mantissa >> shift;
+            uint32_t remainder = mantissa & ((1u << shift) - 1u);
+            uint32_t middle = 1u << (shift - 1u);
+            if (remainder > middle || (remainder == middle && (half & 1u))) {
+                ++half;
+            }
+            return static_cast<uint16_t>(sign | half);
+        }
+        uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+        uint32_t remainder = mantissa & 0x1fffu;
+        // 就近舍入到偶数，进位溢出到指数位时结果仍然正确
+        if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+            ++half;
+        }
+        return static_cast<uint16_t>(half);
+    }
+
+    float halfToFloat(uint16_t half) {
+        uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+        uint32_t exponent = (half >> 10) & 0x1fu;
+        uint32_t mantissa = half & 0x3ffu;
+        uint32_t bits;
+        if (0 == exponent) {
+            if (0 == mantissa) {
+                bits = sign;
+            } else {
+                exponent = 127 - 15 + 1;
+                while (0 == (mantissa & 0x400u)) {
+                    mantissa <<= 1;
+                    --exponent;
+                }
+                bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+            }
+        } else if (0x1fu == exponent) {
+            bits = sign | 0x7f800000u | (mantissa << 13);
+        } else {
+            bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        }
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    void halfToFloat(const uint16_t *source, float *target, size_t count) {
+        size_t i = 0;
+#if defined(__F16C__)
+        for (; i + 8 <= count; i += 8) {
+            __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+            _mm256_storeu_ps(target + i, _mm256_cvtph_ps(packed));
+        }
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__aarch64__)
+        for (; i + 4 <= count; i += 4) {
+            vst1q_f32(target + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(source + i))));
+        }
+#endif
+        for (; i < count; ++i) {
+            target[i] = halfToFloat(source[i]);
+        }
+    }
+
+    // 两个查询与四行在[0, depth)上的点积，累加到acc
+    void dotTile(const float *const *queries, const float *const *rows, size_t depth,
+                 float acc[TILE_QUERIES][TILE_ROWS]) {
+        size_t k = 0;
+#if defined(__AVX2__)
+        __m256 sums[TILE_QUERIES][TILE_ROWS];
+        for (size_t i = 0; i < TILE_QUERIES; ++i) {
+            for (size_t j = 0; j < TILE_ROWS; ++j) {
+                sums[i][j] = _mm256_setzero_ps();
+            }
+        }
+        for (; k + 8 <= depth; k += 8) {
+            __m256 row[TILE_ROWS];
+            for (size_t j = 0; j < TILE_ROWS; ++j) {
+                row[j] = _mm256_loadu_ps(rows[j] + k);
+            }
+            for (size_t i = 0; i < TILE_QUERIES; ++i) {
+                __m256 query = _mm256_loadu_ps(queries[i] + k);
+                for (size_t j = 0; j < TILE_ROWS; ++j) {
+#if defined(__FMA__)
+                    sums[i][j] = _mm256_fmadd_ps(query, row[j], sums[i][j]);
+#else
+                    sums[i][j] = _mm256_add_ps(sums[i][j], _mm256_mul_ps(query, row[j]));
+#endif
+                }
+            }
+        }
+        for (size_t i = 0; i < TILE_QUERIES; ++i) {
+            for (size_t j = 0; j < TILE_ROWS; ++j) {
+                __m128 half = _mm_add_ps(_mm256_castps256_ps128(sums[i][j]), _mm256_extractf128_ps(sums[i][j], 1));
+                half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+                half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 0x55));
+                acc[i][j] += _mm_cvtss_f32(half);
+            }
+        }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        float32x4_t sums[TILE_QUERIES][TILE_ROWS];
+        for (size_t i = 0; i < TILE_QUERIES; ++i) {
+            for (size_t j = 0; j < TILE_ROWS; ++j) {
+                sums[i][j] = vdupq_n_f32(0.0f);
+            }
+        }
+        for (; k + 4 <= depth; k += 4) {
+            float32x4_t row[TILE_ROWS];
+            for (size_t j = 0; j < TILE_ROWS; ++j) {
+                row[j] = vld1q_f32(rows[j] + k);
+            }
+            for (size_t i = 0; i < TILE_QUERIES; ++i) {
+                float32x4_t query = vld1q_f32(queries[i] + k);
+                for (size_t j = 0; j < TILE_ROWS; ++j) {
+#if defined(__aarch64__)
+                    sums[i][j] = vfmaq_f32(sums[i][j], query, row[j]);
+#else
+                    sums[i][j] = vmlaq_f32(sums[i][j], query, row[j]);
+#endif
+                }
+            }
+        }
+        for (size_t i = 0; i < TILE_QUERIES; ++i) {
+            for (size_t j = 0; j < TILE_ROWS; ++j) {
+#if defined(__aarch64__)
+                acc[i][j] += vaddvq_f32(sums[i][j]);
+#else
+                float32x2_t pair = vadd_f32(vget_low_f32(sums[i][j]), vget_high_f32(sums[i][j]));
+                acc[i][j] += vget_lane_f32(vpadd_f32(pair, pair), 0);
+#endif
+            }
+        }
+#endif
+        for (; k < depth; ++k) {
+            for (size_t i = 0; i < TILE_QUERIES; ++i) {
+                for (size_t j = 0; j < TILE_ROWS; ++j) {
+                    acc[i][j] += queries[i][k] * rows[j][k];
+                }
+            }
+        }
+    }
+}
+
+MatrixPrecision parseMatrixPrecision(const std::string &name, MatrixPrecision fallback) {
+    if ("int8" == name) {
+        return MatrixPrecision::Int8;
+    }
+    if ("fp16" == name) {
+        return MatrixPrecision::Float16;
+    }
+    if ("fp32" == name) {
+        return MatrixPrecision::Float32;
+    }
+    return fallback;
+}
+
+EmbeddingMatrix::EmbeddingMatrix(size_t dimension, MatrixPrecision precision)
+        : _dimension(dimension), _precision(precision), _rows(0) {}
+
+size_t EmbeddingMatrix::byteSize() const {
+    return _float32.size() * sizeof(float) + _float16.size() * sizeof(uint16_t) +
+           _int8.size() * sizeof(int8_t) + _scales.size() * sizeof(float);
+}
+
+void EmbeddingMatrix::reserve(size_t rows) {
+    switch (_precision) {
+        case MatrixPrecision::Int8:
+            _int8.reserve(rows * _dimension);
+            _scales.reserve(rows);
+            break;
+        case MatrixPrecision::Float16:
+            _float16.reserve(rows * _dimension);
+            break;
+        case MatrixPrecision::Float32:
+            _float32.reserve(rows * _dimension);
+            break;
+    }
+}
+
+void EmbeddingMatrix::appendZeroRow() {
+    switch (_precision) {
+        case MatrixPrecision::Int8:
+            _int8.resize(_int8.size() + _dimension, 0);
+            _scales.push_back(0.0f);
+            break;
+        case MatrixPrecision::Float16:
+            _float16.resize(_float16.size() + _dimension, 0);
+            break;
+        case MatrixPrecision::Float32:
+            _float32.resize(_float32.size() + _dimension, 0.0f);
+            break;
+    }
+    ++_rows;
+}
+
+void EmbeddingMatrix::appendRow(const float *values, size_t size) {
+    if (nullptr == values || size != _dimension) {
+        appendZeroRow();
+        return;
+    }
+    if (MatrixPrecision::Int8 == _precision) {
+        Int8Embedding quantized;
+        if (!EmbeddingQuantizer::quantize(values, size, quantized)) {
+            appendZeroRow();
+            return;
+        }
+        _int8.insert(_int8.end(), quantized.values.begin(), quantized.values.end());
+        _scales.push_back(quantized.scale);
+        ++_rows;
+        return;
+    }
+
+    double squareSum = 0.0;
+    for (size_t i = 0; i < size; ++i) {
+        squareSum += static_cast<double>(values[i]) * values[i];
+    }
+    if (squareSum <= 0.0) {
+        appendZeroRow();
+        return;
+    }
+    auto invNorm = static_cast<float>(1.0 / std::sqrt(squareSum));
+    if (MatrixPrecision::Float16 == _precision) {
+        for (size_t i = 0; i < size; ++i) {
+            _float16.push_back(floatToHalf(values[i] * invNorm));
+        }
+    } else {
+        for (size_t i = 0; i < size; ++i) {
+            _float32.push_back(values[i] * invNorm);
+        }
+    }
+    ++_rows;
+}
+
+void EmbeddingMatrix::appendRow(const Int8EmbeddingView &embedding) {
+    if (embedding.empty() || embedding.size != _dimension || embedding.scale <= 0.0f) {
+        appendZeroRow();
+        return;
+    }
+    if (MatrixPrecision::Int8 == _precision) {
+        _int8.insert(_int8.end(), embedding.values, embedding.values + embedding.size);
+        _scales.push_back(embedding.scale);
+        ++_rows;
+        return;
+    }
+    std::vector<float> values(embedding.size);
+    for (size_t i = 0; i < embedding.size; ++i) {
+        values[i] = embedding.values[i] * embedding.scale;
+    }
+    appendRow(values.data(), values.size());
+}
+
+void EmbeddingMatrix::multiplyAccumulate(const float *queries, size_t queryCount, const float *weights,
+                                         float *out, size_t ldOut) const {
+    if (nullptr == queries || 0 == queryCount || 0 == _rows || 0 == _dimension) {
+        return;
+    }
+    if (MatrixPrecision::Int8 == _precision) {
+        multiplyInt8(queries, queryCount, weights, out, ldOut);
+    } else {
+        multiplyFloat(queries, queryCount, weights, out, ldOut);
+    }
+}
+
+void EmbeddingMatrix::multiplyFloat(const float *queries, size_t queryCount, const float *weights,
+                                    float *out, size_t ldOut) const {
+    // fp16的行块在每个维度块内先转换（打包）成float，再交给同一个微块内核
+    std::vector<float> packed;
+    if (MatrixPrecision::Float16 == _precision) {
+        packed.resize(ROW_BLOCK * DEPTH_BLOCK);
+    }
+
+    for (size_t rowBegin = 0; rowBegin < _rows; rowBegin += ROW_BLOCK) {
+        size_t rowEnd = std::min(_rows, rowBegin + ROW_BLOCK);
+        for (size_t depthBegin = 0; depthBegin < _dimension; depthBegin += DEPTH_BLOCK) {
+            size_t depth = std::min(DEPTH_BLOCK, _dimension - depthBegin);
+            const float *block;
+            size_t rowStride;
+            if (MatrixPrecision::Float16 == _precision) {
+                for (size_t r = rowBegin; r < rowEnd; ++r) {
+                    halfToFloat(_float16.data() + r * _dimension + depthBegin, packed.data() + (r - rowBegin) * depth,
+                                depth);
+                }
+                block = packed.data();
+                rowStride = depth;
+            } else {
+                block = _float32.data() + rowBegin * _dimension + depthBegin;
+                rowStride = _dimension;
+            }
+
+            for (size_t queryBegin = 0; queryBegin < queryCount; queryBegin += TILE_QUERIES) {
+                size_t tileQueries = std::min(TILE_QUERIES, queryCount - queryBegin);
+                bool active = false;
+                const float *queryTile[TILE_QUERIES];
+                for (size_t i = 0; i < TILE_QUERIES; ++i) {
+                    // 不足一个微块时重复最后一个查询，多算的结果丢弃
+                    size_t query = queryBegin + std::min(i, tileQueries - 1);
+                    queryTile[i] = queries + query * _dimension + depthBegin;
+                    active = active || (i < tileQueries && 0.0f != weights[query]);
+                }
+                if (!active) {
+                    continue;
+                }
+                for (size_t row = rowBegin; row < rowEnd; row += TILE_ROWS) {
+                    size_t tileRows = std::min(TILE_ROWS, rowEnd - row);
+                    const float *rowTile[TILE_ROWS];
+                    for (size_t j = 0; j < TILE_ROWS; ++j) {
+                        rowTile[j] = block + (row + std::min(j, tileRows - 1) - rowBegin) * rowStride;
+                    }
+                    float acc[TILE_QUERIES][TILE_ROWS] = {};
+                    dotTile(queryTile, rowTile, depth, acc);
+                    for (size_t i = 0; i < tileQueries; ++i) {
+                        float weight = weights[queryBegin + i];
+                        float *target = out + (queryBegin + i) * ldOut + row;
+                        for (size_t j = 0; j < tileRows; ++j) {
+                            target[j] += weight * acc[i][j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void EmbeddingMatrix::multiplyInt8(const float *queries, size_t queryCount, const float *weights,
+                                   float *out, size_t ldOut) const {
+    // 查询按与模型中相同的方式量化，点积用int8 SIMD，结果 = 点积 × 查询scale × 行scale，与逐个比较一致
+    std::vector<Int8Embedding> quantized(queryCount);
+    std::vector<float> factors(queryCount, 0.0f);
+    for (size_t q = 0; q < queryCount; ++q) {
+        if (0.0f != weights[q] && EmbeddingQuantizer::quantize(queries + q * _dimension, _dimension, quantized[q])) {
+            factors[q] = weights[q] * quantized[q].scale;
+        }
+    }
+
+    for (size_t rowBegin = 0; rowBegin < _rows; rowBegin += ROW_BLOCK) {
+        size_t rowEnd = std::min(_rows, rowBegin + ROW_BLOCK);
+        for (size_t q = 0; q < queryCount; ++q) {
+            if (0.0f == factors[q]) {
+                continue;
+            }
+            const int8_t *query = quantized[q].values.data();
+            float *target = out + q * ldOut;
+            for (size_t row = rowBegin; row < rowEnd; ++row) {
+                int32_t dot = EmbeddingQuantizer::dotProduct(query, _int8.data() + row * _dimension, _dimension);
+                target[row] += factors[q] * _scales[row] * static_cast<float>(dot);
+            }
+        }
+    }
+}
+
+} // namespace fastbotx
+
+#endif // EmbeddingMatrix_CPP_
@@ -0,0 +1,76 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef EmbeddingMatrix_H_
+#define EmbeddingMatrix_H_
+
+#include "EmbeddingQuantizer.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fastbotx {
+
+// 矩阵元素的存储精度：Int8与复用模型中保存的量化向量一致（结果与逐个比较相同），
+// Float16/Float32用更多内存换取不对查询做量化
+enum class MatrixPrecision {
+    Int8 = 0,
+    Float16 = 1,
+    Float32 = 2
+};
+
+// "int8" / "fp16" / "fp32"，无法识别时返回fallback
+MatrixPrecision parseMatrixPrecision(const std::string &name, MatrixPrecision fallback);
+
+// 行主序的嵌入矩阵：每行一个L2归一化的向量，Int8精度下每行另存一个scale。
+// 一批查询与全部行的点积（即余弦相似度）按 行块 × 维度块 分块计算，
+// 内核为2个查询 × 4行的微块（AVX2 FMA / NEON，不支持时回退到标量实现）
+class EmbeddingMatrix {
+public:
+    EmbeddingMatrix(size_t dimension, MatrixPrecision precision);
+
+    size_t rows() const { return _rows; }
+
+    size_t dimension() const { return _dimension; }
+
+    MatrixPrecision precision() const { return _precision; }
+
+    // 矩阵数据占用的字节数
+    size_t byteSize() const;
+
+    void reserve(size_t rows);
+
+    // 追加一行，先做L2归一化；维度不一致或为零向量时追加零行（与任何查询的点积为0）
+    void appendRow(const float *values, size_t size);
+
+    // 追加一个量化向量：Int8精度下原样保存，其他精度反量化并归一化后保存
+    void appendRow(const Int8EmbeddingView &embedding);
+
+    // out[q * ldOut + r] += weights[q] * <queries[q], row[r]>，queries为queryCount × dimension的行主序矩阵，
+    // 调用方保证查询已归一化；weights为0的查询不参与计算
+    void multiplyAccumulate(const float *queries, size_t queryCount, const float *weights,
+                            float *out, size_t ldOut) const;
+
+private:
+    void multiplyFloat(const float *queries, size_t queryCount, const float *weights, float *out, size_t ldOut) const;
+
+    void multiplyInt8(const float *queries, size_t queryCount, const float *weights, float *out, size_t ldOut) const;
+
+    void appendZeroRow();
+
+    size_t _dimension;
+    MatrixPrecision _precision;
+    size_t _rows;
+    std::vector<float> _float32;
+    std::vector<uint16_t> _float16;
+    std::vector<int8_t> _int8;
+    std::vector<float> _scales;
+};
+
+} // namespace fastbotx
+
+#endif // EmbeddingMatrix_H_
@@ -0,0 +1,125 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef EmbeddingQuantizer_CPP_
+#define EmbeddingQuantizer_CPP_
+
+#include "EmbeddingQuantizer.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+namespace fastbotx {
+
+bool EmbeddingQuantizer::quantize(const float *data, size_t size, Int8Embedding &out) {
+    out.scale = 0.0f;
+    out.values.clear();
+    if (nullptr == data || 0 == size) {
+        return false;
+    }
+
+    double squareSum = 0.0;
+    for (size_t i = 0; i < size; ++i) {
+        squareSum += static_cast<double>(data[i]) * data[i];
+    }
+    if (squareSum <= 0.0) {
+        return false;
+    }
+    auto invNorm = static_cast<float>(1.0 / std::sqrt(squareSum));
+
+    // 归一化后的最大绝对值决定量化步长
+    float maxAbs = 0.0f;
+    for (size_t i = 0; i < size; ++i) {
+        maxAbs = std::max(maxAbs, std::fabs(data[i] * invNorm));
+    }
+    if (maxAbs <= 0.0f) {
+        return false;
+    }
+
+    out.scale = maxAbs / 127.0f;
+    float factor = invNorm / out.scale;
+    out.values.resize(size);
+    for (size_t i = 0; i < size; ++i) {
+        long q = std::lround(data[i] * factor);
+        q = std::max(-127L, std::min(127L, q));
+        out.values[i] = static_cast<int8_t>(q);
+    }
+    return true;
+}
+
+bool EmbeddingQuantizer::quantize(const std::vector<float> &embedding, Int8Embedding &out) {
+    return quantize(embedding.data(), embedding.size(), out);
+}
+
+int32_t EmbeddingQuantizer::dotProduct(const int8_t *a, const int8_t *b, size_t size) {
+    int32_t sum = 0;
+    size_t i = 0;
+#if defined(__ARM_FEATURE_DOTPROD) && defined(__aarch64__)
+    int32x4_t acc = vdupq_n_s32(0);
+    for (; i + 16 <= size; i += 16) {
+        acc = vdotq_s32(acc, vld1q_s8(a + i), vld1q_s8(b + i));
+    }
+    sum = vaddvq_s32(acc);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    // 量化值在[-127, 127]，单个乘积不会溢出int16
+    int32x4_t acc = vdupq_n_s32(0);
+    for (; i + 16 <= size; i += 16) {
+        int8x16_t va = vld1q_s8(a + i);
+        int8x16_t vb = vld1q_s8(b + i);
+        acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(va), vget_low_s8(vb)));
+        acc = vpadalq_s16(acc, vmull_s8(vget_high_s8(va), vget_high_s8(vb)));
+    }
+#if defined(__aarch64__)
+    sum = vaddvq_s32(acc);
+#else
+    int32x2_t pair = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+    sum = vget_lane_s32(vpadd_s32(pair, pair), 0);
+#endif
+#elif defined(__AVX2__)
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 16 <= size; i += 16) {
+        __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)));
+        __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+    }
+    __m128i acc128 = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    acc128 = _mm_hadd_epi32(acc128, acc128);
+    acc128 = _mm_hadd_epi32(acc128, acc128);
+    sum = _mm_cvtsi128_si32(acc128);
+#elif defined(__SSE4_1__)
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 8 <= size; i += 8) {
+        __m128i va = _mm_cvtepi8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(a + i)));
+        __m128i vb = _mm_cvtepi8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(b + i)));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(va, vb));
+    }
+    acc = _mm_hadd_epi32(acc, acc);
+    acc = _mm_hadd_epi32(acc, acc);
+    sum = _mm_cvtsi128_si32(acc);
+#endif
+    for (; i < size; ++i) {
+        sum += static_cast<int32_t>(a[i]) * static_cast<int32_t>(b[i]);
+    }
+    return sum;
+}
+
+double EmbeddingQuantizer::cosineSimilarity(const Int8EmbeddingView &a, const Int8EmbeddingView &b) {
+    if (a.empty() || b.empty() || a.size != b.size) {
+        return 0.0;
+    }
+    // 量化前已做L2归一化，点积乘以两个scale即为余弦值
+    double similarity = static_cast<double>(dotProduct(a.values, b.values, a.size)) * a.scale * b.scale;
+    return std::max(-1.0, std::min(1.0, similarity));
+}
+
+} // namespace fastbotx
+
+#endif // EmbeddingQuantizer_CPP_
@@ -0,0 +1,70 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef EmbeddingQuantizer_H_
+#define EmbeddingQuantizer_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fastbotx {
+
+// int8量化后的嵌入向量：量化前先做L2归一化，再按每个向量的最大绝对值对称量化到[-127, 127]
+struct Int8Embedding {
+    float scale;
+    std::vector<int8_t> values;
+
+    Int8Embedding() : scale(0.0f) {}
+
+    bool empty() const { return values.empty(); }
+};
+
+// 量化向量的只读视图，可直接指向FlatBuffer中的数据（零拷贝）
+struct Int8EmbeddingView {
+    const int8_t *values;
+    size_t size;
+    float scale;
+
+    Int8EmbeddingView() : values(nullptr), size(0), scale(0.0f) {}
+
+    Int8EmbeddingView(const int8_t *v, size_t n, float s) : values(v), size(n), scale(s) {}
+
+    explicit Int8EmbeddingView(const Int8Embedding &embedding)
+            : values(embedding.values.data()), size(embedding.values.size()), scale(embedding.scale) {}
+
+    bool empty() const { return nullptr == values || 0 == size; }
+};
+
+// 一个widget/action在复用模型中保存的各属性嵌入，为空表示模型中未保存
+struct SimilarityEmbeddings {
+    Int8EmbeddingView text;
+    Int8EmbeddingView activityName;
+    Int8EmbeddingView resourceId;
+    Int8EmbeddingView icon;
+
+    bool empty() const {
+        return text.empty() && activityName.empty() && resourceId.empty() && icon.empty();
+    }
+};
+
+class EmbeddingQuantizer {
+public:
+    // 将float向量L2归一化后量化为int8，零向量返回false
+    static bool quantize(const float *data, size_t size, Int8Embedding &out);
+
+    static bool quantize(const std::vector<float> &embedding, Int8Embedding &out);
+
+    // int8点积（NEON / SSE4.1 / AVX2，不支持时回退到标量实现）
+    static int32_t dotProduct(const int8_t *a, const int8_t *b, size_t size);
+
+    // 两个量化向量的余弦相似度，维度不一致时返回0
+    static double cosineSimilarity(const Int8EmbeddingView &a, const Int8EmbeddingView &b);
+};
+
+} // namespace fastbotx
+
+#endif // EmbeddingQuantizer_H_
@@ -0,0 +1,181 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef IconEmbeddingCache_CPP_
+#define IconEmbeddingCache_CPP_
+
+#include "IconEmbeddingCache.h"
+#include "../utils.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace fastbotx {
+
+static const char ICON_CACHE_MAGIC[8] = {'F', 'B', 'I', 'C', 'O', 'N', 'E', 'C'};
+static const uint32_t ICON_CACHE_VERSION = 1;
+
+// 缓存文件头，之后是count个条目：contentHash(uint64) + dimension个float，本机字节序
+struct IconCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dimension;
+    uint64_t count;
+    uint64_t modelTag;
+};
+
+IconEmbeddingCache::IconEmbeddingCache(size_t capacity)
+        : _capacity(capacity > 0 ? capacity : 1), _dirty(false) {
+}
+
+bool IconEmbeddingCache::find(uint64_t contentHash, std::vector<float> &embedding) {
+    std::lock_guard<std::mutex> guard(_lock);
+    auto it = _entries.find(contentHash);
+    if (it == _entries.end()) {
+        return false;
+    }
+    _order.splice(_order.begin(), _order, it->second.position);
+    embedding = it->second.embedding;
+    return true;
+}
+
+bool IconEmbeddingCache::contains(uint64_t contentHash) const {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _entries.find(contentHash) != _entries.end();
+}
+
+void IconEmbeddingCache::put(uint64_t contentHash, const std::vector<float> &embedding) {
+    if (embedding.empty()) return;
+    std::lock_guard<std::mutex> guard(_lock);
+    insertLocked(contentHash, embedding);
+    _dirty = true;
+}
+
+void IconEmbeddingCache::setCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> guard(_lock);
+    _capacity = capacity > 0 ? capacity : 1;
+    evictLocked();
+}
+
+size_t IconEmbeddingCache::size() const {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _entries.size();
+}
+
+void IconEmbeddingCache::insertLocked(uint64_t contentHash, const std::vector<float> &embedding) {
+    auto it = _entries.find(contentHash);
+    if (it != _entries.end()) {
+        it->second.embedding = embedding;
+        _order.splice(_order.begin(), _order, it->second.position);
+        return;
+    }
+    _order.push_front(contentHash);
+    Entry entry;
+    entry.embedding = embedding;
+    entry.position = _order.begin();
+    _entries.emplace(contentHash, std::move(entry));
+    evictLocked();
+}
+
+void IconEmbeddingCache::evictLocked() {
+    while (_entries.size() > _capacity) {
+        _entries.erase(_order.back());
+        _order.pop_back();
+    }
+}
+
+bool IconEmbeddingCache::load(const std::string &path, uint64_t modelTag) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+    IconCacheHeader header{};
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!in.good() || 0 != std::memcmp(header.magic, ICON_CACHE_MAGIC, sizeof(header.magic)) ||
+        ICON_CACHE_VERSION != header.version || modelTag != header.modelTag || 0 == header.dimension) {
+        BLOG("图标嵌入缓存文件%s与当前模型不匹配，忽略", path.c_str());
+        return false;
+    }
+
+    // 文件中按从旧到新排列，逐个插到队首后最新的条目排在最前；超出容量的部分只读最新的
+    std::lock_guard<std::mutex> guard(_lock);
+    uint64_t skip = header.count > _capacity ? header.count - _capacity : 0;
+    std::streamoff entryBytes = static_cast<std::streamoff>(sizeof(uint64_t) + header.dimension * sizeof(float));
+    in.seekg(static_cast<std::streamoff>(skip) * entryBytes, std::ios::cur);
+    std::vector<float> embedding(header.dimension);
+    size_t loaded = 0;
+    for (uint64_t i = skip; i < header.count; ++i) {
+        uint64_t contentHash = 0;
+        in.read(reinterpret_cast<char *>(&contentHash), sizeof(contentHash));
+        in.read(reinterpret_cast<char *>(embedding.data()),
+                static_cast<std::streamsize>(header.dimension * sizeof(float)));
+        if (!in.good()) {
+            break;
+        }
+        // 本次运行已经算过的条目较新，不覆盖
+        if (_entries.find(contentHash) == _entries.end()) {
+            insertLocked(contentHash, embedding);
+            ++loaded;
+        }
+    }
+    BLOG("从%s加载图标嵌入缓存%zu条", path.c_str(), loaded);
+    return loaded > 0;
+}
+
+bool IconEmbeddingCache::save(const std::string &path, uint64_t modelTag) {
+    // 在锁内复制快照，写文件时不阻塞查询
+    std::vector<uint64_t> hashes;
+    std::vector<float> data;
+    uint32_t dimension = 0;
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (!_dirty || _entries.empty()) {
+            return true;
+        }
+        dimension = static_cast<uint32_t>(_entries.find(_order.front())->second.embedding.size());
+        hashes.reserve(_entries.size());
+        data.reserve(_entries.size() * dimension);
+        for (auto it = _order.rbegin(); it != _order.rend(); ++it) {
+            const std::vector<float> &embedding = _entries.find(*it)->second.embedding;
+            if (embedding.size() != dimension) continue;
+            hashes.push_back(*it);
+            data.insert(data.end(), embedding.begin(), embedding.end());
+        }
+        _dirty = false;
+    }
+
+    IconCacheHeader header{};
+    std::memcpy(header.magic, ICON_CACHE_MAGIC, sizeof(header.magic));
+    header.version = ICON_CACHE_VERSION;
+    header.dimension = dimension;
+    header.count = hashes.size();
+    header.modelTag = modelTag;
+
+    std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        BLOGE("无法写入图标嵌入缓存: %s", tempPath.c_str());
+        return false;
+    }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        out.write(reinterpret_cast<const char *>(&hashes[i]), sizeof(uint64_t));
+        out.write(reinterpret_cast<const char *>(data.data() + i * dimension),
+                  static_cast<std::streamsize>(dimension * sizeof(float)));
+    }
+    out.close();
+    if (!out.good() || 0 != std::rename(tempPath.c_str(), path.c_str())) {
+        std::remove(tempPath.c_str());
+        BLOGE("保存图标嵌入缓存失败: %s", path.c_str());
+        return false;
+    }
+    BLOG("图标嵌入缓存已保存到%s，共%zu条", path.c_str(), hashes.size());
+    return true;
+}
+
+} // namespace fastbotx
+
+#endif // IconEmbeddingCache_CPP_
@@ -0,0 +1,67 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef IconEmbeddingCache_H_
+#define IconEmbeddingCache_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fastbotx {
+
+// 图标嵌入缓存：按解码后图标字节的内容哈希索引（同一图标不同的base64写法共用一个条目），
+// 超出容量时淘汰最久未使用的条目；可以写到文件，下次运行启动时加载，避免重复跑CLIP。
+// 所有方法线程安全。
+class IconEmbeddingCache {
+public:
+    explicit IconEmbeddingCache(size_t capacity);
+
+    // 命中时复制向量到embedding并标记为最近使用
+    bool find(uint64_t contentHash, std::vector<float> &embedding);
+
+    // 只判断是否存在，不影响淘汰顺序
+    bool contains(uint64_t contentHash) const;
+
+    void put(uint64_t contentHash, const std::vector<float> &embedding);
+
+    // 修改容量，超出的旧条目立即淘汰
+    void setCapacity(size_t capacity);
+
+    // 从文件加载条目，已在内存中的条目保留；文件格式或modelTag（生成向量的模型标识）不一致时忽略整个文件
+    bool load(const std::string &path, uint64_t modelTag);
+
+    // 从旧到新写出（加载后LRU顺序不变），先写临时文件再rename；自上次保存后没有新条目时直接返回
+    bool save(const std::string &path, uint64_t modelTag);
+
+    size_t size() const;
+
+private:
+    struct Entry {
+        std::vector<float> embedding;
+        std::list<uint64_t>::iterator position;
+    };
+
+    // 调用方持有锁
+    void insertLocked(uint64_t contentHash, const std::vector<float> &embedding);
+
+    void evictLocked();
+
+    size_t _capacity;
+    // 队首为最近使用
+    std::list<uint64_t> _order;
+    std::unordered_map<uint64_t, Entry> _entries;
+    bool _dirty;
+    mutable std::mutex _lock;
+};
+
+} // namespace fastbotx
+
+#endif // IconEmbeddingCache_H_
@@ -0,0 +1,173 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef IconIngestion_CPP_
+#define IconIngestion_CPP_
+
+#include "IconIngestion.h"
+#include "ActionSimilarity.h"
+#include "../utils.hpp"
+#include <cstring>
+
+namespace fastbotx {
+
+// 二进制图标包，本机字节序（Java端使用ByteBuffer.order(ByteOrder.nativeOrder())写入）：
+//   uint32 magic | uint16 version | uint16 count
+//   count个条目：uint16 keyLength | uint16 reserved | uint32 imageLength | key(UTF-8) | image(PNG/JPEG)
+static const uint32_t ICON_BUFFER_MAGIC = 0x43494246; // "FBIC"
+static const uint16_t ICON_BUFFER_VERSION = 1;
+static const size_t ICON_BUFFER_HEADER_SIZE = 8;
+static const size_t ICON_ENTRY_HEADER_SIZE = 8;
+
+const size_t IconIngestion::MAX_PENDING_BATCHES;
+
+template<typename T>
+static T readValue(const uint8_t *data) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+IconIngestionPtr IconIngestion::inst() {
+    static IconIngestionPtr ingestion = std::make_shared<IconIngestion>();
+    return ingestion;
+}
+
+IconIngestion::IconIngestion()
+        : _stopped(false), _published(std::make_shared<const ActivityIconTable>()) {
+    _worker = std::thread(&IconIngestion::run, this);
+}
+
+IconIngestion::~IconIngestion() {
+    {
+        std::lock_guard<std::mutex> guard(_pendingLock);
+        _stopped = true;
+        _pending.clear();
+    }
+    _pendingCondition.notify_all();
+    if (_worker.joinable()) {
+        _worker.join();
+    }
+}
+
+bool IconIngestion::submitBuffer(const std::string &activity, const uint8_t *data, size_t length) {
+    if (nullptr == data || length < ICON_BUFFER_HEADER_SIZE ||
+        ICON_BUFFER_MAGIC != readValue<uint32_t>(data) || ICON_BUFFER_VERSION != readValue<uint16_t>(data + 4)) {
+        BLOGE("invalid icon buffer for %s, length %zu", activity.c_str(), length);
+        return false;
+    }
+    uint16_t count = readValue<uint16_t>(data + 6);
+    IconBatch batch;
+    batch.activity = activity;
+    batch.icons.reserve(count);
+    size_t offset = ICON_BUFFER_HEADER_SIZE;
+    for (uint16_t i = 0; i < count; ++i) {
+        if (length - offset < ICON_ENTRY_HEADER_SIZE) {
+            BLOGE("truncated icon buffer for %s at entry %u", activity.c_str(), i);
+            return false;
+        }
+        size_t keyLength = readValue<uint16_t>(data + offset);
+        size_t imageLength = readValue<uint32_t>(data + offset + 4);
+        offset += ICON_ENTRY_HEADER_SIZE;
+        if (length - offset < keyLength || length - offset - keyLength < imageLength) {
+            BLOGE("truncated icon buffer for %s at entry %u", activity.c_str(), i);
+            return false;
+        }
+        PendingIcon icon;
+        icon.key.assign(reinterpret_cast<const char *>(data + offset), keyLength);
+        offset += keyLength;
+        icon.bytes.assign(data + offset, data + offset + imageLength);
+        offset += imageLength;
+        if (!icon.key.empty() && !icon.bytes.empty()) {
+            batch.icons.push_back(std::move(icon));
+        }
+    }
+    enqueue(batch);
+    return true;
+}
+
+void IconIngestion::submitBase64(const std::string &activity, std::map<std::string, std::string> &iconMap) {
+    IconBatch batch;
+    batch.activity = activity;
+    batch.icons.reserve(iconMap.size());
+    for (auto &keyIcon : iconMap) {
+        PendingIcon icon;
+        icon.key = keyIcon.first;
+        icon.base64.swap(keyIcon.second);
+        batch.icons.push_back(std::move(icon));
+    }
+    enqueue(batch);
+}
+
+void IconIngestion::enqueue(IconBatch &batch) {
+    {
+        std::lock_guard<std::mutex> guard(_pendingLock);
+        if (_pending.size() >= MAX_PENDING_BATCHES) {
+            BDLOG("icon ingestion backlog full, drop icons of %s", _pending.front().activity.c_str());
+            _pending.pop_front();
+        }
+        _pending.push_back(std::move(batch));
+    }
+    _pendingCondition.notify_one();
+}
+
+WidgetIconIdMapPtr IconIngestion::snapshot(const std::string &activity) const {
+    std::shared_ptr<const ActivityIconTable> table = std::atomic_load(&_published);
+    auto it = table->find(activity);
+    return it == table->end() ? nullptr : it->second;
+}
+
+void IconIngestion::clear() {
+    {
+        std::lock_guard<std::mutex> guard(_pendingLock);
+        _pending.clear();
+    }
+    std::atomic_store(&_published, std::make_shared<const ActivityIconTable>());
+}
+
+void IconIngestion::run() {
+    while (true) {
+        IconBatch batch;
+        {
+            std::unique_lock<std::mutex> lock(_pendingLock);
+            _pendingCondition.wait(lock, [this]() { return _stopped || !_pending.empty(); });
+            if (_stopped) {
+                return;
+            }
+            batch = std::move(_pending.front());
+            _pending.pop_front();
+        }
+        process(batch);
+    }
+}
+
+void IconIngestion::process(IconBatch &batch) {
+    double startTime = currentStamp();
+    IconStorePtr store = IconStore::inst();
+    auto icons = std::make_shared<WidgetIconIdMap>();
+    for (auto &icon : batch.icons) {
+        IconId iconId = icon.base64.empty() ? store->intern(icon.bytes) : store->intern(icon.base64);
+        if (INVALID_ICON_ID != iconId) {
+            (*icons)[icon.key] = iconId;
+        }
+    }
+
+    // 先发布图标表，再在后台补算嵌入，决策线程可以尽早拿到图标
+    std::shared_ptr<const ActivityIconTable> current = std::atomic_load(&_published);
+    auto next = std::make_shared<ActivityIconTable>(*current);
+    (*next)[batch.activity] = icons;
+    std::atomic_store(&_published, std::shared_ptr<const ActivityIconTable>(next));
+    BDLOG("ingested %zu/%zu icons for %s in %.3fs", icons->size(), batch.icons.size(), batch.activity.c_str(),
+          currentStamp() - startTime);
+
+    for (const auto &keyIcon : *icons) {
+        ActionSimilarity::prefetchIconEmbedding(keyIcon.second);
+    }
+}
+
+} // namespace fastbotx
+
+#endif // IconIngestion_CPP_
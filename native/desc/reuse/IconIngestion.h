@@ -0,0 +1,88 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef IconIngestion_H_
+#define IconIngestion_H_
+
+#include "IconStore.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fastbotx {
+
+class IconIngestion;
+
+typedef std::shared_ptr<IconIngestion> IconIngestionPtr;
+typedef std::shared_ptr<const WidgetIconIdMap> WidgetIconIdMapPtr;
+
+// 异步图标接入：JNI线程只做拷贝和入队，后台线程完成解码、登记到IconStore和嵌入预计算，
+// 然后以写时复制的方式发布每个activity最新的图标表。决策线程读取时只做一次原子指针加载，
+// 不等待解码也不持锁；图标尚未处理完时本次状态没有图标，下次进入该activity时生效。
+class IconIngestion {
+public:
+    static IconIngestionPtr inst();
+
+    IconIngestion();
+
+    ~IconIngestion();
+
+    // 解析二进制图标包（格式见IconIngestion.cpp）并拷贝入队，格式错误返回false
+    bool submitBuffer(const std::string &activity, const uint8_t *data, size_t length);
+
+    // 旧接口：key -> base64图标
+    void submitBase64(const std::string &activity, std::map<std::string, std::string> &iconMap);
+
+    // 该activity最近一次处理完的图标表，没有时返回nullptr
+    WidgetIconIdMapPtr snapshot(const std::string &activity) const;
+
+    // 丢弃未处理的图标包和已发布的图标表
+    void clear();
+
+private:
+    struct PendingIcon {
+        std::string key;
+        std::vector<uchar> bytes;
+        std::string base64;
+    };
+
+    struct IconBatch {
+        std::string activity;
+        std::vector<PendingIcon> icons;
+    };
+
+    typedef std::unordered_map<std::string, WidgetIconIdMapPtr> ActivityIconTable;
+
+    // 积压超过这个数量时丢弃最旧的图标包，界面已经变了，旧图标的价值最低
+    static const size_t MAX_PENDING_BATCHES = 4;
+
+    void enqueue(IconBatch &batch);
+
+    void run();
+
+    void process(IconBatch &batch);
+
+    std::deque<IconBatch> _pending;
+    std::mutex _pendingLock;
+    std::condition_variable _pendingCondition;
+    bool _stopped;
+    std::thread _worker;
+
+    // 只由工作线程和clear()替换，读取方用std::atomic_load
+    std::shared_ptr<const ActivityIconTable> _published;
+};
+
+} // namespace fastbotx
+
+#endif // IconIngestion_H_
@@ -0,0 +1,196 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef IconStore_CPP_
+#define IconStore_CPP_
+
+#include "IconStore.h"
+#include "Preference.h"
+#include "base64.h"
+#include "../utils.hpp"
+
+namespace fastbotx {
+
+IconStorePtr IconStore::inst() {
+    static IconStorePtr store = std::make_shared<IconStore>(Preference::inst()->getIconSimilarityConfig().storeBytes);
+    return store;
+}
+
+IconStore::IconStore(size_t byteCapacity) : _byteCapacity(byteCapacity) {
+}
+
+// base64串的64位FNV-1a（std::hash在32位设备上只有32位）
+static uint64_t base64Key(const std::string &base64Icon) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char c : base64Icon) {
+        hash ^= static_cast<uchar>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+const IconStore::Base64Entry *IconStore::findBase64Locked(const std::string &base64Icon, uint64_t key) const {
+    auto it = _idsByBase64.find(key);
+    if (it == _idsByBase64.end() || it->second.length != base64Icon.size() ||
+        it->second.check != std::hash<std::string>()(base64Icon)) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+IconId IconStore::intern(const std::string &base64Icon) {
+    if (base64Icon.empty()) {
+        return INVALID_ICON_ID;
+    }
+    uint64_t key = base64Key(base64Icon);
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        const Base64Entry *entry = findBase64Locked(base64Icon, key);
+        if (entry && !_entries[entry->id - 1].bytes.empty()) {
+            return entry->id;
+        }
+    }
+
+    std::vector<uchar> bytes = WidgetIcon::decodeBase64(base64Icon);
+    IconId id = intern(bytes);
+    if (INVALID_ICON_ID != id) {
+        std::lock_guard<std::mutex> guard(_lock);
+        _idsByBase64[key] = Base64Entry{id, base64Icon.size(), std::hash<std::string>()(base64Icon)};
+    }
+    return id;
+}
+
+IconId IconStore::intern(std::vector<uchar> &bytes) {
+    if (bytes.empty()) {
+        return INVALID_ICON_ID;
+    }
+    uint64_t contentHash = WidgetIcon::contentHash(bytes);
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        auto it = _idsByContent.find(contentHash);
+        if (it != _idsByContent.end() && !_entries[it->second - 1].bytes.empty()) {
+            return it->second;
+        }
+    }
+
+    // 解码和计算指纹放在锁外；解码出的图像用完即丢，只保留压缩字节
+    WidgetIcon icon;
+    if (!icon.loadFromBytes(bytes)) {
+        return INVALID_ICON_ID;
+    }
+
+    std::lock_guard<std::mutex> guard(_lock);
+    IconId id = INVALID_ICON_ID;
+    auto it = _idsByContent.find(contentHash);
+    if (it != _idsByContent.end()) {
+        // 其他线程已经登记，或者字节曾被淘汰，这里恢复
+        id = it->second;
+        if (!_entries[id - 1].bytes.empty()) {
+            return id;
+        }
+    } else {
+        _entries.emplace_back();
+        id = static_cast<IconId>(_entries.size());
+        _entries.back().fingerprint = icon.getFingerprint();
+        _idsByContent[contentHash] = id;
+    }
+    IconEntry &entry = _entries[id - 1];
+    entry.bytes.swap(bytes);
+    _byteSize += entry.bytes.size();
+    _resident.push_front(id);
+    entry.position = _resident.begin();
+    evictLocked();
+    BDLOG("icon store: icon %u, %zu icons / %zu resident / %zu bytes", id, _entries.size(), _resident.size(),
+          _byteSize);
+    return id;
+}
+
+IconId IconStore::find(const std::string &base64Icon) const {
+    if (base64Icon.empty()) {
+        return INVALID_ICON_ID;
+    }
+    std::lock_guard<std::mutex> guard(_lock);
+    const Base64Entry *entry = findBase64Locked(base64Icon, base64Key(base64Icon));
+    return entry ? entry->id : INVALID_ICON_ID;
+}
+
+bool IconStore::fingerprint(IconId id, IconFingerprint &out) const {
+    std::lock_guard<std::mutex> guard(_lock);
+    if (INVALID_ICON_ID == id || id > _entries.size()) {
+        return false;
+    }
+    out = _entries[id - 1].fingerprint;
+    return true;
+}
+
+IconStore::IconEntry *IconStore::residentEntryLocked(IconId id) {
+    if (INVALID_ICON_ID == id || id > _entries.size() || _entries[id - 1].bytes.empty()) {
+        return nullptr;
+    }
+    IconEntry &entry = _entries[id - 1];
+    _resident.splice(_resident.begin(), _resident, entry.position);
+    return &entry;
+}
+
+void IconStore::evictLocked() {
+    // 至少保留最近的一个图标
+    while (_byteSize > _byteCapacity && _resident.size() > 1) {
+        IconEntry &entry = _entries[_resident.back() - 1];
+        _byteSize -= entry.bytes.size();
+        std::vector<uchar>().swap(entry.bytes);
+        _resident.pop_back();
+    }
+}
+
+std::string IconStore::base64(IconId id) {
+    std::lock_guard<std::mutex> guard(_lock);
+    IconEntry *entry = residentEntryLocked(id);
+    if (nullptr == entry) {
+        return "";
+    }
+    return base64_encode(entry->bytes.data(), entry->bytes.size());
+}
+
+bool IconStore::bytes(IconId id, std::vector<uchar> &out) {
+    std::lock_guard<std::mutex> guard(_lock);
+    IconEntry *entry = residentEntryLocked(id);
+    if (nullptr == entry) {
+        return false;
+    }
+    out = entry->bytes;
+    return true;
+}
+
+WidgetIconPtr IconStore::decode(IconId id) {
+    std::vector<uchar> bytes;
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        IconEntry *entry = residentEntryLocked(id);
+        if (nullptr == entry) {
+            return nullptr;
+        }
+        bytes = entry->bytes;
+    }
+    auto icon = std::make_shared<WidgetIcon>();
+    if (!icon->loadFromBytes(bytes)) {
+        return nullptr;
+    }
+    return icon;
+}
+
+size_t IconStore::size() const {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _entries.size();
+}
+
+size_t IconStore::byteSize() const {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _byteSize;
+}
+
+} // namespace fastbotx
+
+#endif // IconStore_CPP_
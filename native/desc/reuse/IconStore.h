@@ -0,0 +1,103 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef IconStore_H_
+#define IconStore_H_
+
+#include "WidgetIcon.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fastbotx {
+
+typedef uint32_t IconId;
+const IconId INVALID_ICON_ID = 0;
+
+// 界面上控件的key（resource-id或类名+边界）-> IconId
+typedef std::map<std::string, IconId> WidgetIconIdMap;
+
+class IconStore;
+
+typedef std::shared_ptr<IconStore> IconStorePtr;
+
+// 进程内的图标存储：同一图标（按解码后字节的内容哈希去重）只保存一份压缩字节和指纹，
+// widget和复用模型的属性只持有4字节的IconId。解码后的图像只在需要推理时临时生成，
+// 嵌入向量保存在ActionSimilarity按内容哈希索引的缓存中。
+// 压缩字节的总量有上限，超出时丢弃最久未使用图标的字节（指纹和id保留，再次上报时恢复）。线程安全。
+class IconStore {
+public:
+    static IconStorePtr inst();
+
+    explicit IconStore(size_t byteCapacity);
+
+    // 登记一个base64图标，返回其id；相同内容的图标返回同一个id，无法解码时返回INVALID_ICON_ID
+    IconId intern(const std::string &base64Icon);
+
+    // 登记压缩图片字节（PNG/JPEG），bytes会被移走
+    IconId intern(std::vector<uchar> &bytes);
+
+    // 只查询已登记过的base64串，不解码，未登记返回INVALID_ICON_ID
+    IconId find(const std::string &base64Icon) const;
+
+    bool fingerprint(IconId id, IconFingerprint &out) const;
+
+    // 由保存的压缩字节重新编码，用于写入复用模型和基于base64的相似度计算；字节已被淘汰时返回空串
+    std::string base64(IconId id);
+
+    // 取得保存的压缩字节（写入复用模型的图标字典）；字节已被淘汰时返回false
+    bool bytes(IconId id, std::vector<uchar> &out);
+
+    // 临时解码出完整图标（用于CLIP推理），不在存储中保留解码结果
+    WidgetIconPtr decode(IconId id);
+
+    size_t size() const;
+
+    // 当前驻留的压缩字节总大小
+    size_t byteSize() const;
+
+private:
+    struct IconEntry {
+        IconFingerprint fingerprint;
+        std::vector<uchar> bytes;
+        // 字节驻留时在_resident中的位置
+        std::list<IconId>::iterator position;
+    };
+
+    // 调用方持有锁；id有效且字节仍驻留时返回条目并标记为最近使用
+    IconEntry *residentEntryLocked(IconId id);
+
+    void evictLocked();
+
+    size_t _byteCapacity;
+    // 下标为id - 1
+    std::vector<IconEntry> _entries;
+    // 持有字节的图标，队首为最近使用
+    std::list<IconId> _resident;
+    std::unordered_map<uint64_t, IconId> _idsByContent;
+    // base64串的64位哈希 -> id，界面重复上报同一个图标时不再解码。
+    // 命中时再比较串长和另一个哈希，哈希碰撞时按未命中处理，不会返回别的图标
+    struct Base64Entry {
+        IconId id;
+        size_t length;
+        size_t check;
+    };
+    std::unordered_map<uint64_t, Base64Entry> _idsByBase64;
+    // 调用方持有锁；未登记或校验不一致时返回nullptr
+    const Base64Entry *findBase64Locked(const std::string &base64Icon, uint64_t base64Key) const;
+    size_t _byteSize{0};
+    mutable std::mutex _lock;
+};
+
+} // namespace fastbotx
+
+#endif // IconStore_H_
@@ -0,0 +1,170 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef InferenceContext_CPP_
+#define InferenceContext_CPP_
+
+#include "InferenceContext.h"
+#include "../utils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace fastbotx {
+
+static const size_t DEFAULT_BERT_HIDDEN_SIZE = 768;
+static const size_t DEFAULT_CLIP_EMBEDDING_SIZE = 512;
+
+// 按名称查找模型输出的形状，动态维度为-1
+static std::vector<int64_t> outputShapeOf(Ort::Session *session, const char *outputName) {
+    Ort::AllocatorWithDefaultOptions allocator;
+    for (size_t i = 0; i < session->GetOutputCount(); ++i) {
+        auto name = session->GetOutputNameAllocated(i, allocator);
+        if (0 == std::strcmp(name.get(), outputName)) {
+            return session->GetOutputTypeInfo(i).GetTensorTypeAndShapeInfo().GetShape();
+        }
+    }
+    return std::vector<int64_t>();
+}
+
+// 原地L2归一化，余弦相似度不受影响，下游可以直接做点积
+static void normalizeL2(float *data, size_t size) {
+    float squareSum = 0.0f;
+    for (size_t i = 0; i < size; ++i) {
+        squareSum += data[i] * data[i];
+    }
+    if (squareSum <= 0.0f) return;
+    float invNorm = 1.0f / std::sqrt(squareSum);
+    for (size_t i = 0; i < size; ++i) {
+        data[i] *= invNorm;
+    }
+}
+
+BertInferenceContext::BertInferenceContext(Ort::Session *session, const std::vector<const char *> &inputNames,
+                                           const std::vector<const char *> &outputNames, int64_t sequenceLength)
+        : _session(session), _sequenceLength(sequenceLength), _hiddenSize(DEFAULT_BERT_HIDDEN_SIZE),
+          _pooledOutput(false),
+          _inputIds(static_cast<size_t>(sequenceLength), 0),
+          _attentionMask(static_cast<size_t>(sequenceLength), 0),
+          _tokenTypeIds(static_cast<size_t>(sequenceLength), 0),
+          _inputShape({1, sequenceLength}),
+          _memoryInfo(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault)),
+          _outputTensor(nullptr), _binding(*session) {
+    std::vector<int64_t> shape = outputShapeOf(session, outputNames[0]);
+    if (!shape.empty() && shape.back() > 0) {
+        _hiddenSize = static_cast<size_t>(shape.back());
+    }
+    // 输出为[1, hidden]说明池化已在导出的计算图中完成
+    _pooledOutput = (2 == shape.size());
+    if (_pooledOutput) {
+        _outputShape = {1, static_cast<int64_t>(_hiddenSize)};
+    } else {
+        _outputShape = {1, sequenceLength, static_cast<int64_t>(_hiddenSize)};
+    }
+    _output.assign(static_cast<size_t>(_pooledOutput ? 1 : sequenceLength) * _hiddenSize, 0.0f);
+
+    // 输入顺序与bertInputNames一致：input_ids, attention_mask, token_type_ids
+    std::vector<int64_t> *inputBuffers[] = {&_inputIds, &_attentionMask, &_tokenTypeIds};
+    size_t inputCount = std::min(inputNames.size(), sizeof(inputBuffers) / sizeof(inputBuffers[0]));
+    for (size_t i = 0; i < inputCount; ++i) {
+        _inputTensors.push_back(Ort::Value::CreateTensor<int64_t>(
+                _memoryInfo, inputBuffers[i]->data(), inputBuffers[i]->size(),
+                _inputShape.data(), _inputShape.size()));
+        _binding.BindInput(inputNames[i], _inputTensors.back());
+    }
+    _outputTensor = Ort::Value::CreateTensor<float>(_memoryInfo, _output.data(), _output.size(),
+                                                    _outputShape.data(), _outputShape.size());
+    _binding.BindOutput(outputNames[0], _outputTensor);
+
+    BLOG("BERT推理上下文创建完成: sequence_length=%lld, hidden_size=%zu, pooled_output=%d",
+         (long long) _sequenceLength, _hiddenSize, _pooledOutput ? 1 : 0);
+}
+
+bool BertInferenceContext::run(int64_t padId, float *embedding) {
+    if (nullptr == _session || nullptr == embedding) {
+        return false;
+    }
+
+    // 构建attention mask：非PAD为1，PAD为0
+    int64_t validCount = 0;
+    for (int64_t j = 0; j < _sequenceLength; ++j) {
+        _attentionMask[j] = (_inputIds[j] == padId) ? 0 : 1;
+        validCount += _attentionMask[j];
+    }
+
+    _session->Run(_runOptions, _binding);
+
+    if (_pooledOutput) {
+        std::copy(_output.begin(), _output.begin() + _hiddenSize, embedding);
+    } else {
+        // 掩码平均池化：按行累加有效token，内层循环连续访问
+        std::fill(embedding, embedding + _hiddenSize, 0.0f);
+        for (int64_t j = 0; j < _sequenceLength; ++j) {
+            if (1 != _attentionMask[j]) continue;
+            const float *row = _output.data() + static_cast<size_t>(j) * _hiddenSize;
+            for (size_t i = 0; i < _hiddenSize; ++i) {
+                embedding[i] += row[i];
+            }
+        }
+        float invCount = 1.0f / static_cast<float>(std::max<int64_t>(validCount, 1));
+        for (size_t i = 0; i < _hiddenSize; ++i) {
+            embedding[i] *= invCount;
+        }
+    }
+    normalizeL2(embedding, _hiddenSize);
+    return true;
+}
+
+ClipInferenceContext::ClipInferenceContext(Ort::Session *session, const std::vector<const char *> &inputNames,
+                                           const std::vector<const char *> &outputNames,
+                                           const std::vector<int64_t> &inputShape)
+        : _session(session), _inputShape(inputShape),
+          _memoryInfo(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault)),
+          _inputTensor(nullptr), _outputTensor(nullptr), _binding(*session) {
+    size_t inputSize = 1;
+    for (int64_t dim : _inputShape) {
+        inputSize *= static_cast<size_t>(std::max<int64_t>(dim, 1));
+    }
+    _input.assign(inputSize, 0.0f);
+
+    // 动态维度：batch按1处理，嵌入维度缺省为512
+    _outputShape = outputShapeOf(session, outputNames[0]);
+    if (_outputShape.empty()) {
+        _outputShape = {1, static_cast<int64_t>(DEFAULT_CLIP_EMBEDDING_SIZE)};
+    }
+    for (size_t i = 0; i < _outputShape.size(); ++i) {
+        if (_outputShape[i] <= 0) {
+            _outputShape[i] = (i + 1 == _outputShape.size()) ? static_cast<int64_t>(DEFAULT_CLIP_EMBEDDING_SIZE) : 1;
+        }
+    }
+    size_t outputSize = 1;
+    for (int64_t dim : _outputShape) {
+        outputSize *= static_cast<size_t>(dim);
+    }
+    _output.assign(outputSize, 0.0f);
+
+    _inputTensor = Ort::Value::CreateTensor<float>(_memoryInfo, _input.data(), _input.size(),
+                                                   _inputShape.data(), _inputShape.size());
+    _outputTensor = Ort::Value::CreateTensor<float>(_memoryInfo, _output.data(), _output.size(),
+                                                    _outputShape.data(), _outputShape.size());
+    _binding.BindInput(inputNames[0], _inputTensor);
+    _binding.BindOutput(outputNames[0], _outputTensor);
+
+    BLOG("CLIP推理上下文创建完成: input_size=%zu, embedding_size=%zu", _input.size(), _output.size());
+}
+
+bool ClipInferenceContext::run(float *embedding) {
+    if (nullptr == _session || nullptr == embedding) {
+        return false;
+    }
+    _session->Run(_runOptions, _binding);
+    std::copy(_output.begin(), _output.end(), embedding);
+    return true;
+}
+
+} // namespace fastbotx
+
+#endif // InferenceContext_CPP_
@@ -0,0 +1,92 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef InferenceContext_H_
+#define InferenceContext_H_
+
+#include <onnxruntime/onnxruntime_cxx_api.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace fastbotx {
+
+// BERT推理上下文：输入/输出缓冲区在构造时一次性分配并通过IoBinding绑定，
+// 之后每次推理只写入token id，不再创建tensor或分配内存。
+// 同一个上下文不可并发使用，调用方负责加锁（或每个线程各持有一个）。
+class BertInferenceContext {
+public:
+    BertInferenceContext(Ort::Session *session, const std::vector<const char *> &inputNames,
+                         const std::vector<const char *> &outputNames, int64_t sequenceLength);
+
+    // 输入token id缓冲区，长度为sequenceLength()，不足部分由调用方填充PAD
+    int64_t *inputIds() { return _inputIds.data(); }
+
+    int64_t sequenceLength() const { return _sequenceLength; }
+
+    // 输出嵌入的维度
+    size_t hiddenSize() const { return _hiddenSize; }
+
+    // 推理并在输出上做掩码平均池化 + L2归一化，结果写入embedding（hiddenSize()个float）
+    // 若模型导出时已包含池化（输出为[1, hidden]），直接拷贝输出
+    bool run(int64_t padId, float *embedding);
+
+private:
+    Ort::Session *_session;
+    int64_t _sequenceLength;
+    size_t _hiddenSize;
+    bool _pooledOutput;
+
+    std::vector<int64_t> _inputIds;
+    std::vector<int64_t> _attentionMask;
+    std::vector<int64_t> _tokenTypeIds;
+    std::vector<float> _output;
+
+    std::vector<int64_t> _inputShape;
+    std::vector<int64_t> _outputShape;
+    Ort::MemoryInfo _memoryInfo;
+    std::vector<Ort::Value> _inputTensors;
+    Ort::Value _outputTensor;
+    Ort::IoBinding _binding;
+    Ort::RunOptions _runOptions;
+};
+
+// CLIP图像编码推理上下文：输入为预分配的[1, 3, H, W] float缓冲区
+class ClipInferenceContext {
+public:
+    ClipInferenceContext(Ort::Session *session, const std::vector<const char *> &inputNames,
+                         const std::vector<const char *> &outputNames, const std::vector<int64_t> &inputShape);
+
+    // 输入图像缓冲区，调用方直接写入预处理后的像素
+    float *input() { return _input.data(); }
+
+    size_t inputSize() const { return _input.size(); }
+
+    size_t embeddingSize() const { return _output.size(); }
+
+    // 推理并把图像嵌入拷贝到embedding（embeddingSize()个float）
+    bool run(float *embedding);
+
+private:
+    Ort::Session *_session;
+    std::vector<float> _input;
+    std::vector<float> _output;
+
+    std::vector<int64_t> _inputShape;
+    std::vector<int64_t> _outputShape;
+    Ort::MemoryInfo _memoryInfo;
+    Ort::Value _inputTensor;
+    Ort::Value _outputTensor;
+    Ort::IoBinding _binding;
+    Ort::RunOptions _runOptions;
+};
+
+typedef std::shared_ptr<BertInferenceContext> BertInferenceContextPtr;
+typedef std::shared_ptr<ClipInferenceContext> ClipInferenceContextPtr;
+
+} // namespace fastbotx
+
+#endif // InferenceContext_H_
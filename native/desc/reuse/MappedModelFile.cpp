@@ -0,0 +1,78 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef MappedModelFile_CPP_
+#define MappedModelFile_CPP_
+
+#include "MappedModelFile.h"
+#ifdef FASTBOT_HOST_TOOL
+#include "../../tools/MergeLog.h"
+#else
+#include "../utils.hpp"
+#endif
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fastbotx {
+
+MappedModelFile::MappedModelFile()
+        : _data(nullptr), _size(0), _mapped(nullptr) {
+}
+
+MappedModelFile::~MappedModelFile() {
+    if (_mapped) {
+        munmap(_mapped, _size);
+        _mapped = nullptr;
+    }
+}
+
+MappedModelFilePtr MappedModelFile::open(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat fileStat{};
+    if (0 != fstat(fd, &fileStat) || fileStat.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    MappedModelFilePtr file(new MappedModelFile());
+    file->_size = static_cast<size_t>(fileStat.st_size);
+    void *mapped = mmap(nullptr, file->_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED != mapped) {
+        file->_mapped = mapped;
+        file->_data = static_cast<const uint8_t *>(mapped);
+        return file;
+    }
+
+    BLOG("mmap %s failed, read it into memory", path.c_str());
+    std::ifstream input(path, std::ios::binary);
+    file->_buffer.resize(file->_size);
+    if (!input.read(reinterpret_cast<char *>(file->_buffer.data()), static_cast<std::streamsize>(file->_size))) {
+        return nullptr;
+    }
+    file->_data = file->_buffer.data();
+    return file;
+}
+
+MappedModelFilePtr MappedModelFile::fromBuffer(std::vector<uint8_t> &buffer) {
+    if (buffer.empty()) {
+        return nullptr;
+    }
+    MappedModelFilePtr file(new MappedModelFile());
+    file->_buffer.swap(buffer);
+    file->_size = file->_buffer.size();
+    file->_data = file->_buffer.data();
+    return file;
+}
+
+} // namespace fastbotx
+
+#endif // MappedModelFile_CPP_
@@ -0,0 +1,129 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef MappedModelFile_H_
+#define MappedModelFile_H_
+
+#include "flatbuffers/flatbuffers.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fastbotx {
+
+class MappedModelFile;
+
+typedef std::shared_ptr<MappedModelFile> MappedModelFilePtr;
+
+// 只读映射的模型文件：FlatBuffers数据直接在映射区上读取，只有访问到的页才会载入内存。
+// mmap失败时退回到把文件读入内存。保存模型时须先写临时文件再rename，不能原地截断正在映射的文件
+class MappedModelFile {
+public:
+    // 文件不存在或为空时返回nullptr
+    static MappedModelFilePtr open(const std::string &path);
+
+    // 由内存中的数据构造（如加载时由旧格式转换出的模型），buffer会被移走；为空时返回nullptr
+    static MappedModelFilePtr fromBuffer(std::vector<uint8_t> &buffer);
+
+    ~MappedModelFile();
+
+    const uint8_t *data() const { return _data; }
+
+    size_t size() const { return _size; }
+
+    bool mapped() const { return nullptr != _mapped; }
+
+private:
+    MappedModelFile();
+
+    const uint8_t *_data;
+    size_t _size;
+    void *_mapped;
+    std::vector<uint8_t> _buffer;
+};
+
+// 按action hash查找模型中的ReuseEntry表（action字段为key）。
+// 保存时条目按key排序，直接用LookupByKey二分查找；旧版本写出的未排序文件在加载时建立一份按key排序的下标
+template<typename Entry>
+class SortedEntryTable {
+public:
+    typedef flatbuffers::Vector<flatbuffers::Offset<Entry>> EntryVector;
+
+    SortedEntryTable() : _entries(nullptr) {}
+
+    void reset(const EntryVector *entries) {
+        _entries = entries;
+        _order.clear();
+        if (nullptr == _entries) {
+            return;
+        }
+        bool sorted = true;
+        for (uint32_t i = 1; i < _entries->size() && sorted; ++i) {
+            sorted = _entries->Get(i - 1)->action() <= _entries->Get(i)->action();
+        }
+        if (sorted) {
+            return;
+        }
+        _order.resize(_entries->size());
+        for (uint32_t i = 0; i < _entries->size(); ++i) {
+            _order[i] = i;
+        }
+        const EntryVector *vector = _entries;
+        std::stable_sort(_order.begin(), _order.end(), [vector](uint32_t a, uint32_t b) {
+            return vector->Get(a)->action() < vector->Get(b)->action();
+        });
+    }
+
+    size_t size() const { return _entries ? _entries->size() : 0; }
+
+    // 第i个条目（按key升序）
+    const Entry *at(size_t i) const {
+        return _entries->Get(static_cast<flatbuffers::uoffset_t>(_order.empty() ? i : _order[i]));
+    }
+
+    // 第一个key不小于给定值的条目位置（按key升序），都小于时返回size()
+    size_t lowerBound(uint64_t key) const {
+        size_t low = 0;
+        size_t high = size();
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (at(middle)->action() < key) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    }
+
+    const Entry *find(uint64_t key) const {
+        if (nullptr == _entries) {
+            return nullptr;
+        }
+        if (_order.empty()) {
+            return _entries->LookupByKey(key);
+        }
+        const EntryVector *vector = _entries;
+        auto it = std::lower_bound(_order.begin(), _order.end(), key, [vector](uint32_t index, uint64_t value) {
+            return vector->Get(index)->action() < value;
+        });
+        if (it == _order.end() || _entries->Get(*it)->action() != key) {
+            return nullptr;
+        }
+        return _entries->Get(*it);
+    }
+
+private:
+    const EntryVector *_entries;
+    std::vector<uint32_t> _order;
+};
+
+} // namespace fastbotx
+
+#endif // MappedModelFile_H_
@@ -0,0 +1,232 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef ReuseModelJournal_CPP_
+#define ReuseModelJournal_CPP_
+
+#include "ReuseModelJournal.h"
+#include "../utils.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <unistd.h>
+
+namespace fastbotx {
+
+static const char JOURNAL_MAGIC[8] = {'F', 'B', 'R', 'J', 'O', 'U', 'R', 'N'};
+static const uint32_t JOURNAL_VERSION = 1;
+// 单条记录的widget数上限，超出视为损坏
+static const uint32_t JOURNAL_MAX_WIDGETS = 1u << 16;
+
+struct JournalFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+// 每条记录：头部之后是widgetCount个widget hash，全部为本机字节序
+struct JournalRecordHeader {
+    uint64_t sequence;
+    uint64_t actionHash;
+    uint32_t widgetCount;
+    uint32_t checksum;
+};
+
+static uint32_t recordChecksum(const JournalRecordHeader &header, const uint64_t *widgetHashes) {
+    uint32_t hash = 2166136261u;
+    auto mix = [&hash](const void *data, size_t size) {
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+    };
+    mix(&header.sequence, sizeof(header.sequence));
+    mix(&header.actionHash, sizeof(header.actionHash));
+    mix(&header.widgetCount, sizeof(header.widgetCount));
+    mix(widgetHashes, header.widgetCount * sizeof(uint64_t));
+    return hash;
+}
+
+ReuseModelJournal::ReuseModelJournal(const std::string &modelPath)
+        : _path(modelPath + ".journal"), _file(nullptr), _activeLastSequence(0) {
+    size_t slash = _path.find_last_of('/');
+    _directory = std::string::npos == slash ? "." : _path.substr(0, slash);
+    _segmentPrefix = (std::string::npos == slash ? _path : _path.substr(slash + 1)) + ".";
+}
+
+ReuseModelJournal::~ReuseModelJournal() {
+    closeActive();
+}
+
+std::vector<ReuseModelJournal::Segment> ReuseModelJournal::sealedSegments() const {
+    std::vector<Segment> segments;
+    DIR *dir = opendir(_directory.c_str());
+    if (nullptr == dir) {
+        return segments;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        std::string name = entry->d_name;
+        if (name.size() <= _segmentPrefix.size() || 0 != name.compare(0, _segmentPrefix.size(), _segmentPrefix)) {
+            continue;
+        }
+        std::string suffix = name.substr(_segmentPrefix.size());
+        if (!std::all_of(suffix.begin(), suffix.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            continue;
+        }
+        segments.push_back(Segment{std::strtoull(suffix.c_str(), nullptr, 10), _directory + "/" + name});
+    }
+    closedir(dir);
+    std::sort(segments.begin(), segments.end(), [](const Segment &a, const Segment &b) {
+        return a.lastSequence < b.lastSequence;
+    });
+    return segments;
+}
+
+long ReuseModelJournal::replayFile(const std::string &path, uint64_t snapshotSequence, uint64_t &lastSequence,
+                                   const ApplyFunction &apply, size_t &applied) const {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (nullptr == file) {
+        return 0;
+    }
+    JournalFileHeader fileHeader{};
+    if (1 != fread(&fileHeader, sizeof(fileHeader), 1, file)
+        || 0 != std::memcmp(fileHeader.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC))
+        || JOURNAL_VERSION != fileHeader.version) {
+        fclose(file);
+        return 0;
+    }
+    long validBytes = ftell(file);
+    JournalRecordHeader header{};
+    std::vector<uint64_t> widgetHashes;
+    while (1 == fread(&header, sizeof(header), 1, file)) {
+        if (header.widgetCount > JOURNAL_MAX_WIDGETS) {
+            break;
+        }
+        widgetHashes.resize(header.widgetCount);
+        if (header.widgetCount > 0 && 1 != fread(widgetHashes.data(), header.widgetCount * sizeof(uint64_t), 1, file)) {
+            break;
+        }
+        if (recordChecksum(header, widgetHashes.data()) != header.checksum) {
+            break;
+        }
+        validBytes = ftell(file);
+        if (header.sequence > std::max(snapshotSequence, lastSequence)) {
+            apply(header.actionHash, widgetHashes);
+            lastSequence = header.sequence;
+            ++applied;
+        }
+    }
+    fclose(file);
+    return validBytes;
+}
+
+uint64_t ReuseModelJournal::replay(uint64_t snapshotSequence, const ApplyFunction &apply) {
+    std::lock_guard<std::mutex> guard(_lock);
+    closeActive();
+    uint64_t lastSequence = snapshotSequence;
+    size_t applied = 0;
+    for (const auto &segment : sealedSegments()) {
+        if (segment.lastSequence > snapshotSequence) {
+            replayFile(segment.path, snapshotSequence, lastSequence, apply, applied);
+        } else {
+            std::remove(segment.path.c_str());
+        }
+    }
+
+    uint64_t beforeActive = lastSequence;
+    long validBytes = replayFile(_path, snapshotSequence, lastSequence, apply, applied);
+    if (0 == validBytes) {
+        // 不存在或文件头无效，重新开始
+        std::remove(_path.c_str());
+    } else if (0 != truncate(_path.c_str(), validBytes)) {
+        BLOGE("truncate journal %s failed", _path.c_str());
+    }
+    _activeLastSequence = lastSequence > beforeActive ? lastSequence : 0;
+    BLOG("replayed %zu journal records after sequence %llu, last sequence %llu", applied,
+         (unsigned long long) snapshotSequence, (unsigned long long) lastSequence);
+    return lastSequence;
+}
+
+bool ReuseModelJournal::openActive() {
+    if (_file) {
+        return true;
+    }
+    _file = fopen(_path.c_str(), "ab");
+    if (nullptr == _file) {
+        BLOGE("open journal %s failed", _path.c_str());
+        return false;
+    }
+    fseek(_file, 0, SEEK_END);
+    if (0 == ftell(_file)) {
+        JournalFileHeader fileHeader{};
+        std::memcpy(fileHeader.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        fileHeader.version = JOURNAL_VERSION;
+        if (1 != fwrite(&fileHeader, sizeof(fileHeader), 1, _file)) {
+            closeActive();
+            return false;
+        }
+    }
+    return true;
+}
+
+void ReuseModelJournal::closeActive() {
+    if (_file) {
+        fclose(_file);
+        _file = nullptr;
+    }
+}
+
+bool ReuseModelJournal::append(uint64_t sequence, uint64_t actionHash, const std::vector<uint64_t> &widgetHashes) {
+    if (widgetHashes.size() > JOURNAL_MAX_WIDGETS) {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(_lock);
+    if (!openActive()) {
+        return false;
+    }
+    JournalRecordHeader header{};
+    header.sequence = sequence;
+    header.actionHash = actionHash;
+    header.widgetCount = static_cast<uint32_t>(widgetHashes.size());
+    header.checksum = recordChecksum(header, widgetHashes.data());
+    bool written = 1 == fwrite(&header, sizeof(header), 1, _file)
+                   && (widgetHashes.empty()
+                       || 1 == fwrite(widgetHashes.data(), widgetHashes.size() * sizeof(uint64_t), 1, _file));
+    // 只交给页缓存：进程崩溃不丢，断电时丢失的尾部记录在重放时被校验丢弃
+    written = 0 == fflush(_file) && written;
+    _activeLastSequence = std::max(_activeLastSequence, sequence);
+    return written;
+}
+
+void ReuseModelJournal::seal() {
+    std::lock_guard<std::mutex> guard(_lock);
+    closeActive();
+    if (0 == _activeLastSequence) {
+        std::remove(_path.c_str());
+        return;
+    }
+    std::string segmentPath = _directory + "/" + _segmentPrefix + std::to_string(_activeLastSequence);
+    if (0 != std::rename(_path.c_str(), segmentPath.c_str())) {
+        BLOGE("seal journal %s failed", _path.c_str());
+        return;
+    }
+    _activeLastSequence = 0;
+}
+
+void ReuseModelJournal::discardThrough(uint64_t sequence) {
+    std::lock_guard<std::mutex> guard(_lock);
+    for (const auto &segment : sealedSegments()) {
+        if (segment.lastSequence <= sequence) {
+            std::remove(segment.path.c_str());
+        }
+    }
+}
+
+} // namespace fastbotx
+
+#endif // ReuseModelJournal_CPP_
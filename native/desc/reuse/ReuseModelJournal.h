@@ -0,0 +1,72 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef ReuseModelJournal_H_
+#define ReuseModelJournal_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fastbotx {
+
+// 复用模型的追加日志：每次学习更新追加一条记录（序号、action hash、本次计数各加1的widget hash），
+// 只写入页缓存不做fsync，每步的代价是一次小的顺序写。
+// 快照（.fbm）中记录已合并的最后序号，加载时只重放之后的记录，因此重复或过期的日志不会被计算两次。
+// 活动日志为 <模型路径>.journal；压缩时改名为 <模型路径>.journal.<其中最大的序号> 封存，快照写完后删除。线程安全
+class ReuseModelJournal {
+public:
+    typedef std::function<void(uint64_t actionHash, const std::vector<uint64_t> &widgetHashes)> ApplyFunction;
+
+    explicit ReuseModelJournal(const std::string &modelPath);
+
+    ~ReuseModelJournal();
+
+    // 按序号依次应用封存的日志和活动日志中序号大于snapshotSequence的记录，返回读到的最大序号；
+    // 每个文件在第一条不完整或校验失败的记录处停止，活动日志截掉之后的部分以便继续追加
+    uint64_t replay(uint64_t snapshotSequence, const ApplyFunction &apply);
+
+    bool append(uint64_t sequence, uint64_t actionHash, const std::vector<uint64_t> &widgetHashes);
+
+    // 封存活动日志，之后的记录写入新的活动日志
+    void seal();
+
+    // 删除最大序号不超过sequence的封存日志（已合并进快照）
+    void discardThrough(uint64_t sequence);
+
+private:
+    struct Segment {
+        uint64_t lastSequence;
+        std::string path;
+    };
+
+    std::vector<Segment> sealedSegments() const;
+
+    // 读取一个日志文件，返回有效部分的字节数
+    long replayFile(const std::string &path, uint64_t snapshotSequence, uint64_t &lastSequence,
+                    const ApplyFunction &apply, size_t &applied) const;
+
+    bool openActive();
+
+    void closeActive();
+
+    std::string _path;
+    std::string _directory;
+    std::string _segmentPrefix;
+    FILE *_file;
+    uint64_t _activeLastSequence;
+    std::mutex _lock;
+};
+
+typedef std::shared_ptr<ReuseModelJournal> ReuseModelJournalPtr;
+
+} // namespace fastbotx
+
+#endif // ReuseModelJournal_H_
@@ -116,7 +116,7 @@ namespace fastbotx {
         }
     }
 
-    void ReuseState::setWidgetIcons(const std::map<std::string, std::string>& iconMap) {
+    void ReuseState::setWidgetIcons(const WidgetIconIdMap& iconMap) {
         for (auto& widget : _widgets) {
             // 使用widget的唯一标识（如resourceId或其他标识）作为键来查找对应的图标
             std::string widgetKey = widget->getResourceID();
@@ -127,7 +127,7 @@ namespace fastbotx {
             
             auto it = iconMap.find(widgetKey);
             if (it != iconMap.end()) {
-                widget->setIcon(it->second);
+                widget->setIconId(it->second);
             }
         }
     }
@@ -0,0 +1,137 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef SimilarityEngine_CPP_
+#define SimilarityEngine_CPP_
+
+#include "SimilarityEngine.h"
+#include "WidgetIcon.h"
+#include "../utils.hpp"
+
+namespace fastbotx {
+
+SimilarityEngine::SimilarityEngine(ModelSession bert, ModelSession clip, size_t workerCount)
+        : _bert(std::move(bert)), _clip(std::move(clip)),
+          // 每个工作线程一个上下文，另留一个给直接在决策线程上的计算
+          _bertContexts(workerCount + 1), _clipContexts(workerCount + 1),
+          _workerCount(workerCount), _queue(std::make_shared<TaskQueue>()) {
+    for (size_t i = 0; i < workerCount; ++i) {
+        _workers.emplace_back(&SimilarityEngine::workerLoop, _queue);
+    }
+    BLOG("相似度引擎创建完成: BERT=%s, CLIP=%s, 工作线程%zu个", hasBert() ? "ok" : "unavailable",
+         hasClip() ? "ok" : "unavailable", workerCount);
+}
+
+SimilarityEngine::~SimilarityEngine() {
+    shutdown();
+    _bertContexts.clear();
+    _clipContexts.clear();
+}
+
+void SimilarityEngine::shutdown() {
+    {
+        std::lock_guard<std::mutex> guard(_queue->lock);
+        _queue->stopped = true;
+    }
+    _queue->available.notify_all();
+    for (auto &worker : _workers) {
+        if (worker.get_id() == std::this_thread::get_id()) {
+            // 最后一个引用在工作线程的任务中释放，该线程执行完当前任务后自行退出
+            worker.detach();
+        } else if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    _workers.clear();
+}
+
+bool SimilarityEngine::enqueue(std::function<void()> task) {
+    if (0 == _workerCount) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> guard(_queue->lock);
+        if (_queue->stopped) {
+            return false;
+        }
+        _queue->tasks.push_back(std::move(task));
+    }
+    _queue->available.notify_one();
+    return true;
+}
+
+void SimilarityEngine::workerLoop(std::shared_ptr<TaskQueue> queue) {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(queue->lock);
+            queue->available.wait(guard, [&queue]() { return queue->stopped || !queue->tasks.empty(); });
+            if (queue->tasks.empty()) {
+                return;
+            }
+            task = std::move(queue->tasks.front());
+            queue->tasks.pop_front();
+        }
+        // 任务都包装在packaged_task中，异常会转交给对应的future
+        task();
+    }
+}
+
+size_t SimilarityEngine::bertSequenceLength() const {
+    return _bert.inputShape.size() > 1 ? static_cast<size_t>(_bert.inputShape[1]) : 0;
+}
+
+bool SimilarityEngine::bertEmbedding(const std::vector<int64_t> &inputIds, int64_t padId,
+                                     std::vector<float> &embedding) {
+    if (!hasBert()) {
+        return false;
+    }
+    InferenceContextPool<BertInferenceContext>::Lease context(_bertContexts, _bertContexts.acquire([this]() {
+        return std::make_shared<BertInferenceContext>(_bert.session.get(), _bert.inputNames, _bert.outputNames,
+                                                      static_cast<int64_t>(bertSequenceLength()));
+    }));
+    // 只写入token id，掩码平均池化与L2归一化在上下文中完成，输出只拷贝一个hidden_size长度的向量
+    auto sequenceLength = static_cast<size_t>(context->sequenceLength());
+    size_t inputCount = std::min(inputIds.size(), sequenceLength);
+    std::copy(inputIds.begin(), inputIds.begin() + inputCount, context->inputIds());
+    std::fill(context->inputIds() + inputCount, context->inputIds() + sequenceLength, padId);
+
+    embedding.assign(context->hiddenSize(), 0.0f);
+    if (!context->run(padId, embedding.data())) {
+        embedding.clear();
+        return false;
+    }
+    return true;
+}
+
+bool SimilarityEngine::clipEmbedding(const cv::Mat &image, std::vector<float> &embedding) {
+    if (!hasClip() || _clip.inputShape.size() < 4) {
+        return false;
+    }
+    InferenceContextPool<ClipInferenceContext>::Lease context(_clipContexts, _clipContexts.acquire([this]() {
+        return std::make_shared<ClipInferenceContext>(_clip.session.get(), _clip.inputNames, _clip.outputNames,
+                                                      _clip.inputShape);
+    }));
+    // 输入形状为[1, 3, H, W]，缩放、通道转换、归一化一次写入输入缓冲区
+    int inputHeight = static_cast<int>(_clip.inputShape[2]);
+    int inputWidth = static_cast<int>(_clip.inputShape[3]);
+    if (context->inputSize() != static_cast<size_t>(3 * inputHeight * inputWidth) ||
+        !WidgetIcon::writeClipTensor(image, context->input(), inputWidth, inputHeight)) {
+        BLOGE("图像预处理失败: %dx%d", image.cols, image.rows);
+        return false;
+    }
+
+    embedding.assign(context->embeddingSize(), 0.0f);
+    if (!context->run(embedding.data())) {
+        embedding.clear();
+        return false;
+    }
+    return true;
+}
+
+} // namespace fastbotx
+
+#endif // SimilarityEngine_CPP_
@@ -0,0 +1,184 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef SimilarityEngine_H_
+#define SimilarityEngine_H_
+
+#include "InferenceContext.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <onnxruntime/onnxruntime_cxx_api.h>
+#include <opencv2/core/core.hpp>
+
+namespace fastbotx {
+
+// 一个模型会话及其输入输出描述，会话为空表示该模型不可用
+struct ModelSession {
+    std::unique_ptr<Ort::Session> session;
+    std::vector<const char *> inputNames;
+    std::vector<const char *> outputNames;
+    std::vector<int64_t> inputShape;
+};
+
+// 推理上下文池：上下文不可重入，同一时刻只借给一个线程；没有空闲上下文且未达上限时新建，否则等待归还
+template<typename Context>
+class InferenceContextPool {
+public:
+    typedef std::shared_ptr<Context> ContextPtr;
+
+    explicit InferenceContextPool(size_t limit) : _limit(std::max<size_t>(limit, 1)), _created(0) {}
+
+    // 借出的上下文，析构时自动归还
+    class Lease {
+    public:
+        Lease(InferenceContextPool &pool, ContextPtr context) : _pool(pool), _context(std::move(context)) {}
+
+        Lease(const Lease &) = delete;
+
+        Lease &operator=(const Lease &) = delete;
+
+        ~Lease() { _pool.release(std::move(_context)); }
+
+        Context *operator->() const { return _context.get(); }
+
+    private:
+        InferenceContextPool &_pool;
+        ContextPtr _context;
+    };
+
+    template<typename Factory>
+    ContextPtr acquire(Factory factory) {
+        std::unique_lock<std::mutex> guard(_lock);
+        _available.wait(guard, [this]() { return !_idle.empty() || _created < _limit; });
+        if (!_idle.empty()) {
+            ContextPtr context = _idle.back();
+            _idle.pop_back();
+            return context;
+        }
+        ++_created;
+        guard.unlock();
+        try {
+            return factory();
+        } catch (...) {
+            guard.lock();
+            --_created;
+            _available.notify_one();
+            throw;
+        }
+    }
+
+    void release(ContextPtr context) {
+        std::lock_guard<std::mutex> guard(_lock);
+        _idle.push_back(std::move(context));
+        _available.notify_one();
+    }
+
+    // 只能在没有借出的上下文时调用
+    void clear() {
+        std::lock_guard<std::mutex> guard(_lock);
+        _idle.clear();
+        _created = 0;
+    }
+
+private:
+    std::mutex _lock;
+    std::condition_variable _available;
+    std::vector<ContextPtr> _idle;
+    size_t _limit;
+    size_t _created;
+};
+
+class SimilarityEngine;
+
+typedef std::shared_ptr<SimilarityEngine> SimilarityEnginePtr;
+
+// 相似度引擎：持有BERT/CLIP会话、推理上下文池和固定大小的工作线程池，推理接口可被任意线程并发调用。
+// 由ActionSimilarity在模型加载完成后创建并发布；shutdown()后不再接受新任务，
+// 最后一个持有者释放时依次停止线程、释放上下文，最后释放会话
+class SimilarityEngine {
+public:
+    // workerCount为0时不创建线程，提交的任务在调用线程直接执行
+    SimilarityEngine(ModelSession bert, ModelSession clip, size_t workerCount);
+
+    ~SimilarityEngine();
+
+    bool hasBert() const { return nullptr != _bert.session; }
+
+    bool hasClip() const { return nullptr != _clip.session; }
+
+    // BERT输入的序列长度（含[CLS]和[SEP]）
+    size_t bertSequenceLength() const;
+
+    // BERT推理：inputIds超出序列长度的部分截断，不足的部分用padId填充，输出L2归一化的向量
+    bool bertEmbedding(const std::vector<int64_t> &inputIds, int64_t padId, std::vector<float> &embedding);
+
+    // CLIP推理：图像缩放、通道转换、归一化后直接写入上下文的输入缓冲区
+    bool clipEmbedding(const cv::Mat &image, std::vector<float> &embedding);
+
+    size_t workerCount() const { return _workerCount; }
+
+    // 提交一个任务，返回对应的future；没有工作线程或已shutdown时在调用线程直接执行。
+    // 任务中不要等待同一线程池中其他任务的future
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> submit(F task) {
+        typedef typename std::result_of<F()>::type Result;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        std::future<Result> future = packaged->get_future();
+        if (!enqueue([packaged]() { (*packaged)(); })) {
+            (*packaged)();
+        }
+        return future;
+    }
+
+    // 批量提交，返回的future与tasks一一对应
+    template<typename Result>
+    std::vector<std::future<Result>> submitBatch(std::vector<std::function<Result()>> tasks) {
+        std::vector<std::future<Result>> futures;
+        futures.reserve(tasks.size());
+        for (auto &task : tasks) {
+            futures.push_back(submit(std::move(task)));
+        }
+        return futures;
+    }
+
+    // 停止接受新任务，已入队的任务执行完后工作线程退出；可重复调用
+    void shutdown();
+
+private:
+    // 任务队列由工作线程共同持有，引擎在工作线程中析构时线程可以安全脱离
+    struct TaskQueue {
+        std::mutex lock;
+        std::condition_variable available;
+        std::deque<std::function<void()>> tasks;
+        bool stopped{false};
+    };
+
+    bool enqueue(std::function<void()> task);
+
+    static void workerLoop(std::shared_ptr<TaskQueue> queue);
+
+    // 会话先于上下文声明，析构时上下文先释放
+    ModelSession _bert;
+    ModelSession _clip;
+    InferenceContextPool<BertInferenceContext> _bertContexts;
+    InferenceContextPool<ClipInferenceContext> _clipContexts;
+
+    const size_t _workerCount;
+    std::shared_ptr<TaskQueue> _queue;
+    std::vector<std::thread> _workers;
+};
+
+} // namespace fastbotx
+
+#endif // SimilarityEngine_H_
@@ -0,0 +1,221 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef WidgetCountMatrix_CPP_
+#define WidgetCountMatrix_CPP_
+
+#include "WidgetCountMatrix.h"
+#include <algorithm>
+
+namespace fastbotx {
+
+// 增量缓冲并入CSR的最小项数，避免小模型频繁重建
+static const size_t MinDeltaCellsToMerge = 4096;
+
+size_t WidgetCountMatrix::DeltaRow::find(uint32_t column) const {
+    return static_cast<size_t>(std::find(columns.begin(), columns.end(), column) - columns.begin());
+}
+
+void WidgetCountMatrix::DeltaRow::append(uint32_t column, int32_t count) {
+    columns.push_back(column);
+    counts.push_back(count);
+}
+
+void WidgetCountMatrix::DeltaRow::erase(size_t i) {
+    columns[i] = columns.back();
+    counts[i] = counts.back();
+    columns.pop_back();
+    counts.pop_back();
+}
+
+size_t WidgetCountMatrix::Csr::find(uint64_t key) const {
+    auto it = std::lower_bound(rowKeys.begin(), rowKeys.end(), key);
+    if (it == rowKeys.end() || *it != key) {
+        return rowKeys.size();
+    }
+    return static_cast<size_t>(it - rowKeys.begin());
+}
+
+void WidgetCountMatrix::Csr::append(uint64_t key, const uint32_t *rowColumns, const int32_t *rowCounts,
+                                    size_t size) {
+    rowKeys.push_back(key);
+    columns.insert(columns.end(), rowColumns, rowColumns + size);
+    counts.insert(counts.end(), rowCounts, rowCounts + size);
+    rowOffsets.push_back(static_cast<uint32_t>(columns.size()));
+}
+
+WidgetCountMatrix::WidgetCountMatrix()
+        : _csr(std::make_shared<Csr>()), _deltaCells(0), _deltaNewRows(0) {
+}
+
+WidgetCountMatrix::Csr &WidgetCountMatrix::ownCsr() {
+    if (_csr.use_count() > 1) {
+        _csr = std::make_shared<Csr>(*_csr);
+    }
+    return *_csr;
+}
+
+size_t WidgetCountMatrix::rowCount() const {
+    return _csr->rowKeys.size() + _deltaNewRows;
+}
+
+size_t WidgetCountMatrix::cellCount() const {
+    return _csr->columns.size() + _deltaCells;
+}
+
+size_t WidgetCountMatrix::byteSize() const {
+    return _csr->rowKeys.capacity() * sizeof(uint64_t) + _csr->rowOffsets.capacity() * sizeof(uint32_t) +
+           _csr->columns.capacity() * sizeof(uint32_t) + _csr->counts.capacity() * sizeof(int32_t) +
+           _deltaCells * (sizeof(uint32_t) + sizeof(int32_t));
+}
+
+bool WidgetCountMatrix::contains(uint64_t key) const {
+    return _delta.find(key) != _delta.end() || _csr->find(key) < _csr->rowKeys.size();
+}
+
+bool WidgetCountMatrix::row(uint64_t key, RowView &out) const {
+    auto deltaIterator = _delta.find(key);
+    if (deltaIterator != _delta.end()) {
+        out = deltaIterator->second->view();
+        return true;
+    }
+    size_t row = _csr->find(key);
+    if (row == _csr->rowKeys.size()) {
+        return false;
+    }
+    out = _csr->view(row);
+    return true;
+}
+
+WidgetCountMatrix::DeltaRow &WidgetCountMatrix::mutableRow(uint64_t key, bool *created) {
+    if (created) {
+        *created = false;
+    }
+    auto deltaIterator = _delta.find(key);
+    if (deltaIterator != _delta.end()) {
+        // 快照还在读这一行，复制后再修改
+        if (deltaIterator->second.use_count() > 1) {
+            deltaIterator->second = std::make_shared<DeltaRow>(*deltaIterator->second);
+        }
+        return *deltaIterator->second;
+    }
+    auto row = std::make_shared<DeltaRow>();
+    size_t csrRow = _csr->find(key);
+    if (csrRow < _csr->rowKeys.size()) {
+        RowView view = _csr->view(csrRow);
+        row->columns.assign(view.columns, view.columns + view.size);
+        row->counts.assign(view.counts, view.counts + view.size);
+    } else {
+        _deltaNewRows++;
+        if (created) {
+            *created = true;
+        }
+    }
+    _deltaCells += row->size();
+    _delta.emplace(key, row);
+    return *row;
+}
+
+void WidgetCountMatrix::mergeDeltaIfNeeded() {
+    // 增量行的长度在mutableRow返回后可能变化，这里按当前内容重新统计
+    _deltaCells = 0;
+    for (const auto &delta : _delta) {
+        _deltaCells += delta.second->size();
+    }
+    if (_deltaCells > std::max(MinDeltaCellsToMerge, _csr->columns.size() / 8)) {
+        mergeDelta();
+    }
+}
+
+void WidgetCountMatrix::mergeDelta() {
+    if (_delta.empty()) {
+        return;
+    }
+    // 新的CSR由旧CSR与增量缓冲按key归并得到，增量行替换CSR中的同一行；旧CSR可能仍被快照引用，不原地修改
+    auto merged = std::make_shared<Csr>();
+    merged->rowKeys.reserve(rowCount());
+    merged->rowOffsets.reserve(rowCount() + 1);
+    merged->columns.reserve(cellCount());
+    merged->counts.reserve(cellCount());
+    forEachRow([&merged](uint64_t key, const RowView &view) {
+        merged->append(key, view.columns, view.counts, view.size);
+    });
+    _csr = merged;
+    _delta.clear();
+    _deltaCells = 0;
+    _deltaNewRows = 0;
+}
+
+void WidgetCountMatrix::scale(double factor) {
+    mergeDelta();
+    auto scaled = std::make_shared<Csr>();
+    scaled->rowKeys.reserve(_csr->rowKeys.size());
+    scaled->rowOffsets.reserve(_csr->rowOffsets.size());
+    scaled->columns.reserve(_csr->columns.size());
+    scaled->counts.reserve(_csr->counts.size());
+    for (size_t row = 0; row < _csr->rowKeys.size(); ++row) {
+        RowView view = _csr->view(row);
+        for (size_t i = 0; i < view.size; ++i) {
+            auto count = static_cast<int32_t>(view.counts[i] * factor);
+            if (count > 0) {
+                scaled->columns.push_back(view.columns[i]);
+                scaled->counts.push_back(count);
+            }
+        }
+        scaled->rowKeys.push_back(_csr->rowKeys[row]);
+        scaled->rowOffsets.push_back(static_cast<uint32_t>(scaled->columns.size()));
+    }
+    _csr = scaled;
+}
+
+void WidgetCountMatrix::forEachRow(const std::function<void(uint64_t, const RowView &)> &visit) const {
+    const Csr &csr = *_csr;
+    size_t row = 0;
+    auto deltaIterator = _delta.begin();
+    while (row < csr.rowKeys.size() || deltaIterator != _delta.end()) {
+        if (deltaIterator == _delta.end() || (row < csr.rowKeys.size() && csr.rowKeys[row] < deltaIterator->first)) {
+            visit(csr.rowKeys[row], csr.view(row));
+            row++;
+            continue;
+        }
+        if (row < csr.rowKeys.size() && csr.rowKeys[row] == deltaIterator->first) {
+            row++;
+        }
+        visit(deltaIterator->first, deltaIterator->second->view());
+        ++deltaIterator;
+    }
+}
+
+void WidgetCountMatrix::appendRow(uint64_t key, const uint32_t *columns, const int32_t *counts, size_t size) {
+    ownCsr().append(key, columns, counts, size);
+}
+
+void WidgetCountMatrix::clear() {
+    _csr = std::make_shared<Csr>();
+    _delta.clear();
+    _deltaCells = 0;
+    _deltaNewRows = 0;
+}
+
+void WidgetCountMatrix::sumRow(const RowView &row, const std::vector<uint64_t> &columnBits, long long &total,
+                               long long &marked) {
+    long long rowTotal = 0;
+    long long rowMarked = 0;
+    const uint64_t *bits = columnBits.data();
+    for (size_t i = 0; i < row.size; ++i) {
+        uint32_t column = row.columns[i];
+        long long count = row.counts[i];
+        long long mask = -static_cast<long long>((bits[column >> 6] >> (column & 63)) & 1);
+        rowTotal += count;
+        rowMarked += count & mask;
+    }
+    total = rowTotal;
+    marked = rowMarked;
+}
+
+} // namespace fastbotx
+
+#endif // WidgetCountMatrix_CPP_
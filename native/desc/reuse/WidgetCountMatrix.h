@@ -0,0 +1,125 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef WidgetCountMatrix_H_
+#define WidgetCountMatrix_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace fastbotx {
+
+// action -> widget计数的稀疏矩阵（CSR）：按action hash升序的行下标，每行的widget编号与计数分别连续存放，
+// 扫描一行是顺序读内存。新的观测先写入小的增量缓冲（按行，第一次修改时从CSR复制该行），
+// 增量缓冲超过CSR的一定比例时整体并入CSR。
+// 按值复制得到一致的快照：CSR不可变、共享，增量缓冲中的行写时复制。不是线程安全的
+class WidgetCountMatrix {
+public:
+    // 一行的只读视图，列无序
+    struct RowView {
+        const uint32_t *columns;
+        const int32_t *counts;
+        size_t size;
+
+        RowView() : columns(nullptr), counts(nullptr), size(0) {}
+
+        RowView(const uint32_t *c, const int32_t *n, size_t s) : columns(c), counts(n), size(s) {}
+    };
+
+    // 增量缓冲中的一行：列与计数一一对应，列无序
+    struct DeltaRow {
+        std::vector<uint32_t> columns;
+        std::vector<int32_t> counts;
+
+        // 列在行中的位置，不存在时返回size()
+        size_t find(uint32_t column) const;
+
+        size_t size() const { return columns.size(); }
+
+        void append(uint32_t column, int32_t count);
+
+        // 删除第i项（与最后一项交换）
+        void erase(size_t i);
+
+        RowView view() const { return RowView(columns.data(), counts.data(), columns.size()); }
+    };
+
+    WidgetCountMatrix();
+
+    // 行数（CSR与增量缓冲合计）
+    size_t rowCount() const;
+
+    // 非零项数（增量缓冲中的行按其当前内容计）
+    size_t cellCount() const;
+
+    size_t byteSize() const;
+
+    bool contains(uint64_t key) const;
+
+    // 取得一行的视图，行不存在时返回false；视图在下一次修改矩阵之前有效
+    bool row(uint64_t key, RowView &out) const;
+
+    // 取得可修改的行：不在增量缓冲中时从CSR复制，矩阵中没有时新建空行（created置为true）；
+    // 行仍被快照引用时先复制一份
+    DeltaRow &mutableRow(uint64_t key, bool *created = nullptr);
+
+    // 增量缓冲超过CSR的1/8（至少若干项）时并入CSR
+    void mergeDeltaIfNeeded();
+
+    void mergeDelta();
+
+    // 所有计数乘以factor，向下取整为0的项删除（行保留）
+    void scale(double factor);
+
+    // 按key升序遍历所有行
+    void forEachRow(const std::function<void(uint64_t, const RowView &)> &visit) const;
+
+    // 批量构建：增量缓冲须为空，key须严格升序且大于已有的行
+    void appendRow(uint64_t key, const uint32_t *columns, const int32_t *counts, size_t size);
+
+    void clear();
+
+    // 一行的计数之和，以及列在位图中置位的那部分计数之和。位图按列编号置位，须覆盖行中所有列；
+    // 循环中没有分支，编译器可以向量化
+    static void sumRow(const RowView &row, const std::vector<uint64_t> &columnBits, long long &total,
+                       long long &marked);
+
+private:
+    struct Csr {
+        std::vector<uint64_t> rowKeys;
+        std::vector<uint32_t> rowOffsets;   // rowKeys.size() + 1项
+        std::vector<uint32_t> columns;
+        std::vector<int32_t> counts;
+
+        Csr() : rowOffsets(1, 0) {}
+
+        // 行号，不存在时返回rowKeys.size()
+        size_t find(uint64_t key) const;
+
+        RowView view(size_t row) const {
+            return RowView(columns.data() + rowOffsets[row], counts.data() + rowOffsets[row],
+                           rowOffsets[row + 1] - rowOffsets[row]);
+        }
+
+        void append(uint64_t key, const uint32_t *rowColumns, const int32_t *rowCounts, size_t size);
+    };
+
+    // 被快照共享时先复制
+    Csr &ownCsr();
+
+    std::shared_ptr<Csr> _csr;
+    std::map<uint64_t, std::shared_ptr<DeltaRow>> _delta;
+    size_t _deltaCells;     // 增量缓冲中的项数
+    size_t _deltaNewRows;   // 增量缓冲中CSR没有的行数
+};
+
+} // namespace fastbotx
+
+#endif // WidgetCountMatrix_H_
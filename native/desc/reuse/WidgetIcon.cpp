@@ -9,10 +9,12 @@
 
 #include "WidgetIcon.h"
 #include <opencv2/opencv.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 #include <base64.h>
 #include <string>
 #include <vector>
 #include <stdexcept>
+#include <cstring>
 #include "../utils.hpp"
 
 namespace fastbotx {
@@ -38,16 +40,13 @@ bool WidgetIcon::loadFromBase64(const std::string& base64Icon) {
         // 保存原始base64字符串
         _base64String = base64Icon;
 
-        _icon = base64ToMat(base64Icon);
-        _isValid = !_icon.empty();
-        if (_isValid) {
-            BLOG("Base64解码成功，图像尺寸: %dx%d", _icon.cols, _icon.rows);
-            _icon = preprocess_image(_icon);
-            BLOG("图像预处理完成，新尺寸: %dx%d", _icon.cols, _icon.rows);
-        } else {
-            BLOGE("Base64解码失败，生成的图像为空");
+        std::vector<uchar> decodedData = decodeBase64(base64Icon);
+        if (decodedData.empty()) {
+            BLOGE("Base64解码失败，数据为空");
+            _isValid = false;
+            return false;
         }
-        return _isValid;
+        return loadFromBytes(decodedData);
     } catch (const std::exception& e) {
         BLOGE("加载图标失败: %s", e.what());
         _isValid = false;
@@ -55,42 +54,135 @@ bool WidgetIcon::loadFromBase64(const std::string& base64Icon) {
     }
 }
 
-cv::Mat WidgetIcon::preprocess_image(const cv::Mat& image) {
-    if (image.empty()) {
-        BLOGE("预处理失败: 输入图像为空");
-        throw std::runtime_error("无法加载图像: 图像为空");
+bool WidgetIcon::loadFromBytes(const std::vector<uchar>& bytes) {
+    try {
+        _icon = bytes.empty() ? cv::Mat() : cv::imdecode(bytes, cv::IMREAD_COLOR);
+    } catch (const cv::Exception& e) {
+        BLOGE("图像解码异常: %s", e.what());
+        _icon.release();
     }
+    _isValid = !_icon.empty();
+    if (_isValid) {
+        // 只保存解码后的8位图像，缩放和归一化在推理前由writeClipTensor一次完成；
+        // 指纹在这里一次算好，后续的嵌入缓存和相似度预筛选都直接使用
+        _fingerprint.contentHash = contentHash(bytes);
+        _fingerprint.perceptualHash = perceptualHash(_icon);
+        BLOG("图标解码成功，图像尺寸: %dx%d", _icon.cols, _icon.rows);
+    } else {
+        _fingerprint = IconFingerprint();
+        BLOGE("图像解码失败，生成的图像为空");
+    }
+    return _isValid;
+}
 
-    BLOG("开始预处理图像，原始尺寸: %dx%d", image.cols, image.rows);
-    
-    // 创建一个新的 Mat 对象，存储调整大小后的图像
-    cv::Mat resized_image;
-    cv::resize(image, resized_image, cv::Size(224, 224));
-    BLOG("图像调整大小完成: %dx%d", resized_image.cols, resized_image.rows);
-
-    // 转换为浮点类型并归一化
-    resized_image.convertTo(resized_image, CV_32F, 1.0 / 255.0);
-    BLOG("图像归一化完成");
-
-    // 转换为 RGB 格式
-    cv::Mat rgb_image;
-    cv::cvtColor(resized_image, rgb_image, cv::COLOR_BGR2RGB);
-    BLOG("图像转换为RGB格式完成");
-
-    // 转换为 CHW 格式（通道分离和合并）
-    std::vector<cv::Mat> channels(3);
-    cv::split(rgb_image, channels);
-    cv::Mat chw_image;
-    cv::merge(channels, chw_image);
-    BLOG("图像转换为CHW格式完成");
-
-    return chw_image;
+// CLIP图像编码器的归一化参数（RGB顺序）
+static const float CLIP_MEAN[3] = {0.48145466f, 0.4578275f, 0.40821073f};
+static const float CLIP_STD[3] = {0.26862954f, 0.26130258f, 0.27577711f};
+
+// 垂直方向插值：两行8位像素按权重混合为一行float（保持BGR交错布局）
+static void interpolateRows(const uchar* row0, const uchar* row1, float weight, float* out, int count) {
+    int i = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+    cv::v_float32 vWeight = cv::vx_setall_f32(weight);
+    for (; i <= count - lanes; i += lanes) {
+        cv::v_float32 top = cv::v_cvt_f32(cv::v_reinterpret_as_s32(cv::vx_load_expand_q(row0 + i)));
+        cv::v_float32 bottom = cv::v_cvt_f32(cv::v_reinterpret_as_s32(cv::vx_load_expand_q(row1 + i)));
+        cv::v_store(out + i, cv::v_fma(cv::v_sub(bottom, top), vWeight, top));
+    }
+#endif
+    for (; i < count; ++i) {
+        float top = row0[i];
+        out[i] = top + (static_cast<float>(row1[i]) - top) * weight;
+    }
 }
 
-std::vector<float> WidgetIcon::mat_to_tensor(const cv::Mat& image) {
-    std::vector<float> tensor_values;
-    tensor_values.assign((float*)image.datastart, (float*)image.dataend);
-    return tensor_values;
+// 水平方向插值 + 归一化：从交错行中按下标取出一个通道，结果连续写入该通道的平面
+static void interpolateColumns(const float* row, const int* left, const int* right, const float* weights,
+                               float scale, float bias, float* out, int width) {
+    int x = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+    cv::v_float32 vScale = cv::vx_setall_f32(scale);
+    cv::v_float32 vBias = cv::vx_setall_f32(bias);
+    for (; x <= width - lanes; x += lanes) {
+        cv::v_float32 leftValue = cv::v_lut(row, left + x);
+        cv::v_float32 rightValue = cv::v_lut(row, right + x);
+        cv::v_float32 value = cv::v_fma(cv::v_sub(rightValue, leftValue), cv::vx_load(weights + x), leftValue);
+        cv::v_store(out + x, cv::v_fma(value, vScale, vBias));
+    }
+#endif
+    for (; x < width; ++x) {
+        float leftValue = row[left[x]];
+        float value = leftValue + (row[right[x]] - leftValue) * weights[x];
+        out[x] = value * scale + bias;
+    }
+}
+
+// 与cv::resize(INTER_LINEAR)相同的像素中心对齐方式，计算源坐标的两个邻点与权重
+static void linearSource(int dst, int dstSize, int srcSize, int& first, int& second, float& weight) {
+    float src = (static_cast<float>(dst) + 0.5f) * static_cast<float>(srcSize) / static_cast<float>(dstSize) - 0.5f;
+    if (src < 0.0f) src = 0.0f;
+    first = static_cast<int>(src);
+    if (first >= srcSize - 1) {
+        first = srcSize - 1;
+        second = first;
+        weight = 0.0f;
+    } else {
+        second = first + 1;
+        weight = src - static_cast<float>(first);
+    }
+}
+
+bool WidgetIcon::writeClipTensor(const cv::Mat& image, float* out, int width, int height) {
+    if (image.empty() || nullptr == out || width <= 0 || height <= 0 || image.depth() != CV_8U) {
+        return false;
+    }
+    cv::Mat bgr = image;
+    if (1 == image.channels()) {
+        cv::cvtColor(image, bgr, cv::COLOR_GRAY2BGR);
+    } else if (4 == image.channels()) {
+        cv::cvtColor(image, bgr, cv::COLOR_BGRA2BGR);
+    } else if (3 != image.channels()) {
+        return false;
+    }
+
+    const int srcWidth = bgr.cols;
+    const int srcHeight = bgr.rows;
+    const size_t planeSize = static_cast<size_t>(width) * height;
+
+    // 插值表与行缓冲按线程复用，推理前的预处理不再分配整幅中间图像
+    static thread_local std::vector<int> leftIndex, rightIndex;
+    static thread_local std::vector<float> columnWeights, rowBuffer;
+    leftIndex.resize(width);
+    rightIndex.resize(width);
+    columnWeights.resize(width);
+    rowBuffer.resize(static_cast<size_t>(srcWidth) * 3);
+    for (int x = 0; x < width; ++x) {
+        int first = 0, second = 0;
+        linearSource(x, width, srcWidth, first, second, columnWeights[x]);
+        leftIndex[x] = first * 3;
+        rightIndex[x] = second * 3;
+    }
+
+    // 输出通道为RGB，对应BGR源中的第2/1/0个分量；(v / 255 - mean) / std 合并为 v * scale + bias
+    float scale[3], bias[3];
+    for (int c = 0; c < 3; ++c) {
+        scale[c] = 1.0f / (255.0f * CLIP_STD[c]);
+        bias[c] = -CLIP_MEAN[c] / CLIP_STD[c];
+    }
+
+    for (int y = 0; y < height; ++y) {
+        int top = 0, bottom = 0;
+        float rowWeight = 0.0f;
+        linearSource(y, height, srcHeight, top, bottom, rowWeight);
+        interpolateRows(bgr.ptr<uchar>(top), bgr.ptr<uchar>(bottom), rowWeight, rowBuffer.data(), srcWidth * 3);
+        for (int c = 0; c < 3; ++c) {
+            interpolateColumns(rowBuffer.data() + (2 - c), leftIndex.data(), rightIndex.data(), columnWeights.data(),
+                               scale[c], bias[c], out + c * planeSize + static_cast<size_t>(y) * width, width);
+        }
+    }
+    return true;
 }
 
 cv::Mat WidgetIcon::getIcon() const {
@@ -101,28 +193,40 @@ bool WidgetIcon::isEmpty() const {
     return !_isValid || _icon.empty();
 }
 
-cv::Mat WidgetIcon::base64ToMat(const std::string& base64String) {
-    BLOG("开始解码Base64字符串");
-    
-    // 解码 Base64 字符串为二进制数据
-    std::vector<uchar> decodedData = decodeBase64(base64String);
-    BLOG("Base64解码完成，数据大小: %zu bytes", decodedData.size());
-
-    // 检查解码是否成功
-    if (decodedData.empty()) {
-        BLOGE("Base64解码失败，数据为空");
-        throw std::runtime_error("Failed to decode Base64 string.");
+uint64_t WidgetIcon::contentHash(const std::vector<uchar>& bytes) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (uchar byte : bytes) {
+        hash ^= byte;
+        hash *= 0x100000001b3ULL;
     }
+    return hash;
+}
 
-    // 将二进制数据转换为 OpenCV Mat
-    cv::Mat img = cv::imdecode(decodedData, cv::IMREAD_COLOR);
-    if (img.empty()) {
-        BLOGE("图像解码失败");
-        throw std::runtime_error("Failed to decode image from binary data.");
+uint64_t WidgetIcon::perceptualHash(const cv::Mat& image) {
+    if (image.empty() || image.depth() != CV_8U) {
+        return 0;
     }
+    cv::Mat gray = image;
+    if (3 == image.channels()) {
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    } else if (4 == image.channels()) {
+        cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
+    }
+    // 区域插值缩放到9x8，每行8对相邻像素共64位
+    cv::Mat small;
+    cv::resize(gray, small, cv::Size(9, 8), 0, 0, cv::INTER_AREA);
+    uint64_t hash = 0;
+    for (int y = 0; y < 8; ++y) {
+        const uchar* row = small.ptr<uchar>(y);
+        for (int x = 0; x < 8; ++x) {
+            hash = (hash << 1) | (row[x] < row[x + 1] ? 1ULL : 0ULL);
+        }
+    }
+    return hash;
+}
 
-    BLOG("图像解码成功，尺寸: %dx%d", img.cols, img.rows);
-    return img;
+int WidgetIcon::hammingDistance(uint64_t hash1, uint64_t hash2) {
+    return __builtin_popcountll(hash1 ^ hash2);
 }
 
 std::vector<uchar> WidgetIcon::decodeBase64(const std::string& base64String) {
@@ -8,11 +8,18 @@
 #define WidgetIcon_H_
 
 #include <opencv2/opencv.hpp>
+#include <cstdint>
 #include <memory>
 #include <string>
 
 namespace fastbotx {
 
+// 图标指纹：contentHash为解码后图片字节的64位FNV-1a，perceptualHash为64位dHash（9x8灰度相邻像素比较）
+struct IconFingerprint {
+    uint64_t contentHash{0};
+    uint64_t perceptualHash{0};
+};
+
 class WidgetIcon {
 public:
     WidgetIcon();
@@ -21,10 +28,30 @@ public:
 
     // 从Base64字符串加载图标
     bool loadFromBase64(const std::string& base64Icon);
+
+    // 从已解码的压缩图片字节（PNG/JPEG等）加载图标，不保存base64
+    bool loadFromBytes(const std::vector<uchar>& bytes);
+
+    // 去掉data URI前缀和空白后解码base64，失败返回空
+    static std::vector<uchar> decodeBase64(const std::string& base64String);
+
+    // 压缩图片字节的64位FNV-1a
+    static uint64_t contentHash(const std::vector<uchar>& bytes);
     
-    static std::vector<float> mat_to_tensor(const cv::Mat& image);
+    // 融合预处理：一次遍历完成双线性缩放、BGR转RGB、CLIP均值方差归一化，
+    // 按CHW布局直接写入预分配的推理输入缓冲区out（3 * height * width个float）
+    static bool writeClipTensor(const cv::Mat& image, float* out, int width, int height);
 
-    // 获取图标
+    // 解码后的字节内容哈希与感知哈希，图标无效时均为0
+    const IconFingerprint& getFingerprint() const { return _fingerprint; }
+
+    // 64位dHash：缩放为9x8灰度后逐行比较相邻像素，对缩放、压缩和轻微颜色变化不敏感
+    static uint64_t perceptualHash(const cv::Mat& image);
+
+    // 两个感知哈希的汉明距离（0-64）
+    static int hammingDistance(uint64_t hash1, uint64_t hash2);
+
+    // 获取解码后的8位BGR图标（未缩放）
     cv::Mat getIcon() const;
 
     // 检查图标是否为空
@@ -37,12 +64,7 @@ private:
     cv::Mat _icon;
     bool _isValid;
     std::string _base64String;  // 保存原始的base64字符串
-    
-    // 从Base64解码为图像
-    static cv::Mat base64ToMat(const std::string& base64String);
-    static std::vector<uchar> decodeBase64(const std::string& base64String);
-    // 预处理图标尺寸
-    cv::Mat preprocess_image(const cv::Mat& image);
+    IconFingerprint _fingerprint;
 };
 
 using WidgetIconPtr = std::shared_ptr<WidgetIcon>;
@@ -0,0 +1,382 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef WidgetReuseModelFormat_CPP_
+#define WidgetReuseModelFormat_CPP_
+
+#include "WidgetReuseModelFormat.h"
+#include "base64.h"
+#ifdef FASTBOT_HOST_TOOL
+#include "../../tools/MergeLog.h"
+#else
+#include "../utils.hpp"
+#endif
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <utility>
+
+namespace fastbotx {
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size) {
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static uint64_t embeddingHash(const Int8EmbeddingView &view) {
+    uint64_t hash = fnv1a(0xcbf29ce484222325ULL, &view.scale, sizeof(view.scale));
+    return fnv1a(hash, view.values, view.size);
+}
+
+static std::string stringOf(const flatbuffers::String *value) {
+    return value ? value->str() : std::string();
+}
+
+WidgetReuseDictionary::WidgetReuseDictionary(flatbuffers::FlatBufferBuilder &builder)
+        : _builder(builder) {
+    _activities.push_back(CreateActivityRecord(_builder));
+    _icons.push_back(CreateIconRecord(_builder));
+    _widgets.push_back(CreateWidgetRecord(_builder));
+    _actions.push_back(CreateActionRecord(_builder));
+}
+
+flatbuffers::Offset<QuantizedEmbedding> WidgetReuseDictionary::embedding(const Int8EmbeddingView &view) {
+    flatbuffers::Offset<QuantizedEmbedding> offset;
+    if (view.empty()) {
+        return offset;
+    }
+    uint64_t key = embeddingHash(view);
+    auto it = _embeddings.find(key);
+    if (it != _embeddings.end()) {
+        return it->second;
+    }
+    offset = CreateQuantizedEmbedding(_builder, view.scale, _builder.CreateVector(view.values, view.size));
+    _embeddings[key] = offset;
+    return offset;
+}
+
+uint64_t WidgetReuseDictionary::iconKey(const uint8_t *bytes, size_t size, const Int8EmbeddingView &embedding) {
+    // 保存了向量的图标可能省略了字节，因此有向量时只按向量比较
+    if (!embedding.empty()) {
+        return embeddingHash(embedding);
+    }
+    return fnv1a(0x84222325cbf29ce4ULL, bytes, size);
+}
+
+std::string WidgetReuseDictionary::widgetContentKey(const std::string &text, const std::string &resourceId,
+                                                    uint32_t activity, uint32_t icon) {
+    std::string key = text;
+    key.push_back('\0');
+    key.append(resourceId);
+    key.push_back('\0');
+    key.append(reinterpret_cast<const char *>(&activity), sizeof(activity));
+    key.append(reinterpret_cast<const char *>(&icon), sizeof(icon));
+    return key;
+}
+
+std::string WidgetReuseDictionary::actionKey(int32_t actionType, uint32_t activity, uint32_t targetWidget) {
+    std::string key;
+    key.append(reinterpret_cast<const char *>(&actionType), sizeof(actionType));
+    key.append(reinterpret_cast<const char *>(&activity), sizeof(activity));
+    key.append(reinterpret_cast<const char *>(&targetWidget), sizeof(targetWidget));
+    return key;
+}
+
+void WidgetReuseDictionary::copyFrom(const WidgetReuseModel *model) {
+    if (nullptr == model) {
+        return;
+    }
+    // 下标0在双方都是空记录，从1开始复制；模型中重复的记录也照样复制以保持下标，查找时取第一个
+    if (const auto *activities = model->activities()) {
+        for (uint32_t i = 1; i < activities->size(); ++i) {
+            const auto *record = activities->Get(i);
+            std::string name = stringOf(record->name());
+            _activityIndex.emplace(name, static_cast<uint32_t>(_activities.size()));
+            auto embeddingOffset = embedding(embeddingView(record->embedding()));
+            _activities.push_back(CreateActivityRecord(_builder, _builder.CreateString(name), embeddingOffset));
+        }
+    }
+    if (const auto *icons = model->icons()) {
+        for (uint32_t i = 1; i < icons->size(); ++i) {
+            const auto *record = icons->Get(i);
+            const uint8_t *bytes = record->bytes() ? record->bytes()->data() : nullptr;
+            size_t size = record->bytes() ? record->bytes()->size() : 0;
+            Int8EmbeddingView view = embeddingView(record->embedding());
+            _iconIndex.emplace(iconKey(bytes, size, view), static_cast<uint32_t>(_icons.size()));
+            auto bytesOffset = size > 0 ? _builder.CreateVector(bytes, size) : 0;
+            auto embeddingOffset = embedding(view);
+            _icons.push_back(CreateIconRecord(_builder, bytesOffset, embeddingOffset));
+        }
+    }
+    if (const auto *widgets = model->widgets()) {
+        for (uint32_t i = 1; i < widgets->size(); ++i) {
+            const auto *record = widgets->Get(i);
+            std::string text = stringOf(record->text());
+            std::string resourceId = stringOf(record->resource_id());
+            auto index = static_cast<uint32_t>(_widgets.size());
+            if (0 != record->hash()) {
+                _widgetIndex.emplace(record->hash(), index);
+            } else {
+                _targetWidgetIndex.emplace(widgetContentKey(text, resourceId, record->activity(), record->icon()), index);
+            }
+            auto textOffset = _builder.CreateString(text);
+            auto resourceIdOffset = _builder.CreateString(resourceId);
+            auto textEmbedding = embedding(embeddingView(record->text_embedding()));
+            auto resourceIdEmbedding = embedding(embeddingView(record->resource_id_embedding()));
+            _widgets.push_back(CreateWidgetRecord(_builder, record->hash(), textOffset, resourceIdOffset,
+                                                  record->activity(), record->icon(),
+                                                  textEmbedding, resourceIdEmbedding));
+        }
+    }
+    if (const auto *actions = model->actions()) {
+        for (uint32_t i = 1; i < actions->size(); ++i) {
+            const auto *record = actions->Get(i);
+            _actionIndex.emplace(actionKey(record->action_type(), record->activity(), record->target_widget()),
+                                 static_cast<uint32_t>(_actions.size()));
+            _actions.push_back(CreateActionRecord(_builder, record->action_type(), record->activity(),
+                                                  record->target_widget()));
+        }
+    }
+}
+
+uint32_t WidgetReuseDictionary::findActivity(const std::string &name) const {
+    auto it = _activityIndex.find(name);
+    return it == _activityIndex.end() ? 0 : it->second;
+}
+
+uint32_t WidgetReuseDictionary::activity(const std::string &name, const Int8EmbeddingView &embeddingValue) {
+    if (name.empty()) {
+        return 0;
+    }
+    uint32_t index = findActivity(name);
+    if (0 != index) {
+        return index;
+    }
+    index = static_cast<uint32_t>(_activities.size());
+    _activityIndex[name] = index;
+    auto nameOffset = _builder.CreateString(name);
+    auto embeddingOffset = embedding(embeddingValue);
+    _activities.push_back(CreateActivityRecord(_builder, nameOffset, embeddingOffset));
+    return index;
+}
+
+uint32_t WidgetReuseDictionary::icon(const uint8_t *bytes, size_t size, const Int8EmbeddingView &embeddingValue) {
+    if ((nullptr == bytes || 0 == size) && embeddingValue.empty()) {
+        return 0;
+    }
+    uint64_t key = iconKey(bytes, size, embeddingValue);
+    auto it = _iconIndex.find(key);
+    if (it != _iconIndex.end()) {
+        return it->second;
+    }
+    auto index = static_cast<uint32_t>(_icons.size());
+    _iconIndex[key] = index;
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> bytesOffset;
+    if (embeddingValue.empty()) {
+        bytesOffset = _builder.CreateVector(bytes, size);
+    }
+    auto embeddingOffset = embedding(embeddingValue);
+    _icons.push_back(CreateIconRecord(_builder, bytesOffset, embeddingOffset));
+    return index;
+}
+
+uint32_t WidgetReuseDictionary::findWidget(uint64_t hash) const {
+    auto it = _widgetIndex.find(hash);
+    return it == _widgetIndex.end() ? 0 : it->second;
+}
+
+uint32_t WidgetReuseDictionary::widget(uint64_t hash, const std::string &text, const std::string &resourceId,
+                                       uint32_t activity, uint32_t icon, const Int8EmbeddingView &textEmbedding,
+                                       const Int8EmbeddingView &resourceIdEmbedding) {
+    auto index = static_cast<uint32_t>(_widgets.size());
+    if (0 != hash) {
+        auto inserted = _widgetIndex.emplace(hash, index);
+        if (!inserted.second) {
+            return inserted.first->second;
+        }
+    } else {
+        if (text.empty() && resourceId.empty() && 0 == activity && 0 == icon) {
+            return 0;
+        }
+        auto inserted = _targetWidgetIndex.emplace(widgetContentKey(text, resourceId, activity, icon), index);
+        if (!inserted.second) {
+            return inserted.first->second;
+        }
+    }
+    auto textOffset = _builder.CreateString(text);
+    auto resourceIdOffset = _builder.CreateString(resourceId);
+    auto textEmbeddingOffset = embedding(textEmbedding);
+    auto resourceIdEmbeddingOffset = embedding(resourceIdEmbedding);
+    _widgets.push_back(CreateWidgetRecord(_builder, hash, textOffset, resourceIdOffset, activity, icon,
+                                          textEmbeddingOffset, resourceIdEmbeddingOffset));
+    return index;
+}
+
+uint32_t WidgetReuseDictionary::action(int32_t actionType, uint32_t activity, uint32_t targetWidget) {
+    auto index = static_cast<uint32_t>(_actions.size());
+    auto inserted = _actionIndex.emplace(actionKey(actionType, activity, targetWidget), index);
+    if (!inserted.second) {
+        return inserted.first->second;
+    }
+    _actions.push_back(CreateActionRecord(_builder, actionType, activity, targetWidget));
+    return index;
+}
+
+uint32_t WidgetReuseDictionary::copyActivity(const WidgetReuseModel *model, uint32_t index) {
+    const auto *record = dictionaryRecord(model->activities(), index);
+    if (nullptr == record) {
+        return 0;
+    }
+    return activity(stringOf(record->name()), embeddingView(record->embedding()));
+}
+
+uint32_t WidgetReuseDictionary::copyWidget(const WidgetReuseModel *model, uint32_t index) {
+    const auto *record = dictionaryRecord(model->widgets(), index);
+    if (nullptr == record) {
+        return 0;
+    }
+    if (0 != record->hash()) {
+        uint32_t existing = findWidget(record->hash());
+        if (0 != existing) {
+            return existing;
+        }
+    }
+    uint32_t iconIndex = 0;
+    if (const auto *iconRecord = dictionaryRecord(model->icons(), record->icon())) {
+        iconIndex = icon(iconRecord->bytes() ? iconRecord->bytes()->data() : nullptr,
+                         iconRecord->bytes() ? iconRecord->bytes()->size() : 0,
+                         embeddingView(iconRecord->embedding()));
+    }
+    return widget(record->hash(), stringOf(record->text()), stringOf(record->resource_id()),
+                  copyActivity(model, record->activity()), iconIndex, embeddingView(record->text_embedding()),
+                  embeddingView(record->resource_id_embedding()));
+}
+
+uint32_t WidgetReuseDictionary::copyAction(const WidgetReuseModel *model, uint32_t index) {
+    const auto *record = dictionaryRecord(model->actions(), index);
+    if (nullptr == record) {
+        return 0;
+    }
+    return action(record->action_type(), copyActivity(model, record->activity()),
+                  copyWidget(model, record->target_widget()));
+}
+
+flatbuffers::Offset<WidgetReuseModel> WidgetReuseDictionary::finish(
+        const std::vector<flatbuffers::Offset<ReuseEntryV2>> &entries, const std::string &platformInfo,
+        uint64_t journalSequence) {
+    auto entriesOffset = _builder.CreateVector(entries);
+    auto activitiesOffset = _builder.CreateVector(_activities);
+    auto iconsOffset = _builder.CreateVector(_icons);
+    auto widgetsOffset = _builder.CreateVector(_widgets);
+    auto actionsOffset = _builder.CreateVector(_actions);
+    return CreateWidgetReuseModel(_builder, 0, _builder.CreateString(platformInfo), true, journalSequence,
+                                  WIDGET_REUSE_MODEL_FORMAT_V2, entriesOffset, activitiesOffset, iconsOffset,
+                                  widgetsOffset, actionsOffset);
+}
+
+bool WidgetReuseModelFormat::isV1(const WidgetReuseModel *model) {
+    return nullptr != model && model->format_version() < WIDGET_REUSE_MODEL_FORMAT_V2 && nullptr != model->model();
+}
+
+bool WidgetReuseModelFormat::convertToV2(const uint8_t *data, size_t size, std::vector<uint8_t> &out) {
+    flatbuffers::Verifier verifier(data, size);
+    if (!VerifyWidgetReuseModelBuffer(verifier)) {
+        BLOGE("widget reuse model failed verification, %zu bytes", size);
+        return false;
+    }
+    const WidgetReuseModel *model = GetWidgetReuseModel(data);
+    if (!isV1(model)) {
+        return false;
+    }
+
+    flatbuffers::FlatBufferBuilder builder;
+    WidgetReuseDictionary dictionary(builder);
+    auto widgetIndexOf = [&dictionary](uint64_t widgetHash, const WidgetSimilarityAttributes *attrs) -> uint32_t {
+        uint32_t index = 0 != widgetHash ? dictionary.findWidget(widgetHash) : 0;
+        if (0 != index) {
+            return index;
+        }
+        if (nullptr == attrs) {
+            return dictionary.widget(widgetHash, "", "", 0, 0, Int8EmbeddingView(), Int8EmbeddingView());
+        }
+        uint32_t activity = dictionary.activity(stringOf(attrs->activity_name()),
+                                                embeddingView(attrs->activity_embedding()));
+        std::string iconBytes = attrs->icon_base64() ? base64_decode(attrs->icon_base64()->str()) : std::string();
+        uint32_t icon = dictionary.icon(reinterpret_cast<const uint8_t *>(iconBytes.data()), iconBytes.size(),
+                                        embeddingView(attrs->icon_embedding()));
+        return dictionary.widget(widgetHash, stringOf(attrs->text()), stringOf(attrs->resource_id()), activity, icon,
+                                 embeddingView(attrs->text_embedding()),
+                                 embeddingView(attrs->resource_id_embedding()));
+    };
+
+    // 旧版本写出的条目可能未排序；同一action出现多次时只保留第一条
+    std::map<uint64_t, const ReuseEntry *> sortedEntries;
+    for (const auto *entry : *model->model()) {
+        sortedEntries.emplace(entry->action(), entry);
+    }
+
+    std::vector<flatbuffers::Offset<ReuseEntryV2>> entries;
+    entries.reserve(sortedEntries.size());
+    size_t widgetOccurrences = 0;
+    for (const auto &entryPair : sortedEntries) {
+        const ReuseEntry *entry = entryPair.second;
+        // widget hash -> (字典下标, 多个activity中的最大计数)
+        std::map<uint64_t, std::pair<uint32_t, int>> widgetCounts;
+        if (entry->activities()) {
+            for (const auto *activityEntry : *entry->activities()) {
+                if (nullptr == activityEntry->widgets()) {
+                    continue;
+                }
+                for (const auto *widgetEntry : *activityEntry->widgets()) {
+                    widgetOccurrences++;
+                    auto it = widgetCounts.find(widgetEntry->widget_hash());
+                    if (it != widgetCounts.end()) {
+                        it->second.second = std::max(it->second.second, static_cast<int>(widgetEntry->count()));
+                        continue;
+                    }
+                    uint32_t index = widgetIndexOf(widgetEntry->widget_hash(), widgetEntry->similarity_attrs());
+                    widgetCounts[widgetEntry->widget_hash()] = std::make_pair(index, static_cast<int>(widgetEntry->count()));
+                }
+            }
+        }
+
+        uint32_t attributes = 0;
+        if (const auto *actionAttrs = entry->similarity_attrs()) {
+            const auto *targetAttrs = actionAttrs->target_widget();
+            std::string activityName = stringOf(actionAttrs->activity_name());
+            // action本身没有保存activity向量，目标widget的activity相同时借用它的向量
+            Int8EmbeddingView activityEmbedding;
+            if (targetAttrs && stringOf(targetAttrs->activity_name()) == activityName) {
+                activityEmbedding = embeddingView(targetAttrs->activity_embedding());
+            }
+            uint32_t activity = dictionary.activity(activityName, activityEmbedding);
+            uint32_t targetWidget = targetAttrs ? widgetIndexOf(0, targetAttrs) : 0;
+            attributes = dictionary.action(actionAttrs->action_type(), activity, targetWidget);
+        }
+
+        std::vector<WidgetCountRef> widgetRefs;
+        widgetRefs.reserve(widgetCounts.size());
+        for (const auto &widgetPair : widgetCounts) {
+            widgetRefs.emplace_back(widgetPair.second.first, widgetPair.second.second);
+        }
+        entries.push_back(CreateReuseEntryV2Direct(builder, entry->action(), attributes, &widgetRefs));
+    }
+
+    auto root = dictionary.finish(entries, stringOf(model->platform_info()), model->journal_sequence());
+    builder.Finish(root);
+    out.assign(builder.GetBufferPointer(), builder.GetBufferPointer() + builder.GetSize());
+    BLOG("converted widget reuse model to v2: %zu -> %zu bytes, %zu actions, %zu widget occurrences -> %zu widgets, "
+         "%zu icons, %zu embeddings", size, out.size(), entries.size(), widgetOccurrences, dictionary.widgetCount(),
+         dictionary.iconCount(), dictionary.embeddingCount());
+    return true;
+}
+
+} // namespace fastbotx
+
+#endif // WidgetReuseModelFormat_CPP_
@@ -0,0 +1,119 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef WidgetReuseModelFormat_H_
+#define WidgetReuseModelFormat_H_
+
+#include "../../storage/WidgetReuseModel_generated.h"
+#include "EmbeddingQuantizer.h"
+#include "flatbuffers/flatbuffers.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fastbotx {
+
+// 带去重属性字典的模型格式版本（WidgetReuseModel.format_version）
+static const int32_t WIDGET_REUSE_MODEL_FORMAT_V2 = 2;
+
+// 按下标取字典中的记录，下标为0（空记录）或越界时返回nullptr
+template<typename Record>
+inline const Record *dictionaryRecord(const flatbuffers::Vector<flatbuffers::Offset<Record>> *records, uint32_t index) {
+    if (0 == index || nullptr == records || index >= records->size()) {
+        return nullptr;
+    }
+    return records->Get(index);
+}
+
+// 量化向量表的零拷贝视图
+inline Int8EmbeddingView embeddingView(const QuantizedEmbedding *embedding) {
+    if (nullptr == embedding || nullptr == embedding->values() || 0 == embedding->values()->size()) {
+        return Int8EmbeddingView();
+    }
+    return Int8EmbeddingView(embedding->values()->data(), embedding->values()->size(), embedding->scale());
+}
+
+// 写v2模型时的去重字典：activity按名称、图标按内容（有向量时按向量，否则按字节）、widget按hash
+// （没有hash的目标widget按属性内容）、action属性按内容去重，每条记录只写一次；相同内容的向量表也只写一次。
+// 下标0是保留的空记录。只在一个FlatBufferBuilder上使用，不是线程安全的
+class WidgetReuseDictionary {
+public:
+    explicit WidgetReuseDictionary(flatbuffers::FlatBufferBuilder &builder);
+
+    // 原样复制一个v2模型的全部字典并保持下标，之后该模型中条目的引用可以直接写出；须在添加其他记录之前调用
+    void copyFrom(const WidgetReuseModel *model);
+
+    // 以下返回记录的下标，已有相同内容的记录时返回它；没有任何内容时返回0
+    uint32_t findActivity(const std::string &name) const;
+
+    uint32_t activity(const std::string &name, const Int8EmbeddingView &embedding);
+
+    // 有向量时不再写入图片字节
+    uint32_t icon(const uint8_t *bytes, size_t size, const Int8EmbeddingView &embedding);
+
+    uint32_t findWidget(uint64_t hash) const;
+
+    uint32_t widget(uint64_t hash, const std::string &text, const std::string &resourceId, uint32_t activity,
+                    uint32_t icon, const Int8EmbeddingView &textEmbedding, const Int8EmbeddingView &resourceIdEmbedding);
+
+    uint32_t action(int32_t actionType, uint32_t activity, uint32_t targetWidget);
+
+    // 从另一个v2模型的字典中按内容复制一条记录（连同它引用的activity、图标和目标widget），只写入被引用的记录；
+    // 下标与原模型不同。原记录不存在时返回0
+    uint32_t copyActivity(const WidgetReuseModel *model, uint32_t index);
+
+    uint32_t copyWidget(const WidgetReuseModel *model, uint32_t index);
+
+    uint32_t copyAction(const WidgetReuseModel *model, uint32_t index);
+
+    // 写出根表，entries须已按action hash升序
+    flatbuffers::Offset<WidgetReuseModel> finish(const std::vector<flatbuffers::Offset<ReuseEntryV2>> &entries,
+                                                 const std::string &platformInfo, uint64_t journalSequence);
+
+    size_t widgetCount() const { return _widgets.size() - 1; }
+
+    size_t iconCount() const { return _icons.size() - 1; }
+
+    size_t embeddingCount() const { return _embeddings.size(); }
+
+private:
+    flatbuffers::Offset<QuantizedEmbedding> embedding(const Int8EmbeddingView &view);
+
+    static uint64_t iconKey(const uint8_t *bytes, size_t size, const Int8EmbeddingView &embedding);
+
+    static std::string widgetContentKey(const std::string &text, const std::string &resourceId,
+                                        uint32_t activity, uint32_t icon);
+
+    static std::string actionKey(int32_t actionType, uint32_t activity, uint32_t targetWidget);
+
+    flatbuffers::FlatBufferBuilder &_builder;
+    std::vector<flatbuffers::Offset<ActivityRecord>> _activities;
+    std::vector<flatbuffers::Offset<IconRecord>> _icons;
+    std::vector<flatbuffers::Offset<WidgetRecord>> _widgets;
+    std::vector<flatbuffers::Offset<ActionRecord>> _actions;
+    std::unordered_map<std::string, uint32_t> _activityIndex;
+    std::unordered_map<uint64_t, uint32_t> _iconIndex;
+    std::unordered_map<uint64_t, uint32_t> _widgetIndex;
+    std::unordered_map<std::string, uint32_t> _targetWidgetIndex;
+    std::unordered_map<std::string, uint32_t> _actionIndex;
+    // 向量内容的哈希 -> 已写出的向量表
+    std::unordered_map<uint64_t, flatbuffers::Offset<QuantizedEmbedding>> _embeddings;
+};
+
+class WidgetReuseModelFormat {
+public:
+    // 需要转换的v1模型：有内联属性的model条目，没有v2的format_version
+    static bool isV1(const WidgetReuseModel *model);
+
+    // 把v1模型转换为v2：属性放进去重字典，图标由base64解码为原始字节，同一action下多个activity中的widget计数
+    // 取较大值合并；保留platform_info和journal_sequence。数据校验失败时返回false
+    static bool convertToV2(const uint8_t *data, size_t size, std::vector<uint8_t> &out);
+};
+
+} // namespace fastbotx
+
+#endif // WidgetReuseModelFormat_H_
@@ -0,0 +1,458 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef WordPieceTokenizer_CPP_
+#define WordPieceTokenizer_CPP_
+
+#include "WordPieceTokenizer.h"
+#include "../utils.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fastbotx {
+
+static const char VOCAB_BINARY_MAGIC[8] = {'F', 'B', 'W', 'P', 'V', 'O', 'C', 'B'};
+static const uint32_t VOCAB_BINARY_VERSION = 1;
+
+// 预编译词表的文件头，之后依次是 base[unitCount], check[unitCount], value[unitCount],
+// tokenOffsets[tokenCount + 1], tokenStrings[stringBytes]，全部为本机字节序
+struct VocabBinaryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t unitCount;
+    uint32_t tokenCount;
+    uint32_t stringBytes;
+    int32_t continuationState;
+    int32_t unkId;
+    int32_t clsId;
+    int32_t sepId;
+    int32_t padId;
+    uint32_t reserved;
+};
+
+const size_t WordPieceTokenizer::MAX_CHARS_PER_WORD;
+
+WordPieceTokenizer::WordPieceTokenizer()
+        : _base(nullptr), _check(nullptr), _value(nullptr), _tokenOffsets(nullptr), _tokenStrings(nullptr),
+          _unitCount(0), _tokenCount(0), _stringBytes(0), _continuationState(-1),
+          _unkId(100), _clsId(101), _sepId(102), _padId(0), _mapped(nullptr), _mappedSize(0) {
+}
+
+WordPieceTokenizer::~WordPieceTokenizer() {
+    if (_mapped) {
+        munmap(_mapped, _mappedSize);
+        _mapped = nullptr;
+    }
+}
+
+WordPieceTokenizerPtr WordPieceTokenizer::load(const std::string &vocabPath, const std::string &binaryPath) {
+    struct stat vocabStat{};
+    struct stat binaryStat{};
+    bool hasVocab = 0 == stat(vocabPath.c_str(), &vocabStat);
+    bool hasBinary = !binaryPath.empty() && 0 == stat(binaryPath.c_str(), &binaryStat);
+
+    // 预编译词表不早于vocab.txt时直接映射，省去解析和建trie
+    if (hasBinary && (!hasVocab || binaryStat.st_mtime >= vocabStat.st_mtime)) {
+        WordPieceTokenizerPtr tokenizer(new WordPieceTokenizer());
+        if (tokenizer->mapBinary(binaryPath)) {
+            BLOG("映射预编译词表: %s, %zu个token", binaryPath.c_str(), tokenizer->tokenCount());
+            return tokenizer;
+        }
+        BLOGE("预编译词表无效，重新从文本词表构建: %s", binaryPath.c_str());
+    }
+    if (!hasVocab) {
+        return nullptr;
+    }
+
+    std::ifstream vocabFile(vocabPath);
+    if (!vocabFile.is_open()) {
+        return nullptr;
+    }
+    // 词汇表格式：每行一个token，行号就是ID（空行也占一个ID）
+    std::vector<std::pair<std::string, int32_t>> tokens;
+    tokens.reserve(128 * 1024);
+    std::string line;
+    int32_t lineNumber = 0;
+    while (std::getline(vocabFile, line)) {
+        lineNumber++;
+        if (!line.empty() && '\r' == line.back()) {
+            line.pop_back();
+        }
+        if (line.empty()) continue;
+        tokens.emplace_back(line, lineNumber - 1);
+    }
+    vocabFile.close();
+
+    WordPieceTokenizerPtr tokenizer = build(tokens);
+    BLOG("从文本词表构建trie完成: %s, %zu个token, %zu个单元", vocabPath.c_str(), tokenizer->tokenCount(),
+         tokenizer->_unitCount);
+    if (!binaryPath.empty() && !tokenizer->saveBinary(binaryPath)) {
+        BLOGE("写出预编译词表失败: %s", binaryPath.c_str());
+    }
+    return tokenizer;
+}
+
+WordPieceTokenizerPtr WordPieceTokenizer::build(const std::vector<std::pair<std::string, int32_t>> &tokens) {
+    WordPieceTokenizerPtr tokenizer(new WordPieceTokenizer());
+    std::vector<std::pair<std::string, int32_t>> sortedTokens(tokens);
+    tokenizer->buildTrie(sortedTokens);
+    return tokenizer;
+}
+
+void WordPieceTokenizer::buildTrie(std::vector<std::pair<std::string, int32_t>> &tokens) {
+    // id -> token文本的反查表
+    int32_t maxId = -1;
+    for (const auto &token: tokens) {
+        maxId = std::max(maxId, token.second);
+    }
+    _tokenCount = static_cast<size_t>(maxId + 1);
+    std::vector<const std::string *> byId(_tokenCount, nullptr);
+    for (const auto &token: tokens) {
+        byId[token.second] = &token.first;
+    }
+    _tokenOffsetStorage.assign(_tokenCount + 1, 0);
+    _tokenStringStorage.clear();
+    for (size_t id = 0; id < _tokenCount; ++id) {
+        _tokenOffsetStorage[id] = static_cast<uint32_t>(_tokenStringStorage.size());
+        if (byId[id]) {
+            _tokenStringStorage += *byId[id];
+        }
+    }
+    _tokenOffsetStorage[_tokenCount] = static_cast<uint32_t>(_tokenStringStorage.size());
+
+    // 按字节序排序；重复的token保留后出现的id
+    std::stable_sort(tokens.begin(), tokens.end(),
+                     [](const std::pair<std::string, int32_t> &a, const std::pair<std::string, int32_t> &b) {
+                         return a.first < b.first;
+                     });
+    std::vector<std::pair<std::string, int32_t>> keys;
+    keys.reserve(tokens.size());
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (i + 1 < tokens.size() && tokens[i].first == tokens[i + 1].first) continue;
+        keys.push_back(tokens[i]);
+    }
+
+    // 双数组：子节点t = base[s] + byte + 1，且check[t] == s；value[t] >= 0表示t是某个token的结尾
+    auto ensureSize = [this](size_t size) {
+        if (size <= _checkStorage.size()) return;
+        size_t newSize = std::max(size, _checkStorage.size() * 2);
+        _baseStorage.resize(newSize, 0);
+        _checkStorage.resize(newSize, -1);
+        _valueStorage.resize(newSize, -1);
+    };
+    _baseStorage.clear();
+    _checkStorage.clear();
+    _valueStorage.clear();
+    ensureSize(4096);
+    _checkStorage[0] = 0;
+
+    struct PendingNode {
+        int32_t state;
+        size_t begin;
+        size_t end;
+        size_t depth;
+    };
+    struct Child {
+        int32_t code;
+        size_t begin;
+        size_t end;
+    };
+    std::vector<PendingNode> pending;
+    pending.push_back({0, 0, keys.size(), 0});
+    std::vector<Child> children;
+    size_t nextCheckPos = 1;
+    size_t usedUnits = 1;
+
+    while (!pending.empty()) {
+        PendingNode node = pending.back();
+        pending.pop_back();
+
+        size_t i = node.begin;
+        if (i < node.end && keys[i].first.size() == node.depth) {
+            _valueStorage[node.state] = keys[i].second;
+            ++i;
+        }
+        children.clear();
+        while (i < node.end) {
+            auto byte = static_cast<unsigned char>(keys[i].first[node.depth]);
+            size_t j = i + 1;
+            while (j < node.end && static_cast<unsigned char>(keys[j].first[node.depth]) == byte) ++j;
+            children.push_back({static_cast<int32_t>(byte) + 1, i, j});
+            i = j;
+        }
+        if (children.empty()) continue;
+
+        // 寻找能容纳所有子节点的base；已扫描区间足够稠密时推进起点，避免反复从头扫描
+        size_t position = std::max(static_cast<size_t>(children.front().code) + 1, nextCheckPos) - 1;
+        size_t occupied = 0;
+        bool firstFree = true;
+        size_t base = 0;
+        while (true) {
+            ++position;
+            ensureSize(position + 1);
+            if (-1 != _checkStorage[position]) {
+                ++occupied;
+                continue;
+            }
+            if (firstFree) {
+                nextCheckPos = position;
+                firstFree = false;
+            }
+            base = position - static_cast<size_t>(children.front().code);
+            ensureSize(base + static_cast<size_t>(children.back().code) + 1);
+            bool fits = true;
+            for (const Child &child: children) {
+                if (-1 != _checkStorage[base + child.code]) {
+                    fits = false;
+                    break;
+                }
+            }
+            if (fits) break;
+        }
+        if (occupied * 20 >= (position - nextCheckPos + 1) * 19) {
+            nextCheckPos = position;
+        }
+
+        _baseStorage[node.state] = static_cast<int32_t>(base);
+        for (const Child &child: children) {
+            size_t next = base + child.code;
+            _checkStorage[next] = node.state;
+            usedUnits = std::max(usedUnits, next + 1);
+            pending.push_back({static_cast<int32_t>(next), child.begin, child.end, node.depth + 1});
+        }
+    }
+
+    _baseStorage.resize(usedUnits);
+    _checkStorage.resize(usedUnits);
+    _valueStorage.resize(usedUnits);
+    _base = _baseStorage.data();
+    _check = _checkStorage.data();
+    _value = _valueStorage.data();
+    _unitCount = usedUnits;
+    _tokenOffsets = _tokenOffsetStorage.data();
+    _tokenStrings = _tokenStringStorage.data();
+    _stringBytes = _tokenStringStorage.size();
+
+    int32_t state = 0;
+    for (const char *prefix = "##"; *prefix && state >= 0; ++prefix) {
+        state = transit(state, static_cast<unsigned char>(*prefix));
+    }
+    _continuationState = state;
+
+    int32_t id = tokenId("[UNK]");
+    if (id >= 0) _unkId = id;
+    id = tokenId("[CLS]");
+    if (id >= 0) _clsId = id;
+    id = tokenId("[SEP]");
+    if (id >= 0) _sepId = id;
+    id = tokenId("[PAD]");
+    if (id >= 0) _padId = id;
+}
+
+bool WordPieceTokenizer::saveBinary(const std::string &binaryPath) const {
+    VocabBinaryHeader header{};
+    std::memcpy(header.magic, VOCAB_BINARY_MAGIC, sizeof(header.magic));
+    header.version = VOCAB_BINARY_VERSION;
+    header.unitCount = static_cast<uint32_t>(_unitCount);
+    header.tokenCount = static_cast<uint32_t>(_tokenCount);
+    header.stringBytes = static_cast<uint32_t>(_stringBytes);
+    header.continuationState = _continuationState;
+    header.unkId = static_cast<int32_t>(_unkId);
+    header.clsId = static_cast<int32_t>(_clsId);
+    header.sepId = static_cast<int32_t>(_sepId);
+    header.padId = static_cast<int32_t>(_padId);
+
+    // 先写临时文件再rename，其他进程不会映射到写了一半的词表
+    std::string tempPath = binaryPath + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(_base), static_cast<std::streamsize>(_unitCount * sizeof(int32_t)));
+    out.write(reinterpret_cast<const char *>(_check), static_cast<std::streamsize>(_unitCount * sizeof(int32_t)));
+    out.write(reinterpret_cast<const char *>(_value), static_cast<std::streamsize>(_unitCount * sizeof(int32_t)));
+    out.write(reinterpret_cast<const char *>(_tokenOffsets),
+              static_cast<std::streamsize>((_tokenCount + 1) * sizeof(uint32_t)));
+    out.write(_tokenStrings, static_cast<std::streamsize>(_stringBytes));
+    out.close();
+    if (!out.good() || 0 != std::rename(tempPath.c_str(), binaryPath.c_str())) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool WordPieceTokenizer::mapBinary(const std::string &binaryPath) {
+    int fd = open(binaryPath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat fileStat{};
+    if (0 != fstat(fd, &fileStat) || fileStat.st_size < static_cast<off_t>(sizeof(VocabBinaryHeader))) {
+        close(fd);
+        return false;
+    }
+    auto fileSize = static_cast<size_t>(fileStat.st_size);
+    void *mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == mapped) {
+        return false;
+    }
+
+    const auto *header = static_cast<const VocabBinaryHeader *>(mapped);
+    size_t expectedSize = sizeof(VocabBinaryHeader)
+                          + static_cast<size_t>(header->unitCount) * sizeof(int32_t) * 3
+                          + (static_cast<size_t>(header->tokenCount) + 1) * sizeof(uint32_t)
+                          + header->stringBytes;
+    if (0 != std::memcmp(header->magic, VOCAB_BINARY_MAGIC, sizeof(header->magic))
+        || VOCAB_BINARY_VERSION != header->version || 0 == header->unitCount || expectedSize != fileSize) {
+        munmap(mapped, fileSize);
+        return false;
+    }
+    // token()按相邻偏移切出文本：偏移须从0开始单调不减，且不超出字符串区
+    const auto *tokenOffsets = reinterpret_cast<const uint32_t *>(
+            static_cast<const char *>(mapped) + sizeof(VocabBinaryHeader)
+            + static_cast<size_t>(header->unitCount) * sizeof(int32_t) * 3);
+    bool offsetsValid = 0 == tokenOffsets[0] && tokenOffsets[header->tokenCount] <= header->stringBytes;
+    for (size_t id = 0; offsetsValid && id < header->tokenCount; ++id) {
+        offsetsValid = tokenOffsets[id] <= tokenOffsets[id + 1];
+    }
+    if (!offsetsValid) {
+        munmap(mapped, fileSize);
+        return false;
+    }
+
+    _mapped = mapped;
+    _mappedSize = fileSize;
+    _unitCount = header->unitCount;
+    _tokenCount = header->tokenCount;
+    _stringBytes = header->stringBytes;
+    _continuationState = header->continuationState;
+    _unkId = header->unkId;
+    _clsId = header->clsId;
+    _sepId = header->sepId;
+    _padId = header->padId;
+
+    const char *cursor = static_cast<const char *>(mapped) + sizeof(VocabBinaryHeader);
+    _base = reinterpret_cast<const int32_t *>(cursor);
+    cursor += _unitCount * sizeof(int32_t);
+    _check = reinterpret_cast<const int32_t *>(cursor);
+    cursor += _unitCount * sizeof(int32_t);
+    _value = reinterpret_cast<const int32_t *>(cursor);
+    cursor += _unitCount * sizeof(int32_t);
+    _tokenOffsets = reinterpret_cast<const uint32_t *>(cursor);
+    cursor += (_tokenCount + 1) * sizeof(uint32_t);
+    _tokenStrings = cursor;
+    return true;
+}
+
+int32_t WordPieceTokenizer::tokenId(const char *token, size_t length) const {
+    if (0 == _unitCount || 0 == length) {
+        return -1;
+    }
+    int32_t state = 0;
+    for (size_t i = 0; i < length; ++i) {
+        state = transit(state, static_cast<unsigned char>(token[i]));
+        if (state < 0) {
+            return -1;
+        }
+    }
+    return _value[state];
+}
+
+size_t WordPieceTokenizer::tokenizeWord(const char *word, size_t length, std::vector<int64_t> &ids) const {
+    if (0 == length) {
+        return 0;
+    }
+    size_t charCount = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (0x80 != (static_cast<unsigned char>(word[i]) & 0xC0)) ++charCount;
+    }
+    if (charCount > MAX_CHARS_PER_WORD || 0 == _unitCount) {
+        ids.push_back(_unkId);
+        return 1;
+    }
+
+    // 贪心最长匹配：每段从起点沿trie一直走到失配，记录最后一个token结尾，非首段从"##"节点出发
+    size_t firstToken = ids.size();
+    size_t start = 0;
+    while (start < length) {
+        int32_t state = (0 == start) ? 0 : _continuationState;
+        int32_t matchedId = -1;
+        size_t matchedEnd = start;
+        for (size_t i = start; i < length && state >= 0; ++i) {
+            state = transit(state, static_cast<unsigned char>(word[i]));
+            if (state >= 0 && _value[state] >= 0) {
+                matchedId = _value[state];
+                matchedEnd = i + 1;
+            }
+        }
+        if (matchedId < 0) {
+            ids.resize(firstToken);
+            ids.push_back(_unkId);
+            return 1;
+        }
+        ids.push_back(matchedId);
+        start = matchedEnd;
+    }
+    return ids.size() - firstToken;
+}
+
+size_t WordPieceTokenizer::tokenizeText(const char *text, size_t length, const char *delimiters,
+                                        std::vector<int64_t> &ids) const {
+    size_t before = ids.size();
+    size_t wordStart = 0;
+    for (size_t i = 0; i <= length; ++i) {
+        bool delimiter = (i == length);
+        bool punctuation = false;
+        if (!delimiter) {
+            auto c = static_cast<unsigned char>(text[i]);
+            if (c < 0x80) {
+                delimiter = std::isspace(c) || (delimiters && 0 != c && std::strchr(delimiters, c));
+                punctuation = !delimiter && std::ispunct(c);
+            }
+        }
+        if (!delimiter && !punctuation) continue;
+        if (i > wordStart) {
+            tokenizeWord(text + wordStart, i - wordStart, ids);
+        }
+        if (punctuation) {
+            tokenizeWord(text + i, 1, ids);
+        }
+        wordStart = i + 1;
+    }
+    return ids.size() - before;
+}
+
+void WordPieceTokenizer::tokenizeBatch(const std::vector<std::string> &texts, const char *delimiters,
+                                       std::vector<int64_t> &ids, std::vector<size_t> &offsets) const {
+    offsets.clear();
+    offsets.reserve(texts.size() + 1);
+    offsets.push_back(ids.size());
+    for (const std::string &text: texts) {
+        tokenizeText(text.data(), text.size(), delimiters, ids);
+        offsets.push_back(ids.size());
+    }
+}
+
+std::string WordPieceTokenizer::token(int64_t id) const {
+    if (id < 0 || static_cast<size_t>(id) >= _tokenCount) {
+        return "";
+    }
+    return std::string(_tokenStrings + _tokenOffsets[id], _tokenOffsets[id + 1] - _tokenOffsets[id]);
+}
+
+} // namespace fastbotx
+
+#endif // WordPieceTokenizer_CPP_
@@ -0,0 +1,117 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef WordPieceTokenizer_H_
+#define WordPieceTokenizer_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fastbotx {
+
+class WordPieceTokenizer;
+
+typedef std::shared_ptr<WordPieceTokenizer> WordPieceTokenizerPtr;
+
+// WordPiece分词器：词表保存在双数组trie中，按HuggingFace BERT的规则做贪心最长匹配，
+// 词内非首段使用"##"前缀的续接token。
+// 词表可从vocab.txt构建，也可直接mmap预编译的二进制词表（构建后自动写出，供下次启动使用）。
+// 构建完成后只读，可以被多个线程同时使用。
+class WordPieceTokenizer {
+public:
+    // 超过这个字符数的词直接记为[UNK]，与HuggingFace的max_input_chars_per_word一致
+    static const size_t MAX_CHARS_PER_WORD = 100;
+
+    ~WordPieceTokenizer();
+
+    // 加载词表：binaryPath存在且不早于vocabPath时直接mmap，否则解析vocab.txt构建trie并写出binaryPath
+    static WordPieceTokenizerPtr load(const std::string &vocabPath, const std::string &binaryPath);
+
+    // 由(token, id)列表在内存中构建，用于词表文件缺失时的回退
+    static WordPieceTokenizerPtr build(const std::vector<std::pair<std::string, int32_t>> &tokens);
+
+    // 精确查找token的id，不存在返回-1
+    int32_t tokenId(const char *token, size_t length) const;
+
+    int32_t tokenId(const std::string &token) const { return tokenId(token.data(), token.size()); }
+
+    // 对单个词做WordPiece，token id追加到ids末尾；任何一段无法匹配时整个词记为一个[UNK]
+    // 返回追加的token数
+    size_t tokenizeWord(const char *word, size_t length, std::vector<int64_t> &ids) const;
+
+    // 按空白和delimiters切词（分隔符本身丢弃），其余ASCII标点单独成词，再逐词WordPiece
+    size_t tokenizeText(const char *text, size_t length, const char *delimiters, std::vector<int64_t> &ids) const;
+
+    // 批量分词：所有文本的token连续写入ids，第i个文本对应ids[offsets[i], offsets[i + 1])
+    void tokenizeBatch(const std::vector<std::string> &texts, const char *delimiters,
+                       std::vector<int64_t> &ids, std::vector<size_t> &offsets) const;
+
+    // id对应的token文本，用于日志
+    std::string token(int64_t id) const;
+
+    size_t tokenCount() const { return _tokenCount; }
+
+    int64_t unkId() const { return _unkId; }
+
+    int64_t clsId() const { return _clsId; }
+
+    int64_t sepId() const { return _sepId; }
+
+    int64_t padId() const { return _padId; }
+
+    bool isMapped() const { return nullptr != _mapped; }
+
+private:
+    WordPieceTokenizer();
+
+    // 沿trie走一个字节，失败返回-1
+    int32_t transit(int32_t state, unsigned char byte) const {
+        int64_t next = static_cast<int64_t>(_base[state]) + byte + 1;
+        if (next <= 0 || next >= static_cast<int64_t>(_unitCount) || _check[next] != state) {
+            return -1;
+        }
+        return static_cast<int32_t>(next);
+    }
+
+    bool mapBinary(const std::string &binaryPath);
+
+    bool saveBinary(const std::string &binaryPath) const;
+
+    void buildTrie(std::vector<std::pair<std::string, int32_t>> &tokens);
+
+    // 各数组的指针：mmap时指向映射区，内存构建时指向下面的vector
+    const int32_t *_base;
+    const int32_t *_check;
+    const int32_t *_value;
+    const uint32_t *_tokenOffsets;
+    const char *_tokenStrings;
+    size_t _unitCount;
+    size_t _tokenCount;
+    size_t _stringBytes;
+
+    int32_t _continuationState;
+    int64_t _unkId;
+    int64_t _clsId;
+    int64_t _sepId;
+    int64_t _padId;
+
+    std::vector<int32_t> _baseStorage;
+    std::vector<int32_t> _checkStorage;
+    std::vector<int32_t> _valueStorage;
+    std::vector<uint32_t> _tokenOffsetStorage;
+    std::string _tokenStringStorage;
+
+    void *_mapped;
+    size_t _mappedSize;
+};
+
+} // namespace fastbotx
+
+#endif // WordPieceTokenizer_H_
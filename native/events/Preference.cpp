@@ -8,6 +8,7 @@
 #include <sstream>
 #include <algorithm>
 #include <regex>
+#include <cstdlib>
 #include "utils.hpp"
 #include "Preference.h"
 #include "../thirdpart/json/json.hpp"
@@ -519,6 +520,32 @@ namespace fastbotx {
 #define MaxRandomPickSTR  "max.randomPickFromStringList"
 #define InputFuzzSTR "max.doinputtextFuzzing"
 #define ListenMode "max.listenMode"
+#define OnnxIntraOpThreads "max.onnx.intraOpThreads"
+#define OnnxInterOpThreads "max.onnx.interOpThreads"
+#define OnnxParallelExecution "max.onnx.parallelExecution"
+#define OnnxGlobalThreadPool "max.onnx.globalThreadPool"
+#define OnnxPreferInt8Models "max.onnx.preferInt8Models"
+#define OnnxCacheOptimizedModel "max.onnx.cacheOptimizedModel"
+#define OnnxCpuMemArena "max.onnx.cpuMemArena"
+#define OnnxMemPattern "max.onnx.memPattern"
+#define OnnxArenaExtendStrategy "max.onnx.arenaExtendStrategy"
+#define OnnxPreloadModels "max.onnx.preloadModels"
+#define OnnxSimilarityWorkers "max.onnx.similarityWorkers"
+#define OnnxEmbeddingMatrixPrecision "max.onnx.embeddingMatrixPrecision"
+#define IconEmbeddingCacheSize "max.icon.embeddingCacheSize"
+#define IconPersistEmbeddingCache "max.icon.persistEmbeddingCache"
+#define IconStoreBytes "max.icon.storeBytes"
+#define IconIdenticalHashDistance "max.icon.identicalHashDistance"
+#define IconDifferentHashDistance "max.icon.differentHashDistance"
+#define DecisionBudgetMs "max.decisionBudgetMs"
+#define ReuseModelBounded "max.reuseModel.bounded"
+#define ReuseModelTopWidgets "max.reuseModel.topWidgets"
+#define ReuseModelMaxActions "max.reuseModel.maxActions"
+#define ReuseModelSketchWidth "max.reuseModel.sketchWidth"
+#define ReuseModelSketchDepth "max.reuseModel.sketchDepth"
+#define ReuseModelAgingPeriod "max.reuseModel.agingPeriod"
+#define ReuseModelDecay "max.reuseModel.decay"
+#define GraphResidentStates "max.graph.residentStates"
 
     void Preference::loadBaseConfig() {
         LOGI("pref init checking curr packageName is offset: %s", Preference::PackageName.c_str());
@@ -543,8 +570,83 @@ namespace fastbotx {
             } else if (ListenMode == key_value[0]) {
                 BDLOG("set %s", ListenMode);
                 this->setListenMode("true" == key_value[1]);
+            } else if (OnnxIntraOpThreads == key_value[0]) {
+                this->_inferenceSessionConfig.intraOpThreads = std::max(1, std::atoi(key_value[1].c_str()));
+            } else if (OnnxInterOpThreads == key_value[0]) {
+                this->_inferenceSessionConfig.interOpThreads = std::max(1, std::atoi(key_value[1].c_str()));
+            } else if (OnnxParallelExecution == key_value[0]) {
+                this->_inferenceSessionConfig.parallelExecution = ("true" == key_value[1]);
+            } else if (OnnxGlobalThreadPool == key_value[0]) {
+                this->_inferenceSessionConfig.globalThreadPool = ("true" == key_value[1]);
+            } else if (OnnxPreferInt8Models == key_value[0]) {
+                this->_inferenceSessionConfig.preferInt8Models = ("true" == key_value[1]);
+            } else if (OnnxCacheOptimizedModel == key_value[0]) {
+                this->_inferenceSessionConfig.cacheOptimizedModel = ("true" == key_value[1]);
+            } else if (OnnxCpuMemArena == key_value[0]) {
+                this->_inferenceSessionConfig.cpuMemArena = ("true" == key_value[1]);
+            } else if (OnnxMemPattern == key_value[0]) {
+                this->_inferenceSessionConfig.memPattern = ("true" == key_value[1]);
+            } else if (OnnxArenaExtendStrategy == key_value[0]) {
+                this->_inferenceSessionConfig.arenaExtendSameAsRequested = ("sameAsRequested" == key_value[1]);
+            } else if (OnnxPreloadModels == key_value[0]) {
+                this->_inferenceSessionConfig.preloadModels = ("true" == key_value[1]);
+            } else if (OnnxSimilarityWorkers == key_value[0]) {
+                this->_inferenceSessionConfig.similarityWorkers = std::max(0, std::atoi(key_value[1].c_str()));
+            } else if (OnnxEmbeddingMatrixPrecision == key_value[0]) {
+                this->_inferenceSessionConfig.embeddingMatrixPrecision = key_value[1];
+            } else if (IconEmbeddingCacheSize == key_value[0]) {
+                this->_iconSimilarityConfig.embeddingCacheSize = static_cast<size_t>(
+                        std::max(1, std::atoi(key_value[1].c_str())));
+            } else if (IconPersistEmbeddingCache == key_value[0]) {
+                this->_iconSimilarityConfig.persistEmbeddingCache = ("true" == key_value[1]);
+            } else if (IconStoreBytes == key_value[0]) {
+                this->_iconSimilarityConfig.storeBytes = static_cast<size_t>(
+                        std::max(0L, std::atol(key_value[1].c_str())));
+            } else if (IconIdenticalHashDistance == key_value[0]) {
+                this->_iconSimilarityConfig.identicalHashDistance = std::atoi(key_value[1].c_str());
+            } else if (IconDifferentHashDistance == key_value[0]) {
+                this->_iconSimilarityConfig.differentHashDistance = std::atoi(key_value[1].c_str());
+            } else if (DecisionBudgetMs == key_value[0]) {
+                this->_decisionBudgetMs = std::atoi(key_value[1].c_str());
+            } else if (ReuseModelBounded == key_value[0]) {
+                this->_boundedReuseModelConfig.enabled = ("true" == key_value[1]);
+            } else if (ReuseModelTopWidgets == key_value[0]) {
+                this->_boundedReuseModelConfig.topWidgets = static_cast<size_t>(
+                        std::max(1, std::atoi(key_value[1].c_str())));
+            } else if (ReuseModelMaxActions == key_value[0]) {
+                this->_boundedReuseModelConfig.maxActions = static_cast<size_t>(
+                        std::max(1, std::atoi(key_value[1].c_str())));
+            } else if (ReuseModelSketchWidth == key_value[0]) {
+                this->_boundedReuseModelConfig.sketchWidth = static_cast<size_t>(
+                        std::max(1, std::atoi(key_value[1].c_str())));
+            } else if (ReuseModelSketchDepth == key_value[0]) {
+                this->_boundedReuseModelConfig.sketchDepth = static_cast<size_t>(
+                        std::max(1, std::atoi(key_value[1].c_str())));
+            } else if (ReuseModelAgingPeriod == key_value[0]) {
+                this->_boundedReuseModelConfig.agingPeriod = std::max(0, std::atoi(key_value[1].c_str()));
+            } else if (ReuseModelDecay == key_value[0]) {
+                this->_boundedReuseModelConfig.decay = std::min(1.0, std::max(0.0, std::atof(key_value[1].c_str())));
+            } else if (GraphResidentStates == key_value[0]) {
+                this->_graphResidentStates = std::atoi(key_value[1].c_str());
             }
         }
+        const InferenceSessionConfig &onnx = this->_inferenceSessionConfig;
+        BLOG("onnx session config: intra %d inter %d parallel %d globalPool %d int8 %d cacheOptimized %d "
+             "arena %d memPattern %d arenaSameAsRequested %d preload %d similarityWorkers %d matrix %s",
+             onnx.intraOpThreads, onnx.interOpThreads, onnx.parallelExecution, onnx.globalThreadPool,
+             onnx.preferInt8Models, onnx.cacheOptimizedModel, onnx.cpuMemArena, onnx.memPattern,
+             onnx.arenaExtendSameAsRequested, onnx.preloadModels, onnx.similarityWorkers,
+             onnx.embeddingMatrixPrecision.c_str());
+        const IconSimilarityConfig &icon = this->_iconSimilarityConfig;
+        BLOG("icon similarity config: cache %zu persist %d store %zu bytes identicalDistance %d differentDistance %d",
+             icon.embeddingCacheSize, icon.persistEmbeddingCache, icon.storeBytes, icon.identicalHashDistance,
+             icon.differentHashDistance);
+        BLOG("decision budget: %d ms", this->_decisionBudgetMs);
+        const BoundedReuseModelConfig &bounded = this->_boundedReuseModelConfig;
+        BLOG("bounded reuse model: %d topWidgets %zu maxActions %zu sketch %zu x %zu aging %d decay %.3f",
+             bounded.enabled, bounded.topWidgets, bounded.maxActions, bounded.sketchWidth, bounded.sketchDepth,
+             bounded.agingPeriod, bounded.decay);
+        BLOG("graph resident states: %d", this->_graphResidentStates);
     }
 
 #define PageTextsMaxCount 300
@@ -61,6 +61,63 @@ namespace fastbotx {
     typedef std::vector<CustomEventPtr> CustomEventPtrVec;
     typedef std::map<std::string, std::vector<RectPtr>> StringRectsMap;
 
+    // ONNX Runtime session policy for the similarity models, read from max.config.
+    // the defaults keep the previous behaviour: 1 thread, sequential execution, per-session pools.
+    struct InferenceSessionConfig {
+        int intraOpThreads{1};
+        int interOpThreads{1};
+        bool parallelExecution{false};
+        // share one intra/inter-op pool between the BERT and CLIP sessions
+        bool globalThreadPool{false};
+        // prefer the *.int8.onnx variant of each model when it exists
+        bool preferInt8Models{false};
+        // serialize the optimized graph next to the model and load it on later runs
+        bool cacheOptimizedModel{true};
+        bool cpuMemArena{true};
+        bool memPattern{true};
+        // grow the shared cpu arena by the requested size instead of the next power of two
+        bool arenaExtendSameAsRequested{false};
+        // load and warm up the models in background when the agent is initialized
+        bool preloadModels{true};
+        // worker threads of the similarity engine used to fan out external-model matching,
+        // each worker gets its own inference context; 0 runs every match on the calling thread
+        int similarityWorkers{2};
+        // storage of the external-model embedding matrices ranked in one batched multiply:
+        // int8 (the vectors as saved in the model, same scores as one-by-one matching), fp16 or fp32
+        std::string embeddingMatrixPrecision{"int8"};
+    };
+
+    // icon embedding cache and perceptual-hash prefilter, read from max.config.
+    struct IconSimilarityConfig {
+        // LRU capacity of the icon embedding cache, keyed by the content hash of the decoded icon
+        size_t embeddingCacheSize{2048};
+        // keep the cache on disk so the next run does not re-embed known icons
+        bool persistEmbeddingCache{true};
+        // upper bound of the compressed icon bytes kept in memory; least recently used icons drop their bytes first
+        size_t storeBytes{32 * 1024 * 1024};
+        // dHash hamming distance at or below which two icons are treated as the same icon
+        int identicalHashDistance{2};
+        // dHash hamming distance at or above which two icons are treated as different without running CLIP,
+        // a value above 64 disables the shortcut
+        int differentHashDistance{28};
+    };
+
+    // bounded widget reuse model for very long cumulative runs: every action keeps only its top widgets exactly,
+    // the rest is summarized by a count-min sketch, and old counts decay
+    struct BoundedReuseModelConfig {
+        bool enabled{false};
+        // widgets kept with exact counts and attributes per action
+        size_t topWidgets{64};
+        // actions kept in the saved model, the ones with the smallest counts are dropped first
+        size_t maxActions{20000};
+        // count-min sketch of the long-tail (action, widget) counts
+        size_t sketchWidth{1 << 16};
+        size_t sketchDepth{4};
+        // every agingPeriod observations all counts are multiplied by decay, 0 disables aging
+        int agingPeriod{10000};
+        double decay{0.9};
+    };
+
     class Preference {
     public:
         Preference();
@@ -91,6 +148,19 @@ namespace fastbotx {
 
         int getForceMaxBlockStateTimes() const { return this->_forceMaxBlockStateTimes; }
 
+        const InferenceSessionConfig &getInferenceSessionConfig() const { return this->_inferenceSessionConfig; }
+
+        const IconSimilarityConfig &getIconSimilarityConfig() const { return this->_iconSimilarityConfig; }
+
+        const BoundedReuseModelConfig &getBoundedReuseModelConfig() const { return this->_boundedReuseModelConfig; }
+
+        // time budget of one action decision in milliseconds, <= 0 means unbounded
+        int getDecisionBudgetMs() const { return this->_decisionBudgetMs; }
+
+        // states of the graph keeping their widget trees, the least recently visited ones beyond this are compacted;
+        // <= 0 means unbounded
+        int getGraphResidentStates() const { return this->_graphResidentStates; }
+
         ~Preference();
 
     protected:
@@ -166,6 +236,11 @@ namespace fastbotx {
         bool _skipAllActionsFromModel;
         bool _forceUseTextModel{};
         int _forceMaxBlockStateTimes{};
+        InferenceSessionConfig _inferenceSessionConfig;
+        IconSimilarityConfig _iconSimilarityConfig;
+        BoundedReuseModelConfig _boundedReuseModelConfig;
+        int _decisionBudgetMs{800};
+        int _graphResidentStates{1000};
         RectPtr _rootScreenSize;
 
         static std::string loadFileContent(const std::string &fileAbsolutePath);
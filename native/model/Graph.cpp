@@ -10,6 +10,8 @@
 
 #include "Graph.h"
 #include "../utils.hpp"
+#include <algorithm>
+#include <unordered_set>
 #include <vector>
 
 
@@ -17,7 +19,7 @@ namespace fastbotx {
 
 
     Graph::Graph()
-            : _totalDistri(0), _timeStamp(0) {
+            : _totalDistri(0), _timeStamp(0), _residentStateBudget(0) {
 
     }
 
@@ -33,12 +35,15 @@ namespace fastbotx {
         {
             state->setId((int) this->_states.size());
             this->_states.emplace(state);
+            this->_statesById.push_back(state);
+            restoreFromSnapshot(state);
         } else {
             if ((*ifStateExists)->hasNoDetail()) {
                 (*ifStateExists)->fillDetails(state);
             }
             state = *ifStateExists;
         }
+        touchResidentState(state);
 
         this->notifyNewStateEvents(state);//初始化modelreuseagent里的_newstate
 
@@ -59,6 +64,152 @@ namespace fastbotx {
     }
 
 
+// the agent still reads the last few states (n-step SARSA), they are never compacted
+#define MinResidentStates 16
+
+    void Graph::setResidentStateBudget(int budget) {
+        this->_residentStateBudget = budget > 0 ? std::max(budget, MinResidentStates) : 0;
+    }
+
+    void Graph::touchResidentState(const StatePtr &node) {
+        int id = node->getIdi();
+        if (id < 0 || id >= (int) this->_statesById.size()) {
+            return;
+        }
+        if (this->_residentPositions.size() < this->_statesById.size()) {
+            this->_residentPositions.resize(this->_statesById.size(), this->_residentStates.end());
+        }
+        auto &position = this->_residentPositions[id];
+        if (position != this->_residentStates.end()) {
+            this->_residentStates.splice(this->_residentStates.end(), this->_residentStates, position);
+        } else {
+            position = this->_residentStates.insert(this->_residentStates.end(), id);
+        }
+        if (this->_residentStateBudget <= 0) {
+            return;
+        }
+        while ((int) this->_residentStates.size() > this->_residentStateBudget) {
+            int coldId = this->_residentStates.front();
+            this->_residentStates.pop_front();
+            this->_residentPositions[coldId] = this->_residentStates.end();
+            this->_statesById[coldId]->compactDetails();
+            BDLOG("compact state %d, %zu states resident", coldId, this->_residentStates.size());
+        }
+    }
+
+    void Graph::addTransition(const StatePtr &from, const ActivityStateActionPtr &action, const StatePtr &to) {
+        const ActivityStateActionPtrVec &actions = from->getActions();
+        auto found = std::find(actions.begin(), actions.end(), action);
+        if (found == actions.end() || from->getIdi() < 0 || to->getIdi() < 0) {
+            return;
+        }
+        this->_transitions.addEdge(static_cast<uint32_t>(from->getIdi()),
+                                   static_cast<uint32_t>(found - actions.begin()),
+                                   static_cast<uint32_t>(to->getIdi()));
+    }
+
+    ActivityStateActionPtr Graph::planActionToFrontier(const StatePtr &from, size_t maxDepth) {
+        if (nullptr == from || from->getIdi() < 0) {
+            return nullptr;
+        }
+        const std::vector<StatePtr> &states = this->_statesById;
+        auto isFrontier = [&states](uint32_t id) {
+            // 除当前状态外的状态都已清除了控件细节（边界为空，isValid为假），按清除时记录的可执行性判断
+            const StatePtr &state = states[id];
+            bool noDetail = state->hasNoDetail();
+            const ActivityStateActionPtrVec &actions = state->getActions();
+            for (size_t i = 0; i < actions.size(); ++i) {
+                if (noDetail ? !actions[i]->isVisited() && state->wasValidWhenCleared(i)
+                             : enableValidUnvisitedFilter->include(actions[i])) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        uint32_t firstAction = 0;
+        size_t pathLength = 0;
+        if (!this->_frontierPlanner.plan(this->_transitions, static_cast<uint32_t>(from->getIdi()), states.size(),
+                                         maxDepth, isFrontier, firstAction, pathLength)) {
+            return nullptr;
+        }
+        const ActivityStateActionPtrVec &actions = from->getActions();
+        if (firstAction >= actions.size() || !enableValidFilter->include(actions[firstAction])) {
+            return nullptr;
+        }
+        BLOG("frontier state %zu steps away, take action %s", pathLength, actions[firstAction]->toString().c_str());
+        return actions[firstAction];
+    }
+
+    void Graph::attachSnapshot(const GraphSnapshotPtr &snapshot) {
+        this->_snapshot = snapshot;
+        if (!snapshot) {
+            return;
+        }
+        // 本次运行已经访问过的activity在快照的计数上累加
+        this->_totalDistri += snapshot->totalDistri();
+        for (size_t i = 0; i < snapshot->activityCount(); ++i) {
+            std::string activityStr = snapshot->activityName(i);
+            if (activityStr.empty()) {
+                continue;
+            }
+            if (this->_activityDistri.find(activityStr) == this->_activityDistri.end()) {
+                this->_activityDistri[activityStr] = _defaultDistri;
+            }
+            this->_activityDistri[activityStr].first += snapshot->activityVisitedCount(i);
+        }
+        for (auto &distri: this->_activityDistri) {
+            distri.second.second = this->_totalDistri > 0 ? 1.0 * distri.second.first / this->_totalDistri : 0.0;
+        }
+        BLOG("attach graph snapshot: %zu states, %zu activities, total %ld", snapshot->stateCount(),
+             snapshot->activityCount(), snapshot->totalDistri());
+    }
+
+    void Graph::restoreFromSnapshot(const StatePtr &node) const {
+        if (!this->_snapshot) {
+            return;
+        }
+        const GraphSnapshot::StateRecord *record = this->_snapshot->findState(node->hash());
+        if (nullptr == record) {
+            return;
+        }
+        node->setVisitedCount(record->visitedCount);
+        for (const auto &action: node->getActions()) {
+            const GraphSnapshot::ActionRecord *actionRecord = this->_snapshot->findAction(*record, action->hash());
+            if (nullptr != actionRecord) {
+                action->setVisitedCount(actionRecord->visitedCount);
+                action->setQValue(actionRecord->qValue);
+            }
+        }
+    }
+
+    GraphSnapshotBuilderPtr Graph::buildSnapshot() const {
+        auto builder = std::make_shared<GraphSnapshotBuilder>();
+        std::unordered_set<uint64_t> stateHashes;
+        stateHashes.reserve(this->_states.size());
+        for (const auto &state: this->_states) {
+            stringPtr activity = state->getActivityString();
+            builder->addState(state->hash(), state->getVisitedCount(), activity ? *activity : std::string());
+            for (const auto &action: state->getActions()) {
+                builder->addAction(action->hash(), action->getVisitedCount(),
+                                   static_cast<float>(action->getQValue()));
+            }
+            stateHashes.insert(state->hash());
+        }
+        if (this->_snapshot) {
+            const GraphSnapshot::StateRecord *records = this->_snapshot->states();
+            for (size_t i = 0; i < this->_snapshot->stateCount(); ++i) {
+                if (stateHashes.find(records[i].hash) == stateHashes.end()) {
+                    builder->addState(*this->_snapshot, records[i]);
+                }
+            }
+        }
+        for (const auto &distri: this->_activityDistri) {
+            builder->setActivityVisitedCount(distri.first, distri.second.first);
+        }
+        builder->setTotalDistri(this->_totalDistri);
+        return builder;
+    }
+
     void Graph::notifyNewStateEvents(const StatePtr &node) {
         for (const auto &listener: this->_listeners) {
             listener->onAddNode(node);
@@ -138,6 +289,9 @@ namespace fastbotx {
 
     Graph::~Graph() {
         this->_states.clear();
+        this->_residentPositions.clear();
+        this->_residentStates.clear();
+        this->_statesById.clear();
         this->_unvisitedActions.clear();
         this->_widgetActions.clear();
     }
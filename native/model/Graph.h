@@ -11,6 +11,9 @@
 #include "Base.h"
 #include "Action.h"
 #include "../desc/reuse/ActionSimilarity.h"
+#include "GraphSnapshot.h"
+#include "TransitionEdgeStore.h"
+#include <list>
 #include <map>
 
 namespace fastbotx {
@@ -65,6 +68,27 @@ namespace fastbotx {
 
         stringPtrSet getVisitedActivities() const { return this->_visitedActivities; };
 
+        // 保留控件树的状态数，超出时最久没有访问的状态被压缩（见State::compactDetails）；<= 0 表示不限制
+        void setResidentStateBudget(int budget);
+
+        size_t residentStateSize() const { return this->_residentStates.size(); }
+
+        // 记录执行from中的action后到达to
+        void addTransition(const StatePtr &from, const ActivityStateActionPtr &action, const StatePtr &to);
+
+        // 沿已知的转移走向最近的、还有未执行action的状态，返回from中路径的第一步；
+        // maxDepth步之内没有这样的状态时返回nullptr
+        ActivityStateActionPtr planActionToFrontier(const StatePtr &from, size_t maxDepth);
+
+        size_t transitionSize() const { return this->_transitions.edgeCount(); }
+
+        // 挂上一次运行的图快照：activity分布立即恢复，状态与action的访问次数和Q值在状态第一次加入图时恢复
+        void attachSnapshot(const GraphSnapshotPtr &snapshot);
+
+        // 当前的图与快照中本次运行没有访问到的状态合并成待保存的快照。
+        // 图不是线程安全的，须在agent线程上调用；返回的builder可以交给其他线程写出
+        GraphSnapshotBuilderPtr buildSnapshot() const;
+
 
         // 查找与给定action相似的已访问action
         //ActivityNameActionPtr findSimilarAction(const ActivityNameActionPtr& action, double threshold = 0.8) const;
@@ -81,8 +105,15 @@ namespace fastbotx {
     private:
         void addActionFromState(const StatePtr &node);
 
+        // 状态被访问：移到最近访问的一端，超出预算时压缩最久没有访问的状态
+        void touchResidentState(const StatePtr &node);
+
+        // 新状态在快照中有记录时恢复其访问次数，以及其action的访问次数与Q值
+        void restoreFromSnapshot(const StatePtr &node) const;
+
 
         StatePtrSet _states;      // all of the states in the graph
+        std::vector<StatePtr> _statesById;  // the same states indexed by their ids
         stringPtrSet _visitedActivities; // a string set containing all the visited activities
         std::map<std::string, std::pair<int, double>> _activityDistri;
         long _totalDistri; // the count of reaching or accessing states, which could be new states or a state accessed before
@@ -94,6 +125,12 @@ namespace fastbotx {
         ActionCounter _actionCounter;
         GraphListenerPtrVec _listeners;
         time_t _timeStamp;
+        GraphSnapshotPtr _snapshot;
+        TransitionEdgeStore _transitions;
+        int _residentStateBudget;
+        std::list<int> _residentStates;     // ids of the states keeping details, least recently visited first
+        std::vector<std::list<int>::iterator> _residentPositions;   // indexed by id, end() if compacted
+        FrontierPlanner _frontierPlanner;
 
         const static std::pair<int, double> _defaultDistri;
     };
@@ -0,0 +1,252 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef GraphSnapshot_CPP_
+#define GraphSnapshot_CPP_
+
+#include "GraphSnapshot.h"
+#include "../utils.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace fastbotx {
+
+    static const char GRAPH_MAGIC[8] = {'F', 'B', 'G', 'R', 'A', 'P', 'H', '1'};
+    static const uint32_t GRAPH_VERSION = 1;
+
+    // 文件布局：头部、状态记录、action记录、activity表、activity名字，均为本机字节序
+    struct GraphFileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t stateCount;
+        uint64_t actionCount;
+        uint64_t activityCount;
+        uint64_t namesSize;
+        int64_t totalDistri;
+    };
+
+    static const size_t ActivityFields = 3;
+
+    GraphSnapshot::GraphSnapshot()
+            : _states(nullptr), _actions(nullptr), _activities(nullptr), _names(nullptr), _stateCount(0),
+              _actionCount(0), _activityCount(0), _namesSize(0), _totalDistri(0) {
+    }
+
+    GraphSnapshotPtr GraphSnapshot::open(const std::string &path) {
+        MappedModelFilePtr file = MappedModelFile::open(path);
+        if (!file) {
+            return nullptr;
+        }
+        GraphFileHeader header{};
+        if (file->size() < sizeof(header)) {
+            BLOGE("graph snapshot %s is truncated", path.c_str());
+            return nullptr;
+        }
+        memcpy(&header, file->data(), sizeof(header));
+        if (0 != memcmp(header.magic, GRAPH_MAGIC, sizeof(header.magic)) || GRAPH_VERSION != header.version) {
+            BLOGE("graph snapshot %s is invalid", path.c_str());
+            return nullptr;
+        }
+        // 各段长度先与文件大小比较，避免乘法溢出
+        uint64_t remaining = file->size() - sizeof(header);
+        if (header.stateCount > remaining / sizeof(StateRecord) ||
+            header.actionCount > remaining / sizeof(ActionRecord) ||
+            header.activityCount > remaining / (ActivityFields * sizeof(uint32_t)) ||
+            header.stateCount * sizeof(StateRecord) + header.actionCount * sizeof(ActionRecord) +
+            header.activityCount * ActivityFields * sizeof(uint32_t) + header.namesSize != remaining) {
+            BLOGE("graph snapshot %s is truncated", path.c_str());
+            return nullptr;
+        }
+        GraphSnapshotPtr snapshot(new GraphSnapshot());
+        const uint8_t *data = file->data() + sizeof(header);
+        snapshot->_states = reinterpret_cast<const StateRecord *>(data);
+        data += header.stateCount * sizeof(StateRecord);
+        snapshot->_actions = reinterpret_cast<const ActionRecord *>(data);
+        data += header.actionCount * sizeof(ActionRecord);
+        snapshot->_activities = reinterpret_cast<const uint32_t *>(data);
+        data += header.activityCount * ActivityFields * sizeof(uint32_t);
+        snapshot->_names = reinterpret_cast<const char *>(data);
+        snapshot->_stateCount = static_cast<size_t>(header.stateCount);
+        snapshot->_actionCount = static_cast<size_t>(header.actionCount);
+        snapshot->_activityCount = static_cast<size_t>(header.activityCount);
+        snapshot->_namesSize = static_cast<size_t>(header.namesSize);
+        snapshot->_totalDistri = static_cast<long>(header.totalDistri);
+        snapshot->_file = file;
+        return snapshot;
+    }
+
+    bool GraphSnapshot::validState(const StateRecord &state) const {
+        return state.firstAction <= _actionCount && state.actionCount <= _actionCount - state.firstAction &&
+               state.activity < _activityCount;
+    }
+
+    const GraphSnapshot::StateRecord *GraphSnapshot::findState(uint64_t hash) const {
+        const StateRecord *end = _states + _stateCount;
+        const StateRecord *found = std::lower_bound(_states, end, hash,
+                                                    [](const StateRecord &record, uint64_t value) {
+                                                        return record.hash < value;
+                                                    });
+        if (found == end || found->hash != hash || !validState(*found)) {
+            return nullptr;
+        }
+        return found;
+    }
+
+    const GraphSnapshot::ActionRecord *GraphSnapshot::findAction(const StateRecord &state, uint64_t hash) const {
+        const ActionRecord *begin = actions(state);
+        const ActionRecord *end = begin + state.actionCount;
+        const ActionRecord *found = std::lower_bound(begin, end, hash,
+                                                     [](const ActionRecord &record, uint64_t value) {
+                                                         return record.hash < value;
+                                                     });
+        if (found == end || found->hash != hash) {
+            return nullptr;
+        }
+        return found;
+    }
+
+    std::string GraphSnapshot::activityName(size_t index) const {
+        if (index >= _activityCount) {
+            return std::string();
+        }
+        const uint32_t *activity = _activities + index * ActivityFields;
+        if (activity[0] > _namesSize || activity[1] > _namesSize - activity[0]) {
+            return std::string();
+        }
+        return std::string(_names + activity[0], activity[1]);
+    }
+
+    int GraphSnapshot::activityVisitedCount(size_t index) const {
+        return index < _activityCount ? static_cast<int>(_activities[index * ActivityFields + 2]) : 0;
+    }
+
+    GraphSnapshotBuilder::GraphSnapshotBuilder()
+            : _totalDistri(0) {
+    }
+
+    uint32_t GraphSnapshotBuilder::activityIndex(const std::string &activity) {
+        auto found = this->_activityIndex.find(activity);
+        if (found != this->_activityIndex.end()) {
+            return found->second;
+        }
+        auto index = static_cast<uint32_t>(this->_activityNames.size());
+        this->_activityNames.push_back(activity);
+        this->_activityCounts.push_back(0);
+        this->_activityIndex.emplace(activity, index);
+        return index;
+    }
+
+    void GraphSnapshotBuilder::addState(uint64_t hash, int visitedCount, const std::string &activity) {
+        GraphSnapshot::StateRecord state{};
+        state.hash = hash;
+        state.visitedCount = visitedCount;
+        state.activity = activityIndex(activity);
+        state.firstAction = static_cast<uint32_t>(this->_actions.size());
+        state.actionCount = 0;
+        this->_states.push_back(state);
+    }
+
+    void GraphSnapshotBuilder::addAction(uint64_t hash, int visitedCount, float qValue) {
+        if (this->_states.empty()) {
+            return;
+        }
+        GraphSnapshot::ActionRecord action{};
+        action.hash = hash;
+        action.visitedCount = visitedCount;
+        action.qValue = qValue;
+        this->_actions.push_back(action);
+        this->_states.back().actionCount++;
+    }
+
+    void GraphSnapshotBuilder::addState(const GraphSnapshot &snapshot, const GraphSnapshot::StateRecord &state) {
+        if (!snapshot.validState(state)) {
+            return;
+        }
+        addState(state.hash, state.visitedCount, snapshot.activityName(state.activity));
+        const GraphSnapshot::ActionRecord *actions = snapshot.actions(state);
+        this->_actions.insert(this->_actions.end(), actions, actions + state.actionCount);
+        this->_states.back().actionCount = state.actionCount;
+    }
+
+    void GraphSnapshotBuilder::setActivityVisitedCount(const std::string &activity, int count) {
+        this->_activityCounts[activityIndex(activity)] = count;
+    }
+
+    bool GraphSnapshotBuilder::save(const std::string &path) {
+        // 状态按hash排序，同一hash只保留先加入的一条；每个状态的action重新连续排列并按hash排序
+        std::stable_sort(this->_states.begin(), this->_states.end(),
+                         [](const GraphSnapshot::StateRecord &a, const GraphSnapshot::StateRecord &b) {
+                             return a.hash < b.hash;
+                         });
+        std::vector<GraphSnapshot::StateRecord> states;
+        std::vector<GraphSnapshot::ActionRecord> actions;
+        states.reserve(this->_states.size());
+        actions.reserve(this->_actions.size());
+        for (const auto &state : this->_states) {
+            if (!states.empty() && states.back().hash == state.hash) {
+                continue;
+            }
+            GraphSnapshot::StateRecord sorted = state;
+            sorted.firstAction = static_cast<uint32_t>(actions.size());
+            actions.insert(actions.end(), this->_actions.begin() + state.firstAction,
+                           this->_actions.begin() + state.firstAction + state.actionCount);
+            auto begin = actions.begin() + sorted.firstAction;
+            std::stable_sort(begin, actions.end(),
+                             [](const GraphSnapshot::ActionRecord &a, const GraphSnapshot::ActionRecord &b) {
+                                 return a.hash < b.hash;
+                             });
+            actions.erase(std::unique(begin, actions.end(),
+                                      [](const GraphSnapshot::ActionRecord &a, const GraphSnapshot::ActionRecord &b) {
+                                          return a.hash == b.hash;
+                                      }), actions.end());
+            sorted.actionCount = static_cast<uint32_t>(actions.size() - sorted.firstAction);
+            states.push_back(sorted);
+        }
+
+        std::vector<uint32_t> activities;
+        std::string names;
+        activities.reserve(this->_activityNames.size() * ActivityFields);
+        for (size_t i = 0; i < this->_activityNames.size(); ++i) {
+            activities.push_back(static_cast<uint32_t>(names.size()));
+            activities.push_back(static_cast<uint32_t>(this->_activityNames[i].size()));
+            activities.push_back(static_cast<uint32_t>(std::max(0, this->_activityCounts[i])));
+            names += this->_activityNames[i];
+        }
+
+        GraphFileHeader header{};
+        memcpy(header.magic, GRAPH_MAGIC, sizeof(header.magic));
+        header.version = GRAPH_VERSION;
+        header.stateCount = states.size();
+        header.actionCount = actions.size();
+        header.activityCount = this->_activityNames.size();
+        header.namesSize = names.size();
+        header.totalDistri = this->_totalDistri;
+
+        std::string tempPath = path + ".tmp";
+        std::ofstream out(tempPath, std::ios::binary);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(states.data()),
+                  static_cast<std::streamsize>(states.size() * sizeof(GraphSnapshot::StateRecord)));
+        out.write(reinterpret_cast<const char *>(actions.data()),
+                  static_cast<std::streamsize>(actions.size() * sizeof(GraphSnapshot::ActionRecord)));
+        out.write(reinterpret_cast<const char *>(activities.data()),
+                  static_cast<std::streamsize>(activities.size() * sizeof(uint32_t)));
+        out.write(names.data(), static_cast<std::streamsize>(names.size()));
+        out.close();
+        if (!out.good() || 0 != std::rename(tempPath.c_str(), path.c_str())) {
+            BLOGE("save graph snapshot to %s failed", path.c_str());
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+}
+
+#endif // GraphSnapshot_CPP_
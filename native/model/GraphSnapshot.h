@@ -0,0 +1,118 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef GraphSnapshot_H_
+#define GraphSnapshot_H_
+
+#include "../desc/reuse/MappedModelFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fastbotx {
+
+    class GraphSnapshot;
+
+    typedef std::shared_ptr<GraphSnapshot> GraphSnapshotPtr;
+
+    // 上一次运行结束时的探索图：状态的访问次数、每个状态下action的访问次数与Q值，以及activity的访问分布。
+    // 文件只读映射，状态按hash升序、每个状态的action连续存放且按hash升序，查找是二分，只有访问到的页会载入内存。
+    // hash与.fbm复用模型一样只在同一应用版本的多次运行之间稳定
+    class GraphSnapshot {
+    public:
+        struct StateRecord {
+            uint64_t hash;
+            int32_t visitedCount;
+            uint32_t activity;      // activity表中的下标
+            uint32_t firstAction;
+            uint32_t actionCount;
+        };
+
+        struct ActionRecord {
+            uint64_t hash;
+            int32_t visitedCount;
+            float qValue;
+        };
+
+        // 文件不存在、损坏或版本不同时返回nullptr
+        static GraphSnapshotPtr open(const std::string &path);
+
+        size_t stateCount() const { return _stateCount; }
+
+        const StateRecord *states() const { return _states; }
+
+        const StateRecord *findState(uint64_t hash) const;
+
+        // action范围或activity下标越界的记录（文件损坏）视为不存在
+        bool validState(const StateRecord &state) const;
+
+        const ActionRecord *actions(const StateRecord &state) const { return _actions + state.firstAction; }
+
+        const ActionRecord *findAction(const StateRecord &state, uint64_t hash) const;
+
+        size_t activityCount() const { return _activityCount; }
+
+        std::string activityName(size_t index) const;
+
+        int activityVisitedCount(size_t index) const;
+
+        long totalDistri() const { return _totalDistri; }
+
+    private:
+        GraphSnapshot();
+
+        MappedModelFilePtr _file;
+        const StateRecord *_states;
+        const ActionRecord *_actions;
+        const uint32_t *_activities;    // 每项 {名字偏移, 名字长度, 访问次数}
+        const char *_names;
+        size_t _stateCount;
+        size_t _actionCount;
+        size_t _activityCount;
+        size_t _namesSize;
+        long _totalDistri;
+    };
+
+    // 收集要写出的图：状态与action按任意顺序加入，保存时排序。action属于最近加入的状态
+    class GraphSnapshotBuilder {
+    public:
+        GraphSnapshotBuilder();
+
+        void addState(uint64_t hash, int visitedCount, const std::string &activity);
+
+        void addAction(uint64_t hash, int visitedCount, float qValue);
+
+        // 复制快照中的一个状态及其action（本次运行没有访问到的状态）
+        void addState(const GraphSnapshot &snapshot, const GraphSnapshot::StateRecord &state);
+
+        void setActivityVisitedCount(const std::string &activity, int count);
+
+        void setTotalDistri(long totalDistri) { _totalDistri = totalDistri; }
+
+        size_t stateCount() const { return _states.size(); }
+
+        // 写临时文件再rename，正在映射旧文件的读者不受影响
+        bool save(const std::string &path);
+
+    private:
+        uint32_t activityIndex(const std::string &activity);
+
+        std::vector<GraphSnapshot::StateRecord> _states;
+        std::vector<GraphSnapshot::ActionRecord> _actions;
+        std::vector<std::string> _activityNames;
+        std::vector<int32_t> _activityCounts;
+        std::unordered_map<std::string, uint32_t> _activityIndex;
+        long _totalDistri;
+    };
+
+    typedef std::shared_ptr<GraphSnapshotBuilder> GraphSnapshotBuilderPtr;
+
+}
+
+#endif // GraphSnapshot_H_
@@ -9,14 +9,13 @@
 
 #include "Model.h"
 #include "StateFactory.h"
+#include "IconIngestion.h"
 #include "../utils.hpp"
+#include <algorithm>
+#include <chrono>
 #include <ctime>
 #include <iostream>
 
-// 声明外部变量
-extern std::unordered_map<std::string, std::map<std::string, std::string>> g_activityIconsMap;
-extern std::mutex g_iconsMutex;
-
 namespace fastbotx {
 
     std::shared_ptr<Model> Model::create() {
@@ -30,7 +29,52 @@ namespace fastbotx {
         BLOG("---- native version " FASTBOT_VERSION " native version ----\n");
         this->_graph = std::make_shared<Graph>();
         this->_preference = Preference::inst();
+        this->_graph->setResidentStateBudget(this->_preference->getGraphResidentStates());
         this->_netActionParam.netActionTaskid = 0;
+        this->_graphSnapshotSavedAt = 0;
+    }
+
+#ifdef __ANDROID__
+#define STORAGE_PREFIX "/sdcard/fastbot_"
+#else
+#define STORAGE_PREFIX ""
+#endif
+
+// 与复用模型的后台保存间隔一致
+#define GraphSnapshotSaveInterval (2 * 60 * 1000)
+
+    void Model::loadGraphSnapshot(const std::string &packageName) {
+        this->_graphSnapshotPath = std::string(STORAGE_PREFIX) + packageName + ".graph";
+        this->_graphSnapshotSavedAt = currentStamp();
+        GraphSnapshotPtr snapshot = GraphSnapshot::open(this->_graphSnapshotPath);
+        if (!snapshot) {
+            BLOG("no graph snapshot at %s, start from an empty graph", this->_graphSnapshotPath.c_str());
+            return;
+        }
+        this->_graph->attachSnapshot(snapshot);
+    }
+
+    void Model::saveGraphSnapshotIfNeeded() {
+        if (this->_graphSnapshotPath.empty()) {
+            return;
+        }
+        double now = currentStamp();
+        if (now - this->_graphSnapshotSavedAt < GraphSnapshotSaveInterval) {
+            return;
+        }
+        // 上一次写出还没有完成时推迟到下一步
+        if (this->_graphSnapshotSave.valid() &&
+            this->_graphSnapshotSave.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return;
+        }
+        this->_graphSnapshotSavedAt = now;
+        GraphSnapshotBuilderPtr builder = this->_graph->buildSnapshot();
+        std::string path = this->_graphSnapshotPath;
+        this->_graphSnapshotSave = std::async(std::launch::async, [builder, path]() {
+            if (builder->save(path)) {
+                BLOG("save graph snapshot %s: %zu states", path.c_str(), builder->stateCount());
+            }
+        });
     }
 
 
@@ -124,21 +168,32 @@ namespace fastbotx {
             //include all the possible actions according to the widgets inside.
             state = StateFactory::createState(agent->getAlgorithmType(), activityStringPtr,
                                               element);
-            _currentState = state;
-            std::lock_guard<std::mutex> lock(g_iconsMutex);
-            auto it = g_activityIconsMap.find(activity);
-            if (it != g_activityIconsMap.end()) {
-            // 如果有图标信息，设置到模型中
-                setWidgetIcons(activity, it->second);
-            }
             // add state
             // add this state, and the agent will treat this state as the new state(_newState)
             state = this->_graph->addState(state);//初始化modelreuseagent里的_newstate
+            _currentState = state;
+            // 图标由后台线程解码后发布，这里只取已处理完的快照，不等待也不持锁。
+            // 状态已在图中时addState返回图中的对象，第一次访问时还没有图标的状态在之后的访问中补上
+            const WidgetPtrVec &widgets = state->getWidgets();
+            bool missingIcons = std::any_of(widgets.begin(), widgets.end(), [](const WidgetPtr &widget) {
+                return INVALID_ICON_ID == widget->getIconId();
+            });
+            if (missingIcons) {
+                WidgetIconIdMapPtr widgetIcons = IconIngestion::inst()->snapshot(activity);
+                if (widgetIcons) {
+                    setWidgetIcons(activity, *widgetIcons);
+                }
+            }
             state->visit(this->_graph->getTimestamp());
+            if (this->_performedState && this->_performedAction) {
+                this->_graph->addTransition(this->_performedState, this->_performedAction, state);
+            }
         }
 
         // new state is prepared, record the current time
         double stateGeneratedTimestamp = currentStamp();
+        this->_performedState = nullptr;
+        this->_performedAction = nullptr;
         ActionPtr action = customActionPtr; // load the action specified by user
 
         BDLOGE("%s", state->toString().c_str());
@@ -173,6 +228,8 @@ namespace fastbotx {
             if (action->isModelAct() && state) {
                 action->visit(this->_graph->getTimestamp());
                 agent->moveForward(state); // update _currentState/Action with _newState/Action
+                this->_performedState = state;
+                this->_performedAction = std::dynamic_pointer_cast<ActivityStateAction>(action);
             }
         }
 
@@ -189,6 +246,7 @@ namespace fastbotx {
             if (DROP_DETAIL_AFTER_SATE && state && !state->hasNoDetail())
                 state->clearDetails();
         }
+        saveGraphSnapshotIfNeeded();
         // the whole process end, record the current time.
         double methodEndTimestamp = currentStamp();
         BLOG("build state cost: %.3fs action cost: %.3fs total cost %.3fs",
@@ -198,7 +256,7 @@ namespace fastbotx {
         return opt;
     }
 
-    void Model::setWidgetIcons(const std::string& activityName, const std::map<std::string, std::string>& iconMap) {
+    void Model::setWidgetIcons(const std::string& activityName, const WidgetIconIdMap& iconMap) {
         // 如果当前状态已创建且活动名称匹配，则设置图标
         if (_currentState != nullptr) {
             auto reuseState = std::dynamic_pointer_cast<ReuseState>(_currentState);
@@ -208,6 +266,12 @@ namespace fastbotx {
         }
     }
     Model::~Model() {
+        if (this->_graphSnapshotSave.valid()) {
+            this->_graphSnapshotSave.wait();
+        }
+        if (!this->_graphSnapshotPath.empty()) {
+            this->_graph->buildSnapshot()->save(this->_graphSnapshotPath);
+        }
         this->_deviceIDAgentMap.clear();
     }
 
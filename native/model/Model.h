@@ -7,6 +7,7 @@
 #ifndef  Model_H_
 #define  Model_H_
 
+#include <future>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
@@ -75,7 +76,7 @@ namespace fastbotx {
         OperatePtr getOperateOpt(const ElementPtr &element, const std::string &activity,
                                  const std::string &deviceID = "");
 
-        void setWidgetIcons(const std::string& activityName, const std::map<std::string, std::string>& iconMap);
+        void setWidgetIcons(const std::string& activityName, const WidgetIconIdMap& iconMap);
 
         PreferencePtr getPreference() const { return this->_preference; }
 
@@ -86,12 +87,22 @@ namespace fastbotx {
 
         int getNetActionTaskID() const { return this->_netActionParam.netActionTaskid; }
 
+        /// Attach the exploration graph saved by the previous run of this package, so that visit counts and
+        /// Q values start from the learned ones. The snapshot file is mapped, not read, and the graph is saved
+        /// back to it periodically while exploring.
+        /// \param packageName The package name of the app under test
+        void loadGraphSnapshot(const std::string &packageName);
+
         virtual ~Model();
 
     protected:
         Model();
 
     private:
+        /// Collect the graph on the calling (agent) thread and write it in the background,
+        /// at most once per GraphSnapshotSaveInterval
+        void saveGraphSnapshotIfNeeded();
+
         // The smart pointer of the graph object
         GraphPtr _graph;
         // A map containing pairs of device id and the corresponding agent object
@@ -102,11 +113,17 @@ namespace fastbotx {
         // The parameters for communicating with the net model
         NetActionParam _netActionParam;
 
-        // 存储Widget图标数据的映射表
-        std::unordered_map<std::string, std::string> _widgetIconMap;
-
         // 当前状态
         StatePtr _currentState;
+
+        // 上一步执行的action及其所在状态，下一个状态加入图时记录这次转移
+        StatePtr _performedState;
+        ActivityStateActionPtr _performedAction;
+
+        // 图快照的保存路径，为空时不保存
+        std::string _graphSnapshotPath;
+        double _graphSnapshotSavedAt;
+        std::future<void> _graphSnapshotSave;
     };
 
     typedef std::shared_ptr<Model> ModelPtr;
@@ -0,0 +1,136 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef TransitionEdgeStore_CPP_
+#define TransitionEdgeStore_CPP_
+
+#include "TransitionEdgeStore.h"
+#include <algorithm>
+#include <limits>
+
+namespace fastbotx {
+
+    // 增量缓冲并入CSR的最小边数，避免小图频繁重建
+    static const size_t MinDeltaEdgesToMerge = 1024;
+
+    TransitionEdgeStore::TransitionEdgeStore()
+            : _offsets(1, 0), _deltaEdges(0), _deltaNewEdges(0) {
+    }
+
+    TransitionEdgeStore::EdgeView TransitionEdgeStore::edges(uint32_t from) const {
+        auto delta = this->_delta.find(from);
+        if (delta != this->_delta.end()) {
+            return EdgeView(delta->second.data(), delta->second.size());
+        }
+        if (from + 1 >= this->_offsets.size()) {
+            return EdgeView();
+        }
+        return EdgeView(this->_edges.data() + this->_offsets[from], this->_offsets[from + 1] - this->_offsets[from]);
+    }
+
+    void TransitionEdgeStore::addEdge(uint32_t from, uint32_t action, uint32_t to) {
+        auto delta = this->_delta.find(from);
+        if (delta == this->_delta.end()) {
+            EdgeView view = edges(from);
+            delta = this->_delta.emplace(from, std::vector<Edge>(view.edges, view.edges + view.size)).first;
+            this->_deltaEdges += view.size;
+        }
+        std::vector<Edge> &row = delta->second;
+        auto edge = std::find_if(row.begin(), row.end(), [action, to](const Edge &e) {
+            return e.action == action && e.to == to;
+        });
+        if (edge != row.end()) {
+            if (edge->count < std::numeric_limits<uint32_t>::max()) {
+                edge->count++;
+            }
+            return;
+        }
+        row.push_back(Edge{action, to, 1});
+        this->_deltaEdges++;
+        this->_deltaNewEdges++;
+        if (this->_deltaEdges > std::max(MinDeltaEdgesToMerge, this->_edges.size() / 8)) {
+            mergeDelta();
+        }
+    }
+
+    void TransitionEdgeStore::mergeDelta() {
+        if (this->_delta.empty()) {
+            return;
+        }
+        uint32_t rows = static_cast<uint32_t>(this->_offsets.size() - 1);
+        for (const auto &delta : this->_delta) {
+            rows = std::max(rows, delta.first + 1);
+        }
+        std::vector<uint32_t> offsets;
+        std::vector<Edge> merged;
+        offsets.reserve(rows + 1);
+        merged.reserve(edgeCount());
+        offsets.push_back(0);
+        for (uint32_t from = 0; from < rows; ++from) {
+            EdgeView view = edges(from);
+            merged.insert(merged.end(), view.edges, view.edges + view.size);
+            offsets.push_back(static_cast<uint32_t>(merged.size()));
+        }
+        this->_offsets.swap(offsets);
+        this->_edges.swap(merged);
+        this->_delta.clear();
+        this->_deltaEdges = 0;
+        this->_deltaNewEdges = 0;
+    }
+
+    FrontierPlanner::FrontierPlanner()
+            : _generation(0) {
+    }
+
+    bool FrontierPlanner::plan(const TransitionEdgeStore &edges, uint32_t from, size_t stateCount, size_t maxDepth,
+                               const std::function<bool(uint32_t)> &isFrontier, uint32_t &firstAction,
+                               size_t &pathLength) {
+        if (from >= stateCount || 0 == maxDepth) {
+            return false;
+        }
+        if (this->_seen.size() < stateCount) {
+            this->_seen.resize(stateCount, 0);
+            this->_firstAction.resize(stateCount, 0);
+        }
+        if (++this->_generation == 0) {
+            // 代数回绕，重新清零
+            std::fill(this->_seen.begin(), this->_seen.end(), 0);
+            this->_generation = 1;
+        }
+        uint32_t generation = this->_generation;
+        this->_queue.clear();
+        this->_queue.push_back(from);
+        this->_seen[from] = generation;
+        // 按层展开，_queue[levelBegin, levelEnd)为当前层
+        size_t levelBegin = 0;
+        for (size_t depth = 1; depth <= maxDepth && levelBegin < this->_queue.size(); ++depth) {
+            size_t levelEnd = this->_queue.size();
+            for (size_t i = levelBegin; i < levelEnd; ++i) {
+                uint32_t state = this->_queue[i];
+                TransitionEdgeStore::EdgeView view = edges.edges(state);
+                for (size_t e = 0; e < view.size; ++e) {
+                    uint32_t to = view.edges[e].to;
+                    if (to >= stateCount || this->_seen[to] == generation) {
+                        continue;
+                    }
+                    this->_seen[to] = generation;
+                    this->_firstAction[to] = state == from ? view.edges[e].action : this->_firstAction[state];
+                    if (isFrontier(to)) {
+                        firstAction = this->_firstAction[to];
+                        pathLength = depth;
+                        return true;
+                    }
+                    this->_queue.push_back(to);
+                }
+            }
+            levelBegin = levelEnd;
+        }
+        return false;
+    }
+
+}
+
+#endif // TransitionEdgeStore_CPP_
@@ -0,0 +1,80 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef TransitionEdgeStore_H_
+#define TransitionEdgeStore_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace fastbotx {
+
+    // 观测到的状态转移 (state, action) -> next state 及其次数。
+    // 按起点状态编号（图中的状态编号是连续的）做CSR：每个状态的出边连续存放，BFS展开一个状态是顺序读内存。
+    // 新的转移先写入增量缓冲（第一次修改某个状态时从CSR复制其出边），增量缓冲超过CSR的一定比例时整体并入CSR。
+    // 不是线程安全的
+    class TransitionEdgeStore {
+    public:
+        struct Edge {
+            uint32_t action;    // 起点状态中action的下标
+            uint32_t to;        // 终点状态编号
+            uint32_t count;
+        };
+
+        struct EdgeView {
+            const Edge *edges;
+            size_t size;
+
+            EdgeView() : edges(nullptr), size(0) {}
+
+            EdgeView(const Edge *e, size_t s) : edges(e), size(s) {}
+        };
+
+        TransitionEdgeStore();
+
+        // 记录一次转移，已有的边次数加一
+        void addEdge(uint32_t from, uint32_t action, uint32_t to);
+
+        // 状态的出边，视图在下一次修改之前有效
+        EdgeView edges(uint32_t from) const;
+
+        size_t edgeCount() const { return _edges.size() + _deltaNewEdges; }
+
+        void mergeDelta();
+
+    private:
+        std::vector<uint32_t> _offsets;     // 状态from的出边为_edges[_offsets[from], _offsets[from + 1])
+        std::vector<Edge> _edges;
+        std::unordered_map<uint32_t, std::vector<Edge>> _delta;
+        size_t _deltaEdges;     // 增量缓冲中的边数
+        size_t _deltaNewEdges;  // 增量缓冲中CSR没有的边数
+    };
+
+    // 在已知的转移上找到最近的前沿状态（还有未执行action的状态）的最短路径。
+    // 每次规划都从当前状态重新BFS：转移不是确定的，走出一步后实际到达的状态可能不同。
+    // 访问标记按代数递增，不需要每次清空
+    class FrontierPlanner {
+    public:
+        FrontierPlanner();
+
+        // 从from出发按边数最少到达isFrontier为真的状态（不含from本身），返回路径第一步的action下标；
+        // 超过maxDepth步或不可达时返回false。pathLength为到达前沿需要的步数
+        bool plan(const TransitionEdgeStore &edges, uint32_t from, size_t stateCount, size_t maxDepth,
+                  const std::function<bool(uint32_t)> &isFrontier, uint32_t &firstAction, size_t &pathLength);
+
+    private:
+        std::vector<uint32_t> _seen;        // 状态最近一次被访问时的代数
+        std::vector<uint32_t> _firstAction; // 到达该状态的路径第一步
+        std::vector<uint32_t> _queue;
+        uint32_t _generation;
+    };
+
+}
+
+#endif // TransitionEdgeStore_H_
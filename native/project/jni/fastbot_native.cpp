@@ -9,6 +9,8 @@
 #include "Model.h"
 #include "ModelReusableAgent.h"
 #include "WidgetReusableAgent.h"
+#include "ActionSimilarity.h"
+#include "IconIngestion.h"
 #include "utils.hpp"
 
 #ifdef __cplusplus
@@ -17,10 +19,6 @@ extern "C" {
 
 static fastbotx::ModelPtr _fastbot_model = nullptr;
 
-// 添加全局变量用于存储图标信息
-std::unordered_map<std::string, std::map<std::string, std::string>> g_activityIconsMap;
-std::mutex g_iconsMutex; // 用于线程安全访问
-
 //getAction
 jstring JNICALL Java_com_bytedance_fastbot_AiClient_b0bhkadf(JNIEnv *env, jobject, jstring activity,
                                                              jstring xmlDescOfGuiTree) {
@@ -56,13 +54,9 @@ Java_com_bytedance_fastbot_AiClient_setWidgetIcons(JNIEnv *env, jclass clazz, js
             iconMap[it.key()] = it.value();
         }
         
-        // 存储图标信息到全局变量
-        {
-            std::lock_guard<std::mutex> lock(g_iconsMutex);
-            g_activityIconsMap[activityName] = iconMap;
-        }
-        
-        LOGD("Stored %zu widget icons for activity: %s", iconMap.size(), activityName.c_str());
+        // 交给后台线程解码和登记
+        LOGD("Queued %zu widget icons for activity: %s", iconMap.size(), activityName.c_str());
+        fastbotx::IconIngestion::inst()->submitBase64(activityName, iconMap);
     } catch (const std::exception& e) {
         BLOGE("Failed to parse widget icons JSON: %s", e.what());
     }
@@ -72,6 +66,23 @@ Java_com_bytedance_fastbot_AiClient_setWidgetIcons(JNIEnv *env, jclass clazz, js
     env->ReleaseStringUTFChars(serialized_icons, serializedIconsChars);
 }
 
+// 二进制图标通道：buffer为direct ByteBuffer，内容拷贝入队后立即返回，解码和嵌入在后台完成
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_bytedance_fastbot_AiClient_setWidgetIconBuffer(JNIEnv *env, jclass clazz, jstring activity_name,
+                                                        jobject buffer, jint length) {
+    auto data = static_cast<const uint8_t *>(env->GetDirectBufferAddress(buffer));
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (nullptr == data || length < 0 || capacity < length) {
+        BLOGE("setWidgetIconBuffer needs a direct buffer holding %d bytes", length);
+        return JNI_FALSE;
+    }
+    const char *activityNameChars = env->GetStringUTFChars(activity_name, nullptr);
+    std::string activityName(activityNameChars);
+    env->ReleaseStringUTFChars(activity_name, activityNameChars);
+    bool queued = fastbotx::IconIngestion::inst()->submitBuffer(activityName, data, static_cast<size_t>(length));
+    return queued ? JNI_TRUE : JNI_FALSE;
+}
+
 // for single device, just addAgent as empty device //InitAgent
 void JNICALL Java_com_bytedance_fastbot_AiClient_fgdsaf5d(JNIEnv *env, jobject, jint agentType,
                                                           jstring packageName, jint deviceType) {
@@ -85,12 +96,16 @@ void JNICALL Java_com_bytedance_fastbot_AiClient_fgdsaf5d(JNIEnv *env, jobject,
     if (env)
         packageNameCString = env->GetStringUTFChars(packageName, nullptr);
     _fastbot_model->setPackageName(std::string(packageNameCString));
+    // 上一次运行的探索图：访问次数与Q值在状态第一次出现时恢复
+    _fastbot_model->loadGraphSnapshot(std::string(packageNameCString));
 
     BLOG("init agent with type %d, %s,  %d", agentType, packageNameCString, deviceType);
     if (algorithmType == fastbotx::AlgorithmType::Reuse) {
         // 所有的agent都应该是WidgetReusableAgent
         auto widgetReuseAgentPtr = std::dynamic_pointer_cast<fastbotx::WidgetReusableAgent>(agentPointer);
         if (widgetReuseAgentPtr) {
+            // 相似度模型在后台加载和预热，与复用模型的加载并行
+            fastbotx::ActionSimilarity::preloadModelsAsync();
             BLOG("Loading widget reuse model for WidgetReusableAgent");
             widgetReuseAgentPtr->loadReuseModel(std::string(packageNameCString));
         } else {
@@ -176,11 +191,11 @@ void JNICALL Java_com_bytedance_fastbot_AiClient_cleanup(JNIEnv *env, jobject) {
     }
 
     // 清理全局图标数据
-    {
-        std::lock_guard<std::mutex> lock(g_iconsMutex);
-        g_activityIconsMap.clear();
-        BLOG("Cleared global activity icons map");
-    }
+    fastbotx::IconIngestion::inst()->clear();
+    BLOG("Cleared pending and published widget icons");
+
+    // agent析构时已保存模型和图标嵌入缓存，此后停止相似度引擎的线程并释放模型会话
+    fastbotx::ActionSimilarity::shutdownEngine();
 }
 
 #ifdef __cplusplus
@@ -27,6 +27,11 @@ JNIEXPORT void JNICALL Java_com_bytedance_fastbot_AiClient_jdasdbil(JNIEnv *env,
 JNIEXPORT void JNICALL Java_com_bytedance_fastbot_AiClient_sendWidgetIcons(
     JNIEnv *env, jobject obj, jstring serializedIcons);
 
+// binary icon channel: direct ByteBuffer with widget keys and PNG/JPEG bytes
+JNIEXPORT jboolean JNICALL
+Java_com_bytedance_fastbot_AiClient_setWidgetIconBuffer(JNIEnv *env, jclass clazz, jstring activityName,
+                                                        jobject buffer, jint length);
+
 JNIEXPORT jboolean JNICALL
 Java_com_bytedance_fastbot_AiClient_nkksdhdk(JNIEnv *env, jobject, jstring activity, jfloat pointX,
                                              jfloat pointY);
@@ -8,6 +8,9 @@
 
 namespace fastbotx {
 
+struct QuantizedEmbedding;
+struct QuantizedEmbeddingBuilder;
+
 struct WidgetSimilarityAttributes;
 struct WidgetSimilarityAttributesBuilder;
 
@@ -23,9 +26,49 @@ struct ActionSimilarityAttributesBuilder;
 struct ReuseEntry;
 struct ReuseEntryBuilder;
 
+struct ActivityRecord;
+struct ActivityRecordBuilder;
+
+struct IconRecord;
+struct IconRecordBuilder;
+
+struct WidgetRecord;
+struct WidgetRecordBuilder;
+
+struct ActionRecord;
+struct ActionRecordBuilder;
+
+struct WidgetCountRef;
+
+struct ReuseEntryV2;
+struct ReuseEntryV2Builder;
+
 struct WidgetReuseModel;
 struct WidgetReuseModelBuilder;
 
+FLATBUFFERS_MANUALLY_ALIGNED_STRUCT(4) WidgetCountRef FLATBUFFERS_FINAL_CLASS {
+ private:
+  uint32_t widget_;
+  int32_t count_;
+
+ public:
+  WidgetCountRef()
+      : widget_(0),
+        count_(0) {
+  }
+  WidgetCountRef(uint32_t _widget, int32_t _count)
+      : widget_(flatbuffers::EndianScalar(_widget)),
+        count_(flatbuffers::EndianScalar(_count)) {
+  }
+  uint32_t widget() const {
+    return flatbuffers::EndianScalar(widget_);
+  }
+  int32_t count() const {
+    return flatbuffers::EndianScalar(count_);
+  }
+};
+FLATBUFFERS_STRUCT_END(WidgetCountRef, 8);
+
 struct WidgetCount FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   typedef WidgetCountBuilder Builder;
   enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
@@ -240,7 +283,14 @@ struct WidgetReuseModel FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
     VT_MODEL = 4,
     VT_PLATFORM_INFO = 6,
-    VT_SAVE_SIMILARITY_ATTRS = 8
+    VT_SAVE_SIMILARITY_ATTRS = 8,
+    VT_JOURNAL_SEQUENCE = 10,
+    VT_FORMAT_VERSION = 12,
+    VT_ENTRIES = 14,
+    VT_ACTIVITIES = 16,
+    VT_ICONS = 18,
+    VT_WIDGETS = 20,
+    VT_ACTIONS = 22
   };
   const flatbuffers::Vector<flatbuffers::Offset<fastbotx::ReuseEntry>> *model() const {
     return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<fastbotx::ReuseEntry>> *>(VT_MODEL);
@@ -251,6 +301,27 @@ struct WidgetReuseModel FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   bool save_similarity_attrs() const {
     return GetField<uint8_t>(VT_SAVE_SIMILARITY_ATTRS, 0) != 0;
   }
+  uint64_t journal_sequence() const {
+    return GetField<uint64_t>(VT_JOURNAL_SEQUENCE, 0);
+  }
+  int32_t format_version() const {
+    return GetField<int32_t>(VT_FORMAT_VERSION, 0);
+  }
+  const flatbuffers::Vector<flatbuffers::Offset<fastbotx::ReuseEntryV2>> *entries() const {
+    return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<fastbotx::ReuseEntryV2>> *>(VT_ENTRIES);
+  }
+  const flatbuffers::Vector<flatbuffers::Offset<fastbotx::ActivityRecord>> *activities() const {
+    return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<fastbotx::ActivityRecord>> *>(VT_ACTIVITIES);
+  }
+  const flatbuffers::Vector<flatbuffers::Offset<fastbotx::IconRecord>> *icons() const {
+    return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<fastbotx::IconRecord>> *>(VT_ICONS);
+  }
+  const flatbuffers::Vector<flatbuffers::Offset<fastbotx::WidgetRecord>> *widgets() const {
+    return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<fastbotx::WidgetRecord>> *>(VT_WIDGETS);
+  }
+  const flatbuffers::Vector<flatbuffers::Offset<fastbotx::ActionRecord>> *actions() const {
+    return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<fastbotx::ActionRecord>> *>(VT_ACTIONS);
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyOffset(verifier, VT_MODEL) &&
@@ -259,6 +330,23 @@ struct WidgetReuseModel FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
            VerifyOffset(verifier, VT_PLATFORM_INFO) &&
            verifier.VerifyString(platform_info()) &&
            VerifyField<uint8_t>(verifier, VT_SAVE_SIMILARITY_ATTRS) &&
+           VerifyField<uint64_t>(verifier, VT_JOURNAL_SEQUENCE) &&
+           VerifyField<int32_t>(verifier, VT_FORMAT_VERSION) &&
+           VerifyOffset(verifier, VT_ENTRIES) &&
+           verifier.VerifyVector(entries()) &&
+           verifier.VerifyVectorOfTables(entries()) &&
+           VerifyOffset(verifier, VT_ACTIVITIES) &&
+           verifier.VerifyVector(activities()) &&
+           verifier.VerifyVectorOfTables(activities()) &&
+           VerifyOffset(verifier, VT_ICONS) &&
+           verifier.VerifyVector(icons()) &&
+           verifier.VerifyVectorOfTables(icons()) &&
+           VerifyOffset(verifier, VT_WIDGETS) &&
+           verifier.VerifyVector(widgets()) &&
+           verifier.VerifyVectorOfTables(widgets()) &&
+           VerifyOffset(verifier, VT_ACTIONS) &&
+           verifier.VerifyVector(actions()) &&
+           verifier.VerifyVectorOfTables(actions()) &&
            verifier.EndTable();
   }
 };
@@ -276,6 +364,27 @@ struct WidgetReuseModelBuilder {
   void add_save_similarity_attrs(bool save_similarity_attrs) {
     fbb_.AddElement<uint8_t>(WidgetReuseModel::VT_SAVE_SIMILARITY_ATTRS, static_cast<uint8_t>(save_similarity_attrs), 0);
   }
+  void add_journal_sequence(uint64_t journal_sequence) {
+    fbb_.AddElement<uint64_t>(WidgetReuseModel::VT_JOURNAL_SEQUENCE, journal_sequence, 0);
+  }
+  void add_format_version(int32_t format_version) {
+    fbb_.AddElement<int32_t>(WidgetReuseModel::VT_FORMAT_VERSION, format_version, 0);
+  }
+  void add_entries(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<fastbotx::ReuseEntryV2>>> entries) {
+    fbb_.AddOffset(WidgetReuseModel::VT_ENTRIES, entries);
+  }
+  void add_activities(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<fastbotx::ActivityRecord>>> activities) {
+    fbb_.AddOffset(WidgetReuseModel::VT_ACTIVITIES, activities);
+  }
+  void add_icons(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<fastbotx::IconRecord>>> icons) {
+    fbb_.AddOffset(WidgetReuseModel::VT_ICONS, icons);
+  }
+  void add_widgets(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<fastbotx::WidgetRecord>>> widgets) {
+    fbb_.AddOffset(WidgetReuseModel::VT_WIDGETS, widgets);
+  }
+  void add_actions(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<fastbotx::ActionRecord>>> actions) {
+    fbb_.AddOffset(WidgetReuseModel::VT_ACTIONS, actions);
+  }
   explicit WidgetReuseModelBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -291,8 +400,22 @@ inline flatbuffers::Offset<WidgetReuseModel> CreateWidgetReuseModel(
     flatbuffers::FlatBufferBuilder &_fbb,
     flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<fastbotx::ReuseEntry>>> model = 0,
     flatbuffers::Offset<flatbuffers::String> platform_info = 0,
-    bool save_similarity_attrs = false) {
+    bool save_similarity_attrs = false,
+    uint64_t journal_sequence = 0,
+    int32_t format_version = 0,
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<fastbotx::ReuseEntryV2>>> entries = 0,
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<fastbotx::ActivityRecord>>> activities = 0,
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<fastbotx::IconRecord>>> icons = 0,
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<fastbotx::WidgetRecord>>> widgets = 0,
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<fastbotx::ActionRecord>>> actions = 0) {
   WidgetReuseModelBuilder builder_(_fbb);
+  builder_.add_journal_sequence(journal_sequence);
+  builder_.add_actions(actions);
+  builder_.add_widgets(widgets);
+  builder_.add_icons(icons);
+  builder_.add_activities(activities);
+  builder_.add_entries(entries);
+  builder_.add_format_version(format_version);
   builder_.add_model(model);
   builder_.add_platform_info(platform_info);
   builder_.add_save_similarity_attrs(save_similarity_attrs);
@@ -332,6 +455,69 @@ inline void FinishWidgetReuseModelBuffer(
   fbb.Finish(root);
 }
 
+struct QuantizedEmbedding FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  typedef QuantizedEmbeddingBuilder Builder;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_SCALE = 4,
+    VT_VALUES = 6
+  };
+  float scale() const {
+    return GetField<float>(VT_SCALE, 0.0f);
+  }
+  const flatbuffers::Vector<int8_t> *values() const {
+    return GetPointer<const flatbuffers::Vector<int8_t> *>(VT_VALUES);
+  }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<float>(verifier, VT_SCALE) &&
+           VerifyOffset(verifier, VT_VALUES) &&
+           verifier.VerifyVector(values()) &&
+           verifier.EndTable();
+  }
+};
+
+struct QuantizedEmbeddingBuilder {
+  typedef QuantizedEmbedding Table;
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_scale(float scale) {
+    fbb_.AddElement<float>(QuantizedEmbedding::VT_SCALE, scale, 0.0f);
+  }
+  void add_values(flatbuffers::Offset<flatbuffers::Vector<int8_t>> values) {
+    fbb_.AddOffset(QuantizedEmbedding::VT_VALUES, values);
+  }
+  explicit QuantizedEmbeddingBuilder(flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  flatbuffers::Offset<QuantizedEmbedding> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = flatbuffers::Offset<QuantizedEmbedding>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<QuantizedEmbedding> CreateQuantizedEmbedding(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    float scale = 0.0f,
+    flatbuffers::Offset<flatbuffers::Vector<int8_t>> values = 0) {
+  QuantizedEmbeddingBuilder builder_(_fbb);
+  builder_.add_values(values);
+  builder_.add_scale(scale);
+  return builder_.Finish();
+}
+
+inline flatbuffers::Offset<QuantizedEmbedding> CreateQuantizedEmbeddingDirect(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    float scale = 0.0f,
+    const std::vector<int8_t> *values = nullptr) {
+  auto values__ = values ? _fbb.CreateVector<int8_t>(*values) : 0;
+  return fastbotx::CreateQuantizedEmbedding(
+      _fbb,
+      scale,
+      values__);
+}
+
 // WidgetSimilarityAttributes structure
 struct WidgetSimilarityAttributes FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   typedef WidgetSimilarityAttributesBuilder Builder;
@@ -339,7 +525,11 @@ struct WidgetSimilarityAttributes FLATBUFFERS_FINAL_CLASS : private flatbuffers:
     VT_TEXT = 4,
     VT_ACTIVITY_NAME = 6,
     VT_RESOURCE_ID = 8,
-    VT_ICON_BASE64 = 10
+    VT_ICON_BASE64 = 10,
+    VT_TEXT_EMBEDDING = 12,
+    VT_ACTIVITY_EMBEDDING = 14,
+    VT_RESOURCE_ID_EMBEDDING = 16,
+    VT_ICON_EMBEDDING = 18
   };
   const flatbuffers::String *text() const {
     return GetPointer<const flatbuffers::String *>(VT_TEXT);
@@ -353,6 +543,18 @@ struct WidgetSimilarityAttributes FLATBUFFERS_FINAL_CLASS : private flatbuffers:
   const flatbuffers::String *icon_base64() const {
     return GetPointer<const flatbuffers::String *>(VT_ICON_BASE64);
   }
+  const QuantizedEmbedding *text_embedding() const {
+    return GetPointer<const QuantizedEmbedding *>(VT_TEXT_EMBEDDING);
+  }
+  const QuantizedEmbedding *activity_embedding() const {
+    return GetPointer<const QuantizedEmbedding *>(VT_ACTIVITY_EMBEDDING);
+  }
+  const QuantizedEmbedding *resource_id_embedding() const {
+    return GetPointer<const QuantizedEmbedding *>(VT_RESOURCE_ID_EMBEDDING);
+  }
+  const QuantizedEmbedding *icon_embedding() const {
+    return GetPointer<const QuantizedEmbedding *>(VT_ICON_EMBEDDING);
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyOffset(verifier, VT_TEXT) &&
@@ -363,6 +565,14 @@ struct WidgetSimilarityAttributes FLATBUFFERS_FINAL_CLASS : private flatbuffers:
            verifier.VerifyString(resource_id()) &&
            VerifyOffset(verifier, VT_ICON_BASE64) &&
            verifier.VerifyString(icon_base64()) &&
+           VerifyOffset(verifier, VT_TEXT_EMBEDDING) &&
+           verifier.VerifyTable(text_embedding()) &&
+           VerifyOffset(verifier, VT_ACTIVITY_EMBEDDING) &&
+           verifier.VerifyTable(activity_embedding()) &&
+           VerifyOffset(verifier, VT_RESOURCE_ID_EMBEDDING) &&
+           verifier.VerifyTable(resource_id_embedding()) &&
+           VerifyOffset(verifier, VT_ICON_EMBEDDING) &&
+           verifier.VerifyTable(icon_embedding()) &&
            verifier.EndTable();
   }
 };
@@ -383,6 +593,18 @@ struct WidgetSimilarityAttributesBuilder {
   void add_icon_base64(flatbuffers::Offset<flatbuffers::String> icon_base64) {
     fbb_.AddOffset(WidgetSimilarityAttributes::VT_ICON_BASE64, icon_base64);
   }
+  void add_text_embedding(flatbuffers::Offset<QuantizedEmbedding> text_embedding) {
+    fbb_.AddOffset(WidgetSimilarityAttributes::VT_TEXT_EMBEDDING, text_embedding);
+  }
+  void add_activity_embedding(flatbuffers::Offset<QuantizedEmbedding> activity_embedding) {
+    fbb_.AddOffset(WidgetSimilarityAttributes::VT_ACTIVITY_EMBEDDING, activity_embedding);
+  }
+  void add_resource_id_embedding(flatbuffers::Offset<QuantizedEmbedding> resource_id_embedding) {
+    fbb_.AddOffset(WidgetSimilarityAttributes::VT_RESOURCE_ID_EMBEDDING, resource_id_embedding);
+  }
+  void add_icon_embedding(flatbuffers::Offset<QuantizedEmbedding> icon_embedding) {
+    fbb_.AddOffset(WidgetSimilarityAttributes::VT_ICON_EMBEDDING, icon_embedding);
+  }
   explicit WidgetSimilarityAttributesBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -399,8 +621,16 @@ inline flatbuffers::Offset<WidgetSimilarityAttributes> CreateWidgetSimilarityAtt
     flatbuffers::Offset<flatbuffers::String> text = 0,
     flatbuffers::Offset<flatbuffers::String> activity_name = 0,
     flatbuffers::Offset<flatbuffers::String> resource_id = 0,
-    flatbuffers::Offset<flatbuffers::String> icon_base64 = 0) {
+    flatbuffers::Offset<flatbuffers::String> icon_base64 = 0,
+    flatbuffers::Offset<QuantizedEmbedding> text_embedding = 0,
+    flatbuffers::Offset<QuantizedEmbedding> activity_embedding = 0,
+    flatbuffers::Offset<QuantizedEmbedding> resource_id_embedding = 0,
+    flatbuffers::Offset<QuantizedEmbedding> icon_embedding = 0) {
   WidgetSimilarityAttributesBuilder builder_(_fbb);
+  builder_.add_icon_embedding(icon_embedding);
+  builder_.add_resource_id_embedding(resource_id_embedding);
+  builder_.add_activity_embedding(activity_embedding);
+  builder_.add_text_embedding(text_embedding);
   builder_.add_icon_base64(icon_base64);
   builder_.add_resource_id(resource_id);
   builder_.add_activity_name(activity_name);
@@ -473,7 +703,370 @@ inline flatbuffers::Offset<ActionSimilarityAttributes> CreateActionSimilarityAtt
 }
 
 
+struct ActivityRecord FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  typedef ActivityRecordBuilder Builder;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_NAME = 4,
+    VT_EMBEDDING = 6
+  };
+  const flatbuffers::String *name() const {
+    return GetPointer<const flatbuffers::String *>(VT_NAME);
+  }
+  const QuantizedEmbedding *embedding() const {
+    return GetPointer<const QuantizedEmbedding *>(VT_EMBEDDING);
+  }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyOffset(verifier, VT_NAME) &&
+           verifier.VerifyString(name()) &&
+           VerifyOffset(verifier, VT_EMBEDDING) &&
+           verifier.VerifyTable(embedding()) &&
+           verifier.EndTable();
+  }
+};
+
+struct ActivityRecordBuilder {
+  typedef ActivityRecord Table;
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_name(flatbuffers::Offset<flatbuffers::String> name) {
+    fbb_.AddOffset(ActivityRecord::VT_NAME, name);
+  }
+  void add_embedding(flatbuffers::Offset<QuantizedEmbedding> embedding) {
+    fbb_.AddOffset(ActivityRecord::VT_EMBEDDING, embedding);
+  }
+  explicit ActivityRecordBuilder(flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  flatbuffers::Offset<ActivityRecord> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = flatbuffers::Offset<ActivityRecord>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<ActivityRecord> CreateActivityRecord(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    flatbuffers::Offset<flatbuffers::String> name = 0,
+    flatbuffers::Offset<QuantizedEmbedding> embedding = 0) {
+  ActivityRecordBuilder builder_(_fbb);
+  builder_.add_embedding(embedding);
+  builder_.add_name(name);
+  return builder_.Finish();
+}
+
+struct IconRecord FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  typedef IconRecordBuilder Builder;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_BYTES = 4,
+    VT_EMBEDDING = 6
+  };
+  const flatbuffers::Vector<uint8_t> *bytes() const {
+    return GetPointer<const flatbuffers::Vector<uint8_t> *>(VT_BYTES);
+  }
+  const QuantizedEmbedding *embedding() const {
+    return GetPointer<const QuantizedEmbedding *>(VT_EMBEDDING);
+  }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyOffset(verifier, VT_BYTES) &&
+           verifier.VerifyVector(bytes()) &&
+           VerifyOffset(verifier, VT_EMBEDDING) &&
+           verifier.VerifyTable(embedding()) &&
+           verifier.EndTable();
+  }
+};
+
+struct IconRecordBuilder {
+  typedef IconRecord Table;
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_bytes(flatbuffers::Offset<flatbuffers::Vector<uint8_t>> bytes) {
+    fbb_.AddOffset(IconRecord::VT_BYTES, bytes);
+  }
+  void add_embedding(flatbuffers::Offset<QuantizedEmbedding> embedding) {
+    fbb_.AddOffset(IconRecord::VT_EMBEDDING, embedding);
+  }
+  explicit IconRecordBuilder(flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  flatbuffers::Offset<IconRecord> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = flatbuffers::Offset<IconRecord>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<IconRecord> CreateIconRecord(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> bytes = 0,
+    flatbuffers::Offset<QuantizedEmbedding> embedding = 0) {
+  IconRecordBuilder builder_(_fbb);
+  builder_.add_embedding(embedding);
+  builder_.add_bytes(bytes);
+  return builder_.Finish();
+}
+
+struct WidgetRecord FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  typedef WidgetRecordBuilder Builder;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_HASH = 4,
+    VT_TEXT = 6,
+    VT_RESOURCE_ID = 8,
+    VT_ACTIVITY = 10,
+    VT_ICON = 12,
+    VT_TEXT_EMBEDDING = 14,
+    VT_RESOURCE_ID_EMBEDDING = 16
+  };
+  uint64_t hash() const {
+    return GetField<uint64_t>(VT_HASH, 0);
+  }
+  const flatbuffers::String *text() const {
+    return GetPointer<const flatbuffers::String *>(VT_TEXT);
+  }
+  const flatbuffers::String *resource_id() const {
+    return GetPointer<const flatbuffers::String *>(VT_RESOURCE_ID);
+  }
+  uint32_t activity() const {
+    return GetField<uint32_t>(VT_ACTIVITY, 0);
+  }
+  uint32_t icon() const {
+    return GetField<uint32_t>(VT_ICON, 0);
+  }
+  const QuantizedEmbedding *text_embedding() const {
+    return GetPointer<const QuantizedEmbedding *>(VT_TEXT_EMBEDDING);
+  }
+  const QuantizedEmbedding *resource_id_embedding() const {
+    return GetPointer<const QuantizedEmbedding *>(VT_RESOURCE_ID_EMBEDDING);
+  }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<uint64_t>(verifier, VT_HASH) &&
+           VerifyOffset(verifier, VT_TEXT) &&
+           verifier.VerifyString(text()) &&
+           VerifyOffset(verifier, VT_RESOURCE_ID) &&
+           verifier.VerifyString(resource_id()) &&
+           VerifyField<uint32_t>(verifier, VT_ACTIVITY) &&
+           VerifyField<uint32_t>(verifier, VT_ICON) &&
+           VerifyOffset(verifier, VT_TEXT_EMBEDDING) &&
+           verifier.VerifyTable(text_embedding()) &&
+           VerifyOffset(verifier, VT_RESOURCE_ID_EMBEDDING) &&
+           verifier.VerifyTable(resource_id_embedding()) &&
+           verifier.EndTable();
+  }
+};
+
+struct WidgetRecordBuilder {
+  typedef WidgetRecord Table;
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_hash(uint64_t hash) {
+    fbb_.AddElement<uint64_t>(WidgetRecord::VT_HASH, hash, 0);
+  }
+  void add_text(flatbuffers::Offset<flatbuffers::String> text) {
+    fbb_.AddOffset(WidgetRecord::VT_TEXT, text);
+  }
+  void add_resource_id(flatbuffers::Offset<flatbuffers::String> resource_id) {
+    fbb_.AddOffset(WidgetRecord::VT_RESOURCE_ID, resource_id);
+  }
+  void add_activity(uint32_t activity) {
+    fbb_.AddElement<uint32_t>(WidgetRecord::VT_ACTIVITY, activity, 0);
+  }
+  void add_icon(uint32_t icon) {
+    fbb_.AddElement<uint32_t>(WidgetRecord::VT_ICON, icon, 0);
+  }
+  void add_text_embedding(flatbuffers::Offset<QuantizedEmbedding> text_embedding) {
+    fbb_.AddOffset(WidgetRecord::VT_TEXT_EMBEDDING, text_embedding);
+  }
+  void add_resource_id_embedding(flatbuffers::Offset<QuantizedEmbedding> resource_id_embedding) {
+    fbb_.AddOffset(WidgetRecord::VT_RESOURCE_ID_EMBEDDING, resource_id_embedding);
+  }
+  explicit WidgetRecordBuilder(flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  flatbuffers::Offset<WidgetRecord> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = flatbuffers::Offset<WidgetRecord>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<WidgetRecord> CreateWidgetRecord(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    uint64_t hash = 0,
+    flatbuffers::Offset<flatbuffers::String> text = 0,
+    flatbuffers::Offset<flatbuffers::String> resource_id = 0,
+    uint32_t activity = 0,
+    uint32_t icon = 0,
+    flatbuffers::Offset<QuantizedEmbedding> text_embedding = 0,
+    flatbuffers::Offset<QuantizedEmbedding> resource_id_embedding = 0) {
+  WidgetRecordBuilder builder_(_fbb);
+  builder_.add_hash(hash);
+  builder_.add_resource_id_embedding(resource_id_embedding);
+  builder_.add_text_embedding(text_embedding);
+  builder_.add_icon(icon);
+  builder_.add_activity(activity);
+  builder_.add_resource_id(resource_id);
+  builder_.add_text(text);
+  return builder_.Finish();
+}
+
+struct ActionRecord FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  typedef ActionRecordBuilder Builder;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_ACTION_TYPE = 4,
+    VT_ACTIVITY = 6,
+    VT_TARGET_WIDGET = 8
+  };
+  int32_t action_type() const {
+    return GetField<int32_t>(VT_ACTION_TYPE, 0);
+  }
+  uint32_t activity() const {
+    return GetField<uint32_t>(VT_ACTIVITY, 0);
+  }
+  uint32_t target_widget() const {
+    return GetField<uint32_t>(VT_TARGET_WIDGET, 0);
+  }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<int32_t>(verifier, VT_ACTION_TYPE) &&
+           VerifyField<uint32_t>(verifier, VT_ACTIVITY) &&
+           VerifyField<uint32_t>(verifier, VT_TARGET_WIDGET) &&
+           verifier.EndTable();
+  }
+};
+
+struct ActionRecordBuilder {
+  typedef ActionRecord Table;
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_action_type(int32_t action_type) {
+    fbb_.AddElement<int32_t>(ActionRecord::VT_ACTION_TYPE, action_type, 0);
+  }
+  void add_activity(uint32_t activity) {
+    fbb_.AddElement<uint32_t>(ActionRecord::VT_ACTIVITY, activity, 0);
+  }
+  void add_target_widget(uint32_t target_widget) {
+    fbb_.AddElement<uint32_t>(ActionRecord::VT_TARGET_WIDGET, target_widget, 0);
+  }
+  explicit ActionRecordBuilder(flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  flatbuffers::Offset<ActionRecord> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = flatbuffers::Offset<ActionRecord>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<ActionRecord> CreateActionRecord(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    int32_t action_type = 0,
+    uint32_t activity = 0,
+    uint32_t target_widget = 0) {
+  ActionRecordBuilder builder_(_fbb);
+  builder_.add_target_widget(target_widget);
+  builder_.add_activity(activity);
+  builder_.add_action_type(action_type);
+  return builder_.Finish();
+}
+
+struct ReuseEntryV2 FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  typedef ReuseEntryV2Builder Builder;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_ACTION = 4,
+    VT_ATTRIBUTES = 6,
+    VT_WIDGETS = 8,
+    VT_TAIL_COUNT = 10
+  };
+  uint64_t action() const {
+    return GetField<uint64_t>(VT_ACTION, 0);
+  }
+  bool KeyCompareLessThan(const ReuseEntryV2 *o) const {
+    return action() < o->action();
+  }
+  int KeyCompareWithValue(uint64_t val) const {
+    return static_cast<int>(action() > val) - static_cast<int>(action() < val);
+  }
+  uint32_t attributes() const {
+    return GetField<uint32_t>(VT_ATTRIBUTES, 0);
+  }
+  const flatbuffers::Vector<const fastbotx::WidgetCountRef *> *widgets() const {
+    return GetPointer<const flatbuffers::Vector<const fastbotx::WidgetCountRef *> *>(VT_WIDGETS);
+  }
+  int32_t tail_count() const {
+    return GetField<int32_t>(VT_TAIL_COUNT, 0);
+  }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<uint64_t>(verifier, VT_ACTION) &&
+           VerifyField<uint32_t>(verifier, VT_ATTRIBUTES) &&
+           VerifyOffset(verifier, VT_WIDGETS) &&
+           verifier.VerifyVector(widgets()) &&
+           VerifyField<int32_t>(verifier, VT_TAIL_COUNT) &&
+           verifier.EndTable();
+  }
+};
+
+struct ReuseEntryV2Builder {
+  typedef ReuseEntryV2 Table;
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_action(uint64_t action) {
+    fbb_.AddElement<uint64_t>(ReuseEntryV2::VT_ACTION, action, 0);
+  }
+  void add_attributes(uint32_t attributes) {
+    fbb_.AddElement<uint32_t>(ReuseEntryV2::VT_ATTRIBUTES, attributes, 0);
+  }
+  void add_widgets(flatbuffers::Offset<flatbuffers::Vector<const fastbotx::WidgetCountRef *>> widgets) {
+    fbb_.AddOffset(ReuseEntryV2::VT_WIDGETS, widgets);
+  }
+  void add_tail_count(int32_t tail_count) {
+    fbb_.AddElement<int32_t>(ReuseEntryV2::VT_TAIL_COUNT, tail_count, 0);
+  }
+  explicit ReuseEntryV2Builder(flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  flatbuffers::Offset<ReuseEntryV2> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = flatbuffers::Offset<ReuseEntryV2>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<ReuseEntryV2> CreateReuseEntryV2(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    uint64_t action = 0,
+    uint32_t attributes = 0,
+    flatbuffers::Offset<flatbuffers::Vector<const fastbotx::WidgetCountRef *>> widgets = 0,
+    int32_t tail_count = 0) {
+  ReuseEntryV2Builder builder_(_fbb);
+  builder_.add_action(action);
+  builder_.add_tail_count(tail_count);
+  builder_.add_widgets(widgets);
+  builder_.add_attributes(attributes);
+  return builder_.Finish();
+}
 
+inline flatbuffers::Offset<ReuseEntryV2> CreateReuseEntryV2Direct(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    uint64_t action = 0,
+    uint32_t attributes = 0,
+    const std::vector<fastbotx::WidgetCountRef> *widgets = nullptr,
+    int32_t tail_count = 0) {
+  auto widgets__ = widgets ? _fbb.CreateVectorOfStructs<fastbotx::WidgetCountRef>(*widgets) : 0;
+  return fastbotx::CreateReuseEntryV2(
+      _fbb,
+      action,
+      attributes,
+      widgets__,
+      tail_count);
+}
 
 inline void FinishSizePrefixedWidgetReuseModelBuffer(
     flatbuffers::FlatBufferBuilder &fbb,
@@ -0,0 +1,134 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef LegacyReuseModelMerger_CPP_
+#define LegacyReuseModelMerger_CPP_
+
+// ReuseModel与WidgetReuseModel都定义了fastbotx::ReuseEntry，旧格式单独放在这个编译单元里
+#include "ReuseModelMerger.h"
+#include "../storage/ReuseModel_generated.h"
+#include "MergeLog.h"
+#include <map>
+
+namespace fastbotx {
+
+struct LegacyModelInput {
+    MappedModelFilePtr file;
+    SortedEntryTable<ReuseEntry> entries;
+};
+
+struct MergedLegacyEntry {
+    uint64_t action;
+    std::vector<std::pair<std::string, int>> counts;    // activity -> 合并后的次数，按名称升序
+};
+
+struct LegacyShardResult {
+    std::vector<MergedLegacyEntry> entries;
+    size_t inputEntries{0};
+    size_t prunedEntries{0};
+    size_t prunedCounts{0};
+};
+
+static LegacyShardResult mergeLegacyShard(const std::vector<const SortedEntryTable<ReuseEntry> *> &tables,
+                                          const MergeOptions &options, uint64_t first, uint64_t last) {
+    LegacyShardResult result;
+    std::map<std::string, int> counts;
+    mergeShardEntries<ReuseEntry>(tables, first, last, [&](uint64_t action,
+            const std::vector<std::pair<size_t, const ReuseEntry *>> &group) {
+        counts.clear();
+        for (const auto &member : group) {
+            result.inputEntries++;
+            const auto *targets = member.second->targets();
+            if (nullptr == targets) {
+                continue;
+            }
+            for (const auto *target : *targets) {
+                if (nullptr == target->activity()) {
+                    continue;
+                }
+                int &count = counts[target->activity()->str()];
+                count = saturatingAdd(count, target->times());
+            }
+        }
+        MergedLegacyEntry merged;
+        merged.action = action;
+        merged.counts.assign(counts.begin(), counts.end());
+        bool hadCounts = !merged.counts.empty();
+        result.prunedCounts += pruneCounts(merged.counts, options);
+        if (hadCounts && merged.counts.empty()) {
+            result.prunedEntries++;
+            return;
+        }
+        result.entries.push_back(std::move(merged));
+    });
+    return result;
+}
+
+bool mergeLegacyReuseModels(const MergeOptions &options, MergeStats &stats) {
+    unsigned threads = std::max(1u, options.threads);
+
+    std::vector<LegacyModelInput> inputs(options.inputs.size());
+    parallelFor(inputs.size(), threads, [&options, &inputs](size_t i) {
+        MappedModelFilePtr file = MappedModelFile::open(options.inputs[i]);
+        if (!file) {
+            BLOGE("skip %s: open failed", options.inputs[i].c_str());
+            return;
+        }
+        flatbuffers::Verifier verifier(file->data(), file->size());
+        if (!VerifyReuseModelBuffer(verifier) || nullptr == GetReuseModel(file->data())->model()) {
+            BLOGE("skip %s: not a reuse model", options.inputs[i].c_str());
+            return;
+        }
+        inputs[i].file = file;
+        inputs[i].entries.reset(GetReuseModel(file->data())->model());
+    });
+
+    std::vector<const SortedEntryTable<ReuseEntry> *> tables;
+    for (const auto &input : inputs) {
+        if (input.file) {
+            tables.push_back(&input.entries);
+        } else {
+            stats.skippedInputs++;
+        }
+    }
+    stats.inputs = tables.size();
+    if (tables.empty()) {
+        BLOGE("%s", "no reuse model to merge");
+        return false;
+    }
+
+    flatbuffers::FlatBufferBuilder builder;
+    std::vector<flatbuffers::Offset<ReuseEntry>> entries;
+    std::vector<flatbuffers::Offset<ActivityTimes>> targets;
+    std::function<LegacyShardResult(uint64_t, uint64_t)> merge = [&tables, &options](uint64_t first,
+                                                                                     uint64_t last) {
+        return mergeLegacyShard(tables, options, first, last);
+    };
+    std::function<void(LegacyShardResult &)> consume = [&](LegacyShardResult &shard) {
+        stats.inputEntries += shard.inputEntries;
+        stats.prunedEntries += shard.prunedEntries;
+        stats.prunedCounts += shard.prunedCounts;
+        for (const auto &merged : shard.entries) {
+            targets.clear();
+            for (const auto &count : merged.counts) {
+                // activity名称在各条目间大量重复，共享同一份字符串
+                targets.push_back(CreateActivityTimes(builder, builder.CreateSharedString(count.first), count.second));
+            }
+            entries.push_back(CreateReuseEntry(builder, merged.action, builder.CreateVector(targets)));
+        }
+    };
+    runShards<LegacyShardResult>(threads * 4, threads, merge, consume);
+
+    stats.outputEntries = entries.size();
+    builder.Finish(CreateReuseModel(builder, builder.CreateVector(entries)));
+    stats.outputBytes = builder.GetSize();
+    BLOG("merged %zu reuse models: %zu entries -> %zu actions", tables.size(), stats.inputEntries, entries.size());
+    return writeModelFile(options.output, builder.GetBufferPointer(), builder.GetSize());
+}
+
+} // namespace fastbotx
+
+#endif // LegacyReuseModelMerger_CPP_
@@ -0,0 +1,16 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef MergeLog_H_
+#define MergeLog_H_
+
+// 主机工具的日志：输出到stderr。不引入utils.hpp/Base.h，它们依赖的json等第三方头文件只在设备构建中可用
+#include <cstdio>
+
+#define BLOG(...) fprintf(stderr, __VA_ARGS__), fprintf(stderr, "\n")
+#define BLOGE(...) fprintf(stderr, "error: "), fprintf(stderr, __VA_ARGS__), fprintf(stderr, "\n")
+
+#endif // MergeLog_H_
@@ -0,0 +1,55 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef ReuseModelMerger_CPP_
+#define ReuseModelMerger_CPP_
+
+#include "ReuseModelMerger.h"
+#include "../storage/WidgetReuseModel_generated.h"
+#include "MergeLog.h"
+#include <cstdio>
+#include <fstream>
+
+namespace fastbotx {
+
+bool isWidgetReuseModelFile(const MappedModelFilePtr &file) {
+    if (!file) {
+        return false;
+    }
+    flatbuffers::Verifier verifier(file->data(), file->size());
+    if (!VerifyWidgetReuseModelBuffer(verifier)) {
+        return false;
+    }
+    // 两种模型的根表都没有file_identifier，按根表中出现的字段区分
+    const auto *root = flatbuffers::GetRoot<flatbuffers::Table>(file->data());
+    static const flatbuffers::voffset_t widgetOnlyFields[] = {
+            WidgetReuseModel::VT_PLATFORM_INFO, WidgetReuseModel::VT_SAVE_SIMILARITY_ATTRS,
+            WidgetReuseModel::VT_JOURNAL_SEQUENCE, WidgetReuseModel::VT_FORMAT_VERSION,
+            WidgetReuseModel::VT_ENTRIES, WidgetReuseModel::VT_WIDGETS};
+    for (flatbuffers::voffset_t field : widgetOnlyFields) {
+        if (root->CheckField(field)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool writeModelFile(const std::string &path, const uint8_t *data, size_t size) {
+    std::string tempFilePath = path + ".tmp";
+    std::ofstream outputFile(tempFilePath, std::ios::binary);
+    outputFile.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(size));
+    outputFile.close();
+    if (!outputFile.good() || 0 != std::rename(tempFilePath.c_str(), path.c_str())) {
+        BLOGE("write merged model to %s failed", path.c_str());
+        std::remove(tempFilePath.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace fastbotx
+
+#endif // ReuseModelMerger_CPP_
@@ -0,0 +1,184 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef ReuseModelMerger_H_
+#define ReuseModelMerger_H_
+
+#include "../desc/reuse/MappedModelFile.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace fastbotx {
+
+// 合并多台设备复用模型（.fbm）的选项
+struct MergeOptions {
+    std::vector<std::string> inputs;
+    std::string output;
+    unsigned threads;       // 解析和归并的线程数
+    int minCount;           // 合并后计数小于该值的widget（旧格式为activity）被丢弃，0表示不剪枝
+    int capCount;           // 合并后的计数上限，0表示不限
+    int maxWidgets;         // 每个action最多保留计数最大的多少个widget，0表示不限
+
+    MergeOptions() : threads(0), minCount(0), capCount(0), maxWidgets(0) {}
+};
+
+struct MergeStats {
+    size_t inputs{0};
+    size_t skippedInputs{0};
+    size_t inputEntries{0};
+    size_t outputEntries{0};
+    size_t prunedEntries{0};
+    size_t prunedCounts{0};
+    size_t outputBytes{0};
+};
+
+// 复用模型（WidgetReuseModel，v1文件在内存中转换为v2）：按action求和widget计数，属性取各输入中最完整的一份
+bool mergeWidgetReuseModels(const MergeOptions &options, MergeStats &stats);
+
+// 旧格式的复用模型（ReuseModel）：按(action, activity)求和次数
+bool mergeLegacyReuseModels(const MergeOptions &options, MergeStats &stats);
+
+// 根表中是否有WidgetReuseModel独有的字段；只有model字段的文件按旧格式的ReuseModel处理
+bool isWidgetReuseModelFile(const MappedModelFilePtr &file);
+
+// 两个计数相加，不超过int上限
+inline int saturatingAdd(int a, int b) {
+    long long sum = static_cast<long long>(a) + b;
+    return sum > INT_MAX ? INT_MAX : static_cast<int>(sum);
+}
+
+// 对合并后的一个action的计数剪枝：counts为(key, count)，按选项截断计数、丢弃低计数、只保留计数最大的若干个，
+// 结果仍按key升序；返回被丢弃的个数
+template<typename Key>
+size_t pruneCounts(std::vector<std::pair<Key, int>> &counts, const MergeOptions &options) {
+    size_t before = counts.size();
+    if (options.capCount > 0) {
+        for (auto &count : counts) {
+            count.second = std::min(count.second, options.capCount);
+        }
+    }
+    if (options.minCount > 0) {
+        counts.erase(std::remove_if(counts.begin(), counts.end(), [&options](const std::pair<Key, int> &count) {
+            return count.second < options.minCount;
+        }), counts.end());
+    }
+    if (options.maxWidgets > 0 && counts.size() > static_cast<size_t>(options.maxWidgets)) {
+        std::nth_element(counts.begin(), counts.begin() + options.maxWidgets, counts.end(),
+                         [](const std::pair<Key, int> &a, const std::pair<Key, int> &b) {
+                             return a.second > b.second;
+                         });
+        counts.resize(static_cast<size_t>(options.maxWidgets));
+        std::sort(counts.begin(), counts.end());
+    }
+    return before - counts.size();
+}
+
+// 在threads个线程上并行执行task(0..count-1)
+inline void parallelFor(size_t count, unsigned threads, const std::function<void(size_t)> &task) {
+    std::atomic<size_t> next(0);
+    auto worker = [&next, count, &task]() {
+        for (size_t i = next++; i < count; i = next++) {
+            task(i);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads && i < count; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : workers) {
+        thread.join();
+    }
+}
+
+// action hash空间按范围均分为shardCount片，第shard片为[first, last]
+inline void shardRange(size_t shard, size_t shardCount, uint64_t &first, uint64_t &last) {
+    auto boundary = [shardCount](size_t index) {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(index) << 64) / shardCount);
+    };
+    first = boundary(shard);
+    last = shard + 1 == shardCount ? UINT64_MAX : boundary(shard + 1) - 1;
+}
+
+// 分片归并的驱动：最多threads个分片同时在归并，结果严格按分片顺序（即action hash升序）交给consume，
+// consume之后即释放，因此同时驻留的只有窗口内的分片结果
+template<typename Result>
+void runShards(size_t shardCount, unsigned threads, const std::function<Result(uint64_t, uint64_t)> &merge,
+               const std::function<void(Result &)> &consume) {
+    std::deque<std::future<Result>> window;
+    size_t submitted = 0;
+    auto submit = [&]() {
+        uint64_t first;
+        uint64_t last;
+        shardRange(submitted++, shardCount, first, last);
+        window.push_back(std::async(std::launch::async, merge, first, last));
+    };
+    while (submitted < shardCount && window.size() < std::max(1u, threads)) {
+        submit();
+    }
+    while (!window.empty()) {
+        Result result = window.front().get();
+        window.pop_front();
+        if (submitted < shardCount) {
+            submit();
+        }
+        consume(result);
+    }
+}
+
+// 各输入中key落在[first, last]内的条目做k路归并：同一action在各输入中的条目（每个输入至多一条，
+// 表中重复的key只取第一条）按输入顺序交给visit，action按升序
+template<typename Entry>
+void mergeShardEntries(const std::vector<const SortedEntryTable<Entry> *> &tables, uint64_t first, uint64_t last,
+                       const std::function<void(uint64_t, const std::vector<std::pair<size_t, const Entry *>> &)> &visit) {
+    typedef std::pair<uint64_t, size_t> Cursor; // (action, 输入下标)
+    std::priority_queue<Cursor, std::vector<Cursor>, std::greater<Cursor>> heap;
+    std::vector<size_t> positions(tables.size());
+    for (size_t input = 0; input < tables.size(); ++input) {
+        positions[input] = tables[input]->lowerBound(first);
+        if (positions[input] < tables[input]->size() && tables[input]->at(positions[input])->action() <= last) {
+            heap.push(Cursor(tables[input]->at(positions[input])->action(), input));
+        }
+    }
+    std::vector<std::pair<size_t, const Entry *>> group;
+    while (!heap.empty()) {
+        uint64_t action = heap.top().first;
+        group.clear();
+        while (!heap.empty() && heap.top().first == action) {
+            size_t input = heap.top().second;
+            heap.pop();
+            const SortedEntryTable<Entry> &table = *tables[input];
+            size_t &position = positions[input];
+            group.emplace_back(input, table.at(position));
+            // 跳过同一输入中重复的key
+            do {
+                ++position;
+            } while (position < table.size() && table.at(position)->action() == action);
+            if (position < table.size() && table.at(position)->action() <= last) {
+                heap.push(Cursor(table.at(position)->action(), input));
+            }
+        }
+        // 相同action按输入下标出堆，group已按输入顺序
+        visit(action, group);
+    }
+}
+
+// 写到临时文件再rename，输出路径与某个输入相同时也不会破坏正在映射的输入
+bool writeModelFile(const std::string &path, const uint8_t *data, size_t size);
+
+} // namespace fastbotx
+
+#endif // ReuseModelMerger_H_
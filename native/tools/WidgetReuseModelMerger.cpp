@@ -0,0 +1,299 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+#ifndef WidgetReuseModelMerger_CPP_
+#define WidgetReuseModelMerger_CPP_
+
+#include "ReuseModelMerger.h"
+#include "../desc/reuse/WidgetReuseModelFormat.h"
+#include "../desc/reuse/CountMinSketch.h"
+#include "MergeLog.h"
+#include <cstdio>
+#include <unordered_map>
+
+namespace fastbotx {
+
+struct WidgetModelInput {
+    std::string path;
+    MappedModelFilePtr file;
+    const WidgetReuseModel *model{nullptr};
+    SortedEntryTable<ReuseEntryV2> entries;
+    bool hasTail{false};        // 有界模型的条目带长尾计数
+    CountMinSketchPtr sketch;   // 长尾计数的sketch（<path>.sketch），与模型的日志序号不一致时为空
+};
+
+// 属性来源：(输入下标, 字典下标)
+typedef std::pair<size_t, uint32_t> RecordSource;
+
+struct MergedWidgetEntry {
+    uint64_t action;
+    bool hasAttributes;
+    RecordSource attributes;                         // ActionRecord
+    std::vector<std::pair<uint64_t, int>> counts;    // widget hash -> 合并后的计数，按hash升序
+    int tailCount;                                   // 有界模型中长尾widget的计数之和
+};
+
+struct WidgetShardResult {
+    std::vector<MergedWidgetEntry> entries;
+    size_t inputEntries{0};
+    size_t prunedEntries{0};
+    size_t prunedCounts{0};
+};
+
+// 属性的完整程度：非空的属性和保存的向量越多越好，合并时取最完整的一份
+static int widgetRecordRichness(const WidgetReuseModel *model, uint32_t index) {
+    const auto *record = dictionaryRecord(model->widgets(), index);
+    if (nullptr == record) {
+        return -1;
+    }
+    int richness = 0;
+    richness += record->text() && record->text()->size() > 0;
+    richness += record->resource_id() && record->resource_id()->size() > 0;
+    richness += !embeddingView(record->text_embedding()).empty();
+    richness += !embeddingView(record->resource_id_embedding()).empty();
+    if (const auto *activity = dictionaryRecord(model->activities(), record->activity())) {
+        richness += 1 + !embeddingView(activity->embedding()).empty();
+    }
+    if (const auto *icon = dictionaryRecord(model->icons(), record->icon())) {
+        richness += 1 + !embeddingView(icon->embedding()).empty();
+    }
+    return richness;
+}
+
+static int actionRecordRichness(const WidgetReuseModel *model, uint32_t index) {
+    const auto *record = dictionaryRecord(model->actions(), index);
+    if (nullptr == record) {
+        return -1;
+    }
+    return (0 != record->activity()) + std::max(0, widgetRecordRichness(model, record->target_widget()));
+}
+
+static WidgetShardResult mergeWidgetShard(const std::vector<WidgetModelInput> &inputs,
+                                          const std::vector<const SortedEntryTable<ReuseEntryV2> *> &tables,
+                                          const MergeOptions &options, bool keepTail, uint64_t first,
+                                          uint64_t last) {
+    WidgetShardResult result;
+    std::unordered_map<uint64_t, int> counts;
+    mergeShardEntries<ReuseEntryV2>(tables, first, last, [&](uint64_t action,
+            const std::vector<std::pair<size_t, const ReuseEntryV2 *>> &group) {
+        MergedWidgetEntry merged;
+        merged.action = action;
+        merged.hasAttributes = false;
+        merged.tailCount = 0;
+        int bestActionRichness = 0;
+        counts.clear();
+        for (const auto &member : group) {
+            const WidgetReuseModel *model = inputs[member.first].model;
+            const ReuseEntryV2 *entry = member.second;
+            result.inputEntries++;
+            if (keepTail) {
+                merged.tailCount = saturatingAdd(merged.tailCount, entry->tail_count());
+            }
+            int actionRichness = actionRecordRichness(model, entry->attributes());
+            if (actionRichness >= 0 && (!merged.hasAttributes || actionRichness > bestActionRichness)) {
+                merged.hasAttributes = true;
+                merged.attributes = RecordSource(member.first, entry->attributes());
+                bestActionRichness = actionRichness;
+            }
+            if (nullptr == entry->widgets()) {
+                continue;
+            }
+            for (const auto *widgetRef : *entry->widgets()) {
+                const auto *record = dictionaryRecord(model->widgets(), widgetRef->widget());
+                if (nullptr == record) {
+                    continue;
+                }
+                uint64_t widgetHash = record->hash();
+                int &count = counts[widgetHash];
+                count = saturatingAdd(count, widgetRef->count());
+            }
+        }
+        merged.counts.assign(counts.begin(), counts.end());
+        std::sort(merged.counts.begin(), merged.counts.end());
+        bool hadCounts = !merged.counts.empty();
+        result.prunedCounts += pruneCounts(merged.counts, options);
+        if (hadCounts && merged.counts.empty()) {
+            // 所有widget都被剪掉的action整条丢弃
+            result.prunedEntries++;
+            return;
+        }
+        result.entries.push_back(std::move(merged));
+    });
+    return result;
+}
+
+bool mergeWidgetReuseModels(const MergeOptions &options, MergeStats &stats) {
+    unsigned threads = std::max(1u, options.threads);
+
+    // 并行打开输入：映射文件，v1在内存中转换为v2，校验后建立按key排序的条目表
+    std::vector<WidgetModelInput> inputs(options.inputs.size());
+    parallelFor(inputs.size(), threads, [&options, &inputs](size_t i) {
+        WidgetModelInput &input = inputs[i];
+        input.path = options.inputs[i];
+        MappedModelFilePtr file = MappedModelFile::open(input.path);
+        if (!isWidgetReuseModelFile(file)) {
+            BLOGE("skip %s: not a widget reuse model", input.path.c_str());
+            return;
+        }
+        if (WidgetReuseModelFormat::isV1(GetWidgetReuseModel(file->data()))) {
+            std::vector<uint8_t> converted;
+            if (!WidgetReuseModelFormat::convertToV2(file->data(), file->size(), converted)) {
+                BLOGE("skip %s: convert to v2 failed", input.path.c_str());
+                return;
+            }
+            file = MappedModelFile::fromBuffer(converted);
+        }
+        const WidgetReuseModel *model = GetWidgetReuseModel(file->data());
+        if (nullptr == model->entries()) {
+            BLOGE("skip %s: no entries", input.path.c_str());
+            return;
+        }
+        input.file = file;
+        input.model = model;
+        input.entries.reset(model->entries());
+        for (const auto *entry : *model->entries()) {
+            if (entry->tail_count() > 0) {
+                input.hasTail = true;
+                break;
+            }
+        }
+        if (input.hasTail) {
+            input.sketch = CountMinSketch::loadSnapshot(input.path, model->journal_sequence());
+        }
+    });
+
+    std::vector<WidgetModelInput> loaded;
+    for (auto &input : inputs) {
+        if (input.model) {
+            loaded.push_back(std::move(input));
+        } else {
+            stats.skippedInputs++;
+        }
+    }
+    stats.inputs = loaded.size();
+    if (loaded.empty()) {
+        BLOGE("%s", "no widget reuse model to merge");
+        return false;
+    }
+    // 长尾计数只有和sketch一起才有意义：各输入的sketch尺寸相同时逐个计数器相加，
+    // 有输入缺少sketch或尺寸不同时合并结果不保留长尾
+    CountMinSketchPtr mergedSketch;
+    bool keepTail = true;
+    for (const auto &input : loaded) {
+        if (!input.hasTail) {
+            continue;
+        }
+        if (!input.sketch) {
+            BLOG("%s has long-tail counts but no matching sketch, long-tail counts are dropped", input.path.c_str());
+            keepTail = false;
+            break;
+        }
+        if (!mergedSketch) {
+            mergedSketch = std::make_shared<CountMinSketch>(input.sketch->width(), input.sketch->depth());
+        }
+        if (!mergedSketch->merge(*input.sketch)) {
+            BLOG("sketch of %s is %zu x %zu, others are %zu x %zu, long-tail counts are dropped", input.path.c_str(),
+                 input.sketch->width(), input.sketch->depth(), mergedSketch->width(), mergedSketch->depth());
+            keepTail = false;
+            break;
+        }
+    }
+    if (!keepTail) {
+        mergedSketch.reset();
+    }
+    for (auto &input : loaded) {
+        input.sketch.reset();
+    }
+
+    // SortedEntryTable按值移动后仍指向同一块映射区，移动完成后再取指针
+    std::vector<const SortedEntryTable<ReuseEntryV2> *> tables;
+    for (const auto &input : loaded) {
+        tables.push_back(&input.entries);
+    }
+
+    // 每个widget在所有输入中属性最完整的WidgetRecord：输出字典按hash去重，分片不能各自挑选。
+    // 各输入的字典并行打分，再按输入顺序归并，完整程度相同时取靠前的输入
+    std::vector<std::vector<std::pair<uint64_t, std::pair<int, uint32_t>>>> inputWidgets(loaded.size());
+    parallelFor(loaded.size(), threads, [&loaded, &inputWidgets](size_t i) {
+        const WidgetReuseModel *model = loaded[i].model;
+        uint32_t size = model->widgets() ? model->widgets()->size() : 0;
+        auto &scored = inputWidgets[i];
+        scored.reserve(size);
+        for (uint32_t index = 1; index < size; ++index) {
+            const auto *record = dictionaryRecord(model->widgets(), index);
+            if (nullptr != record) {
+                scored.emplace_back(record->hash(), std::make_pair(widgetRecordRichness(model, index), index));
+            }
+        }
+    });
+    std::unordered_map<uint64_t, std::pair<int, RecordSource>> widgetSources;
+    for (size_t i = 0; i < inputWidgets.size(); ++i) {
+        for (const auto &widget : inputWidgets[i]) {
+            auto source = widgetSources.find(widget.first);
+            if (source == widgetSources.end()) {
+                widgetSources.emplace(widget.first, std::make_pair(widget.second.first,
+                                                                   RecordSource(i, widget.second.second)));
+            } else if (widget.second.first > source->second.first) {
+                source->second = std::make_pair(widget.second.first, RecordSource(i, widget.second.second));
+            }
+        }
+        std::vector<std::pair<uint64_t, std::pair<int, uint32_t>>>().swap(inputWidgets[i]);
+    }
+
+    flatbuffers::FlatBufferBuilder builder;
+    WidgetReuseDictionary dictionary(builder);
+    std::vector<flatbuffers::Offset<ReuseEntryV2>> entries;
+    std::vector<WidgetCountRef> widgetRefs;
+
+    // 分片在线程池中归并，输出按分片顺序流式写入builder，已写出的分片结果随即释放
+    std::function<WidgetShardResult(uint64_t, uint64_t)> merge = [&loaded, &tables, &options, keepTail](
+            uint64_t first, uint64_t last) {
+        return mergeWidgetShard(loaded, tables, options, keepTail, first, last);
+    };
+    std::function<void(WidgetShardResult &)> consume = [&](WidgetShardResult &shard) {
+        stats.inputEntries += shard.inputEntries;
+        stats.prunedEntries += shard.prunedEntries;
+        stats.prunedCounts += shard.prunedCounts;
+        for (const auto &merged : shard.entries) {
+            uint32_t attributes = merged.hasAttributes
+                                  ? dictionary.copyAction(loaded[merged.attributes.first].model,
+                                                          merged.attributes.second) : 0;
+            widgetRefs.clear();
+            for (const auto &count : merged.counts) {
+                uint32_t widgetIndex = dictionary.findWidget(count.first);
+                if (0 == widgetIndex) {
+                    const RecordSource &source = widgetSources[count.first].second;
+                    widgetIndex = dictionary.copyWidget(loaded[source.first].model, source.second);
+                }
+                widgetRefs.emplace_back(widgetIndex, count.second);
+            }
+            entries.push_back(CreateReuseEntryV2Direct(builder, merged.action, attributes, &widgetRefs,
+                                                              merged.tailCount));
+        }
+    };
+    runShards<WidgetShardResult>(threads * 4, threads, merge, consume);
+
+    stats.outputEntries = entries.size();
+    auto root = dictionary.finish(entries, "merged:" + std::to_string(loaded.size()), 0);
+    builder.Finish(root);
+    stats.outputBytes = builder.GetSize();
+    BLOG("merged %zu widget reuse models: %zu entries -> %zu actions, %zu widgets, %zu icons, %zu embeddings",
+         loaded.size(), stats.inputEntries, entries.size(), dictionary.widgetCount(), dictionary.iconCount(),
+         dictionary.embeddingCount());
+    if (!writeModelFile(options.output, builder.GetBufferPointer(), builder.GetSize())) {
+        return false;
+    }
+    // 输出的日志序号为0，sketch记录同一个序号；没有长尾时删除旧的sketch，避免加载时与新模型错配
+    if (mergedSketch) {
+        return mergedSketch->save(options.output, 0);
+    }
+    std::remove((options.output + ".sketch").c_str());
+    return true;
+}
+
+} // namespace fastbotx
+
+#endif // WidgetReuseModelMerger_CPP_
@@ -0,0 +1,90 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * @authors 
+ */
+// 合并多台设备上收集的复用模型（.fbm）为一个模型，主机上运行：
+//   fbm_merge -o merged.fbm [-j threads] [--min-count N] [--cap-count N] [--max-widgets N] inputs...
+// 输入按第一个可读文件的格式（WidgetReuseModel或旧的ReuseModel）合并，格式不同的输入被跳过
+#include "ReuseModelMerger.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace fastbotx;
+
+static void usage(const char *program) {
+    fprintf(stderr, "usage: %s -o output.fbm [-j threads] [--min-count N] [--cap-count N] [--max-widgets N] "
+                    "input.fbm...\n", program);
+}
+
+static bool parseCount(const char *value, int &out) {
+    char *end = nullptr;
+    long parsed = strtol(value, &end, 10);
+    if (nullptr == end || '\0' != *end || parsed < 0 || parsed > INT_MAX) {
+        return false;
+    }
+    out = static_cast<int>(parsed);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    MergeOptions options;
+    int threads = 0;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (0 == strcmp(arg, "-o") && hasValue) {
+            options.output = argv[++i];
+        } else if (0 == strcmp(arg, "-j") && hasValue) {
+            if (!parseCount(argv[++i], threads)) {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (0 == strcmp(arg, "--min-count") && hasValue) {
+            if (!parseCount(argv[++i], options.minCount)) {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (0 == strcmp(arg, "--cap-count") && hasValue) {
+            if (!parseCount(argv[++i], options.capCount)) {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (0 == strcmp(arg, "--max-widgets") && hasValue) {
+            if (!parseCount(argv[++i], options.maxWidgets)) {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if ('-' == arg[0]) {
+            usage(argv[0]);
+            return 2;
+        } else {
+            options.inputs.emplace_back(arg);
+        }
+    }
+    if (options.output.empty() || options.inputs.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+    options.threads = threads > 0 ? static_cast<unsigned>(threads)
+                                  : std::max(1u, std::thread::hardware_concurrency());
+
+    bool widgetModel = true;
+    for (const auto &input : options.inputs) {
+        MappedModelFilePtr file = MappedModelFile::open(input);
+        if (file) {
+            widgetModel = isWidgetReuseModelFile(file);
+            break;
+        }
+    }
+
+    MergeStats stats;
+    bool merged = widgetModel ? mergeWidgetReuseModels(options, stats) : mergeLegacyReuseModels(options, stats);
+    fprintf(stderr, "%s: %zu inputs (%zu skipped), %zu entries -> %zu entries, pruned %zu entries / %zu counts, "
+                    "%zu bytes\n", widgetModel ? "WidgetReuseModel" : "ReuseModel", stats.inputs,
+            stats.skippedInputs, stats.inputEntries, stats.outputEntries, stats.prunedEntries, stats.prunedCounts,
+            stats.outputBytes);
+    return merged ? 0 : 1;
+}